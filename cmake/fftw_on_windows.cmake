@@ -40,8 +40,8 @@ execute_process(
     RESULT_VARIABLE ExitCode)
 CheckExitCodeAndExitIfError("lib")
 
-target_link_libraries(${PROJECT_NAME} "${CMAKE_BINARY_DIR}/fftw/libfftw3-3.lib")
-target_include_directories(${PROJECT_NAME} PRIVATE "${CMAKE_BINARY_DIR}/fftw")
+target_link_libraries(${PROJECT_NAME}Core "${CMAKE_BINARY_DIR}/fftw/libfftw3-3.lib")
+target_include_directories(${PROJECT_NAME}Core PUBLIC "${CMAKE_BINARY_DIR}/fftw")
 
 file(COPY "${CMAKE_BINARY_DIR}/fftw/fftw3.h" DESTINATION "${CMAKE_SOURCE_DIR}/src")
 
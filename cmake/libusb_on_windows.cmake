@@ -25,8 +25,8 @@ else()
     message(FATAL_ERROR "Target architecture not known")
 endif()
 
-target_link_libraries(${PROJECT_NAME} "${LIBUSB_DIR}/${ARCH}/libusb-1.0.lib")
-target_include_directories(${PROJECT_NAME} PRIVATE "${LIBUSB_DIR}" "${LIBUSB_DIR}/libusb-1.0")
+target_link_libraries(${PROJECT_NAME}Core "${LIBUSB_DIR}/${ARCH}/libusb-1.0.lib")
+target_include_directories(${PROJECT_NAME}Core PUBLIC "${LIBUSB_DIR}" "${LIBUSB_DIR}/libusb-1.0")
 
 add_custom_command(TARGET ${PROJECT_NAME}
         POST_BUILD
@@ -0,0 +1,544 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  benchmark.cpp
+//
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include "dataanalyzer.h"
+#include "dso.h"
+#include "exporter.h"
+#include "glgenerator.h"
+#include "hantek/control.h"
+#include "hantek/history.h"
+#include "settings.h"
+#include "synthetic/generator.h"
+
+#define BENCHMARK_CHANNELS 2       ///< Number of simulated channels
+#define BENCHMARK_SAMPLERATE 100e6 ///< Samplerate of the test signals in S/s
+#define BENCHMARK_PHOSPHOR_OFF -1  ///< Phosphor depth that disables it
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class ConversionBenchmark                                     benchmark.cpp
+/// \brief Gives access to the raw data conversion of the Hantek::Control.
+/// The device specification is either set up like the one of a DSO-2090 or
+/// loaded by replaying a capture, the control thread itself is never run.
+class ConversionBenchmark : public Hantek::Control {
+public:
+  void setup();
+  bool open(const QString &fileName);
+  void convert(unsigned int recordLength, unsigned int channels);
+
+protected:
+  void run();
+
+private:
+  std::vector<unsigned char> data; ///< Pseudo random raw samples
+};
+
+/// \brief Initializes the specification of an 8 bit DSO-2090 without a device.
+void ConversionBenchmark::setup() {
+  this->specification.gainSteps.clear();
+  this->specification.gainSteps << 0.08 << 0.16 << 0.40 << 0.80 << 1.60
+                                << 4.00 << 8.0 << 16.0 << 40.0;
+  for (int channel = 0; channel < HANTEK_CHANNELS; ++channel) {
+    this->specification.voltageLimit[channel].clear();
+    for (int gainId = 0; gainId < this->specification.gainSteps.count();
+         ++gainId)
+      this->specification.voltageLimit[channel] << 255;
+  }
+  this->specification.sampleSize = 8;
+}
+
+/// \brief Initializes the specification from a capture.
+/// \param fileName The name of the capture file.
+/// \return true if the device was initialized.
+bool ConversionBenchmark::open(const QString &fileName) {
+  this->useReplay(fileName, false);
+  this->connectDevice();
+  this->wait();
+
+  return this->device->isConnected();
+}
+
+/// \brief Converts one acquisition of raw data.
+/// \param recordLength The number of samples per channel.
+/// \param channels The number of used channels.
+void ConversionBenchmark::convert(unsigned int recordLength,
+                                  unsigned int channels) {
+  Hantek::HistorySegment segment;
+  segment.id = 0;
+  segment.timestamp = 0;
+  segment.samplerate = BENCHMARK_SAMPLERATE;
+  segment.append = false;
+  segment.fastRate = channels == 1;
+  segment.triggerPoint = 0;
+  for (int channel = 0; channel < HANTEK_CHANNELS; ++channel) {
+    segment.gain[channel] = 0;
+    segment.offsetReal[channel] = 0.5;
+    segment.used[channel] = (unsigned int)channel < channels;
+  }
+  segment.dataLength = recordLength;
+  if (!segment.fastRate)
+    segment.dataLength *= HANTEK_CHANNELS;
+  if (this->specification.sampleSize > 8)
+    segment.dataLength *= 2;
+
+  if (this->data.size() < segment.dataLength) {
+    quint32 state = 1;
+    this->data.resize(segment.dataLength);
+    for (unsigned int index = 0; index < this->data.size(); ++index) {
+      state = state * 1664525 + 1013904223;
+      this->data[index] = state >> 24;
+    }
+  }
+
+  this->convertSamples(segment, &this->data.front());
+}
+
+/// \brief The control thread isn't needed for the conversion.
+void ConversionBenchmark::run() {}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class Benchmark                                               benchmark.cpp
+/// \brief Measures the stages of the processing pipeline.
+/// Every result is written as one JSON object per line.
+class Benchmark {
+public:
+  Benchmark(QFile *output, unsigned int iterations);
+  ~Benchmark();
+
+  void generate(unsigned int recordLength, unsigned int channels);
+  void convert(ConversionBenchmark *control, unsigned int recordLength,
+               unsigned int channels);
+  void analyze(unsigned int recordLength, unsigned int channels,
+               Dso::WindowFunction window);
+  void graphs(unsigned int recordLength, unsigned int channels, int depth);
+  void exportData(unsigned int recordLength, unsigned int channels,
+                  ExportFormat format, const QString &formatName);
+
+protected:
+  void setUp(unsigned int recordLength, unsigned int channels, bool spectrum);
+  void start();
+  void stop();
+  void report(const char *stage, unsigned int recordLength,
+              unsigned int channels, QJsonObject result);
+
+private:
+  QFile *output;           ///< The file that receives the results
+  unsigned int iterations; ///< Number of measured runs per configuration
+
+  DsoSettings *settings;                    ///< Settings for the pipeline
+  DataAnalyzer *dataAnalyzer;               ///< The analyzed data
+  std::vector<std::vector<double>> samples; ///< The generated samples
+  QMutex samplesMutex;                      ///< Mutex for the samples
+  Synthetic::Generator
+      generator[BENCHMARK_CHANNELS]; ///< The generated test signals
+  QTemporaryDir directory;           ///< Directory for the exported files
+
+  QElapsedTimer timer;       ///< Measures the current run
+  std::vector<qint64> times; ///< Duration of every run in ns
+};
+
+/// \brief Initializes the pipeline.
+/// \param output The file that receives the results.
+/// \param iterations Number of measured runs per configuration.
+Benchmark::Benchmark(QFile *output, unsigned int iterations) {
+  this->output = output;
+  this->iterations = iterations;
+
+  this->settings = new DsoSettings();
+  this->settings->setChannelCount(BENCHMARK_CHANNELS);
+  this->dataAnalyzer = new DataAnalyzer(this->settings);
+
+  // A noisy sine and a modulated carrier
+  Synthetic::Signal signal;
+  signal.frequency = 1e6;
+  signal.noise = 0.05;
+  this->generator[0].setSignal(signal);
+  signal.waveform = Synthetic::WAVEFORM_AM;
+  signal.frequency = 10e6;
+  signal.modulation = 100e3;
+  this->generator[1].setSignal(signal);
+
+  this->samples.resize(BENCHMARK_CHANNELS);
+}
+
+/// \brief Cleans up the pipeline.
+Benchmark::~Benchmark() {
+  delete this->dataAnalyzer;
+  delete this->settings;
+}
+
+/// \brief Measures the synthetic signal generation.
+/// \param recordLength The number of samples per channel.
+/// \param channels The number of used channels.
+void Benchmark::generate(unsigned int recordLength, unsigned int channels) {
+  for (unsigned int channel = 0; channel < channels; ++channel)
+    this->samples[channel].resize(recordLength);
+
+  for (unsigned int iteration = 0; iteration < this->iterations; ++iteration) {
+    this->start();
+    for (unsigned int channel = 0; channel < channels; ++channel)
+      this->generator[channel].generate(&this->samples[channel].front(),
+                                        recordLength, BENCHMARK_SAMPLERATE);
+    this->stop();
+  }
+
+  this->report("generate", recordLength, channels, QJsonObject());
+}
+
+/// \brief Measures the conversion of raw Hantek data.
+/// \param control The control with the specification of the device.
+/// \param recordLength The number of samples per channel.
+/// \param channels The number of used channels.
+void Benchmark::convert(ConversionBenchmark *control,
+                        unsigned int recordLength, unsigned int channels) {
+  for (unsigned int iteration = 0; iteration < this->iterations; ++iteration) {
+    this->start();
+    control->convert(recordLength, channels);
+    this->stop();
+  }
+
+  this->report("convert", recordLength, channels, QJsonObject());
+}
+
+/// \brief Measures the analysis including the spectrum.
+/// \param recordLength The number of samples per channel.
+/// \param channels The number of used channels.
+/// \param window The window function for the spectrum.
+void Benchmark::analyze(unsigned int recordLength, unsigned int channels,
+                        Dso::WindowFunction window) {
+  this->setUp(recordLength, channels, true);
+  this->settings->scope.spectrumWindow = window;
+
+  for (unsigned int iteration = 0; iteration < this->iterations; ++iteration) {
+    this->start();
+    this->dataAnalyzer->analyze(&this->samples, BENCHMARK_SAMPLERATE, false,
+                                &this->samplesMutex);
+    this->dataAnalyzer->wait();
+    this->stop();
+  }
+
+  QJsonObject result;
+  result["window"] = Dso::windowFunctionString(window);
+  this->report("analyze", recordLength, channels, result);
+}
+
+/// \brief Measures the generation of the vertex arrays.
+/// \param recordLength The number of samples per channel.
+/// \param channels The number of used channels.
+/// \param depth The digital phosphor depth, BENCHMARK_PHOSPHOR_OFF disables
+/// it.
+void Benchmark::graphs(unsigned int recordLength, unsigned int channels,
+                       int depth) {
+  this->setUp(recordLength, channels, false);
+  this->settings->view.digitalPhosphor = depth != BENCHMARK_PHOSPHOR_OFF;
+  this->settings->view.digitalPhosphorDepth = qMax(depth, 0);
+
+  this->dataAnalyzer->analyze(&this->samples, BENCHMARK_SAMPLERATE, false,
+                              &this->samplesMutex);
+  this->dataAnalyzer->wait();
+
+  GlGenerator generator(this->settings);
+  generator.setDataAnalyzer(this->dataAnalyzer);
+  for (unsigned int iteration = 0; iteration < this->iterations; ++iteration) {
+    this->start();
+    generator.generateGraphs();
+    this->stop();
+  }
+
+  QJsonObject result;
+  if (depth == BENCHMARK_PHOSPHOR_OFF)
+    result["phosphorDepth"] = QJsonValue();
+  else
+    result["phosphorDepth"] = depth;
+  this->report("graphs", recordLength, channels, result);
+}
+
+/// \brief Measures the export into a file.
+/// \param recordLength The number of samples per channel.
+/// \param channels The number of used channels.
+/// \param format The format of the exported file.
+/// \param formatName The name of the format in the results.
+void Benchmark::exportData(unsigned int recordLength, unsigned int channels,
+                           ExportFormat format, const QString &formatName) {
+  this->setUp(recordLength, channels, false);
+
+  this->dataAnalyzer->analyze(&this->samples, BENCHMARK_SAMPLERATE, false,
+                              &this->samplesMutex);
+  this->dataAnalyzer->wait();
+
+  QString fileName = this->directory.path() + "/export";
+  Exporter exporter(this->settings, this->dataAnalyzer);
+  exporter.setFilename(fileName);
+  exporter.setFormat(format);
+  qint64 size = 0;
+  for (unsigned int iteration = 0; iteration < this->iterations; ++iteration) {
+    this->start();
+    exporter.doExport();
+    this->stop();
+    size = QFile(fileName).size();
+    QFile::remove(fileName);
+    QFile::remove(fileName + ".json");
+  }
+
+  QJsonObject result;
+  result["format"] = formatName;
+  result["bytes"] = size;
+  this->report("export", recordLength, channels, result);
+}
+
+/// \brief Prepares the settings and the samples for a configuration.
+/// \param recordLength The number of samples per channel.
+/// \param channels The number of used channels.
+/// \param spectrum true, if the spectrum of the channels is calculated.
+void Benchmark::setUp(unsigned int recordLength, unsigned int channels,
+                      bool spectrum) {
+  for (int channel = 0; channel < this->settings->scope.voltage.count();
+       ++channel) {
+    bool used = (unsigned int)channel < channels;
+    this->settings->scope.voltage[channel].used = used;
+    this->settings->scope.spectrum[channel].used = used && spectrum;
+  }
+  this->settings->scope.horizontal.recordLength = recordLength;
+  this->settings->scope.horizontal.samplerate = BENCHMARK_SAMPLERATE;
+  this->settings->scope.horizontal.timebase =
+      recordLength / BENCHMARK_SAMPLERATE / DIVS_TIME;
+
+  for (unsigned int channel = 0; channel < BENCHMARK_CHANNELS; ++channel) {
+    if (channel >= channels) {
+      this->samples[channel].clear();
+      continue;
+    }
+    this->samples[channel].resize(recordLength);
+    this->generator[channel].generate(&this->samples[channel].front(),
+                                      recordLength, BENCHMARK_SAMPLERATE);
+  }
+}
+
+/// \brief Starts measuring one run.
+void Benchmark::start() { this->timer.start(); }
+
+/// \brief Stops measuring one run.
+void Benchmark::stop() { this->times.push_back(this->timer.nsecsElapsed()); }
+
+/// \brief Writes the statistics of the measured runs.
+/// \param stage The name of the measured stage.
+/// \param recordLength The number of samples per channel.
+/// \param channels The number of used channels.
+/// \param result Additional parameters of the configuration.
+void Benchmark::report(const char *stage, unsigned int recordLength,
+                       unsigned int channels, QJsonObject result) {
+  if (this->times.empty())
+    return;
+
+  std::sort(this->times.begin(), this->times.end());
+  double total = 0;
+  for (unsigned int index = 0; index < this->times.size(); ++index)
+    total += this->times[index];
+  double mean = total / this->times.size();
+
+  result["stage"] = stage;
+  result["recordLength"] = (double)recordLength;
+  result["channels"] = (int)channels;
+  result["iterations"] = (int)this->times.size();
+  result["minimumMs"] = this->times.front() / 1e6;
+  result["medianMs"] = this->times[this->times.size() / 2] / 1e6;
+  result["meanMs"] = mean / 1e6;
+  result["maximumMs"] = this->times.back() / 1e6;
+  result["samplesPerSecond"] = recordLength * channels / (mean / 1e9);
+
+  this->output->write(QJsonDocument(result).toJson(QJsonDocument::Compact) +
+                      '\n');
+  this->output->flush();
+  this->times.clear();
+}
+
+/// \brief Splits a comma separated list of numbers.
+/// \param text The list.
+/// \param values Receives the numbers.
+/// \return false if an entry isn't a number.
+bool parseList(const QString &text, std::vector<int> *values) {
+  QStringList entries = text.split(',', QString::SkipEmptyParts);
+  for (int entry = 0; entry < entries.size(); ++entry) {
+    bool ok = true;
+    if (entries[entry].trimmed() == "off")
+      values->push_back(BENCHMARK_PHOSPHOR_OFF);
+    else
+      values->push_back(entries[entry].trimmed().toInt(&ok));
+    if (!ok)
+      return false;
+  }
+
+  return !values->empty();
+}
+
+/// \brief Runs the selected stages for all configurations.
+int main(int argc, char *argv[]) {
+  QCoreApplication application(argc, argv);
+  QCoreApplication::setApplicationName("OpenHantekBenchmark");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Measures the processing stages of OpenHantek and writes the results "
+      "as JSON lines.");
+  parser.addHelpOption();
+  QCommandLineOption stagesOption(
+      "stages", "Comma separated stages: generate, convert, analyze, graphs, "
+                "export.",
+      "stages", "generate,convert,analyze,graphs,export");
+  parser.addOption(stagesOption);
+  QCommandLineOption recordLengthsOption(
+      "record-lengths", "Comma separated samples per channel.", "lengths",
+      "10240,102400,1048576");
+  parser.addOption(recordLengthsOption);
+  QCommandLineOption channelsOption(
+      "channels", "Comma separated numbers of used channels.", "counts",
+      "1,2");
+  parser.addOption(channelsOption);
+  QCommandLineOption windowsOption(
+      "windows", "Comma separated window function ids, see Dso::"
+                 "WindowFunction.",
+      "ids", QString("%1,%2,%3")
+                 .arg(Dso::WINDOW_RECTANGULAR)
+                 .arg(Dso::WINDOW_HANN)
+                 .arg(Dso::WINDOW_FLATTOP));
+  parser.addOption(windowsOption);
+  QCommandLineOption depthsOption(
+      "phosphor-depths", "Comma separated digital phosphor depths, off "
+                         "disables it and 0 is infinite.",
+      "depths", "off,16,256");
+  parser.addOption(depthsOption);
+  QCommandLineOption iterationsOption(
+      "iterations", "Measured runs per configuration.", "count", "20");
+  parser.addOption(iterationsOption);
+  QCommandLineOption captureOption(
+      "capture", "USB capture that initializes the raw data conversion, a "
+                 "DSO-2090 is assumed without it.",
+      "file");
+  parser.addOption(captureOption);
+  QCommandLineOption outputOption(
+      "output", "Write the results to <file> instead of stdout.", "file");
+  parser.addOption(outputOption);
+  parser.process(application);
+
+  std::vector<int> recordLengths, channelCounts, windows, depths;
+  if (!parseList(parser.value(recordLengthsOption), &recordLengths) ||
+      !parseList(parser.value(channelsOption), &channelCounts) ||
+      !parseList(parser.value(windowsOption), &windows) ||
+      !parseList(parser.value(depthsOption), &depths)) {
+    std::cerr << "Invalid list argument" << std::endl;
+    return 1;
+  }
+  for (unsigned int index = 0; index < channelCounts.size(); ++index)
+    if (channelCounts[index] < 1 || channelCounts[index] > BENCHMARK_CHANNELS) {
+      std::cerr << "Invalid channel count" << std::endl;
+      return 1;
+    }
+  for (unsigned int index = 0; index < windows.size(); ++index)
+    if (windows[index] < 0 || windows[index] >= Dso::WINDOW_COUNT) {
+      std::cerr << "Invalid window function" << std::endl;
+      return 1;
+    }
+  bool ok;
+  unsigned int iterations = parser.value(iterationsOption).toUInt(&ok);
+  if (!ok || iterations == 0) {
+    std::cerr << "Invalid iteration count" << std::endl;
+    return 1;
+  }
+  QStringList stages = parser.value(stagesOption).split(',');
+
+  QFile output;
+  if (parser.isSet(outputOption)) {
+    output.setFileName(parser.value(outputOption));
+    if (!output.open(QIODevice::WriteOnly)) {
+      std::cerr << "Can't open the output file" << std::endl;
+      return 1;
+    }
+  } else {
+    output.open(stdout, QIODevice::WriteOnly);
+  }
+
+  // The first line describes the environment
+  QJsonObject environment;
+  environment["benchmark"] = "OpenHantek";
+  environment["version"] = VERSION;
+  environment["qt"] = qVersion();
+  environment["threads"] = QThread::idealThreadCount();
+  output.write(QJsonDocument(environment).toJson(QJsonDocument::Compact) +
+               '\n');
+
+  Benchmark benchmark(&output, iterations);
+
+  ConversionBenchmark *control = 0;
+  if (stages.contains("convert")) {
+    control = new ConversionBenchmark();
+    if (!parser.isSet(captureOption))
+      control->setup();
+    else if (!control->open(parser.value(captureOption))) {
+      std::cerr << "Can't initialize the device from the capture"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  for (unsigned int lengthIndex = 0; lengthIndex < recordLengths.size();
+       ++lengthIndex) {
+    unsigned int recordLength = recordLengths[lengthIndex];
+    for (unsigned int channelIndex = 0; channelIndex < channelCounts.size();
+         ++channelIndex) {
+      unsigned int channels = channelCounts[channelIndex];
+
+      if (stages.contains("generate"))
+        benchmark.generate(recordLength, channels);
+      if (control)
+        benchmark.convert(control, recordLength, channels);
+      if (stages.contains("analyze"))
+        for (unsigned int index = 0; index < windows.size(); ++index)
+          benchmark.analyze(recordLength, channels,
+                            (Dso::WindowFunction)windows[index]);
+      if (stages.contains("graphs"))
+        for (unsigned int index = 0; index < depths.size(); ++index)
+          benchmark.graphs(recordLength, channels, depths[index]);
+      if (stages.contains("export")) {
+        benchmark.exportData(recordLength, channels, EXPORT_FORMAT_CSV, "csv");
+        benchmark.exportData(recordLength, channels, EXPORT_FORMAT_FLOAT32,
+                             "float32");
+        benchmark.exportData(recordLength, channels, EXPORT_FORMAT_NPY, "npy");
+      }
+    }
+  }
+
+  delete control;
+
+  return 0;
+}
@@ -0,0 +1,399 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  ringlatency.cpp
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <time.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QStringList>
+#include <QThread>
+
+#include "ringreader.h"
+
+#include "sharedring.h"
+
+#define RINGLATENCY_SAMPLERATE 1e6 ///< Samplerate of the published frames
+#define RINGLATENCY_TIMEOUT 10000  ///< Longest wait for a frame in ms
+
+/// \brief Get the time of the clock the writer uses for the timestamps.
+/// \return The CLOCK_MONOTONIC time in ns.
+static int64_t monotonicNow() {
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (int64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class RingPublisher                                         ringlatency.cpp
+/// \brief Publishes frames at a fixed rate like the control thread would.
+class RingPublisher : public QThread {
+public:
+  RingPublisher(SharedRing *ring, unsigned int recordLength,
+                unsigned int channels, unsigned int frames, double rate);
+
+protected:
+  void run();
+
+private:
+  SharedRing *ring;                         ///< The ring the frames go into
+  std::vector<std::vector<double>> samples; ///< The published samples
+  QMutex samplesMutex;                      ///< Mutex for the samples
+  unsigned int frames;                      ///< Number of published frames
+  double rate;                              ///< Published frames per second
+};
+
+/// \brief Prepares the samples of the frames.
+/// \param ring The ring the frames go into.
+/// \param recordLength The number of samples per channel.
+/// \param channels The number of channels.
+/// \param frames The number of published frames.
+/// \param rate The published frames per second.
+RingPublisher::RingPublisher(SharedRing *ring, unsigned int recordLength,
+                             unsigned int channels, unsigned int frames,
+                             double rate) {
+  this->ring = ring;
+  this->frames = frames;
+  this->rate = rate;
+
+  this->samples.resize(channels);
+  for (unsigned int channel = 0; channel < channels; ++channel) {
+    this->samples[channel].resize(recordLength);
+    for (unsigned int index = 0; index < recordLength; ++index)
+      this->samples[channel][index] = (double)(index % 256) / 128 - 1;
+  }
+}
+
+/// \brief Publishes all frames, each one at its scheduled time.
+void RingPublisher::run() {
+  QElapsedTimer timer;
+  timer.start();
+
+  for (unsigned int frame = 0; frame < this->frames; ++frame) {
+    qint64 due = (qint64)(frame * 1e9 / this->rate);
+    qint64 remaining = due - timer.nsecsElapsed();
+    if (remaining > 0)
+      QThread::usleep(remaining / 1000);
+
+    this->ring->publish(&this->samples, RINGLATENCY_SAMPLERATE, false,
+                        &this->samplesMutex);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class RingLatency                                           ringlatency.cpp
+/// \brief Measures the time from the publication until a reader has a frame.
+/// The reader polls the ring without sleeping, so the results show the cost of
+/// the ring itself. Every result is written as one JSON object per line.
+class RingLatency {
+public:
+  RingLatency(QFile *output, RingReader *reader, bool zeroCopy);
+
+  bool measure(unsigned int frames, RingPublisher *publisher);
+  void report(QJsonObject result);
+
+private:
+  QFile *output;             ///< The file that receives the results
+  RingReader *reader;        ///< The reader that consumes the frames
+  bool zeroCopy;             ///< Read the samples in the shared memory
+  std::vector<qint64> times; ///< Latency of every frame in ns
+  uint64_t samples;          ///< Number of samples read
+  double checksum;           ///< Sum of the samples read without a copy
+};
+
+/// \brief Initializes the measurement.
+/// \param output The file that receives the results.
+/// \param reader The opened reader.
+/// \param zeroCopy true to use acquire() and release() instead of read().
+RingLatency::RingLatency(QFile *output, RingReader *reader, bool zeroCopy) {
+  this->output = output;
+  this->reader = reader;
+  this->zeroCopy = zeroCopy;
+  this->samples = 0;
+  this->checksum = 0;
+}
+
+/// \brief Reads frames and measures the latency of each one.
+/// \param frames The number of frames that should be measured, including the
+/// lost ones.
+/// \param publisher The publisher that has to finish too, or null.
+/// \return false if no frame arrived within RINGLATENCY_TIMEOUT.
+bool RingLatency::measure(unsigned int frames, RingPublisher *publisher) {
+  RingFrame frame;
+  QElapsedTimer idle;
+  idle.start();
+
+  while (this->times.size() + this->reader->getLost() < frames) {
+    int64_t timestamp;
+    if (this->zeroCopy) {
+      uint64_t sequence;
+      const SharedRingSlot *slot = this->reader->acquire(&sequence);
+      if (!slot) {
+        if (idle.elapsed() > RINGLATENCY_TIMEOUT)
+          return false;
+        continue;
+      }
+      timestamp = slot->timestamp;
+      // Summing the samples touches them like a consumer would
+      unsigned int channels = std::min<unsigned int>(
+          slot->channelCount, this->reader->getChannelCount());
+      uint64_t count = 0;
+      double sum = 0;
+      for (unsigned int channel = 0; channel < channels; ++channel) {
+        const double *data = this->reader->getSamples(slot, channel);
+        uint64_t length =
+            std::min<uint64_t>(slot->samples[channel],
+                               this->reader->getCapacity());
+        for (uint64_t index = 0; index < length; ++index)
+          sum += data[index];
+        count += length;
+      }
+      if (!this->reader->release(slot, sequence))
+        continue;
+      this->samples += count;
+      this->checksum += sum;
+    } else {
+      if (!this->reader->read(&frame)) {
+        if (idle.elapsed() > RINGLATENCY_TIMEOUT)
+          return false;
+        continue;
+      }
+      timestamp = frame.timestamp;
+      for (unsigned int channel = 0; channel < frame.samples.size();
+           ++channel)
+        this->samples += frame.samples[channel].size();
+    }
+
+    this->times.push_back(monotonicNow() - timestamp);
+    idle.restart();
+  }
+
+  if (publisher)
+    publisher->wait();
+
+  return true;
+}
+
+/// \brief Writes the statistics of the measured frames.
+/// \param result Parameters of the configuration.
+void RingLatency::report(QJsonObject result) {
+  if (this->times.empty())
+    return;
+
+  std::sort(this->times.begin(), this->times.end());
+  double total = 0;
+  for (unsigned int index = 0; index < this->times.size(); ++index)
+    total += this->times[index];
+  double mean = total / this->times.size();
+
+  result["mode"] = this->zeroCopy ? "zero-copy" : "copy";
+  result["frames"] = (int)this->times.size();
+  result["lost"] = (double)this->reader->getLost();
+  result["samples"] = (double)this->samples;
+  result["minimumUs"] = this->times.front() / 1e3;
+  result["medianUs"] = this->times[this->times.size() / 2] / 1e3;
+  result["p99Us"] = this->times[this->times.size() * 99 / 100] / 1e3;
+  result["meanUs"] = mean / 1e3;
+  result["maximumUs"] = this->times.back() / 1e3;
+
+  this->output->write(QJsonDocument(result).toJson(QJsonDocument::Compact) +
+                      '\n');
+  this->output->flush();
+  this->times.clear();
+  this->samples = 0;
+}
+
+/// \brief Splits a comma separated list of numbers.
+/// \param text The list.
+/// \param values Receives the numbers.
+/// \return false if an entry isn't a positive number.
+bool parseList(const QString &text, std::vector<unsigned int> *values) {
+  QStringList entries = text.split(',', QString::SkipEmptyParts);
+  for (int entry = 0; entry < entries.size(); ++entry) {
+    bool ok;
+    values->push_back(entries[entry].trimmed().toUInt(&ok));
+    if (!ok || !values->back())
+      return false;
+  }
+
+  return !values->empty();
+}
+
+/// \brief Measures the latency of the shared memory ring.
+int main(int argc, char *argv[]) {
+  QCoreApplication application(argc, argv);
+  QCoreApplication::setApplicationName("OpenHantekRingLatency");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Measures the latency from publishing an acquisition into the shared "
+      "memory ring until a reader has it and writes the results as JSON "
+      "lines.");
+  parser.addHelpOption();
+  QCommandLineOption attachOption(
+      "attach", "Read the ring <name> of a running OpenHantek instead of "
+                "publishing test frames.",
+      "name");
+  parser.addOption(attachOption);
+  QCommandLineOption recordLengthsOption(
+      "record-lengths", "Comma separated samples per channel.", "lengths",
+      "1024,10240,102400,1048576");
+  parser.addOption(recordLengthsOption);
+  QCommandLineOption channelsOption(
+      "channels", "Number of published channels.", "count", "2");
+  parser.addOption(channelsOption);
+  QCommandLineOption framesOption(
+      "frames", "Measured frames per configuration.", "count", "1000");
+  parser.addOption(framesOption);
+  QCommandLineOption rateOption(
+      "rate", "Published frames per second.", "rate", "200");
+  parser.addOption(rateOption);
+  QCommandLineOption slotsOption(
+      "slots", "Slots of the published ring.", "count",
+      QString::number(SHAREDRING_DEFAULT_SLOTS));
+  parser.addOption(slotsOption);
+  QCommandLineOption zeroCopyOption(
+      "zero-copy", "Read the samples in the shared memory instead of copying "
+                   "them.");
+  parser.addOption(zeroCopyOption);
+  QCommandLineOption outputOption(
+      "output", "Write the results to <file> instead of stdout.", "file");
+  parser.addOption(outputOption);
+  parser.process(application);
+
+  std::vector<unsigned int> recordLengths;
+  if (!parseList(parser.value(recordLengthsOption), &recordLengths)) {
+    std::cerr << "Invalid list argument" << std::endl;
+    return 1;
+  }
+  bool ok;
+  unsigned int channels = parser.value(channelsOption).toUInt(&ok);
+  if (!ok || channels < 1 || channels > SHAREDRING_CHANNELS) {
+    std::cerr << "Invalid channel count" << std::endl;
+    return 1;
+  }
+  unsigned int frames = parser.value(framesOption).toUInt(&ok);
+  if (!ok || frames == 0) {
+    std::cerr << "Invalid frame count" << std::endl;
+    return 1;
+  }
+  double rate = parser.value(rateOption).toDouble(&ok);
+  if (!ok || rate <= 0) {
+    std::cerr << "Invalid rate" << std::endl;
+    return 1;
+  }
+  unsigned int slotCount = parser.value(slotsOption).toUInt(&ok);
+  if (!ok || slotCount == 0) {
+    std::cerr << "Invalid slot count" << std::endl;
+    return 1;
+  }
+  bool zeroCopy = parser.isSet(zeroCopyOption);
+
+  QFile output;
+  if (parser.isSet(outputOption)) {
+    output.setFileName(parser.value(outputOption));
+    if (!output.open(QIODevice::WriteOnly)) {
+      std::cerr << "Can't open the output file" << std::endl;
+      return 1;
+    }
+  } else {
+    output.open(stdout, QIODevice::WriteOnly);
+  }
+
+  // The first line describes the environment
+  QJsonObject environment;
+  environment["benchmark"] = "OpenHantekRingLatency";
+  environment["version"] = VERSION;
+  environment["qt"] = qVersion();
+  environment["threads"] = QThread::idealThreadCount();
+  output.write(QJsonDocument(environment).toJson(QJsonDocument::Compact) +
+               '\n');
+
+  RingReader reader;
+  if (parser.isSet(attachOption)) {
+    QByteArray name = parser.value(attachOption).toLocal8Bit();
+    if (!reader.open(name.constData())) {
+      std::cerr << "Can't open the ring: " << strerror(errno) << std::endl;
+      return 1;
+    }
+
+    RingLatency latency(&output, &reader, zeroCopy);
+    if (!latency.measure(frames, 0)) {
+      std::cerr << "No frames within " << RINGLATENCY_TIMEOUT << " ms"
+                << std::endl;
+      return 1;
+    }
+    QJsonObject result;
+    result["ring"] = parser.value(attachOption);
+    result["channels"] = (int)reader.getChannelCount();
+    result["slots"] = (int)reader.getSlotCount();
+    latency.report(result);
+
+    return 0;
+  }
+
+  QString name = QString("openhantek-ringlatency-%1")
+                     .arg(QCoreApplication::applicationPid());
+  for (unsigned int lengthIndex = 0; lengthIndex < recordLengths.size();
+       ++lengthIndex) {
+    unsigned int recordLength = recordLengths[lengthIndex];
+
+    SharedRing ring;
+    if (!ring.open(name, channels, slotCount, recordLength)) {
+      std::cerr << "Can't create the ring: "
+                << ring.getErrorString().toLocal8Bit().constData()
+                << std::endl;
+      return 1;
+    }
+    if (!reader.open(name.toLocal8Bit().constData())) {
+      std::cerr << "Can't open the ring: " << strerror(errno) << std::endl;
+      return 1;
+    }
+
+    RingPublisher publisher(&ring, recordLength, channels, frames, rate);
+    RingLatency latency(&output, &reader, zeroCopy);
+    publisher.start();
+    if (!latency.measure(frames, &publisher)) {
+      std::cerr << "No frames within " << RINGLATENCY_TIMEOUT << " ms"
+                << std::endl;
+      publisher.wait();
+      return 1;
+    }
+    reader.close();
+
+    QJsonObject result;
+    result["recordLength"] = (double)recordLength;
+    result["channels"] = (int)channels;
+    result["slots"] = (int)slotCount;
+    result["rate"] = rate;
+    latency.report(result);
+  }
+
+  return 0;
+}
@@ -0,0 +1,245 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  ringreader.cpp
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ringreader.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// class RingReader
+/// \brief Initializes a closed reader.
+RingReader::RingReader() {
+  this->memory = 0;
+  this->size = 0;
+  this->header = 0;
+  this->next = 0;
+  this->lost = 0;
+}
+
+/// \brief Unmaps the shared memory.
+RingReader::~RingReader() { this->close(); }
+
+/// \brief Maps the ring of a running writer.
+/// Reading starts with the first acquisition published after this call.
+/// \param name The name of the shared memory object, a leading '/' is added.
+/// \return true if a valid ring has been mapped, errno tells the reason
+/// otherwise.
+bool RingReader::open(const char *name) {
+  this->close();
+
+  std::string objectName(name);
+  if (objectName.empty() || objectName[0] != '/')
+    objectName.insert(0, 1, '/');
+
+  int fd = shm_open(objectName.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    return false;
+  struct stat status;
+  if (fstat(fd, &status) < 0) {
+    ::close(fd);
+    return false;
+  }
+  if ((size_t)status.st_size < SHAREDRING_HEADER_SIZE) {
+    ::close(fd);
+    errno = EAGAIN;
+    return false;
+  }
+  void *memory = mmap(0, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (memory == MAP_FAILED)
+    return false;
+  this->memory = (unsigned char *)memory;
+  this->size = status.st_size;
+  this->header = (const SharedRingHeader *)this->memory;
+
+  // The writer sets the magic after all other fields of the header
+  if (this->header->magic.load(std::memory_order_acquire) !=
+      SHAREDRING_MAGIC) {
+    this->close();
+    errno = EAGAIN;
+    return false;
+  }
+  if (this->header->version != SHAREDRING_VERSION ||
+      this->header->channelCount > SHAREDRING_CHANNELS ||
+      !this->header->slotCount ||
+      this->size < SHAREDRING_HEADER_SIZE +
+                       this->header->slotCount * this->header->slotSize) {
+    this->close();
+    errno = EPROTO;
+    return false;
+  }
+
+  this->next = this->getLatest() + 1;
+  this->lost = 0;
+
+  return true;
+}
+
+/// \brief Unmaps the shared memory.
+void RingReader::close() {
+  if (!this->memory)
+    return;
+
+  munmap(this->memory, this->size);
+  this->memory = 0;
+  this->size = 0;
+  this->header = 0;
+}
+
+/// \brief Check if a ring has been mapped.
+/// \return true if the reader can be used.
+bool RingReader::isOpen() const { return this->memory != 0; }
+
+/// \brief Get the number of channels in every slot.
+/// \return The channel count of the ring.
+unsigned int RingReader::getChannelCount() const {
+  return this->header->channelCount;
+}
+
+/// \brief Get the number of acquisitions the ring holds.
+/// \return The slot count of the ring.
+unsigned int RingReader::getSlotCount() const {
+  return this->header->slotCount;
+}
+
+/// \brief Get the maximum number of samples per channel.
+/// \return The capacity of every channel in a slot.
+uint64_t RingReader::getCapacity() const { return this->header->capacity; }
+
+/// \brief Get the sequence number of the newest acquisition.
+/// \return The newest complete sequence, 0 if nothing has been published.
+uint64_t RingReader::getLatest() const {
+  return this->header->sequence.load(std::memory_order_acquire);
+}
+
+/// \brief Get the number of acquisitions that were overwritten too early.
+/// \return The lost acquisitions since open().
+uint64_t RingReader::getLost() const { return this->lost; }
+
+/// \brief Copies the next unread acquisition.
+/// \param frame The frame that receives the acquisition.
+/// \return false if no new acquisition has been published.
+bool RingReader::read(RingFrame *frame) {
+  uint64_t sequence;
+  const SharedRingSlot *slot;
+  while ((slot = this->acquire(&sequence))) {
+    frame->sequence = sequence;
+    frame->timestamp = slot->timestamp;
+    frame->samplerate = slot->samplerate;
+    frame->flags = slot->flags;
+    unsigned int channels = slot->channelCount;
+    if (channels > this->header->channelCount)
+      channels = this->header->channelCount;
+    frame->samples.resize(channels);
+    for (unsigned int channel = 0; channel < channels; ++channel) {
+      uint64_t count = slot->samples[channel];
+      if (count > this->header->capacity)
+        count = this->header->capacity;
+      frame->samples[channel].resize(count);
+      if (count)
+        memcpy(&frame->samples[channel].front(),
+               this->getSamples(slot, channel), count * sizeof(double));
+    }
+
+    if (this->release(slot, sequence))
+      return true;
+  }
+
+  return false;
+}
+
+/// \brief Gives access to the next unread acquisition without copying it.
+/// The slot stays in the shared memory and can be overwritten by the writer
+/// at any time, so every value read from it is only valid if release()
+/// returns true afterwards.
+/// \param sequence Receives the sequence number of the acquisition.
+/// \return The slot of the acquisition, null if nothing new was published.
+const SharedRingSlot *RingReader::acquire(uint64_t *sequence) {
+  while (this->skipOverwritten()) {
+    const SharedRingSlot *slot = this->getSlot(this->next);
+    uint64_t slotSequence = slot->sequence.load(std::memory_order_acquire);
+    *sequence = this->next++;
+    if (slotSequence == *sequence * 2)
+      return slot;
+    ++this->lost;
+  }
+
+  return 0;
+}
+
+/// \brief Get the samples of a channel in an acquired slot.
+/// \param slot The slot returned by acquire().
+/// \param channel The channel, the slot has SharedRingSlot::samples of them.
+/// \return The first sample of the channel.
+const double *RingReader::getSamples(const SharedRingSlot *slot,
+                                     unsigned int channel) const {
+  return (const double *)((const unsigned char *)slot +
+                          SHAREDRING_SLOT_HEADER_SIZE) +
+         channel * this->header->capacity;
+}
+
+/// \brief Checks that an acquired slot wasn't overwritten while it was read.
+/// \param slot The slot returned by acquire().
+/// \param sequence The sequence number acquire() returned with the slot.
+/// \return true if the values read from the slot are valid.
+bool RingReader::release(const SharedRingSlot *slot, uint64_t sequence) {
+  // All reads from the slot have to happen before the sequence is checked
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (slot->sequence.load(std::memory_order_relaxed) == sequence * 2)
+    return true;
+
+  ++this->lost;
+  return false;
+}
+
+/// \brief Get the slot of an acquisition.
+/// \param sequence The sequence number of the acquisition.
+/// \return The slot the acquisition is stored in.
+const SharedRingSlot *RingReader::getSlot(uint64_t sequence) const {
+  return (const SharedRingSlot *)(this->memory + SHAREDRING_HEADER_SIZE +
+                                  ((sequence - 1) % this->header->slotCount) *
+                                      this->header->slotSize);
+}
+
+/// \brief Skips the acquisitions the writer has overwritten or is writing.
+/// \return true if there is an unread acquisition.
+bool RingReader::skipOverwritten() {
+  uint64_t latest = this->getLatest();
+
+  // The slot after the latest one may be in use by the writer already
+  uint64_t oldest = 1;
+  if (latest + 2 > this->header->slotCount)
+    oldest = latest + 2 - this->header->slotCount;
+  if (oldest > latest)
+    oldest = latest;
+  if (this->next < oldest) {
+    this->lost += oldest - this->next;
+    this->next = oldest;
+  }
+
+  return this->next <= latest;
+}
@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file ringreader.h
+/// \brief Declares the RingReader class.
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef RINGREADER_H
+#define RINGREADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "sharedringlayout.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// \struct RingFrame                                               ringreader.h
+/// \brief A copy of one acquisition read from the ring.
+struct RingFrame {
+  uint64_t sequence;                        ///< Sequence number of the slot
+  int64_t timestamp;                        ///< Publication in ns, monotonic
+  double samplerate;                        ///< The samplerate in S/s
+  uint32_t flags;                           ///< SHAREDRING_FLAG_* values
+  std::vector<std::vector<double>> samples; ///< The voltages of each channel
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class RingReader                                               ringreader.h
+/// \brief Reads the acquisitions OpenHantek publishes into shared memory.
+/// The reader never blocks the writer, any number of processes can read the
+/// same ring. It only depends on POSIX, so it can be used without Qt.
+/// read() copies the next acquisition, acquire() and release() give access
+/// to the samples in the shared memory without a copy. If the reader is too
+/// slow, the oldest acquisitions are overwritten and counted as lost.
+class RingReader {
+public:
+  RingReader();
+  ~RingReader();
+
+  bool open(const char *name);
+  void close();
+  bool isOpen() const;
+
+  unsigned int getChannelCount() const;
+  unsigned int getSlotCount() const;
+  uint64_t getCapacity() const;
+  uint64_t getLatest() const;
+  uint64_t getLost() const;
+
+  bool read(RingFrame *frame);
+  const SharedRingSlot *acquire(uint64_t *sequence);
+  const double *getSamples(const SharedRingSlot *slot,
+                           unsigned int channel) const;
+  bool release(const SharedRingSlot *slot, uint64_t sequence);
+
+protected:
+  const SharedRingSlot *getSlot(uint64_t sequence) const;
+  bool skipOverwritten();
+
+private:
+  unsigned char *memory;          ///< The mapped shared memory, or null
+  size_t size;                    ///< The size of the mapping in bytes
+  const SharedRingHeader *header; ///< The header at the start of the memory
+  uint64_t next;                  ///< Sequence of the next unread slot
+  uint64_t lost;                  ///< Acquisitions overwritten before reading
+};
+
+#endif
@@ -0,0 +1,257 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  acquisition.cpp
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <utility>
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+#include "acquisition.h"
+
+#include "dataanalyzer.h"
+#include "dsocontrol.h"
+#include "settings.h"
+#include "tracing.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// struct AcquisitionFrame
+/// \brief Initializes the members to their default values.
+AcquisitionFrame::AcquisitionFrame() {
+  this->samplerate = 0.0;
+  this->append = false;
+  this->id = 0;
+  this->time = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class Acquisition
+/// \brief Creates the data analyzer for the pulled frames.
+/// \param dsoControl The controller for the oscilloscope.
+/// \param settings The settings the oscilloscope is configured with.
+/// \param parent The parent object.
+Acquisition::Acquisition(DsoControl *dsoControl, DsoSettings *settings,
+                         QObject *parent)
+    : QObject(parent) {
+  this->dsoControl = dsoControl;
+  this->settings = settings;
+  this->dataAnalyzer = new DataAnalyzer(this->settings, this);
+  this->connected = false;
+
+  this->queueLength = ACQUISITION_QUEUE_LENGTH;
+  this->frames = 0;
+  this->dropped = 0;
+
+  connect(this->dsoControl, SIGNAL(deviceConnected()), this,
+          SLOT(deviceConnected()), Qt::DirectConnection);
+  // Copy the samples in the control thread, the puller may be busy
+  connect(this->dsoControl,
+          SIGNAL(samplesAvailable(const std::vector<std::vector<double>> *,
+                                  double, bool, QMutex *)),
+          this,
+          SLOT(samplesAvailable(const std::vector<std::vector<double>> *,
+                                double, bool, QMutex *)),
+          Qt::DirectConnection);
+}
+
+/// \brief Waits for the running analysis.
+Acquisition::~Acquisition() { this->dataAnalyzer->wait(); }
+
+/// \brief Get the controller for the oscilloscope.
+/// \return The controller given to the constructor.
+DsoControl *Acquisition::getControl() { return this->dsoControl; }
+
+/// \brief Get the settings the oscilloscope is configured with.
+/// \return The settings given to the constructor.
+DsoSettings *Acquisition::getSettings() { return this->settings; }
+
+/// \brief Get the data analyzer that analyze() uses.
+/// \return The data analyzer, its mutex protects the analyzed data.
+DataAnalyzer *Acquisition::getDataAnalyzer() { return this->dataAnalyzer; }
+
+/// \brief Connects the oscilloscope.
+/// \return true if the oscilloscope has been connected.
+bool Acquisition::open() {
+  this->dsoControl->connectDevice();
+
+  return this->connected;
+}
+
+/// \brief Disconnects the oscilloscope and waits for its thread.
+void Acquisition::close() {
+  this->dsoControl->quit();
+  this->dsoControl->wait();
+  this->connected = false;
+}
+
+/// \brief Applies the oscilloscope settings to the controller.
+void Acquisition::configure() {
+  Acquisition::configure(this->dsoControl, this->settings);
+}
+
+/// \brief Applies oscilloscope settings to a controller.
+/// The main window uses it too, so both configure a new device the same way.
+/// \param dsoControl The controller of the oscilloscope.
+/// \param settings The settings that should be applied.
+void Acquisition::configure(DsoControl *dsoControl,
+                            const DsoSettings *settings) {
+  const DsoSettingsScope *scope = &(settings->scope);
+  bool mathUsed = scope->voltage[scope->physicalChannels].used ||
+                  scope->spectrum[scope->physicalChannels].used;
+
+  for (unsigned int channel = 0; channel < scope->physicalChannels;
+       ++channel) {
+    dsoControl->setCoupling(channel,
+                            (Dso::Coupling)scope->voltage[channel].misc);
+    dsoControl->setGain(channel, scope->voltage[channel].gain * DIVS_VOLTAGE);
+    dsoControl->setOffset(
+        channel, (scope->voltage[channel].offset / DIVS_VOLTAGE) + 0.5);
+    dsoControl->setTriggerLevel(channel, scope->voltage[channel].trigger);
+    dsoControl->setChannelUsed(channel, mathUsed ||
+                                            scope->voltage[channel].used ||
+                                            scope->spectrum[channel].used);
+  }
+
+  if (scope->horizontal.samplerateSet)
+    dsoControl->setSamplerate(scope->horizontal.samplerate);
+  else
+    dsoControl->setRecordTime(scope->horizontal.timebase * DIVS_TIME);
+  if (dsoControl->getAvailableRecordLengths()->isEmpty())
+    dsoControl->setRecordLength(scope->horizontal.recordLength);
+  else {
+    int index = dsoControl->getAvailableRecordLengths()->indexOf(
+        scope->horizontal.recordLength);
+    dsoControl->setRecordLength(index < 0 ? 1 : index);
+  }
+
+  dsoControl->setTriggerMode(scope->trigger.mode);
+  dsoControl->setPretriggerPosition(
+      scope->trigger.position * scope->horizontal.timebase * DIVS_TIME);
+  dsoControl->setTriggerSlope(scope->trigger.slope);
+  dsoControl->setTriggerSource(scope->trigger.special, scope->trigger.source);
+}
+
+/// \brief Discards the queued frames and starts sampling.
+void Acquisition::start() {
+  {
+    QMutexLocker locker(&this->queueMutex);
+    this->queue.clear();
+    this->frames = 0;
+    this->dropped = 0;
+  }
+
+  this->dsoControl->startSampling();
+}
+
+/// \brief Stops sampling, the queued frames can still be pulled.
+void Acquisition::stop() { this->dsoControl->stopSampling(); }
+
+/// \brief Sets how many frames are kept until they are pulled.
+/// \param frames The maximum number of queued frames, 0 disables the queue for
+/// programs that connect to the controller themselves.
+void Acquisition::setQueueLength(unsigned int frames) {
+  QMutexLocker locker(&this->queueMutex);
+  this->queueLength = frames;
+  while (this->queue.size() > this->queueLength) {
+    this->queue.pop_back();
+    ++this->dropped;
+  }
+}
+
+/// \brief Takes the oldest frame from the queue.
+/// \param frame The frame that gets the samples.
+/// \param timeout The time to wait for a frame in ms.
+/// \return false if no frame arrived before the timeout.
+bool Acquisition::pullFrame(AcquisitionFrame *frame, unsigned long timeout) {
+  QElapsedTimer timer;
+  timer.start();
+
+  QMutexLocker locker(&this->queueMutex);
+  while (this->queue.empty()) {
+    unsigned long remaining = ULONG_MAX;
+    if (timeout != ULONG_MAX) {
+      unsigned long elapsed = (unsigned long)timer.elapsed();
+      if (elapsed >= timeout)
+        return false;
+      remaining = timeout - elapsed;
+    }
+    this->queueNotEmpty.wait(&this->queueMutex, remaining);
+  }
+
+  std::swap(*frame, this->queue.front());
+  this->queue.pop_front();
+
+  return true;
+}
+
+/// \brief Get the number of frames dropped because the queue was full.
+/// \return The dropped frames since start().
+unsigned int Acquisition::getDropped() {
+  QMutexLocker locker(&this->queueMutex);
+  return this->dropped;
+}
+
+/// \brief Analyzes a pulled frame and waits until the analysis is done.
+/// The results can be read from getDataAnalyzer() afterwards.
+/// \param frame The frame that should be analyzed.
+void Acquisition::analyze(const AcquisitionFrame &frame) {
+  QMutex frameMutex;
+
+  this->dataAnalyzer->wait();
+  this->dataAnalyzer->analyze(&frame.samples, frame.samplerate, frame.append,
+                              &frameMutex);
+  this->dataAnalyzer->wait();
+}
+
+/// \brief Remembers that the oscilloscope has been connected.
+void Acquisition::deviceConnected() { this->connected = true; }
+
+/// \brief Queues a copy of new samples from the oscilloscope.
+/// \param data The data arrays with the samples of each channel.
+/// \param samplerate The samplerate for all samples.
+/// \param append The samples continue the previous ones (Roll mode).
+/// \param mutex The mutex for the data arrays.
+void Acquisition::samplesAvailable(const std::vector<std::vector<double>> *data,
+                                   double samplerate, bool append,
+                                   QMutex *mutex) {
+  Tracing::Scope span("Acquisition::samplesAvailable");
+
+  // Only the puller removes frames, so the checked space stays available
+  AcquisitionFrame frame;
+  {
+    QMutexLocker locker(&this->queueMutex);
+    frame.id = this->frames++;
+    if (this->queue.size() >= this->queueLength) {
+      if (this->queueLength)
+        ++this->dropped;
+      return;
+    }
+  }
+
+  mutex->lock();
+  frame.samples = *data;
+  mutex->unlock();
+  frame.samplerate = samplerate;
+  frame.append = append;
+  frame.time = Tracing::now();
+
+  QMutexLocker locker(&this->queueMutex);
+  this->queue.push_back(std::move(frame));
+  this->queueNotEmpty.wakeAll();
+}
@@ -0,0 +1,102 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file acquisition.h
+/// \brief Declares the Acquisition class.
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ACQUISITION_H
+#define ACQUISITION_H
+
+#include <climits>
+#include <deque>
+#include <vector>
+
+#include <QMutex>
+#include <QObject>
+#include <QWaitCondition>
+
+#define ACQUISITION_QUEUE_LENGTH 16 ///< Default number of queued frames
+
+class DataAnalyzer;
+class DsoControl;
+class DsoSettings;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \struct AcquisitionFrame                                       acquisition.h
+/// \brief The samples of one acquisition as sent by the oscilloscope.
+struct AcquisitionFrame {
+  std::vector<std::vector<double>> samples; ///< The voltages of each channel
+  double samplerate;                        ///< The samplerate in S/s
+  bool append;                              ///< Continues the last frame
+  unsigned int id;                          ///< Frame number since start()
+  qint64 time;                              ///< Arrival time in ns
+
+  AcquisitionFrame();
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class Acquisition                                             acquisition.h
+/// \brief Controls the oscilloscope and analyzes its data without any widgets.
+/// The received frames are queued, so a program can pull and analyze them at
+/// its own pace from any thread. Frames that arrive while the queue is full
+/// are dropped and counted.
+class Acquisition : public QObject {
+  Q_OBJECT
+
+public:
+  Acquisition(DsoControl *dsoControl, DsoSettings *settings,
+              QObject *parent = 0);
+  ~Acquisition();
+
+  DsoControl *getControl();
+  DsoSettings *getSettings();
+  DataAnalyzer *getDataAnalyzer();
+
+  bool open();
+  void close();
+  void configure();
+  void start();
+  static void configure(DsoControl *dsoControl, const DsoSettings *settings);
+  void stop();
+
+  void setQueueLength(unsigned int frames);
+  bool pullFrame(AcquisitionFrame *frame, unsigned long timeout = ULONG_MAX);
+  unsigned int getDropped();
+
+  void analyze(const AcquisitionFrame &frame);
+
+private:
+  DsoControl *dsoControl;     ///< The controller for the oscilloscope
+  DsoSettings *settings;      ///< The oscilloscope settings
+  DataAnalyzer *dataAnalyzer; ///< Analyzes the pulled frames
+  bool connected;             ///< true after the device has been connected
+
+  std::deque<AcquisitionFrame> queue; ///< The frames that weren't pulled yet
+  QMutex queueMutex;                  ///< Protects the queue and its counters
+  QWaitCondition queueNotEmpty;       ///< Wakes the threads waiting for frames
+  unsigned int queueLength;           ///< Maximum queued frames, 0 for none
+  unsigned int frames;                ///< Number of received frames
+  unsigned int dropped;               ///< Frames dropped due to a full queue
+
+private slots:
+  void deviceConnected();
+  void samplesAvailable(const std::vector<std::vector<double>> *data,
+                        double samplerate, bool append, QMutex *mutex);
+};
+
+#endif
@@ -27,13 +27,16 @@
 #include <QGroupBox>
 #include <QHBoxLayout>
 #include <QLabel>
+#include <QLineEdit>
 #include <QSpinBox>
 #include <QVBoxLayout>
 
 #include "configpages.h"
 
 #include "colorbox.h"
+#include "digitalfilter.h"
 #include "settings.h"
+#include "sispinbox.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // class DsoConfigAnalysisPage
@@ -96,8 +99,72 @@ DsoConfigAnalysisPage::DsoConfigAnalysisPage(DsoSettings *settings,
   this->spectrumGroup = new QGroupBox(tr("Spectrum"));
   this->spectrumGroup->setLayout(this->spectrumLayout);
 
+  QStringList filterTypeStrings, filterDesignStrings;
+  for (int type = Dso::FILTERTYPE_NONE; type < Dso::FILTERTYPE_COUNT; ++type)
+    filterTypeStrings << Dso::filterTypeString((Dso::FilterType)type);
+  for (int design = Dso::FILTERDESIGN_IIR; design < Dso::FILTERDESIGN_COUNT;
+       ++design)
+    filterDesignStrings << Dso::filterDesignString((Dso::FilterDesign)design);
+
+  this->filterTypeLabel = new QLabel(tr("Type"));
+  this->filterDesignLabel = new QLabel(tr("Design"));
+  this->filterFrequencyLabel = new QLabel(tr("Frequency"));
+  this->filterBandwidthLabel = new QLabel(tr("Bandwidth"));
+  this->filterOrderLabel = new QLabel(tr("Order/Taps"));
+
+  this->filterLayout = new QGridLayout();
+  this->filterLayout->addWidget(this->filterTypeLabel, 0, 1);
+  this->filterLayout->addWidget(this->filterDesignLabel, 0, 2);
+  this->filterLayout->addWidget(this->filterFrequencyLabel, 0, 3);
+  this->filterLayout->addWidget(this->filterBandwidthLabel, 0, 4);
+  this->filterLayout->addWidget(this->filterOrderLabel, 0, 5);
+
+  for (int channel = 0; channel < (int)this->settings->scope.physicalChannels;
+       ++channel) {
+    const DsoSettingsScopeFilter &filter =
+        this->settings->scope.voltage[channel].filter;
+
+    this->filterChannelLabel.append(
+        new QLabel(this->settings->scope.voltage[channel].name));
+    this->filterTypeComboBox.append(new QComboBox());
+    this->filterTypeComboBox[channel]->addItems(filterTypeStrings);
+    this->filterTypeComboBox[channel]->setCurrentIndex(filter.type);
+    this->filterDesignComboBox.append(new QComboBox());
+    this->filterDesignComboBox[channel]->addItems(filterDesignStrings);
+    this->filterDesignComboBox[channel]->setCurrentIndex(filter.design);
+    this->filterFrequencySiSpinBox.append(new SiSpinBox(Helper::UNIT_HERTZ));
+    this->filterFrequencySiSpinBox[channel]->setMinimum(1e-3);
+    this->filterFrequencySiSpinBox[channel]->setMaximum(100e6);
+    this->filterFrequencySiSpinBox[channel]->setValue(filter.frequency);
+    this->filterBandwidthSiSpinBox.append(new SiSpinBox(Helper::UNIT_HERTZ));
+    this->filterBandwidthSiSpinBox[channel]->setMinimum(1e-3);
+    this->filterBandwidthSiSpinBox[channel]->setMaximum(100e6);
+    this->filterBandwidthSiSpinBox[channel]->setValue(filter.bandwidth);
+    this->filterOrderSpinBox.append(new QSpinBox());
+    this->filterOrderSpinBox[channel]->setMinimum(1);
+    this->filterOrderSpinBox[channel]->setMaximum(DIGITALFILTER_MAXTAPS);
+    this->filterOrderSpinBox[channel]->setValue(filter.order);
+
+    this->filterLayout->addWidget(this->filterChannelLabel[channel],
+                                  channel + 1, 0);
+    this->filterLayout->addWidget(this->filterTypeComboBox[channel],
+                                  channel + 1, 1);
+    this->filterLayout->addWidget(this->filterDesignComboBox[channel],
+                                  channel + 1, 2);
+    this->filterLayout->addWidget(this->filterFrequencySiSpinBox[channel],
+                                  channel + 1, 3);
+    this->filterLayout->addWidget(this->filterBandwidthSiSpinBox[channel],
+                                  channel + 1, 4);
+    this->filterLayout->addWidget(this->filterOrderSpinBox[channel],
+                                  channel + 1, 5);
+  }
+
+  this->filterGroup = new QGroupBox(tr("Filter"));
+  this->filterGroup->setLayout(this->filterLayout);
+
   this->mainLayout = new QVBoxLayout();
   this->mainLayout->addWidget(this->spectrumGroup);
+  this->mainLayout->addWidget(this->filterGroup);
   this->mainLayout->addStretch(1);
 
   this->setLayout(this->mainLayout);
@@ -113,6 +180,19 @@ void DsoConfigAnalysisPage::saveSettings() {
   this->settings->scope.spectrumReference =
       this->referenceLevelSpinBox->value();
   this->settings->scope.spectrumLimit = this->minimumMagnitudeSpinBox->value();
+
+  for (int channel = 0; channel < this->filterTypeComboBox.count();
+       ++channel) {
+    DsoSettingsScopeFilter &filter =
+        this->settings->scope.voltage[channel].filter;
+    filter.type =
+        (Dso::FilterType)this->filterTypeComboBox[channel]->currentIndex();
+    filter.design =
+        (Dso::FilterDesign)this->filterDesignComboBox[channel]->currentIndex();
+    filter.frequency = this->filterFrequencySiSpinBox[channel]->value();
+    filter.bandwidth = this->filterBandwidthSiSpinBox[channel]->value();
+    filter.order = this->filterOrderSpinBox[channel]->value();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -360,10 +440,16 @@ DsoConfigScopePage::DsoConfigScopePage(DsoSettings *settings, QWidget *parent)
       this->settings->view.interpolation);
   this->digitalPhosphorDepthLabel = new QLabel(tr("Digital phosphor depth"));
   this->digitalPhosphorDepthSpinBox = new QSpinBox();
-  this->digitalPhosphorDepthSpinBox->setMinimum(2);
-  this->digitalPhosphorDepthSpinBox->setMaximum(99);
+  this->digitalPhosphorDepthSpinBox->setMinimum(0);
+  this->digitalPhosphorDepthSpinBox->setMaximum(10000);
+  this->digitalPhosphorDepthSpinBox->setSpecialValueText(tr("Infinite"));
   this->digitalPhosphorDepthSpinBox->setValue(
       this->settings->view.digitalPhosphorDepth);
+  this->waterfallDepthLabel = new QLabel(tr("Waterfall depth"));
+  this->waterfallDepthSpinBox = new QSpinBox();
+  this->waterfallDepthSpinBox->setMinimum(16);
+  this->waterfallDepthSpinBox->setMaximum(4096);
+  this->waterfallDepthSpinBox->setValue(this->settings->view.waterfallDepth);
 
   this->graphLayout = new QGridLayout();
   this->graphLayout->addWidget(this->antialiasingCheckBox, 0, 0, 1, 2);
@@ -371,12 +457,74 @@ DsoConfigScopePage::DsoConfigScopePage(DsoSettings *settings, QWidget *parent)
   this->graphLayout->addWidget(this->interpolationComboBox, 1, 1);
   this->graphLayout->addWidget(this->digitalPhosphorDepthLabel, 2, 0);
   this->graphLayout->addWidget(this->digitalPhosphorDepthSpinBox, 2, 1);
+  this->graphLayout->addWidget(this->waterfallDepthLabel, 3, 0);
+  this->graphLayout->addWidget(this->waterfallDepthSpinBox, 3, 1);
 
   this->graphGroup = new QGroupBox(tr("Graph"));
   this->graphGroup->setLayout(this->graphLayout);
 
+  this->historySegmentsLabel = new QLabel(tr("Stored acquisitions"));
+  this->historySegmentsSpinBox = new QSpinBox();
+  this->historySegmentsSpinBox->setMinimum(0);
+  this->historySegmentsSpinBox->setMaximum(100000);
+  this->historySegmentsSpinBox->setValue(
+      this->settings->scope.history.segments);
+  this->historyMemoryLimitLabel = new QLabel(tr("Memory limit"));
+  this->historyMemoryLimitSpinBox = new QSpinBox();
+  this->historyMemoryLimitSpinBox->setMinimum(1);
+  this->historyMemoryLimitSpinBox->setMaximum(65536);
+  this->historyMemoryLimitSpinBox->setSuffix(tr(" MiB"));
+  this->historyMemoryLimitSpinBox->setValue(
+      this->settings->scope.history.memoryLimit);
+  this->historySpillCheckBox =
+      new QCheckBox(tr("Use a temporary file beyond the limit"));
+  this->historySpillCheckBox->setChecked(this->settings->scope.history.spill);
+
+  this->historyLayout = new QGridLayout();
+  this->historyLayout->addWidget(this->historySegmentsLabel, 0, 0);
+  this->historyLayout->addWidget(this->historySegmentsSpinBox, 0, 1);
+  this->historyLayout->addWidget(this->historyMemoryLimitLabel, 1, 0);
+  this->historyLayout->addWidget(this->historyMemoryLimitSpinBox, 1, 1);
+  this->historyLayout->addWidget(this->historySpillCheckBox, 2, 0, 1, 2);
+
+  this->historyGroup = new QGroupBox(tr("History"));
+  this->historyGroup->setLayout(this->historyLayout);
+
+  this->loggerDirectoryLabel = new QLabel(tr("Directory"));
+  this->loggerDirectoryLineEdit =
+      new QLineEdit(this->settings->scope.logger.directory);
+  this->loggerRotateSizeLabel = new QLabel(tr("New file after"));
+  this->loggerRotateSizeSpinBox = new QSpinBox();
+  this->loggerRotateSizeSpinBox->setMinimum(0);
+  this->loggerRotateSizeSpinBox->setMaximum(65536);
+  this->loggerRotateSizeSpinBox->setSuffix(tr(" MiB"));
+  this->loggerRotateSizeSpinBox->setSpecialValueText(tr("Unlimited"));
+  this->loggerRotateSizeSpinBox->setValue(
+      this->settings->scope.logger.rotateSize);
+  this->loggerRotateTimeLabel = new QLabel(tr("New file every"));
+  this->loggerRotateTimeSpinBox = new QSpinBox();
+  this->loggerRotateTimeSpinBox->setMinimum(0);
+  this->loggerRotateTimeSpinBox->setMaximum(10080);
+  this->loggerRotateTimeSpinBox->setSuffix(tr(" min"));
+  this->loggerRotateTimeSpinBox->setSpecialValueText(tr("Never"));
+  this->loggerRotateTimeSpinBox->setValue(
+      this->settings->scope.logger.rotateTime);
+
+  this->loggerLayout = new QGridLayout();
+  this->loggerLayout->addWidget(this->loggerDirectoryLabel, 0, 0);
+  this->loggerLayout->addWidget(this->loggerDirectoryLineEdit, 0, 1);
+  this->loggerLayout->addWidget(this->loggerRotateSizeLabel, 1, 0);
+  this->loggerLayout->addWidget(this->loggerRotateSizeSpinBox, 1, 1);
+  this->loggerLayout->addWidget(this->loggerRotateTimeLabel, 2, 0);
+  this->loggerLayout->addWidget(this->loggerRotateTimeSpinBox, 2, 1);
+
+  this->loggerGroup = new QGroupBox(tr("Logger"));
+  this->loggerGroup->setLayout(this->loggerLayout);
+
   this->mainLayout = new QVBoxLayout();
   this->mainLayout->addWidget(this->graphGroup);
+  this->mainLayout->addWidget(this->historyGroup);
+  this->mainLayout->addWidget(this->loggerGroup);
   this->mainLayout->addStretch(1);
 
   this->setLayout(this->mainLayout);
@@ -392,4 +540,16 @@ void DsoConfigScopePage::saveSettings() {
       (Dso::InterpolationMode)this->interpolationComboBox->currentIndex();
   this->settings->view.digitalPhosphorDepth =
       this->digitalPhosphorDepthSpinBox->value();
+  this->settings->view.waterfallDepth = this->waterfallDepthSpinBox->value();
+  this->settings->scope.history.segments =
+      this->historySegmentsSpinBox->value();
+  this->settings->scope.history.memoryLimit =
+      this->historyMemoryLimitSpinBox->value();
+  this->settings->scope.history.spill = this->historySpillCheckBox->isChecked();
+  this->settings->scope.logger.directory =
+      this->loggerDirectoryLineEdit->text();
+  this->settings->scope.logger.rotateSize =
+      this->loggerRotateSizeSpinBox->value();
+  this->settings->scope.logger.rotateTime =
+      this->loggerRotateTimeSpinBox->value();
 }
@@ -32,11 +32,13 @@
 
 class ColorBox;
 class DsoSettings;
+class SiSpinBox;
 class QCheckBox;
 class QComboBox;
 class QSpinBox;
 class QStringList;
 class QLabel;
+class QLineEdit;
 
 ////////////////////////////////////////////////////////////////////////////////
 /// \class DsoConfigAnalysisPage                                   configpages.h
@@ -71,6 +73,17 @@ private:
   QLabel *minimumMagnitudeUnitLabel;
   QHBoxLayout *minimumMagnitudeLayout;
 
+  QGroupBox *filterGroup;
+  QGridLayout *filterLayout;
+  QLabel *filterTypeLabel, *filterDesignLabel, *filterFrequencyLabel,
+      *filterBandwidthLabel, *filterOrderLabel;
+  QList<QLabel *> filterChannelLabel;
+  QList<QComboBox *> filterTypeComboBox;
+  QList<QComboBox *> filterDesignComboBox;
+  QList<SiSpinBox *> filterFrequencySiSpinBox;
+  QList<SiSpinBox *> filterBandwidthSiSpinBox;
+  QList<QSpinBox *> filterOrderSpinBox;
+
 private slots:
 };
 
@@ -174,6 +187,25 @@ private:
   QSpinBox *digitalPhosphorDepthSpinBox;
   QLabel *interpolationLabel;
   QComboBox *interpolationComboBox;
+  QLabel *waterfallDepthLabel;
+  QSpinBox *waterfallDepthSpinBox;
+
+  QGroupBox *historyGroup;
+  QGridLayout *historyLayout;
+  QLabel *historySegmentsLabel;
+  QSpinBox *historySegmentsSpinBox;
+  QLabel *historyMemoryLimitLabel;
+  QSpinBox *historyMemoryLimitSpinBox;
+  QCheckBox *historySpillCheckBox;
+
+  QGroupBox *loggerGroup;
+  QGridLayout *loggerLayout;
+  QLabel *loggerDirectoryLabel;
+  QLineEdit *loggerDirectoryLineEdit;
+  QLabel *loggerRotateSizeLabel;
+  QSpinBox *loggerRotateSizeSpinBox;
+  QLabel *loggerRotateTimeLabel;
+  QSpinBox *loggerRotateTimeSpinBox;
 
 private slots:
 };
@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  counters.cpp
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <QAtomicInteger>
+#include <QCoreApplication>
+
+#include "counters.h"
+
+#include "helper.h"
+#include "tracing.h"
+
+namespace Counters {
+static QAtomicInteger<quint64> values[COUNT]; ///< The current counter values
+
+/// \brief Increases a counter.
+/// The counters are only used for statistics, so the addition is relaxed and
+/// doesn't order any other memory access.
+/// \param id The counter.
+/// \param value The amount that is added.
+void add(Id id, quint64 value) { values[id].fetchAndAddRelaxed(value); }
+
+/// \brief Get the current value of a counter.
+/// \param id The counter.
+/// \return The sum of all additions so far.
+quint64 get(Id id) { return values[id].load(); }
+
+/// \brief Get the name of a counter for programmatic queries.
+/// \param id The counter.
+/// \return The name of the counter, like "usb.bytes_in".
+QString getName(Id id) {
+  switch (id) {
+  case USB_BYTES_IN:
+    return "usb.bytes_in";
+  case USB_BYTES_OUT:
+    return "usb.bytes_out";
+  case USB_TRANSFERS:
+    return "usb.transfers";
+  case USB_RETRIES:
+    return "usb.retries";
+  case USB_TIMEOUTS:
+    return "usb.timeouts";
+  case FRAMES_ANALYZED:
+    return "analyzer.frames";
+  case FRAMES_DROPPED:
+    return "analyzer.dropped";
+  case ANALYSIS_TIME:
+    return "analyzer.time_ns";
+  case FRAMES_RENDERED:
+    return "scope.frames";
+  case RENDER_TIME:
+    return "scope.time_ns";
+  default:
+    return QString();
+  }
+}
+
+/// \brief Reads all counters.
+/// \param snapshot The snapshot that gets the current values.
+void takeSnapshot(Snapshot *snapshot) {
+  snapshot->time = Tracing::now();
+  for (int id = 0; id < COUNT; ++id)
+    snapshot->values[id] = values[id].load();
+}
+
+/// \brief Describes the rates between two snapshots for the status bar.
+/// \param previous The older snapshot.
+/// \param current The newer snapshot.
+/// \return Waveforms per second, drops, USB throughput and render rate.
+QString summary(const Snapshot &previous, const Snapshot &current) {
+  double seconds = (current.time - previous.time) / 1e9;
+  if (seconds <= 0)
+    return QString();
+
+  quint64 delta[COUNT];
+  for (int id = 0; id < COUNT; ++id)
+    delta[id] = current.values[id] - previous.values[id];
+
+  double analysisTime =
+      delta[FRAMES_ANALYZED]
+          ? delta[ANALYSIS_TIME] / 1e9 / delta[FRAMES_ANALYZED]
+          : 0.0;
+  double renderTime = delta[FRAMES_RENDERED]
+                          ? delta[RENDER_TIME] / 1e9 / delta[FRAMES_RENDERED]
+                          : 0.0;
+
+  return QCoreApplication::tr("%L1 wfm/s (%2 dropped, %3 each), "
+                              "USB %L4 MB/s (%5 retries), %L6 fps (%7 each)")
+      .arg(delta[FRAMES_ANALYZED] / seconds, 0, 'f', 1)
+      .arg(delta[FRAMES_DROPPED])
+      .arg(Helper::valueToString(analysisTime, Helper::UNIT_SECONDS, 3))
+      .arg((delta[USB_BYTES_IN] + delta[USB_BYTES_OUT]) / seconds / 1e6, 0,
+           'f', 2)
+      .arg(delta[USB_RETRIES])
+      .arg(delta[FRAMES_RENDERED] / seconds, 0, 'f', 1)
+      .arg(Helper::valueToString(renderTime, Helper::UNIT_SECONDS, 3));
+}
+}
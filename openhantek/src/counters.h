@@ -0,0 +1,62 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file counters.h
+/// \brief Declares the performance counters.
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <QString>
+#include <QtGlobal>
+
+namespace Counters {
+//////////////////////////////////////////////////////////////////////////////
+/// \enum Id                                                        counters.h
+/// \brief The counters, all of them only increase.
+enum Id {
+  USB_BYTES_IN,    ///< Bytes received from the oscilloscope
+  USB_BYTES_OUT,   ///< Bytes sent to the oscilloscope
+  USB_TRANSFERS,   ///< USB transfers including retries
+  USB_RETRIES,     ///< Transfers that were repeated after a timeout
+  USB_TIMEOUTS,    ///< Transfers that timed out
+  FRAMES_ANALYZED, ///< Acquisitions processed by the data analyzer
+  FRAMES_DROPPED,  ///< Acquisitions dropped because the analyzer was busy
+  ANALYSIS_TIME,   ///< Time spent analyzing in ns
+  FRAMES_RENDERED, ///< Frames generated for the scope views
+  RENDER_TIME,     ///< Time spent drawing all scope views in ns
+  COUNT            ///< The total number of counters
+};
+
+//////////////////////////////////////////////////////////////////////////////
+/// \struct Snapshot                                                counters.h
+/// \brief The values of all counters at one point of time.
+struct Snapshot {
+  qint64 time;           ///< Time of the snapshot in ns, monotonic
+  quint64 values[COUNT]; ///< The value of each counter
+};
+
+void add(Id id, quint64 value = 1);
+quint64 get(Id id);
+QString getName(Id id);
+
+void takeSnapshot(Snapshot *snapshot);
+QString summary(const Snapshot &previous, const Snapshot &current);
+}
+
+#endif
@@ -0,0 +1,275 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  csvwriter.cpp
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThreadPool>
+
+#include "csvwriter.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// class CsvWriter
+/// \brief Initializes an empty writer.
+CsvWriter::CsvWriter() {
+  this->bytesWritten = 0;
+  this->throughput = 0.0;
+}
+
+/// \brief Adds a series that will be written to the file.
+/// \param name The name of the series.
+/// \param interval The time between two samples in seconds.
+/// \param samples The values, they have to stay valid until write() returns.
+void CsvWriter::addSeries(const QString &name, double interval,
+                          const std::vector<double> *samples) {
+  Series newSeries;
+  newSeries.name = name;
+  newSeries.interval = interval;
+  newSeries.samples = samples;
+  this->series.push_back(newSeries);
+}
+
+/// \brief Writes all series into a file.
+/// \param filename The name of the CSV file.
+/// \param layout The arrangement of the values.
+/// \return true if the file was written successfully.
+bool CsvWriter::write(const QString &filename, CsvLayout layout) {
+  QElapsedTimer timer;
+  timer.start();
+
+  this->bytesWritten = 0;
+  this->throughput = 0.0;
+
+  // Without QIODevice::Text, so the lines end with '\n' on all platforms and
+  // bytesWritten is the size of the file
+  QFile file(filename);
+  if (!file.open(QIODevice::WriteOnly))
+    return false;
+
+  char number[CSVWRITER_NUMBER];
+  bool success = true;
+  if (layout == CSV_LAYOUT_ROWS) {
+    for (unsigned int index = 0; success && index < this->series.size();
+         ++index) {
+      // Start with series name and the sample interval
+      QByteArray header = '"' + this->series[index].name.toUtf8() + "\",";
+      header.append(number,
+                    formatDouble(this->series[index].interval, number) -
+                        number);
+      success = file.write(header) == header.size() &&
+                this->writeValues(&file, layout, index,
+                                  this->series[index].samples->size()) &&
+                file.write("\n", 1) == 1;
+      this->bytesWritten += header.size() + 1;
+    }
+  } else {
+    // A header line with the column names
+    QByteArray header("\"t / s\"");
+    unsigned int rowCount = 0;
+    for (unsigned int index = 0; index < this->series.size(); ++index) {
+      header += ",\"" + this->series[index].name.toUtf8() + '"';
+      rowCount = qMax(rowCount,
+                      (unsigned int)this->series[index].samples->size());
+    }
+    header += '\n';
+    success = file.write(header) == header.size() &&
+              this->writeValues(&file, layout, 0, rowCount);
+    this->bytesWritten += header.size();
+  }
+
+  file.close();
+
+  qint64 elapsed = timer.nsecsElapsed();
+  if (success && elapsed > 0)
+    this->throughput = this->bytesWritten * 1e3 / elapsed;
+
+  return success;
+}
+
+/// \brief Returns the size of the last written file.
+/// \return The number of bytes written by the last call of write().
+qint64 CsvWriter::getBytesWritten() const { return this->bytesWritten; }
+
+/// \brief Returns the speed of the last write.
+/// \return The throughput of the last call of write() in MB/s.
+double CsvWriter::getThroughput() const { return this->throughput; }
+
+/// \brief Formats a range of values into text.
+/// This method only reads the series and can be called from several threads.
+/// \param layout The arrangement of the values.
+/// \param series The series for CSV_LAYOUT_ROWS.
+/// \param first The first value (or row for CSV_LAYOUT_COLUMNS).
+/// \param last The value or row after the last formatted one.
+/// \param output The buffer for the text.
+void CsvWriter::format(CsvLayout layout, unsigned int series,
+                       unsigned int first, unsigned int last,
+                       QByteArray *output) const {
+  // Reserve enough space for the longest numbers
+  const unsigned int lineLength =
+      (layout == CSV_LAYOUT_ROWS)
+          ? CSVWRITER_NUMBER + 1
+          : (CSVWRITER_NUMBER + 1) * (this->series.size() + 1);
+  output->resize((last - first) * lineLength);
+  char *const begin = output->data();
+  char *position = begin;
+
+  if (layout == CSV_LAYOUT_ROWS) {
+    const std::vector<double> &samples = *this->series[series].samples;
+    for (unsigned int index = first; index < last; ++index) {
+      *(position++) = ',';
+      position = formatDouble(samples[index], position);
+    }
+  } else {
+    const double interval =
+        this->series.empty() ? 0.0 : this->series[0].interval;
+    for (unsigned int row = first; row < last; ++row) {
+      position = formatDouble(row * interval, position);
+      for (unsigned int index = 0; index < this->series.size(); ++index) {
+        *(position++) = ',';
+        const std::vector<double> &samples = *this->series[index].samples;
+        if (row < samples.size())
+          position = formatDouble(samples[row], position);
+      }
+      *(position++) = '\n';
+    }
+  }
+
+  output->resize(position - begin);
+}
+
+/// \brief Formats a double with the shortest text that reads back exactly.
+/// 15 significant digits always identify a double uniquely within its rounding
+/// interval, so if they read back, %g has already removed all digits that
+/// aren't needed. Otherwise the shortest exact text has 16 or 17 digits.
+/// \param value The value that should be formatted.
+/// \param buffer The buffer with space for CSVWRITER_NUMBER characters.
+/// \return The position after the last written character.
+char *CsvWriter::formatDouble(double value, char *buffer) {
+  int length = 0;
+  for (int precision = 15; precision <= 17; ++precision) {
+    length = snprintf(buffer, CSVWRITER_NUMBER, "%.*g", precision, value);
+    if (precision == 17 || strtod(buffer, 0) == value)
+      break;
+  }
+
+  // The C locale may use a decimal comma
+  for (int index = 0; index < length; ++index) {
+    if (buffer[index] == ',')
+      buffer[index] = '.';
+  }
+
+  return buffer + length;
+}
+
+/// \brief Formats and writes a range of values, in parallel if it's large.
+/// \param file The output file.
+/// \param layout The arrangement of the values.
+/// \param series The series for CSV_LAYOUT_ROWS.
+/// \param count The number of values (or rows for CSV_LAYOUT_COLUMNS).
+/// \return true if the text was written successfully.
+bool CsvWriter::writeValues(QFile *file, CsvLayout layout, unsigned int series,
+                            unsigned int count) {
+  // The formatters run on the threads of the global pool, they are created
+  // for the whole series and reused for every block
+  QThreadPool *pool = QThreadPool::globalInstance();
+  unsigned int threadCount = 1;
+  if (count >= CSVWRITER_PARALLEL)
+    threadCount = qMax(pool->maxThreadCount(), 1);
+
+  std::vector<CsvFormatter *> formatters;
+  for (unsigned int thread = 1; thread < threadCount; ++thread)
+    formatters.push_back(new CsvFormatter(this));
+
+  QByteArray output;
+  bool success = true;
+  for (unsigned int first = 0; success && first < count;) {
+    // Every thread formats the following block
+    for (unsigned int thread = 0; thread < formatters.size(); ++thread) {
+      unsigned int blockFirst =
+          qMin(first + (thread + 1) * CSVWRITER_BLOCK, count);
+      unsigned int blockLast = qMin(blockFirst + CSVWRITER_BLOCK, count);
+      formatters[thread]->setRange(layout, series, blockFirst, blockLast);
+      pool->start(formatters[thread]);
+    }
+    this->format(layout, series, first, qMin(first + CSVWRITER_BLOCK, count),
+                 &output);
+
+    // Write the blocks in order
+    success = file->write(output) == output.size();
+    this->bytesWritten += output.size();
+    for (unsigned int thread = 0; thread < formatters.size(); ++thread) {
+      formatters[thread]->wait();
+      QByteArray *threadOutput = formatters[thread]->getOutput();
+      if (success) {
+        success = file->write(*threadOutput) == threadOutput->size();
+        this->bytesWritten += threadOutput->size();
+      }
+    }
+
+    first = qMin(first + threadCount * CSVWRITER_BLOCK, count);
+  }
+
+  for (unsigned int thread = 0; thread < formatters.size(); ++thread)
+    delete formatters[thread];
+
+  return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class CsvFormatter
+/// \brief Initializes the formatter, it isn't deleted by the thread pool.
+/// \param writer The writer whose series are formatted.
+CsvFormatter::CsvFormatter(const CsvWriter *writer) {
+  this->setAutoDelete(false);
+  this->writer = writer;
+  this->layout = CSV_LAYOUT_ROWS;
+  this->series = 0;
+  this->first = 0;
+  this->last = 0;
+}
+
+/// \brief Sets the values that are formatted by the next run.
+/// \param layout The arrangement of the values.
+/// \param series The series for CSV_LAYOUT_ROWS.
+/// \param first The first value or row.
+/// \param last The value or row after the last formatted one.
+void CsvFormatter::setRange(CsvLayout layout, unsigned int series,
+                            unsigned int first, unsigned int last) {
+  this->layout = layout;
+  this->series = series;
+  this->first = first;
+  this->last = last;
+}
+
+/// \brief Waits until the run started last has finished.
+void CsvFormatter::wait() { this->finished.acquire(); }
+
+/// \brief Returns the text of the last run.
+/// \return The buffer with the formatted values.
+QByteArray *CsvFormatter::getOutput() { return &this->output; }
+
+/// \brief Formats the values.
+void CsvFormatter::run() {
+  this->writer->format(this->layout, this->series, this->first, this->last,
+                       &this->output);
+  this->finished.release();
+}
@@ -0,0 +1,110 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file csvwriter.h
+/// \brief Declares the CsvWriter class.
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CSVWRITER_H
+#define CSVWRITER_H
+
+#include <vector>
+
+#include <QByteArray>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QString>
+
+#define CSVWRITER_NUMBER 32       ///< Maximum characters of a formatted value
+#define CSVWRITER_BLOCK 262144    ///< Values formatted by one thread at once
+#define CSVWRITER_PARALLEL 131072 ///< Values needed to format in parallel
+
+class QFile;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \enum CsvLayout                                                  csvwriter.h
+/// \brief The arrangement of the values in the CSV file.
+enum CsvLayout {
+  CSV_LAYOUT_ROWS,   ///< One line per series, starting with name and interval
+  CSV_LAYOUT_COLUMNS ///< A time column and one column per series
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class CsvWriter                                                 csvwriter.h
+/// \brief Writes sample series into CSV files.
+/// The values are formatted with the shortest representation that reads back
+/// to the same double into large byte buffers. Large series are split into
+/// blocks that are formatted by several threads and written in order.
+class CsvWriter {
+public:
+  CsvWriter();
+
+  void addSeries(const QString &name, double interval,
+                 const std::vector<double> *samples);
+  bool write(const QString &filename, CsvLayout layout);
+
+  qint64 getBytesWritten() const;
+  double getThroughput() const;
+
+  void format(CsvLayout layout, unsigned int series, unsigned int first,
+              unsigned int last, QByteArray *output) const;
+
+  static char *formatDouble(double value, char *buffer);
+
+private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \struct Series                                               csvwriter.h
+  /// \brief One sample series that should be written.
+  struct Series {
+    QString name;                        ///< Name written to the file
+    double interval;                     ///< Time between two samples in s
+    const std::vector<double> *samples; ///< The values of the series
+  };
+
+  bool writeValues(QFile *file, CsvLayout layout, unsigned int series,
+                   unsigned int count);
+
+  std::vector<Series> series; ///< The series in the order of the file
+  qint64 bytesWritten;        ///< Size of the last written file
+  double throughput;          ///< Speed of the last write in MB/s
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class CsvFormatter                                              csvwriter.h
+/// \brief Formats a range of values of a CsvWriter in a pooled thread.
+class CsvFormatter : public QRunnable {
+public:
+  CsvFormatter(const CsvWriter *writer);
+
+  void setRange(CsvLayout layout, unsigned int series, unsigned int first,
+                unsigned int last);
+  void wait();
+  QByteArray *getOutput();
+
+  void run();
+
+private:
+  const CsvWriter *writer; ///< The writer that provides the values
+  CsvLayout layout;        ///< The layout that should be formatted
+  unsigned int series;     ///< The series for CSV_LAYOUT_ROWS
+  unsigned int first;      ///< The first formatted value or row
+  unsigned int last;       ///< The value or row after the formatted ones
+  QByteArray output;       ///< The formatted text
+  QSemaphore finished;     ///< Released when a run has finished
+};
+
+#endif
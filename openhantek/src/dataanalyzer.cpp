@@ -21,24 +21,33 @@
 //
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
 #include <cmath>
 
 #include <QColor>
+#include <QElapsedTimer>
 #include <QMutex>
 
 #include <fftw3.h>
 
 #include "dataanalyzer.h"
 
-#include "glscope.h"
+#include "counters.h"
+#include "digitalfilter.h"
 #include "helper.h"
 #include "settings.h"
+#include "tracing.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // struct SampleValues
 /// \brief Initializes the members to their default values.
 SampleValues::SampleValues() { this->interval = 0.0; }
 
+////////////////////////////////////////////////////////////////////////////////
+// struct SampleEnvelope
+/// \brief Initializes the members to their default values.
+SampleEnvelope::SampleEnvelope() { this->interval = 0.0; }
+
 ////////////////////////////////////////////////////////////////////////////////
 // struct AnalyzedData
 /// \brief Initializes the members to their default values.
@@ -47,6 +56,27 @@ AnalyzedData::AnalyzedData() {
   this->frequency = 0.0;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// struct AcquisitionState
+/// \brief Initializes the members to their default values.
+AcquisitionState::AcquisitionState() {
+  this->count = 0;
+  this->sampleCount = 0;
+  this->interval = 0.0;
+  this->gain = 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// struct SpectrumState
+/// \brief Initializes the members to their default values.
+SpectrumState::SpectrumState() {
+  this->count = 0;
+  this->mode = Dso::SPECTRUMMODE_NORMAL;
+  this->modeCount = 0;
+  this->interval = 0.0;
+  this->window = Dso::WINDOW_RECTANGULAR;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // class DataAnalyzer
 /// \brief Initializes the buffers and other variables.
@@ -59,6 +89,22 @@ DataAnalyzer::DataAnalyzer(DsoSettings *settings, QObject *parent)
   this->lastRecordLength = 0;
   this->lastWindow = (Dso::WindowFunction)-1;
   this->window = 0;
+  this->dftInput = 0;
+  this->dftOutput = 0;
+  this->correlation = 0;
+  this->dftPlan = 0;
+  this->inversePlan = 0;
+
+  this->lastAcquisitionMode = Dso::ACQUISITIONMODE_NORMAL;
+  this->lastAcquisitionCount = 0;
+  this->lastTimebase = 0.0;
+
+  this->welchLength = 0;
+  this->welchWindowFunction = Dso::WINDOW_RECTANGULAR;
+  this->welchWindow = 0;
+  this->welchInput = 0;
+  this->welchOutput = 0;
+  this->welchPlan = 0;
 
   this->analyzedDataMutex = new QMutex();
 
@@ -66,10 +112,32 @@ DataAnalyzer::DataAnalyzer(DsoSettings *settings, QObject *parent)
 
   this->waitingDataSamplerate = 0.0;
   this->waitingDataMutex = 0;
+
+  this->mathSource = this->settings->scope.mathExpression;
 }
 
 /// \brief Deallocates the buffers.
-DataAnalyzer::~DataAnalyzer() {}
+DataAnalyzer::~DataAnalyzer() {
+  for (unsigned int channel = 0; channel < this->filters.size(); ++channel)
+    delete this->filters[channel];
+
+  if (this->welchPlan) {
+    fftw_destroy_plan(this->welchPlan);
+    fftw_free(this->welchWindow);
+    fftw_free(this->welchInput);
+    fftw_free(this->welchOutput);
+  }
+
+  if (this->dftPlan) {
+    fftw_destroy_plan(this->dftPlan);
+    fftw_destroy_plan(this->inversePlan);
+    fftw_free(this->dftInput);
+    fftw_free(this->dftOutput);
+    fftw_free(this->correlation);
+  }
+  if (this->window)
+    fftw_free(this->window);
+}
 
 /// \brief Returns the analyzed data.
 /// \param channel Channel, whose data should be returned.
@@ -89,8 +157,20 @@ unsigned int DataAnalyzer::sampleCount() { return this->maxSamples; }
 /// \return Mutex for the analyzed data.
 QMutex *DataAnalyzer::mutex() const { return this->analyzedDataMutex; }
 
+/// \brief Sets the formula of the math channel in the expression mode.
+/// The settings are written by the GUI thread while the analyzer runs, so
+/// the formula is passed in here instead of being read from them.
+/// \param source The formula, see MathExpression.
+void DataAnalyzer::setMathExpression(const QString &source) {
+  QMutexLocker locker(&this->mathSourceMutex);
+  this->mathSource = source;
+}
+
 /// \brief Analyzes the data from the dso.
 void DataAnalyzer::run() {
+  Tracing::Scope span("DataAnalyzer::run");
+  QElapsedTimer timer;
+  timer.start();
   this->analyzedDataMutex->lock();
 
   unsigned int maxSamples = 0;
@@ -99,6 +179,47 @@ void DataAnalyzer::run() {
 
   // Adapt the number of channels for analyzed data
   this->analyzedData.resize(channelCount);
+  this->spectrumState.resize(channelCount);
+
+  // Create the filters for new channels
+  while (this->filters.size() < this->settings->scope.physicalChannels)
+    this->filters.push_back(new DigitalFilter());
+
+  // Drop the accumulated samples if the acquisition settings have changed
+  this->acquisitionState.resize(this->settings->scope.physicalChannels);
+  if (this->settings->scope.acquisition.mode != this->lastAcquisitionMode ||
+      this->settings->scope.acquisition.count != this->lastAcquisitionCount ||
+      this->settings->scope.horizontal.timebase != this->lastTimebase) {
+    this->lastAcquisitionMode = this->settings->scope.acquisition.mode;
+    this->lastAcquisitionCount = this->settings->scope.acquisition.count;
+    this->lastTimebase = this->settings->scope.horizontal.timebase;
+    for (unsigned int channel = 0; channel < this->acquisitionState.size();
+         ++channel)
+      this->acquisitionState[channel].count = 0;
+  }
+
+  // Recompile the math channel formula only when it has changed
+  QString mathSource;
+  switch (this->settings->scope.voltage[this->settings->scope.physicalChannels]
+              .misc) {
+  case Dso::MATHMODE_1ADD2:
+    mathSource = "CH1 + CH2";
+    break;
+  case Dso::MATHMODE_1SUB2:
+    mathSource = "CH1 - CH2";
+    break;
+  case Dso::MATHMODE_2SUB1:
+    mathSource = "CH2 - CH1";
+    break;
+  default:
+    this->mathSourceMutex.lock();
+    mathSource = this->mathSource;
+    this->mathSourceMutex.unlock();
+    break;
+  }
+  if (mathSource != this->mathExpression.getSource())
+    this->mathExpression.compile(mathSource,
+                                 this->settings->scope.physicalChannels);
 
   for (unsigned int channel = 0; channel < channelCount; ++channel) {
     AnalyzedData *const channelData = &this->analyzedData[channel];
@@ -112,9 +233,7 @@ void DataAnalyzer::run() {
             channel >= this->settings->scope.physicalChannels &&
             (this->settings->scope.voltage[channel].used ||
              this->settings->scope.spectrum[channel].used) &&
-            this->analyzedData.size() >= 2 &&
-            !this->analyzedData[0].samples.voltage.sample.empty() &&
-            !this->analyzedData[1].samples.voltage.sample.empty())) {
+            this->mathExpression.isValid() && maxSamples > 0)) {
       // Set sampling interval
       const double interval = 1.0 / this->waitingDataSamplerate;
       if (interval != channelData->samples.voltage.interval) {
@@ -136,58 +255,65 @@ void DataAnalyzer::run() {
 
       // Physical channels
       if (channel < this->settings->scope.physicalChannels) {
+        // Redesign the filter if its settings or the samplerate changed
+        DigitalFilter *filter = this->filters[channel];
+        const DsoSettingsScopeFilter &filterSettings =
+            this->settings->scope.voltage[channel].filter;
+        filter->setup(filterSettings.type, filterSettings.design,
+                      filterSettings.frequency, filterSettings.bandwidth,
+                      filterSettings.order, this->waitingDataSamplerate);
+
         // Copy the buffer of the oscilloscope into the sample buffer
-        if (this->waitingDataAppend)
+        if (this->waitingDataAppend) {
+          unsigned int start = channelData->samples.voltage.sample.size();
           channelData->samples.voltage.sample.insert(
               channelData->samples.voltage.sample.end(),
               this->waitingData->at(channel).begin(),
               this->waitingData->at(channel).end());
-        else
+          channelData->samples.envelope.minimum.clear();
+          channelData->samples.envelope.maximum.clear();
+
+          // Only the new block is filtered, the state continues from the last
+          if (start == 0)
+            filter->reset();
+          filter->process(channelData->samples.voltage.sample.data() + start,
+                          channelData->samples.voltage.sample.size() - start);
+        } else {
           channelData->samples.voltage.sample = this->waitingData->at(channel);
+
+          // Every acquisition is a new signal for the filter
+          filter->reset();
+          filter->process(channelData->samples.voltage.sample.data(),
+                          channelData->samples.voltage.sample.size());
+
+          // Averaging and high resolution processing
+          this->processAcquisition(channel);
+        }
       }
       // Math channel
       else {
-        // Resize the sample vector
-        channelData->samples.voltage.sample.resize(size);
         // Set sampling interval
-        this->analyzedData[this->settings->scope.physicalChannels]
-            .samples.voltage.interval =
+        channelData->samples.voltage.interval =
             this->analyzedData[0].samples.voltage.interval;
 
-        // Resize the sample vector
-        this->analyzedData[this->settings->scope.physicalChannels]
-            .samples.voltage.sample.resize(
-                qMin(this->analyzedData[0].samples.voltage.sample.size(),
-                     this->analyzedData[1].samples.voltage.sample.size()));
-
-        // Calculate values and write them into the sample buffer
-        std::vector<double>::const_iterator ch1Iterator =
-            this->analyzedData[0].samples.voltage.sample.begin();
-        std::vector<double>::const_iterator ch2Iterator =
-            this->analyzedData[1].samples.voltage.sample.begin();
-        std::vector<double> &resultData =
-            this->analyzedData[this->settings->scope.physicalChannels]
-                .samples.voltage.sample;
-        for (std::vector<double>::iterator resultIterator = resultData.begin();
-             resultIterator != resultData.end(); ++resultIterator) {
-          switch (this->settings->scope
-                      .voltage[this->settings->scope.physicalChannels]
-                      .misc) {
-          case Dso::MATHMODE_1ADD2:
-            *(resultIterator++) = *(ch1Iterator++) + *(ch2Iterator++);
-            break;
-          case Dso::MATHMODE_1SUB2:
-            *(resultIterator++) = *(ch1Iterator++) - *(ch2Iterator++);
-            break;
-          case Dso::MATHMODE_2SUB1:
-            *(resultIterator++) = *(ch2Iterator++) - *(ch1Iterator++);
-            break;
-          }
+        // Evaluate the formula over the samples all used channels have
+        std::vector<const std::vector<double> *> sources;
+        unsigned int count = maxSamples;
+        for (unsigned int source = 0;
+             source < this->settings->scope.physicalChannels; ++source) {
+          sources.push_back(&this->analyzedData[source].samples.voltage.sample);
+          if (this->mathExpression.usesChannel(source))
+            count = qMin(count, (unsigned int)sources.back()->size());
         }
+        this->mathExpression.evaluate(
+            sources, channelData->samples.voltage.interval, count,
+            &channelData->samples.voltage.sample);
       }
     } else {
       // Clear unused channels
       channelData->samples.voltage.sample.clear();
+      channelData->samples.envelope.minimum.clear();
+      channelData->samples.envelope.maximum.clear();
       this->analyzedData[this->settings->scope.physicalChannels]
           .samples.voltage.interval = 0;
     }
@@ -211,135 +337,33 @@ void DataAnalyzer::run() {
         if (this->lastRecordLength != sampleCount) {
           this->lastRecordLength = sampleCount;
 
+          // The buffers and plans are kept until the record length changes
           if (this->window)
             fftw_free(this->window);
+          if (this->dftPlan) {
+            fftw_destroy_plan(this->dftPlan);
+            fftw_destroy_plan(this->inversePlan);
+            fftw_free(this->dftInput);
+            fftw_free(this->dftOutput);
+            fftw_free(this->correlation);
+          }
           this->window =
               (double *)fftw_malloc(sizeof(double) * this->lastRecordLength);
+          this->dftInput = (double *)fftw_malloc(sizeof(double) * sampleCount);
+          this->dftOutput = (double *)fftw_malloc(sizeof(double) * sampleCount);
+          this->correlation =
+              (double *)fftw_malloc(sizeof(double) * sampleCount);
+          this->dftPlan =
+              fftw_plan_r2r_1d(sampleCount, this->dftInput, this->dftOutput,
+                               FFTW_R2HC, FFTW_ESTIMATE);
+          this->inversePlan =
+              fftw_plan_r2r_1d(sampleCount, this->dftInput, this->correlation,
+                               FFTW_HC2R, FFTW_ESTIMATE);
         }
 
-        unsigned int windowEnd = this->lastRecordLength - 1;
         this->lastWindow = this->settings->scope.spectrumWindow;
-
-        switch (this->settings->scope.spectrumWindow) {
-        case Dso::WINDOW_HAMMING:
-          for (unsigned int windowPosition = 0;
-               windowPosition < this->lastRecordLength; ++windowPosition)
-            *(this->window + windowPosition) =
-                0.54 - 0.46 * cos(2.0 * M_PI * windowPosition / windowEnd);
-          break;
-        case Dso::WINDOW_HANN:
-          for (unsigned int windowPosition = 0;
-               windowPosition < this->lastRecordLength; ++windowPosition)
-            *(this->window + windowPosition) =
-                0.5 * (1.0 - cos(2.0 * M_PI * windowPosition / windowEnd));
-          break;
-        case Dso::WINDOW_COSINE:
-          for (unsigned int windowPosition = 0;
-               windowPosition < this->lastRecordLength; ++windowPosition)
-            *(this->window + windowPosition) =
-                sin(M_PI * windowPosition / windowEnd);
-          break;
-        case Dso::WINDOW_LANCZOS:
-          for (unsigned int windowPosition = 0;
-               windowPosition < this->lastRecordLength; ++windowPosition) {
-            double sincParameter =
-                (2.0 * windowPosition / windowEnd - 1.0) * M_PI;
-            if (sincParameter == 0)
-              *(this->window + windowPosition) = 1;
-            else
-              *(this->window + windowPosition) =
-                  sin(sincParameter) / sincParameter;
-          }
-          break;
-        case Dso::WINDOW_BARTLETT:
-          for (unsigned int windowPosition = 0;
-               windowPosition < this->lastRecordLength; ++windowPosition)
-            *(this->window + windowPosition) =
-                2.0 / windowEnd *
-                (windowEnd / 2 -
-                 std::abs((double)(windowPosition - windowEnd / 2.0)));
-          break;
-        case Dso::WINDOW_TRIANGULAR:
-          for (unsigned int windowPosition = 0;
-               windowPosition < this->lastRecordLength; ++windowPosition)
-            *(this->window + windowPosition) =
-                2.0 / this->lastRecordLength *
-                (this->lastRecordLength / 2 -
-                 std::abs((double)(windowPosition - windowEnd / 2.0)));
-          break;
-        case Dso::WINDOW_GAUSS: {
-          double sigma = 0.4;
-          for (unsigned int windowPosition = 0;
-               windowPosition < this->lastRecordLength; ++windowPosition)
-            *(this->window + windowPosition) =
-                exp(-0.5 * pow(((windowPosition - windowEnd / 2) /
-                                (sigma * windowEnd / 2)),
-                               2));
-        } break;
-        case Dso::WINDOW_BARTLETTHANN:
-          for (unsigned int windowPosition = 0;
-               windowPosition < this->lastRecordLength; ++windowPosition)
-            *(this->window + windowPosition) =
-                0.62 -
-                0.48 * std::abs((double)(windowPosition / windowEnd - 0.5)) -
-                0.38 * cos(2.0 * M_PI * windowPosition / windowEnd);
-          break;
-        case Dso::WINDOW_BLACKMAN: {
-          double alpha = 0.16;
-          for (unsigned int windowPosition = 0;
-               windowPosition < this->lastRecordLength; ++windowPosition)
-            *(this->window + windowPosition) =
-                (1 - alpha) / 2 -
-                0.5 * cos(2.0 * M_PI * windowPosition / windowEnd) +
-                alpha / 2 * cos(4.0 * M_PI * windowPosition / windowEnd);
-        } break;
-        // case WINDOW_KAISER:
-        // TODO
-        // double alpha = 3.0;
-        // for(unsigned int windowPosition = 0; windowPosition <
-        // this->lastRecordLength; ++windowPosition)
-        //*(this->window + windowPosition) = ;
-        // break;
-        case Dso::WINDOW_NUTTALL:
-          for (unsigned int windowPosition = 0;
-               windowPosition < this->lastRecordLength; ++windowPosition)
-            *(this->window + windowPosition) =
-                0.355768 -
-                0.487396 * cos(2 * M_PI * windowPosition / windowEnd) +
-                0.144232 * cos(4 * M_PI * windowPosition / windowEnd) -
-                0.012604 * cos(6 * M_PI * windowPosition / windowEnd);
-          break;
-        case Dso::WINDOW_BLACKMANHARRIS:
-          for (unsigned int windowPosition = 0;
-               windowPosition < this->lastRecordLength; ++windowPosition)
-            *(this->window + windowPosition) =
-                0.35875 - 0.48829 * cos(2 * M_PI * windowPosition / windowEnd) +
-                0.14128 * cos(4 * M_PI * windowPosition / windowEnd) -
-                0.01168 * cos(6 * M_PI * windowPosition / windowEnd);
-          break;
-        case Dso::WINDOW_BLACKMANNUTTALL:
-          for (unsigned int windowPosition = 0;
-               windowPosition < this->lastRecordLength; ++windowPosition)
-            *(this->window + windowPosition) =
-                0.3635819 -
-                0.4891775 * cos(2 * M_PI * windowPosition / windowEnd) +
-                0.1365995 * cos(4 * M_PI * windowPosition / windowEnd) -
-                0.0106411 * cos(6 * M_PI * windowPosition / windowEnd);
-          break;
-        case Dso::WINDOW_FLATTOP:
-          for (unsigned int windowPosition = 0;
-               windowPosition < this->lastRecordLength; ++windowPosition)
-            *(this->window + windowPosition) =
-                1.0 - 1.93 * cos(2 * M_PI * windowPosition / windowEnd) +
-                1.29 * cos(4 * M_PI * windowPosition / windowEnd) -
-                0.388 * cos(6 * M_PI * windowPosition / windowEnd) +
-                0.032 * cos(8 * M_PI * windowPosition / windowEnd);
-          break;
-        default: // Dso::WINDOW_RECTANGULAR
-          for (unsigned int windowPosition = 0;
-               windowPosition < this->lastRecordLength; ++windowPosition)
-            *(this->window + windowPosition) = 1.0;
-        }
+        this->calculateWindow(this->lastWindow, this->lastRecordLength,
+                              this->window);
       }
 
       // Set sampling interval
@@ -352,26 +376,20 @@ void DataAnalyzer::run() {
       // Reallocate memory for samples if the sample count has changed
       channelData->samples.spectrum.sample.resize(sampleCount);
 
-      // Create sample buffer and apply window
-      double *windowedValues = new double[sampleCount];
+      // Apply window
       for (unsigned int position = 0; position < sampleCount; ++position)
-        windowedValues[position] =
+        this->dftInput[position] =
             this->window[position] *
             channelData->samples.voltage.sample[position];
 
       // Do discrete real to half-complex transformation
       /// \todo Check if record length is multiple of 2
-      /// \todo Reuse plan and use FFTW_MEASURE to get fastest algorithm
-      fftw_plan fftPlan =
-          fftw_plan_r2r_1d(sampleCount, windowedValues,
-                           &channelData->samples.spectrum.sample.front(),
-                           FFTW_R2HC, FFTW_ESTIMATE);
-      fftw_execute(fftPlan);
-      fftw_destroy_plan(fftPlan);
+      fftw_execute(this->dftPlan);
+      std::copy(this->dftOutput, this->dftOutput + sampleCount,
+                channelData->samples.spectrum.sample.begin());
 
       // Do an autocorrelation to get the frequency of the signal
-      double *conjugateComplex =
-          windowedValues; // Reuse the windowedValues buffer
+      double *conjugateComplex = this->dftInput; // Reuse the input buffer
 
       // Real values
       unsigned int position;
@@ -395,12 +413,8 @@ void DataAnalyzer::run() {
         conjugateComplex[position] = 0;
 
       // Do half-complex to real inverse transformation
-      double *correlation = new double[sampleCount];
-      fftPlan = fftw_plan_r2r_1d(sampleCount, conjugateComplex, correlation,
-                                 FFTW_HC2R, FFTW_ESTIMATE);
-      fftw_execute(fftPlan);
-      fftw_destroy_plan(fftPlan);
-      delete[] conjugateComplex;
+      fftw_execute(this->inversePlan);
+      const double *correlation = this->correlation;
 
       // Calculate peak-to-peak voltage
       double minimalVoltage, maximalVoltage;
@@ -428,7 +442,6 @@ void DataAnalyzer::run() {
         } else if (correlation[position] < minimumCorrelation)
           minimumCorrelation = correlation[position];
       }
-      delete[] correlation;
 
       // Calculate the frequency in Hz
       if (peakPosition)
@@ -438,25 +451,8 @@ void DataAnalyzer::run() {
         channelData->frequency = 0;
 
       // Finally calculate the real spectrum if we want it
-      if (this->settings->scope.spectrum[channel].used) {
-        // Convert values into dB (Relative to the reference level)
-        double offset = 60 - this->settings->scope.spectrumReference -
-                        20 * log10(dftLength);
-        double offsetLimit = this->settings->scope.spectrumLimit -
-                             this->settings->scope.spectrumReference;
-        for (std::vector<double>::iterator spectrumIterator =
-                 channelData->samples.spectrum.sample.begin();
-             spectrumIterator != channelData->samples.spectrum.sample.end();
-             ++spectrumIterator) {
-          double value = 20 * log10(fabs(*spectrumIterator)) + offset;
-
-          // Check if this value has to be limited
-          if (offsetLimit > value)
-            value = offsetLimit;
-
-          *spectrumIterator = value;
-        }
-      }
+      if (this->settings->scope.spectrum[channel].used)
+        this->processSpectrum(channel);
     } else if (!channelData->samples.spectrum.sample.empty()) {
       // Clear unused channels
       channelData->samples.spectrum.interval = 0;
@@ -468,6 +464,400 @@ void DataAnalyzer::run() {
   emit(analyzed(maxSamples));
 
   this->analyzedDataMutex->unlock();
+
+  Counters::add(Counters::FRAMES_ANALYZED);
+  Counters::add(Counters::ANALYSIS_TIME, timer.nsecsElapsed());
+}
+
+/// \brief Calculates the displayed spectrum from the dft results.
+/// The power of each frequency bin is accumulated according to the spectrum
+/// mode in buffers that are kept between the acquisitions and only converted
+/// into dB afterwards.
+/// \param channel The channel whose spectrum should be calculated.
+void DataAnalyzer::processSpectrum(unsigned int channel) {
+  AnalyzedData *const channelData = &this->analyzedData[channel];
+  SpectrumState *const state = &this->spectrumState[channel];
+  const Dso::SpectrumMode mode = this->settings->scope.spectrum[channel].mode;
+  const unsigned int count =
+      qMax(this->settings->scope.spectrum[channel].count, 1u);
+
+  // Get the power of the current acquisition
+  unsigned int dftLength;
+  if (mode == Dso::SPECTRUMMODE_WELCH)
+    dftLength = this->calculateWelch(channel, count);
+  else {
+    dftLength = channelData->samples.voltage.sample.size();
+    this->spectrumPower.resize(dftLength / 2 + 1);
+    this->halfcomplexPower(channelData->samples.spectrum.sample.data(),
+                           dftLength, this->spectrumPower.data());
+  }
+  const unsigned int binCount = dftLength / 2 + 1;
+  channelData->samples.spectrum.interval =
+      1.0 / channelData->samples.voltage.interval / dftLength;
+
+  // Restart accumulation if the mode or the frequency bins have changed
+  if (state->power.size() != binCount || state->mode != mode ||
+      state->modeCount != count ||
+      state->interval != channelData->samples.spectrum.interval ||
+      state->window != this->settings->scope.spectrumWindow) {
+    state->power.resize(binCount);
+    state->count = 0;
+    state->mode = mode;
+    state->modeCount = count;
+    state->interval = channelData->samples.spectrum.interval;
+    state->window = this->settings->scope.spectrumWindow;
+  }
+
+  double *const power = state->power.data();
+  const double *const current = this->spectrumPower.data();
+  if (state->count == 0 || mode == Dso::SPECTRUMMODE_NORMAL ||
+      mode == Dso::SPECTRUMMODE_WELCH) {
+    std::copy(current, current + binCount, power);
+    state->count = 1;
+  } else if (mode == Dso::SPECTRUMMODE_MAXHOLD) {
+    for (unsigned int bin = 0; bin < binCount; ++bin)
+      power[bin] = qMax(power[bin], current[bin]);
+  } else {
+    // Same weighting as the averaging acquisition modes
+    double weight;
+    if (mode == Dso::SPECTRUMMODE_AVERAGE) {
+      if (state->count < count)
+        ++state->count;
+      weight = 1.0 / state->count;
+    } else
+      weight = 2.0 / (count + 1);
+
+    for (unsigned int bin = 0; bin < binCount; ++bin)
+      power[bin] += (current[bin] - power[bin]) * weight;
+  }
+
+  // Convert values into dB (Relative to the reference level)
+  double offset = 60 - this->settings->scope.spectrumReference -
+                  20 * log10(dftLength / 2);
+  double offsetLimit = this->settings->scope.spectrumLimit -
+                       this->settings->scope.spectrumReference;
+  channelData->samples.spectrum.sample.resize(binCount);
+  double *const spectrum = channelData->samples.spectrum.sample.data();
+  for (unsigned int bin = 0; bin < binCount; ++bin) {
+    double value = 10 * log10(power[bin]) + offset;
+
+    // Check if this value has to be limited
+    if (offsetLimit > value)
+      value = offsetLimit;
+
+    spectrum[bin] = value;
+  }
+}
+
+/// \brief Calculates the power spectral density with Welch's method.
+/// The record is split into segments that overlap by 50%, the power of the
+/// windowed segments is averaged into spectrumPower.
+/// \param channel The channel whose voltage samples should be used.
+/// \param segments The requested number of segments.
+/// \return The length of the segments.
+unsigned int DataAnalyzer::calculateWelch(unsigned int channel,
+                                          unsigned int segments) {
+  const std::vector<double> &samples =
+      this->analyzedData[channel].samples.voltage.sample;
+  const unsigned int sampleCount = samples.size();
+
+  // Segments of length L with a hop of L/2 cover (N + 1) * L / 2 samples
+  unsigned int length = 2 * sampleCount / (segments + 1);
+  if (length < 16)
+    length = sampleCount;
+  const unsigned int hop = qMax(length / 2, 1u);
+  const unsigned int segmentCount = (sampleCount - length) / hop + 1;
+
+  // The buffers and the plan are only recreated when the length changes
+  if (this->welchLength != length) {
+    if (this->welchPlan) {
+      fftw_destroy_plan(this->welchPlan);
+      fftw_free(this->welchWindow);
+      fftw_free(this->welchInput);
+      fftw_free(this->welchOutput);
+    }
+    this->welchLength = length;
+    this->welchWindow = (double *)fftw_malloc(sizeof(double) * length);
+    this->welchInput = (double *)fftw_malloc(sizeof(double) * length);
+    this->welchOutput = (double *)fftw_malloc(sizeof(double) * length);
+    this->welchPlan = fftw_plan_r2r_1d(length, this->welchInput,
+                                       this->welchOutput, FFTW_R2HC,
+                                       FFTW_ESTIMATE);
+    this->welchPower.resize(length / 2 + 1);
+    this->welchWindowFunction = this->settings->scope.spectrumWindow;
+    this->calculateWindow(this->welchWindowFunction, length,
+                          this->welchWindow);
+  } else if (this->welchWindowFunction !=
+             this->settings->scope.spectrumWindow) {
+    this->welchWindowFunction = this->settings->scope.spectrumWindow;
+    this->calculateWindow(this->welchWindowFunction, length,
+                          this->welchWindow);
+  }
+
+  const unsigned int binCount = length / 2 + 1;
+  this->spectrumPower.assign(binCount, 0.0);
+  for (unsigned int segment = 0; segment < segmentCount; ++segment) {
+    const double *const segmentSamples = samples.data() + segment * hop;
+    for (unsigned int position = 0; position < length; ++position)
+      this->welchInput[position] =
+          this->welchWindow[position] * segmentSamples[position];
+    fftw_execute(this->welchPlan);
+
+    this->halfcomplexPower(this->welchOutput, length, this->welchPower.data());
+    for (unsigned int bin = 0; bin < binCount; ++bin)
+      this->spectrumPower[bin] += this->welchPower[bin];
+  }
+
+  const double factor = 1.0 / segmentCount;
+  for (unsigned int bin = 0; bin < binCount; ++bin)
+    this->spectrumPower[bin] *= factor;
+
+  return length;
+}
+
+/// \brief Calculates the power of each frequency bin of a half-complex dft.
+/// \param halfcomplex The result of a FFTW_R2HC transformation.
+/// \param length The length of the transformation.
+/// \param power The array for the length / 2 + 1 power values.
+void DataAnalyzer::halfcomplexPower(const double *halfcomplex,
+                                    unsigned int length, double *power) {
+  power[0] = halfcomplex[0] * halfcomplex[0];
+  for (unsigned int bin = 1; bin < (length + 1) / 2; ++bin)
+    power[bin] = halfcomplex[bin] * halfcomplex[bin] +
+                 halfcomplex[length - bin] * halfcomplex[length - bin];
+  if (length % 2 == 0)
+    power[length / 2] = halfcomplex[length / 2] * halfcomplex[length / 2];
+}
+
+/// \brief Calculates the factors of a dft window function.
+/// \param function The window function.
+/// \param length The number of factors.
+/// \param window The array the factors are written to.
+void DataAnalyzer::calculateWindow(Dso::WindowFunction function,
+                                   unsigned int length, double *window) {
+  unsigned int windowEnd = length - 1;
+
+  switch (function) {
+  case Dso::WINDOW_HAMMING:
+    for (unsigned int windowPosition = 0; windowPosition < length;
+         ++windowPosition)
+      window[windowPosition] =
+          0.54 - 0.46 * cos(2.0 * M_PI * windowPosition / windowEnd);
+    break;
+  case Dso::WINDOW_HANN:
+    for (unsigned int windowPosition = 0; windowPosition < length;
+         ++windowPosition)
+      window[windowPosition] =
+          0.5 * (1.0 - cos(2.0 * M_PI * windowPosition / windowEnd));
+    break;
+  case Dso::WINDOW_COSINE:
+    for (unsigned int windowPosition = 0; windowPosition < length;
+         ++windowPosition)
+      window[windowPosition] = sin(M_PI * windowPosition / windowEnd);
+    break;
+  case Dso::WINDOW_LANCZOS:
+    for (unsigned int windowPosition = 0; windowPosition < length;
+         ++windowPosition) {
+      double sincParameter = (2.0 * windowPosition / windowEnd - 1.0) * M_PI;
+      if (sincParameter == 0)
+        window[windowPosition] = 1;
+      else
+        window[windowPosition] = sin(sincParameter) / sincParameter;
+    }
+    break;
+  case Dso::WINDOW_BARTLETT:
+    for (unsigned int windowPosition = 0; windowPosition < length;
+         ++windowPosition)
+      window[windowPosition] =
+          2.0 / windowEnd *
+          (windowEnd / 2 -
+           std::abs((double)(windowPosition - windowEnd / 2.0)));
+    break;
+  case Dso::WINDOW_TRIANGULAR:
+    for (unsigned int windowPosition = 0; windowPosition < length;
+         ++windowPosition)
+      window[windowPosition] =
+          2.0 / length *
+          (length / 2 - std::abs((double)(windowPosition - windowEnd / 2.0)));
+    break;
+  case Dso::WINDOW_GAUSS: {
+    double sigma = 0.4;
+    for (unsigned int windowPosition = 0; windowPosition < length;
+         ++windowPosition)
+      window[windowPosition] =
+          exp(-0.5 * pow(((windowPosition - windowEnd / 2) /
+                          (sigma * windowEnd / 2)),
+                         2));
+  } break;
+  case Dso::WINDOW_BARTLETTHANN:
+    for (unsigned int windowPosition = 0; windowPosition < length;
+         ++windowPosition)
+      window[windowPosition] =
+          0.62 - 0.48 * std::abs((double)(windowPosition / windowEnd - 0.5)) -
+          0.38 * cos(2.0 * M_PI * windowPosition / windowEnd);
+    break;
+  case Dso::WINDOW_BLACKMAN: {
+    double alpha = 0.16;
+    for (unsigned int windowPosition = 0; windowPosition < length;
+         ++windowPosition)
+      window[windowPosition] =
+          (1 - alpha) / 2 - 0.5 * cos(2.0 * M_PI * windowPosition / windowEnd) +
+          alpha / 2 * cos(4.0 * M_PI * windowPosition / windowEnd);
+  } break;
+  // case WINDOW_KAISER:
+  // TODO
+  // double alpha = 3.0;
+  // for(unsigned int windowPosition = 0; windowPosition < length;
+  // ++windowPosition)
+  // window[windowPosition] = ;
+  // break;
+  case Dso::WINDOW_NUTTALL:
+    for (unsigned int windowPosition = 0; windowPosition < length;
+         ++windowPosition)
+      window[windowPosition] =
+          0.355768 - 0.487396 * cos(2 * M_PI * windowPosition / windowEnd) +
+          0.144232 * cos(4 * M_PI * windowPosition / windowEnd) -
+          0.012604 * cos(6 * M_PI * windowPosition / windowEnd);
+    break;
+  case Dso::WINDOW_BLACKMANHARRIS:
+    for (unsigned int windowPosition = 0; windowPosition < length;
+         ++windowPosition)
+      window[windowPosition] =
+          0.35875 - 0.48829 * cos(2 * M_PI * windowPosition / windowEnd) +
+          0.14128 * cos(4 * M_PI * windowPosition / windowEnd) -
+          0.01168 * cos(6 * M_PI * windowPosition / windowEnd);
+    break;
+  case Dso::WINDOW_BLACKMANNUTTALL:
+    for (unsigned int windowPosition = 0; windowPosition < length;
+         ++windowPosition)
+      window[windowPosition] =
+          0.3635819 - 0.4891775 * cos(2 * M_PI * windowPosition / windowEnd) +
+          0.1365995 * cos(4 * M_PI * windowPosition / windowEnd) -
+          0.0106411 * cos(6 * M_PI * windowPosition / windowEnd);
+    break;
+  case Dso::WINDOW_FLATTOP:
+    for (unsigned int windowPosition = 0; windowPosition < length;
+         ++windowPosition)
+      window[windowPosition] =
+          1.0 - 1.93 * cos(2 * M_PI * windowPosition / windowEnd) +
+          1.29 * cos(4 * M_PI * windowPosition / windowEnd) -
+          0.388 * cos(6 * M_PI * windowPosition / windowEnd) +
+          0.032 * cos(8 * M_PI * windowPosition / windowEnd);
+    break;
+  default: // Dso::WINDOW_RECTANGULAR
+    for (unsigned int windowPosition = 0; windowPosition < length;
+         ++windowPosition)
+      window[windowPosition] = 1.0;
+  }
+}
+
+/// \brief Applies the acquisition mode to the samples of a physical channel.
+/// The samples are processed in place, the averaged values and the envelope
+/// are accumulated in buffers that are only reallocated when the record length
+/// grows.
+/// \param channel The physical channel whose samples should be processed.
+void DataAnalyzer::processAcquisition(unsigned int channel) {
+  SampleValues *const voltage = &this->analyzedData[channel].samples.voltage;
+  SampleEnvelope *const envelope =
+      &this->analyzedData[channel].samples.envelope;
+  AcquisitionState *const state = &this->acquisitionState[channel];
+  const Dso::AcquisitionMode mode = this->settings->scope.acquisition.mode;
+  const unsigned int count = qMax(this->settings->scope.acquisition.count, 1u);
+  const unsigned int sampleCount = voltage->sample.size();
+  double *const samples = voltage->sample.data();
+
+  if (mode != Dso::ACQUISITIONMODE_ENVELOPE) {
+    envelope->minimum.clear();
+    envelope->maximum.clear();
+  }
+
+  // Restart accumulation if the gain or the horizontal settings have changed
+  if (state->sampleCount != sampleCount ||
+      state->interval != voltage->interval ||
+      state->gain != this->settings->scope.voltage[channel].gain) {
+    state->count = 0;
+    state->sampleCount = sampleCount;
+    state->interval = voltage->interval;
+    state->gain = this->settings->scope.voltage[channel].gain;
+  }
+
+  switch (mode) {
+  case Dso::ACQUISITIONMODE_AVERAGE:
+  case Dso::ACQUISITIONMODE_EXPONENTIAL: {
+    if (state->count == 0) {
+      state->accumulator.assign(voltage->sample.begin(), voltage->sample.end());
+      state->count = 1;
+      break;
+    }
+
+    // The average of the last N acquisitions is approximated by weighting
+    // new acquisitions with 1/N once N acquisitions have been accumulated
+    double weight;
+    if (mode == Dso::ACQUISITIONMODE_AVERAGE) {
+      if (state->count < count)
+        ++state->count;
+      weight = 1.0 / state->count;
+    } else
+      weight = 2.0 / (count + 1);
+
+    double *const accumulator = state->accumulator.data();
+    for (unsigned int position = 0; position < sampleCount; ++position) {
+      accumulator[position] += (samples[position] - accumulator[position]) *
+                               weight;
+      samples[position] = accumulator[position];
+    }
+    break;
+  }
+  case Dso::ACQUISITIONMODE_HIGHRES: {
+    // Replace each group of samples by its average
+    unsigned int points = sampleCount / count;
+    if (points == 0)
+      break;
+
+    const double factor = 1.0 / count;
+    for (unsigned int point = 0; point < points; ++point) {
+      const double *const group = samples + point * count;
+      double sum = 0.0;
+      for (unsigned int position = 0; position < count; ++position)
+        sum += group[position];
+      samples[point] = sum * factor;
+    }
+    voltage->sample.resize(points);
+    voltage->interval *= count;
+    break;
+  }
+  case Dso::ACQUISITIONMODE_ENVELOPE: {
+    // Minimum and maximum of each bucket, held over the acquisitions
+    unsigned int buckets = (sampleCount + count - 1) / count;
+    bool hold = state->count > 0 && envelope->minimum.size() == buckets;
+    envelope->minimum.resize(buckets);
+    envelope->maximum.resize(buckets);
+    envelope->interval = voltage->interval * count;
+
+    double *const minimum = envelope->minimum.data();
+    double *const maximum = envelope->maximum.data();
+    for (unsigned int bucket = 0; bucket < buckets; ++bucket) {
+      const unsigned int end = qMin((bucket + 1) * count, sampleCount);
+      double bucketMinimum = samples[bucket * count];
+      double bucketMaximum = bucketMinimum;
+      for (unsigned int position = bucket * count + 1; position < end;
+           ++position) {
+        bucketMinimum = qMin(bucketMinimum, samples[position]);
+        bucketMaximum = qMax(bucketMaximum, samples[position]);
+      }
+      if (hold) {
+        bucketMinimum = qMin(bucketMinimum, minimum[bucket]);
+        bucketMaximum = qMax(bucketMaximum, maximum[bucket]);
+      }
+      minimum[bucket] = bucketMinimum;
+      maximum[bucket] = bucketMaximum;
+    }
+    state->count = 1;
+    break;
+  }
+  default:
+    break;
+  }
 }
 
 /// \brief Starts the analyzing of new input data.
@@ -481,6 +871,7 @@ void DataAnalyzer::analyze(const std::vector<std::vector<double>> *data,
                            double samplerate, bool append, QMutex *mutex) {
   // Previous analysis still running, drop the new data
   if (this->isRunning()) {
+    Counters::add(Counters::FRAMES_DROPPED);
 #ifdef DEBUG
     Helper::timestampDebug("Analyzer overload, dropping packets!");
 #endif
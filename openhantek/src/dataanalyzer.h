@@ -27,14 +27,18 @@
 
 #include <vector>
 
+#include <QMutex>
 #include <QThread>
 
+#include <fftw3.h>
+
 #include "dso.h"
 #include "helper.h"
+#include "mathexpression.h"
 
+class DigitalFilter;
 class DsoSettings;
 class HantekDSOAThread;
-class QMutex;
 
 ////////////////////////////////////////////////////////////////////////////////
 /// \struct SampleValues                                          dataanalyzer.h
@@ -46,12 +50,24 @@ struct SampleValues {
   SampleValues();
 };
 
+////////////////////////////////////////////////////////////////////////////////
+/// \struct SampleEnvelope                                        dataanalyzer.h
+/// \brief Struct for the minimum and maximum values of sample buckets.
+struct SampleEnvelope {
+  std::vector<double> minimum; ///< The lowest value of each bucket
+  std::vector<double> maximum; ///< The highest value of each bucket
+  double interval;             ///< The interval between two buckets
+
+  SampleEnvelope();
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 /// \struct SampleData                                            dataanalyzer.h
 /// \brief Struct for the sample value arrays.
 struct SampleData {
   SampleValues voltage;  ///< The time-domain voltage levels (V)
   SampleValues spectrum; ///< The frequency-domain power levels (dB)
+  SampleEnvelope envelope; ///< The voltage envelope (Envelope mode only)
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -65,6 +81,35 @@ struct AnalyzedData {
   AnalyzedData();
 };
 
+////////////////////////////////////////////////////////////////////////////////
+/// \struct AcquisitionState                                      dataanalyzer.h
+/// \brief The accumulated samples of the averaging and envelope modes for one
+/// channel.
+struct AcquisitionState {
+  std::vector<double> accumulator; ///< The averaged sample values
+  unsigned int count;              ///< Number of accumulated acquisitions
+  unsigned int sampleCount; ///< The record length of the accumulated samples
+  double interval; ///< The interval between two accumulated samples
+  double gain;     ///< The gain used for the accumulated samples
+
+  AcquisitionState();
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \struct SpectrumState                                         dataanalyzer.h
+/// \brief The accumulated spectrum power of the averaging and max-hold modes
+/// for one channel.
+struct SpectrumState {
+  std::vector<double> power;  ///< The accumulated power of each frequency bin
+  unsigned int count;         ///< Number of accumulated spectrums
+  Dso::SpectrumMode mode;     ///< The mode of the accumulated power
+  unsigned int modeCount;     ///< The averaging count of the accumulated power
+  double interval;            ///< The frequency step between two bins
+  Dso::WindowFunction window; ///< The window used for the accumulated power
+
+  SpectrumState();
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 /// \class DataAnalyzer                                           dataanalyzer.h
 /// \brief Analyzes the data from the dso.
@@ -83,6 +128,14 @@ public:
 
 protected:
   void run();
+  void processAcquisition(unsigned int channel);
+  void processSpectrum(unsigned int channel);
+  unsigned int calculateWelch(unsigned int channel, unsigned int segments);
+
+  static void calculateWindow(Dso::WindowFunction function,
+                              unsigned int length, double *window);
+  static void halfcomplexPower(const double *halfcomplex, unsigned int length,
+                               double *power);
 
   DsoSettings *settings; ///< The settings provided by the parent class
 
@@ -95,6 +148,33 @@ protected:
   unsigned int maxSamples; ///< The maximum record length of the analyzed data
   Dso::WindowFunction lastWindow; ///< The previously used dft window function
   double *window;                 ///< The array for the dft window factors
+  double *dftInput;               ///< The windowed samples, then the power
+  double *dftOutput;              ///< The half-complex spectrum
+  double *correlation;            ///< The autocorrelation of the samples
+  fftw_plan dftPlan;              ///< Transforms dftInput into dftOutput
+  fftw_plan inversePlan;          ///< Transforms dftInput into correlation
+
+  std::vector<AcquisitionState>
+      acquisitionState; ///< The averaging buffers for each physical channel
+  Dso::AcquisitionMode lastAcquisitionMode; ///< The previous acquisition mode
+  unsigned int lastAcquisitionCount; ///< The previous averaging count
+  double lastTimebase; ///< The timebase of the accumulated samples
+
+  std::vector<SpectrumState>
+      spectrumState; ///< The power accumulators for each channel
+  std::vector<double> spectrumPower; ///< The power of the current spectrum
+  unsigned int welchLength;          ///< The length of the Welch segments
+  Dso::WindowFunction welchWindowFunction; ///< The window of welchWindow
+  double *welchWindow; ///< The window factors for the Welch segments
+  double *welchInput;  ///< The windowed segment for the Welch dft
+  double *welchOutput; ///< The half-complex spectrum of the segment
+  std::vector<double> welchPower; ///< The power of the segment
+  fftw_plan welchPlan; ///< The plan reused for all Welch segments
+
+  MathExpression mathExpression; ///< The compiled formula of the math channel
+  QString mathSource;             ///< The formula set by setMathExpression()
+  QMutex mathSourceMutex;         ///< Protects mathSource
+  std::vector<DigitalFilter *> filters; ///< The filter of each physical channel
 
   const std::vector<std::vector<double>>
       *waitingData;             ///< Pointer to input data from device
@@ -105,6 +185,7 @@ protected:
 public slots:
   void analyze(const std::vector<std::vector<double>> *data, double samplerate,
                bool append, QMutex *mutex);
+  void setMathExpression(const QString &source);
 
 signals:
   void analyzed(unsigned long samples); ///< The data with that much samples has
@@ -0,0 +1,310 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  datalogger.cpp
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstring>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+
+#include "datalogger.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// class IndexQueue
+/// \brief Initializes an empty queue.
+/// \param capacity The maximum number of queued indices.
+IndexQueue::IndexQueue(unsigned int capacity) : entries(capacity + 1) {
+  this->head.storeRelease(0);
+  this->tail.storeRelease(0);
+}
+
+/// \brief Appends an index, may only be called by the producer thread.
+/// \param value The index that should be queued.
+/// \return false if the queue is full.
+bool IndexQueue::push(unsigned int value) {
+  const int tail = this->tail.load();
+  const int next = (tail + 1) % this->entries.size();
+  if (next == this->head.loadAcquire())
+    return false;
+
+  this->entries[tail] = value;
+  this->tail.storeRelease(next);
+  return true;
+}
+
+/// \brief Removes the oldest index, may only be called by the consumer thread.
+/// \param value Receives the index.
+/// \return false if the queue is empty.
+bool IndexQueue::pop(unsigned int *value) {
+  const int head = this->head.load();
+  if (head == this->tail.loadAcquire())
+    return false;
+
+  *value = this->entries[head];
+  this->head.storeRelease((head + 1) % this->entries.size());
+  return true;
+}
+
+/// \brief Empties the queue, no other thread may use it meanwhile.
+void IndexQueue::clear() {
+  this->head.storeRelease(0);
+  this->tail.storeRelease(0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class DataLogger
+/// \brief Initializes the logger and its records.
+/// \param parent The parent object.
+DataLogger::DataLogger(QObject *parent)
+    : QThread(parent), records(DATALOGGER_RECORDS),
+      freeRecords(DATALOGGER_RECORDS), filledRecords(DATALOGGER_RECORDS) {
+  this->active.storeRelease(0);
+  this->stopping.storeRelease(0);
+  this->dropped.storeRelease(0);
+
+  this->rotateSize = 0;
+  this->rotateTime = 0;
+  this->file = 0;
+  this->fileOpened = 0;
+}
+
+/// \brief Finishes writing and closes the log file.
+DataLogger::~DataLogger() { this->close(); }
+
+/// \brief Starts logging into a new file.
+/// \param directory The directory for the log files.
+/// \param rotateSize Size in bytes after that a new file is started, 0 for no
+/// limit.
+/// \param rotateTime Time in seconds after that a new file is started, 0 for
+/// no limit.
+/// \return true if the first file was created.
+bool DataLogger::open(const QString &directory, quint64 rotateSize,
+                      unsigned int rotateTime) {
+  this->close();
+
+  this->directory = directory;
+  this->rotateSize = rotateSize;
+  this->rotateTime = rotateTime;
+  if (!QDir().mkpath(directory) || !this->openFile())
+    return false;
+
+  // All records are free
+  this->freeRecords.clear();
+  this->filledRecords.clear();
+  for (unsigned int index = 0; index < this->records.size(); ++index)
+    this->freeRecords.push(index);
+  this->filledCount.acquire(this->filledCount.available());
+
+  this->dropped.storeRelease(0);
+  this->stopping.storeRelease(0);
+  this->start(QThread::LowPriority);
+  this->logMutex.lock();
+  this->active.storeRelease(1);
+  this->logMutex.unlock();
+
+  return true;
+}
+
+/// \brief Stops logging after the queued acquisitions have been written.
+void DataLogger::close() {
+  // Wait for a running log(), no further one will queue a record afterwards
+  this->logMutex.lock();
+  this->active.storeRelease(0);
+  this->logMutex.unlock();
+
+  if (this->isRunning()) {
+    this->stopping.storeRelease(1);
+    this->filledCount.release();
+    this->wait();
+  }
+
+  if (this->file) {
+    this->file->close();
+    delete this->file;
+    this->file = 0;
+  }
+}
+
+/// \brief Checks if acquisitions are logged.
+/// \return true if the logger is open.
+bool DataLogger::isOpen() const { return this->active.loadAcquire() != 0; }
+
+/// \brief Returns the number of dropped acquisitions.
+/// \return Acquisitions that were dropped because the queue was full.
+unsigned int DataLogger::getDropped() const {
+  return this->dropped.loadAcquire();
+}
+
+/// \brief Returns the name of the current log file.
+/// \return The absolute path of the file that is written.
+QString DataLogger::getFileName() const {
+  QMutexLocker locker(&this->fileNameMutex);
+  return this->fileName;
+}
+
+/// \brief Writes the queued records until the logger is closed.
+void DataLogger::run() {
+  bool error = false;
+
+  forever {
+    // Wake up regularly to rotate the file even without new data
+    bool available = this->filledCount.tryAcquire(1, 500);
+    unsigned int index;
+    if (available)
+      available = this->filledRecords.pop(&index);
+
+    if (!error) {
+      qint64 age = QDateTime::currentMSecsSinceEpoch() - this->fileOpened;
+      if ((this->rotateTime > 0 && age >= (qint64)this->rotateTime * 1000) ||
+          (available && this->rotateSize > 0 &&
+           (quint64)this->file->size() >= this->rotateSize))
+        error = !this->openFile();
+      if (!error && available)
+        error = !this->writeRecord(index);
+      if (error) {
+        this->active.storeRelease(0);
+        emit this->failed(tr("Logging to %1 failed").arg(this->fileName));
+      }
+    }
+
+    if (available)
+      this->freeRecords.push(index);
+    else if (this->stopping.loadAcquire())
+      break;
+  }
+
+  if (this->file)
+    this->file->flush();
+}
+
+/// \brief Closes the current log file and starts a new one.
+/// \return true if the new file was created.
+bool DataLogger::openFile() {
+  if (this->file) {
+    this->file->close();
+    delete this->file;
+  }
+
+  this->fileOpened = QDateTime::currentMSecsSinceEpoch();
+  QString fileName = QDir(this->directory)
+                         .absoluteFilePath(
+                             QDateTime::fromMSecsSinceEpoch(this->fileOpened)
+                                 .toString("yyyyMMdd-hhmmss-zzz") +
+                             ".ohlog");
+  this->fileNameMutex.lock();
+  this->fileName = fileName;
+  this->fileNameMutex.unlock();
+  this->file = new QFile(fileName);
+  if (!this->file->open(QIODevice::WriteOnly))
+    return false;
+
+  const quint32 byteOrder = DATALOGGER_BYTEORDER;
+  return this->file->write(DATALOGGER_MAGIC, 8) == 8 &&
+         this->file->write((const char *)&byteOrder, sizeof(byteOrder)) ==
+             sizeof(byteOrder);
+}
+
+/// \brief Appends a record to the current log file.
+/// \param index The index of the record.
+/// \return true if the record was written completely.
+bool DataLogger::writeRecord(unsigned int index) {
+  const Record &record = this->records[index];
+  const quint32 channelCount = record.channels.size();
+
+  // The header with the sample counts is written at once
+  std::vector<char> header(sizeof(quint32) + sizeof(qint64) + sizeof(double) +
+                           sizeof(quint32) * (2 + channelCount));
+  quint32 size = header.size();
+  for (quint32 channel = 0; channel < channelCount; ++channel)
+    size += record.channels[channel].size() * sizeof(float);
+  const quint32 flags = record.append ? 1 : 0;
+
+  char *position = &header.front();
+  memcpy(position, &size, sizeof(size));
+  position += sizeof(size);
+  memcpy(position, &record.timestamp, sizeof(record.timestamp));
+  position += sizeof(record.timestamp);
+  memcpy(position, &record.samplerate, sizeof(record.samplerate));
+  position += sizeof(record.samplerate);
+  memcpy(position, &flags, sizeof(flags));
+  position += sizeof(flags);
+  memcpy(position, &channelCount, sizeof(channelCount));
+  position += sizeof(channelCount);
+  for (quint32 channel = 0; channel < channelCount; ++channel) {
+    const quint32 sampleCount = record.channels[channel].size();
+    memcpy(position, &sampleCount, sizeof(sampleCount));
+    position += sizeof(sampleCount);
+  }
+
+  if (this->file->write(&header.front(), header.size()) !=
+      (qint64)header.size())
+    return false;
+
+  for (quint32 channel = 0; channel < channelCount; ++channel) {
+    const std::vector<float> &samples = record.channels[channel];
+    if (samples.empty())
+      continue;
+    const qint64 length = samples.size() * sizeof(float);
+    if (this->file->write((const char *)&samples.front(), length) != length)
+      return false;
+  }
+
+  return true;
+}
+
+/// \brief Copies an acquisition into a free record and queues it.
+/// This slot has to be connected directly, it's called in the thread of the
+/// oscilloscope control and never waits for the disk. It holds logMutex, so
+/// open() and close() can't reset the queues while a record is filled.
+/// \param data The samples of all channels.
+/// \param samplerate The samplerate in S/s.
+/// \param append true, if it is a roll mode block.
+/// \param mutex The mutex that protects the samples.
+void DataLogger::log(const std::vector<std::vector<double>> *data,
+                     double samplerate, bool append, QMutex *mutex) {
+  QMutexLocker locker(&this->logMutex);
+  if (!this->active.loadAcquire())
+    return;
+
+  unsigned int index;
+  if (!this->freeRecords.pop(&index)) {
+    this->dropped.fetchAndAddRelaxed(1);
+    return;
+  }
+
+  Record &record = this->records[index];
+  record.timestamp = QDateTime::currentMSecsSinceEpoch();
+  record.samplerate = samplerate;
+  record.append = append;
+
+  mutex->lock();
+  record.channels.resize(data->size());
+  for (unsigned int channel = 0; channel < data->size(); ++channel) {
+    const std::vector<double> &samples = (*data)[channel];
+    record.channels[channel].resize(samples.size());
+    for (unsigned int position = 0; position < samples.size(); ++position)
+      record.channels[channel][position] = samples[position];
+  }
+  mutex->unlock();
+
+  this->filledRecords.push(index);
+  this->filledCount.release();
+}
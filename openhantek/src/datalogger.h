@@ -0,0 +1,128 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file datalogger.h
+/// \brief Declares the DataLogger class.
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef DATALOGGER_H
+#define DATALOGGER_H
+
+#include <vector>
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QSemaphore>
+#include <QString>
+#include <QThread>
+
+#define DATALOGGER_RECORDS 32           ///< Acquisitions queued for writing
+#define DATALOGGER_MAGIC "OHLOG001"     ///< The first bytes of every log file
+#define DATALOGGER_BYTEORDER 0x01020304 ///< Written in the host byte order
+
+class QFile;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class IndexQueue                                               datalogger.h
+/// \brief Lock-free queue of indices for one producer and one consumer thread.
+class IndexQueue {
+public:
+  IndexQueue(unsigned int capacity);
+
+  bool push(unsigned int value);
+  bool pop(unsigned int *value);
+  void clear();
+
+private:
+  std::vector<unsigned int> entries; ///< One more entry than the capacity
+  QAtomicInt head;                   ///< Next entry read by the consumer
+  QAtomicInt tail;                   ///< Next entry written by the producer
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class DataLogger                                               datalogger.h
+/// \brief Appends every acquisition to rotating binary log files.
+/// The samples are copied into preallocated records in the thread that emits
+/// them and handed to the I/O thread through a lock-free queue. If the disk
+/// can't keep up, acquisitions are dropped instead of blocking the caller.
+/// The producer only competes for logMutex with open() and close(), which
+/// makes sure that it doesn't use the queues while they are reset.
+///
+/// Every file starts with DATALOGGER_MAGIC and DATALOGGER_BYTEORDER as quint32,
+/// followed by the records. A record consists of its size in bytes (quint32,
+/// including this field), the timestamp in ms since the epoch (qint64), the
+/// samplerate in S/s (double), flags (quint32, bit 0 set for roll mode
+/// blocks), the channel count (quint32), the sample count of each channel
+/// (quint32) and the samples of all channels one after another (float).
+class DataLogger : public QThread {
+  Q_OBJECT
+
+public:
+  DataLogger(QObject *parent = 0);
+  ~DataLogger();
+
+  bool open(const QString &directory, quint64 rotateSize,
+            unsigned int rotateTime);
+  void close();
+  bool isOpen() const;
+
+  unsigned int getDropped() const;
+  QString getFileName() const;
+
+protected:
+  void run();
+
+  bool openFile();
+  bool writeRecord(unsigned int index);
+
+private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \struct Record                                              datalogger.h
+  /// \brief One queued acquisition.
+  struct Record {
+    qint64 timestamp;  ///< Time of the acquisition in ms since the epoch
+    double samplerate; ///< The samplerate in S/s
+    bool append;       ///< true, if it is a roll mode block
+    std::vector<std::vector<float>> channels; ///< The samples of each channel
+  };
+
+  std::vector<Record> records; ///< The preallocated records
+  IndexQueue freeRecords;      ///< Records that can be filled
+  IndexQueue filledRecords;    ///< Records waiting to be written
+  QSemaphore filledCount;      ///< Wakes the I/O thread
+  QAtomicInt active;           ///< 1 while acquisitions are logged
+  QAtomicInt stopping;         ///< 1 when the I/O thread should finish
+  QAtomicInt dropped;          ///< Acquisitions dropped since open()
+  QMutex logMutex;             ///< Held by log() while it uses a record
+
+  QString directory;            ///< The directory for the log files
+  quint64 rotateSize;           ///< Maximum file size in bytes, 0 for no limit
+  unsigned int rotateTime;      ///< Maximum file age in s, 0 for no limit
+  QFile *file;                  ///< The current log file
+  QString fileName;             ///< The name of the current log file
+  mutable QMutex fileNameMutex; ///< Protects fileName from the I/O thread
+  qint64 fileOpened;            ///< Time the current file was opened in ms
+
+public slots:
+  void log(const std::vector<std::vector<double>> *data, double samplerate,
+           bool append, QMutex *mutex);
+
+signals:
+  void failed(const QString &message); ///< Writing failed, logging stopped
+};
+
+#endif
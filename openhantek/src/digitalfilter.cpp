@@ -0,0 +1,438 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  digitalfilter.cpp
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cmath>
+
+#include <QtGlobal>
+
+#include "digitalfilter.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// class DigitalFilter
+/// \brief Initializes an inactive filter.
+DigitalFilter::DigitalFilter() {
+  this->type = Dso::FILTERTYPE_NONE;
+  this->design = Dso::FILTERDESIGN_IIR;
+  this->frequency = 0.0;
+  this->bandwidth = 0.0;
+  this->order = 0;
+  this->samplerate = 0.0;
+  this->active = false;
+  this->primed = false;
+  this->filtered = 0;
+
+  this->fftSize = 0;
+  this->fftInput = 0;
+  this->fftSpectrum = 0;
+  this->tapSpectrum = 0;
+  this->fftOutput = 0;
+  this->forwardPlan = 0;
+  this->backwardPlan = 0;
+}
+
+/// \brief Frees the FFT buffers and plans.
+DigitalFilter::~DigitalFilter() { this->releaseFft(); }
+
+/// \brief Designs the filter, nothing is done if the parameters didn't change.
+/// \param type The frequency response.
+/// \param design IIR biquad cascade or FIR filter.
+/// \param frequency The cutoff or center frequency in Hz.
+/// \param bandwidth The width of the band-pass or notch in Hz.
+/// \param order The IIR filter order or the number of FIR taps.
+/// \param samplerate The samplerate of the filtered samples in S/s.
+void DigitalFilter::setup(Dso::FilterType type, Dso::FilterDesign design,
+                          double frequency, double bandwidth,
+                          unsigned int order, double samplerate) {
+  if (type == this->type && design == this->design &&
+      frequency == this->frequency && bandwidth == this->bandwidth &&
+      order == this->order && samplerate == this->samplerate)
+    return;
+
+  this->type = type;
+  this->design = design;
+  this->frequency = frequency;
+  this->bandwidth = bandwidth;
+  this->order = order;
+  this->samplerate = samplerate;
+
+  this->sections.clear();
+  this->taps.clear();
+  this->releaseFft();
+
+  // Frequencies have to be below the nyquist frequency
+  this->active = type != Dso::FILTERTYPE_NONE && samplerate > 0 &&
+                 frequency > 0 && frequency < samplerate / 2;
+  if (this->active && (type == Dso::FILTERTYPE_BANDPASS ||
+                       type == Dso::FILTERTYPE_NOTCH))
+    this->active = bandwidth > 0;
+  if (!this->active)
+    return;
+
+  if (design == Dso::FILTERDESIGN_IIR)
+    this->designBiquads();
+  else
+    this->designTaps();
+
+  this->reset();
+}
+
+/// \brief Checks if the samples are changed by process().
+/// \return true, if a valid filter has been set up.
+bool DigitalFilter::isActive() const { return this->active; }
+
+/// \brief Get the group delay that process() compensates.
+/// \return The delay of the FIR filter in samples, 0 for IIR filters.
+unsigned int DigitalFilter::getDelay() const {
+  if (!this->active || this->design == Dso::FILTERDESIGN_IIR)
+    return 0;
+  return this->history.size() / 2;
+}
+
+/// \brief Clears the filter state, the next sample starts a new signal.
+void DigitalFilter::reset() {
+  this->primed = false;
+  this->filtered = 0;
+}
+
+/// \brief Filters the samples in place.
+/// FIR filters need getDelay() samples beyond the end of the block, they are
+/// extrapolated by holding the last sample. If the block continues the one of
+/// the last call, the output of that call has to be directly in front of
+/// \p samples, since its last getDelay() samples are corrected with the real
+/// input of this block.
+/// \param samples The samples that should be filtered.
+/// \param count The number of samples.
+void DigitalFilter::process(double *samples, unsigned int count) {
+  if (!this->active || count == 0)
+    return;
+
+  if (!this->primed) {
+    // Start in the steady state for the first sample to avoid a step response
+    double input = samples[0];
+    for (std::vector<Biquad>::iterator section = this->sections.begin();
+         section != this->sections.end(); ++section) {
+      double output = input * (section->b0 + section->b1 + section->b2) /
+                      (1.0 + section->a1 + section->a2);
+      section->z1 = output - section->b0 * input;
+      section->z2 = section->b2 * input - section->a2 * output;
+      input = output;
+    }
+    std::fill(this->history.begin(), this->history.end(), samples[0]);
+    this->primed = true;
+  }
+
+  if (this->design == Dso::FILTERDESIGN_IIR) {
+    this->processBiquads(samples, count);
+    return;
+  }
+
+  // The output lags the input by delay samples, the tail provides the last
+  // outputs without changing the state for the next block
+  unsigned int delay = this->getDelay();
+  unsigned int corrected = qMin(delay, this->filtered);
+  this->tail.assign(delay, samples[count - 1]);
+  this->processTaps(samples, count);
+  this->saved = this->history;
+  this->processTaps(this->tail.data(), delay);
+  this->history.swap(this->saved);
+
+  // Move the output back by delay, overwriting the estimates of the last block
+  double *output = samples - corrected;
+  for (unsigned int index = delay - corrected; index < count + delay; ++index)
+    *output++ = index < count ? samples[index] : this->tail[index - count];
+  this->filtered = qMin(this->filtered + count, delay);
+}
+
+/// \brief Calculates the biquad sections of a Butterworth filter.
+void DigitalFilter::designBiquads() {
+  unsigned int sectionCount =
+      (qBound(1u, this->order, (unsigned int)DIGITALFILTER_MAXORDER) + 1) / 2;
+  double omega = 2.0 * M_PI * this->frequency / this->samplerate;
+  double cosOmega = cos(omega);
+
+  for (unsigned int index = 0; index < sectionCount; ++index) {
+    double quality;
+    if (this->type == Dso::FILTERTYPE_LOWPASS ||
+        this->type == Dso::FILTERTYPE_HIGHPASS)
+      // The pole pairs of the Butterworth filter
+      quality = 1.0 / (2.0 * cos(M_PI * (2 * index + 1) / (4 * sectionCount)));
+    else
+      quality = this->frequency / this->bandwidth;
+    double alpha = sin(omega) / (2.0 * quality);
+
+    Biquad section;
+    switch (this->type) {
+    case Dso::FILTERTYPE_LOWPASS:
+      section.b0 = (1.0 - cosOmega) / 2.0;
+      section.b1 = 1.0 - cosOmega;
+      section.b2 = section.b0;
+      break;
+    case Dso::FILTERTYPE_HIGHPASS:
+      section.b0 = (1.0 + cosOmega) / 2.0;
+      section.b1 = -(1.0 + cosOmega);
+      section.b2 = section.b0;
+      break;
+    case Dso::FILTERTYPE_BANDPASS:
+      section.b0 = alpha;
+      section.b1 = 0.0;
+      section.b2 = -alpha;
+      break;
+    default:
+      section.b0 = 1.0;
+      section.b1 = -2.0 * cosOmega;
+      section.b2 = 1.0;
+      break;
+    }
+    section.a1 = -2.0 * cosOmega;
+    section.a2 = 1.0 - alpha;
+
+    // Normalize to a0 = 1
+    double a0 = 1.0 + alpha;
+    section.b0 /= a0;
+    section.b1 /= a0;
+    section.b2 /= a0;
+    section.a1 /= a0;
+    section.a2 /= a0;
+    section.z1 = 0.0;
+    section.z2 = 0.0;
+
+    this->sections.push_back(section);
+  }
+}
+
+/// \brief Calculates the coefficients of a windowed sinc FIR filter.
+void DigitalFilter::designTaps() {
+  // Odd number of taps for a symmetric filter with integer delay
+  unsigned int count =
+      qBound(3u, this->order | 1, (unsigned int)DIGITALFILTER_MAXTAPS);
+  std::vector<double> lower(count), upper(count);
+
+  switch (this->type) {
+  case Dso::FILTERTYPE_LOWPASS:
+    this->lowpassTaps(this->frequency, &this->taps);
+    break;
+  case Dso::FILTERTYPE_HIGHPASS:
+    this->lowpassTaps(this->frequency, &lower);
+    this->taps.assign(count, 0.0);
+    for (unsigned int tap = 0; tap < count; ++tap)
+      this->taps[tap] = -lower[tap];
+    this->taps[count / 2] += 1.0;
+    break;
+  default:
+    // Band-pass is the difference of two low-passes, notch the inverse of it
+    this->lowpassTaps(qMax(this->frequency - this->bandwidth / 2, 0.0),
+                      &lower);
+    this->lowpassTaps(qMin(this->frequency + this->bandwidth / 2,
+                           this->samplerate / 2),
+                      &upper);
+    this->taps.assign(count, 0.0);
+    for (unsigned int tap = 0; tap < count; ++tap)
+      this->taps[tap] = upper[tap] - lower[tap];
+    if (this->type == Dso::FILTERTYPE_NOTCH) {
+      for (unsigned int tap = 0; tap < count; ++tap)
+        this->taps[tap] = -this->taps[tap];
+      this->taps[count / 2] += 1.0;
+    }
+    break;
+  }
+
+  // Store reversed, so the convolution is a dot product over the history
+  std::reverse(this->taps.begin(), this->taps.end());
+  this->history.assign(count - 1, 0.0);
+
+  if (count <= DIGITALFILTER_DIRECTTAPS)
+    return;
+
+  // Overlap-save, every transform yields fftSize - count + 1 samples
+  this->fftSize = 1024;
+  while (this->fftSize < 4 * count)
+    this->fftSize <<= 1;
+  unsigned int spectrumSize = this->fftSize / 2 + 1;
+  this->fftInput = (double *)fftw_malloc(sizeof(double) * this->fftSize);
+  this->fftOutput = (double *)fftw_malloc(sizeof(double) * this->fftSize);
+  this->fftSpectrum =
+      (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * spectrumSize);
+  this->tapSpectrum =
+      (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * spectrumSize);
+  this->forwardPlan = fftw_plan_dft_r2c_1d(this->fftSize, this->fftInput,
+                                           this->fftSpectrum, FFTW_ESTIMATE);
+  this->backwardPlan = fftw_plan_dft_c2r_1d(this->fftSize, this->fftSpectrum,
+                                            this->fftOutput, FFTW_ESTIMATE);
+
+  // Transform the coefficients once, including the 1/n of the inverse FFT
+  std::fill(this->fftInput, this->fftInput + this->fftSize, 0.0);
+  for (unsigned int tap = 0; tap < count; ++tap)
+    this->fftInput[tap] = this->taps[count - 1 - tap] / this->fftSize;
+  fftw_execute(this->forwardPlan);
+  std::copy(&this->fftSpectrum[0][0],
+            &this->fftSpectrum[0][0] + 2 * spectrumSize,
+            &this->tapSpectrum[0][0]);
+}
+
+/// \brief Calculates the coefficients of a Blackman windowed sinc low-pass.
+/// \param cutoff The cutoff frequency in Hz.
+/// \param taps The vector the coefficients are written to, it also gives the
+/// number of taps.
+void DigitalFilter::lowpassTaps(double cutoff,
+                                std::vector<double> *taps) const {
+  unsigned int count =
+      qBound(3u, this->order | 1, (unsigned int)DIGITALFILTER_MAXTAPS);
+  double normalized = cutoff / this->samplerate;
+  double center = (count - 1) / 2.0;
+  double sum = 0.0;
+
+  taps->resize(count);
+  for (unsigned int tap = 0; tap < count; ++tap) {
+    double position = tap - center;
+    double sinc = (position == 0.0)
+                      ? 2.0 * normalized
+                      : sin(2.0 * M_PI * normalized * position) /
+                            (M_PI * position);
+    double window = 0.42 - 0.5 * cos(2.0 * M_PI * tap / (count - 1)) +
+                    0.08 * cos(4.0 * M_PI * tap / (count - 1));
+    (*taps)[tap] = sinc * window;
+    sum += (*taps)[tap];
+  }
+
+  // Unity gain at DC, a cutoff of 0 gives an all-zero filter
+  if (sum != 0.0 && cutoff > 0.0)
+    for (unsigned int tap = 0; tap < count; ++tap)
+      (*taps)[tap] /= sum;
+}
+
+/// \brief Runs the samples through the biquad cascade.
+/// \param samples The samples that should be filtered.
+/// \param count The number of samples.
+void DigitalFilter::processBiquads(double *samples, unsigned int count) {
+  for (std::vector<Biquad>::iterator section = this->sections.begin();
+       section != this->sections.end(); ++section) {
+    const double b0 = section->b0, b1 = section->b1, b2 = section->b2;
+    const double a1 = section->a1, a2 = section->a2;
+    double z1 = section->z1, z2 = section->z2;
+
+    for (unsigned int sample = 0; sample < count; ++sample) {
+      double input = samples[sample];
+      double output = b0 * input + z1;
+      z1 = b1 * input - a1 * output + z2;
+      z2 = b2 * input - a2 * output;
+      samples[sample] = output;
+    }
+
+    section->z1 = z1;
+    section->z2 = z2;
+  }
+}
+
+/// \brief Convolves the samples with the FIR coefficients.
+/// \param samples The samples that should be filtered.
+/// \param count The number of samples.
+void DigitalFilter::processTaps(double *samples, unsigned int count) {
+  if (this->taps.size() <= DIGITALFILTER_DIRECTTAPS)
+    this->processDirect(samples, count);
+  else
+    this->processOverlapSave(samples, count);
+}
+
+/// \brief Convolves the samples directly with the FIR coefficients.
+/// \param samples The samples that should be filtered.
+/// \param count The number of samples.
+void DigitalFilter::processDirect(double *samples, unsigned int count) {
+  unsigned int tapCount = this->taps.size();
+  unsigned int historySize = this->history.size();
+
+  this->work.resize(historySize + count);
+  std::copy(this->history.begin(), this->history.end(), this->work.begin());
+  std::copy(samples, samples + count, this->work.begin() + historySize);
+
+  const double *coefficients = this->taps.data();
+  for (unsigned int sample = 0; sample < count; ++sample) {
+    const double *input = this->work.data() + sample;
+    double sum = 0.0;
+    for (unsigned int tap = 0; tap < tapCount; ++tap)
+      sum += coefficients[tap] * input[tap];
+    samples[sample] = sum;
+  }
+
+  std::copy(this->work.end() - historySize, this->work.end(),
+            this->history.begin());
+}
+
+/// \brief Convolves the samples with the FIR coefficients using overlap-save.
+/// \param samples The samples that should be filtered.
+/// \param count The number of samples.
+void DigitalFilter::processOverlapSave(double *samples, unsigned int count) {
+  unsigned int historySize = this->history.size();
+  unsigned int step = this->fftSize - historySize;
+  unsigned int spectrumSize = this->fftSize / 2 + 1;
+
+  for (unsigned int blockStart = 0; blockStart < count; blockStart += step) {
+    unsigned int blockSize = qMin(step, count - blockStart);
+
+    // The block starts with the history, a short last block is zero-padded
+    std::copy(this->history.begin(), this->history.end(), this->fftInput);
+    std::copy(samples + blockStart, samples + blockStart + blockSize,
+              this->fftInput + historySize);
+    std::fill(this->fftInput + historySize + blockSize,
+              this->fftInput + this->fftSize, 0.0);
+    std::copy(this->fftInput + blockSize,
+              this->fftInput + blockSize + historySize, this->history.begin());
+
+    fftw_execute(this->forwardPlan);
+    for (unsigned int bin = 0; bin < spectrumSize; ++bin) {
+      double real = this->fftSpectrum[bin][0] * this->tapSpectrum[bin][0] -
+                    this->fftSpectrum[bin][1] * this->tapSpectrum[bin][1];
+      double imaginary =
+          this->fftSpectrum[bin][0] * this->tapSpectrum[bin][1] +
+          this->fftSpectrum[bin][1] * this->tapSpectrum[bin][0];
+      this->fftSpectrum[bin][0] = real;
+      this->fftSpectrum[bin][1] = imaginary;
+    }
+    fftw_execute(this->backwardPlan);
+
+    // The first historySize results are wrapped around and discarded
+    std::copy(this->fftOutput + historySize,
+              this->fftOutput + historySize + blockSize, samples + blockStart);
+  }
+}
+
+/// \brief Frees the buffers and plans for the overlap-save convolution.
+void DigitalFilter::releaseFft() {
+  if (this->forwardPlan)
+    fftw_destroy_plan(this->forwardPlan);
+  if (this->backwardPlan)
+    fftw_destroy_plan(this->backwardPlan);
+  if (this->fftInput)
+    fftw_free(this->fftInput);
+  if (this->fftOutput)
+    fftw_free(this->fftOutput);
+  if (this->fftSpectrum)
+    fftw_free(this->fftSpectrum);
+  if (this->tapSpectrum)
+    fftw_free(this->tapSpectrum);
+
+  this->fftSize = 0;
+  this->fftInput = 0;
+  this->fftSpectrum = 0;
+  this->tapSpectrum = 0;
+  this->fftOutput = 0;
+  this->forwardPlan = 0;
+  this->backwardPlan = 0;
+}
@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file digitalfilter.h
+/// \brief Declares the DigitalFilter class.
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef DIGITALFILTER_H
+#define DIGITALFILTER_H
+
+#include <vector>
+
+#include <fftw3.h>
+
+#include "dso.h"
+
+#define DIGITALFILTER_DIRECTTAPS 64 ///< Longest FIR filter convolved directly
+#define DIGITALFILTER_MAXTAPS 65535 ///< Longest supported FIR filter
+#define DIGITALFILTER_MAXORDER 16   ///< Highest supported IIR filter order
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class DigitalFilter                                         digitalfilter.h
+/// \brief Filters the samples of one channel.
+/// IIR filters are cascades of Butterworth biquad sections, FIR filters are
+/// windowed sinc filters. Short FIR filters are convolved directly, long ones
+/// use FFT overlap-save with FFTW plans that are kept until the filter changes.
+/// The filter state is kept between calls to process(), so consecutive blocks
+/// are filtered like one continuous signal until reset() is called. The group
+/// delay of the linear phase FIR filters is compensated, so edges stay where
+/// they are in the unfiltered signal.
+class DigitalFilter {
+public:
+  DigitalFilter();
+  ~DigitalFilter();
+
+  void setup(Dso::FilterType type, Dso::FilterDesign design, double frequency,
+             double bandwidth, unsigned int order, double samplerate);
+  bool isActive() const;
+  unsigned int getDelay() const;
+  void reset();
+  void process(double *samples, unsigned int count);
+
+private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \struct Biquad                                           digitalfilter.h
+  /// \brief The normalized coefficients and the state of a biquad section.
+  struct Biquad {
+    double b0, b1, b2; ///< Numerator coefficients
+    double a1, a2;     ///< Denominator coefficients (a0 is 1)
+    double z1, z2;     ///< State of the transposed direct form II
+  };
+
+  DigitalFilter(const DigitalFilter &);
+  DigitalFilter &operator=(const DigitalFilter &);
+
+  void designBiquads();
+  void designTaps();
+  void lowpassTaps(double cutoff, std::vector<double> *taps) const;
+  void processBiquads(double *samples, unsigned int count);
+  void processTaps(double *samples, unsigned int count);
+  void processDirect(double *samples, unsigned int count);
+  void processOverlapSave(double *samples, unsigned int count);
+  void releaseFft();
+
+  Dso::FilterType type;     ///< The frequency response
+  Dso::FilterDesign design; ///< IIR or FIR implementation
+  double frequency;         ///< Cutoff or center frequency in Hz
+  double bandwidth;         ///< Width of the band in Hz
+  unsigned int order;       ///< Requested order or number of taps
+  double samplerate;        ///< The samplerate the filter was designed for
+  bool active;              ///< false, if the samples are passed unchanged
+  bool primed; ///< false, if the state has to be set from the next sample
+  unsigned int filtered; ///< Output samples since reset(), up to the delay
+
+  std::vector<Biquad> sections; ///< The IIR biquad cascade
+
+  std::vector<double> taps;    ///< The FIR coefficients in reversed order
+  std::vector<double> history; ///< The last taps - 1 input samples
+  std::vector<double> work;    ///< History and input for direct convolution
+  std::vector<double> tail;    ///< Extrapolated input beyond the last sample
+  std::vector<double> saved;   ///< History while the tail is filtered
+
+  unsigned int fftSize;        ///< Length of the overlap-save transforms
+  double *fftInput;            ///< Time domain block for the forward FFT
+  fftw_complex *fftSpectrum;   ///< Spectrum of the input block
+  fftw_complex *tapSpectrum;   ///< Scaled spectrum of the FIR coefficients
+  double *fftOutput;           ///< Time domain block after the inverse FFT
+  fftw_plan forwardPlan;       ///< Plan for fftInput to fftSpectrum
+  fftw_plan backwardPlan;      ///< Plan for fftSpectrum to fftOutput
+};
+
+#endif
@@ -25,11 +25,15 @@
 #include <QCloseEvent>
 #include <QComboBox>
 #include <QDockWidget>
+#include <QHBoxLayout>
 #include <QLabel>
+#include <QLineEdit>
+#include <QSpinBox>
 
 #include "dockwindows.h"
 
 #include "helper.h"
+#include "mathexpression.h"
 #include "settings.h"
 #include "sispinbox.h"
 
@@ -57,8 +61,8 @@ HorizontalDock::HorizontalDock(DsoSettings *settings, QWidget *parent,
   this->timebaseLabel = new QLabel(tr("Timebase"));
   this->timebaseSiSpinBox = new SiSpinBox(Helper::UNIT_SECONDS);
   this->timebaseSiSpinBox->setSteps(timebaseSteps);
-  this->timebaseSiSpinBox->setMinimum(1e-9);
-  this->timebaseSiSpinBox->setMaximum(3.6e3);
+  this->timebaseSiSpinBox->setMinimum(TIMEBASE_MINIMUM);
+  this->timebaseSiSpinBox->setMaximum(TIMEBASE_MAXIMUM);
 
   this->frequencybaseLabel = new QLabel(tr("Frequencybase"));
   this->frequencybaseSiSpinBox = new SiSpinBox(Helper::UNIT_HERTZ);
@@ -75,6 +79,18 @@ HorizontalDock::HorizontalDock(DsoSettings *settings, QWidget *parent,
     this->formatComboBox->addItem(
         Dso::graphFormatString((Dso::GraphFormat)format));
 
+  this->acquisitionModeLabel = new QLabel(tr("Acquisition"));
+  this->acquisitionModeComboBox = new QComboBox();
+  for (int mode = Dso::ACQUISITIONMODE_NORMAL;
+       mode < Dso::ACQUISITIONMODE_COUNT; ++mode)
+    this->acquisitionModeComboBox->addItem(
+        Dso::acquisitionModeString((Dso::AcquisitionMode)mode));
+
+  this->acquisitionCountLabel = new QLabel(tr("Averages"));
+  this->acquisitionCountSpinBox = new QSpinBox();
+  this->acquisitionCountSpinBox->setMinimum(2);
+  this->acquisitionCountSpinBox->setMaximum(1024);
+
   this->dockLayout = new QGridLayout();
   this->dockLayout->setColumnMinimumWidth(0, 64);
   this->dockLayout->setColumnStretch(1, 1);
@@ -88,6 +104,10 @@ HorizontalDock::HorizontalDock(DsoSettings *settings, QWidget *parent,
   this->dockLayout->addWidget(this->recordLengthComboBox, 3, 1);
   this->dockLayout->addWidget(this->formatLabel, 4, 0);
   this->dockLayout->addWidget(this->formatComboBox, 4, 1);
+  this->dockLayout->addWidget(this->acquisitionModeLabel, 5, 0);
+  this->dockLayout->addWidget(this->acquisitionModeComboBox, 5, 1);
+  this->dockLayout->addWidget(this->acquisitionCountLabel, 6, 0);
+  this->dockLayout->addWidget(this->acquisitionCountSpinBox, 6, 1);
 
   this->setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea);
 
@@ -106,6 +126,10 @@ HorizontalDock::HorizontalDock(DsoSettings *settings, QWidget *parent,
           SLOT(recordLengthSelected(int)));
   connect(this->formatComboBox, SIGNAL(currentIndexChanged(int)), this,
           SLOT(formatSelected(int)));
+  connect(this->acquisitionModeComboBox, SIGNAL(currentIndexChanged(int)),
+          this, SLOT(acquisitionModeSelected(int)));
+  connect(this->acquisitionCountSpinBox, SIGNAL(valueChanged(int)), this,
+          SLOT(acquisitionCountSelected(int)));
 
   // Set values
   this->setSamplerate(this->settings->scope.horizontal.samplerate);
@@ -113,6 +137,8 @@ HorizontalDock::HorizontalDock(DsoSettings *settings, QWidget *parent,
   this->setFrequencybase(this->settings->scope.horizontal.frequencybase);
   this->setRecordLength(this->settings->scope.horizontal.recordLength);
   this->setFormat(this->settings->scope.horizontal.format);
+  this->setAcquisitionMode(this->settings->scope.acquisition.mode);
+  this->setAcquisitionCount(this->settings->scope.acquisition.count);
 }
 
 /// \brief Cleans up everything.
@@ -176,6 +202,30 @@ int HorizontalDock::setFormat(Dso::GraphFormat format) {
   return -1;
 }
 
+/// \brief Changes the acquisition mode if the new value is supported.
+/// \param mode The processing of the acquired samples.
+/// \return Index of mode-value, -1 on error.
+int HorizontalDock::setAcquisitionMode(Dso::AcquisitionMode mode) {
+  if (mode >= Dso::ACQUISITIONMODE_NORMAL &&
+      mode < Dso::ACQUISITIONMODE_COUNT) {
+    this->suppressSignals = true;
+    this->acquisitionModeComboBox->setCurrentIndex(mode);
+    this->acquisitionModeSelected(mode);
+    this->suppressSignals = false;
+    return mode;
+  }
+
+  return -1;
+}
+
+/// \brief Changes the number of averaged acquisitions or samples.
+/// \param count The averaging count.
+void HorizontalDock::setAcquisitionCount(unsigned int count) {
+  this->suppressSignals = true;
+  this->acquisitionCountSpinBox->setValue(count);
+  this->suppressSignals = false;
+}
+
 /// \brief Updates the available record lengths in the combo box.
 /// \param recordLengths The available record lengths for the combo box.
 void HorizontalDock::availableRecordLengthsChanged(
@@ -282,6 +332,26 @@ void HorizontalDock::formatSelected(int index) {
     emit formatChanged(this->settings->scope.horizontal.format);
 }
 
+/// \brief Called when the acquisition mode combo box changes its value.
+/// \param index The index of the combo box item.
+void HorizontalDock::acquisitionModeSelected(int index) {
+  this->settings->scope.acquisition.mode = (Dso::AcquisitionMode)index;
+  if (index == Dso::ACQUISITIONMODE_HIGHRES)
+    this->acquisitionCountLabel->setText(tr("Samples per point"));
+  else if (index == Dso::ACQUISITIONMODE_ENVELOPE)
+    this->acquisitionCountLabel->setText(tr("Samples per bucket"));
+  else
+    this->acquisitionCountLabel->setText(tr("Averages"));
+  this->acquisitionCountSpinBox->setEnabled(index !=
+                                            Dso::ACQUISITIONMODE_NORMAL);
+}
+
+/// \brief Called when the averaging spin box changes its value.
+/// \param count The new averaging count.
+void HorizontalDock::acquisitionCountSelected(int count) {
+  this->settings->scope.acquisition.count = count;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // class TriggerDock
 /// \brief Initializes the trigger settings docking window.
@@ -458,6 +528,18 @@ SpectrumDock::SpectrumDock(DsoSettings *settings, QWidget *parent,
 
     this->usedCheckBox.append(
         new QCheckBox(this->settings->scope.voltage[channel].name));
+
+    this->modeComboBox.append(new QComboBox());
+    for (int mode = Dso::SPECTRUMMODE_NORMAL; mode < Dso::SPECTRUMMODE_COUNT;
+         ++mode)
+      this->modeComboBox[channel]->addItem(
+          Dso::spectrumModeString((Dso::SpectrumMode)mode));
+    this->countSpinBox.append(new QSpinBox());
+    this->countSpinBox[channel]->setMinimum(2);
+    this->countSpinBox[channel]->setMaximum(1024);
+    this->modeLayout.append(new QHBoxLayout());
+    this->modeLayout[channel]->addWidget(this->modeComboBox[channel], 1);
+    this->modeLayout[channel]->addWidget(this->countSpinBox[channel]);
   }
 
   this->dockLayout = new QGridLayout();
@@ -465,8 +547,10 @@ SpectrumDock::SpectrumDock(DsoSettings *settings, QWidget *parent,
   this->dockLayout->setColumnStretch(1, 1);
   for (int channel = 0; channel < this->settings->scope.voltage.count();
        ++channel) {
-    this->dockLayout->addWidget(this->usedCheckBox[channel], channel, 0);
-    this->dockLayout->addWidget(this->magnitudeComboBox[channel], channel, 1);
+    this->dockLayout->addWidget(this->usedCheckBox[channel], channel * 2, 0);
+    this->dockLayout->addWidget(this->magnitudeComboBox[channel], channel * 2,
+                                1);
+    this->dockLayout->addLayout(this->modeLayout[channel], channel * 2 + 1, 1);
   }
 
   this->setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea);
@@ -482,6 +566,10 @@ SpectrumDock::SpectrumDock(DsoSettings *settings, QWidget *parent,
             this, SLOT(magnitudeSelected(int)));
     connect(this->usedCheckBox[channel], SIGNAL(toggled(bool)), this,
             SLOT(usedSwitched(bool)));
+    connect(this->modeComboBox[channel], SIGNAL(currentIndexChanged(int)),
+            this, SLOT(modeSelected(int)));
+    connect(this->countSpinBox[channel], SIGNAL(valueChanged(int)), this,
+            SLOT(countSelected(int)));
   }
 
   // Set values
@@ -490,6 +578,8 @@ SpectrumDock::SpectrumDock(DsoSettings *settings, QWidget *parent,
     this->setMagnitude(channel,
                        this->settings->scope.spectrum[channel].magnitude);
     this->setUsed(channel, this->settings->scope.spectrum[channel].used);
+    this->setCount(channel, this->settings->scope.spectrum[channel].count);
+    this->setMode(channel, this->settings->scope.spectrum[channel].mode);
   }
 }
 
@@ -532,6 +622,34 @@ int SpectrumDock::setUsed(int channel, bool used) {
   return -1;
 }
 
+/// \brief Sets the spectrum mode for a channel.
+/// \param channel The channel, whose mode should be set.
+/// \param mode The spectrum mode.
+/// \return Index of the mode, -1 on error.
+int SpectrumDock::setMode(int channel, Dso::SpectrumMode mode) {
+  if (channel < 0 || channel >= this->settings->scope.voltage.count())
+    return -1;
+  if (mode < Dso::SPECTRUMMODE_NORMAL || mode >= Dso::SPECTRUMMODE_COUNT)
+    return -1;
+
+  this->modeComboBox[channel]->setCurrentIndex(mode);
+  this->countSpinBox[channel]->setEnabled(mode != Dso::SPECTRUMMODE_NORMAL &&
+                                          mode != Dso::SPECTRUMMODE_MAXHOLD);
+  return mode;
+}
+
+/// \brief Sets the number of averaged spectrums or Welch segments.
+/// \param channel The channel, whose count should be set.
+/// \param count The averaging count.
+/// \return The count that has been set, -1 on error.
+int SpectrumDock::setCount(int channel, unsigned int count) {
+  if (channel < 0 || channel >= this->settings->scope.voltage.count())
+    return -1;
+
+  this->countSpinBox[channel]->setValue(count);
+  return this->countSpinBox[channel]->value();
+}
+
 /// \brief Called when the source combo box changes it's value.
 /// \param index The index of the combo box item.
 void SpectrumDock::magnitudeSelected(int index) {
@@ -568,6 +686,38 @@ void SpectrumDock::usedSwitched(bool checked) {
   }
 }
 
+/// \brief Called when the mode combo box changes it's value.
+/// \param index The index of the combo box item.
+void SpectrumDock::modeSelected(int index) {
+  int channel;
+
+  // Which combobox was it?
+  for (channel = 0; channel < this->settings->scope.voltage.count(); ++channel)
+    if (this->sender() == this->modeComboBox[channel])
+      break;
+
+  if (channel < this->settings->scope.voltage.count()) {
+    this->settings->scope.spectrum[channel].mode = (Dso::SpectrumMode)index;
+    this->countSpinBox[channel]->setEnabled(index != Dso::SPECTRUMMODE_NORMAL &&
+                                            index !=
+                                                Dso::SPECTRUMMODE_MAXHOLD);
+  }
+}
+
+/// \brief Called when the count spin box changes it's value.
+/// \param count The new averaging count.
+void SpectrumDock::countSelected(int count) {
+  int channel;
+
+  // Which spinbox was it?
+  for (channel = 0; channel < this->settings->scope.voltage.count(); ++channel)
+    if (this->sender() == this->countSpinBox[channel])
+      break;
+
+  if (channel < this->settings->scope.voltage.count())
+    this->settings->scope.spectrum[channel].count = count;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // class VoltageDock
 /// \brief Initializes the vertical axis docking window.
@@ -587,8 +737,7 @@ VoltageDock::VoltageDock(DsoSettings *settings, QWidget *parent,
   for (int mode = Dso::MATHMODE_1ADD2; mode < Dso::MATHMODE_COUNT; ++mode)
     this->modeStrings.append(Dso::mathModeString((Dso::MathMode)mode));
 
-  this->gainSteps << 1e-2 << 2e-2 << 5e-2 << 1e-1 << 2e-1 << 5e-1 << 1e0 << 2e0
-                  << 5e0; ///< Voltage steps in V/div
+  this->gainSteps = Dso::gainSteps();
   for (QList<double>::iterator gain = this->gainSteps.begin();
        gain != this->gainSteps.end(); ++gain)
     this->gainStrings << Helper::valueToString(*gain, Helper::UNIT_VOLTS, 0);
@@ -608,6 +757,8 @@ VoltageDock::VoltageDock(DsoSettings *settings, QWidget *parent,
     this->usedCheckBox.append(
         new QCheckBox(this->settings->scope.voltage[channel].name));
   }
+  this->mathExpressionLineEdit =
+      new QLineEdit(this->settings->scope.mathExpression);
 
   this->dockLayout = new QGridLayout();
   this->dockLayout->setColumnMinimumWidth(0, 64);
@@ -619,6 +770,8 @@ VoltageDock::VoltageDock(DsoSettings *settings, QWidget *parent,
     this->dockLayout->addWidget(this->miscComboBox[channel], channel * 2 + 1,
                                 1);
   }
+  this->dockLayout->addWidget(this->mathExpressionLineEdit,
+                              this->settings->scope.voltage.count() * 2, 1);
 
   this->setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea);
 
@@ -636,6 +789,8 @@ VoltageDock::VoltageDock(DsoSettings *settings, QWidget *parent,
     connect(this->usedCheckBox[channel], SIGNAL(toggled(bool)), this,
             SLOT(usedSwitched(bool)));
   }
+  connect(this->mathExpressionLineEdit, SIGNAL(editingFinished()), this,
+          SLOT(mathExpressionEdited()));
 
   // Set values
   for (int channel = 0; channel < this->settings->scope.voltage.count();
@@ -694,9 +849,11 @@ int VoltageDock::setGain(int channel, double gain) {
 /// \param mode The math-mode.
 /// \return Index of math-mode, -1 on error.
 int VoltageDock::setMode(Dso::MathMode mode) {
-  if (mode >= Dso::MATHMODE_1ADD2 && mode <= Dso::MATHMODE_2SUB1) {
+  if (mode >= Dso::MATHMODE_1ADD2 && mode < Dso::MATHMODE_COUNT) {
     this->miscComboBox[this->settings->scope.physicalChannels]->setCurrentIndex(
         mode);
+    this->mathExpressionLineEdit->setEnabled(mode ==
+                                             Dso::MATHMODE_EXPRESSION);
     return mode;
   }
 
@@ -750,12 +907,34 @@ void VoltageDock::miscSelected(int index) {
     if (channel < (int)this->settings->scope.physicalChannels)
       emit couplingChanged(
           channel, (Dso::Coupling)this->settings->scope.voltage[channel].misc);
-    else
+    else {
+      this->mathExpressionLineEdit->setEnabled(index ==
+                                               Dso::MATHMODE_EXPRESSION);
       emit modeChanged(
           (Dso::MathMode)this->settings->scope.voltage[channel].misc);
+    }
   }
 }
 
+/// \brief Called when the formula for the math channel has been edited.
+void VoltageDock::mathExpressionEdited() {
+  QString source = this->mathExpressionLineEdit->text();
+  if (source == this->settings->scope.mathExpression)
+    return;
+
+  // Show syntax errors as tooltip, the math channel stays empty until fixed
+  MathExpression expression;
+  expression.compile(source, this->settings->scope.physicalChannels);
+  this->mathExpressionLineEdit->setToolTip(expression.getError());
+
+  this->settings->scope.mathExpression = source;
+  emit mathExpressionChanged(source);
+  emit modeChanged(
+      (Dso::MathMode)this->settings->scope
+          .voltage[this->settings->scope.physicalChannels]
+          .misc);
+}
+
 /// \brief Called when the used checkbox is switched.
 /// \param checked The check-state of the checkbox.
 void VoltageDock::usedSwitched(bool checked) {
@@ -34,6 +34,9 @@
 class QLabel;
 class QCheckBox;
 class QComboBox;
+class QHBoxLayout;
+class QLineEdit;
+class QSpinBox;
 
 class SiSpinBox;
 
@@ -54,6 +57,8 @@ public:
   void setTimebase(double timebase);
   void setRecordLength(unsigned int recordLength);
   int setFormat(Dso::GraphFormat format);
+  int setAcquisitionMode(Dso::AcquisitionMode mode);
+  void setAcquisitionCount(unsigned int count);
 
 protected:
   void closeEvent(QCloseEvent *event);
@@ -65,6 +70,8 @@ protected:
   QLabel *frequencybaseLabel;     ///< The label for the frequencybase spinbox
   QLabel *recordLengthLabel;      ///< The label for the record length combobox
   QLabel *formatLabel;            ///< The label for the format combobox
+  QLabel *acquisitionModeLabel;   ///< The label for the acquisition combobox
+  QLabel *acquisitionCountLabel;  ///< The label for the averaging spinbox
   SiSpinBox *samplerateSiSpinBox; ///< Selects the samplerate for aquisitions
   SiSpinBox *timebaseSiSpinBox;   ///< Selects the timebase for voltage graphs
   SiSpinBox *
@@ -73,6 +80,8 @@ protected:
       *recordLengthComboBox; ///< Selects the record length for aquisitions
   QComboBox *formatComboBox; ///< Selects the way the sampled data is
                              ///interpreted and shown
+  QComboBox *acquisitionModeComboBox; ///< Selects averaging or high resolution
+  QSpinBox *acquisitionCountSpinBox;  ///< Selects the averaging count
 
   DsoSettings *settings; ///< The settings provided by the parent class
 
@@ -91,6 +100,8 @@ protected slots:
   void timebaseSelected(double timebase);
   void recordLengthSelected(int index);
   void formatSelected(int index);
+  void acquisitionModeSelected(int index);
+  void acquisitionCountSelected(int count);
 
 signals:
   void frequencybaseChanged(
@@ -180,6 +191,7 @@ protected:
       gainComboBox; ///< Select the vertical gain for the channels
   QList<QComboBox *>
       miscComboBox; ///< Select coupling for real and mode for math channels
+  QLineEdit *mathExpressionLineEdit; ///< The formula for the expression mode
 
   DsoSettings *settings; ///< The settings provided by the parent class
 
@@ -191,6 +203,7 @@ protected:
 protected slots:
   void gainSelected(int index);
   void miscSelected(int index);
+  void mathExpressionEdited();
   void usedSwitched(bool checked);
 
 signals:
@@ -201,6 +214,8 @@ signals:
                    double gain); ///< A gain has been selected
   void modeChanged(
       Dso::MathMode mode); ///< The mode for the math channels has been changed
+  void mathExpressionChanged(
+      const QString &source); ///< The formula of the math channel was edited
   void usedChanged(unsigned int channel,
                    bool used); ///< A channel has been enabled/disabled
 };
@@ -220,6 +235,8 @@ public:
 
   int setMagnitude(int channel, double magnitude);
   int setUsed(int channel, bool used);
+  int setMode(int channel, Dso::SpectrumMode mode);
+  int setCount(int channel, unsigned int count);
 
 protected:
   void closeEvent(QCloseEvent *event);
@@ -229,6 +246,9 @@ protected:
   QList<QCheckBox *> usedCheckBox; ///< Enable/disable spectrum for a channel
   QList<QComboBox *>
       magnitudeComboBox; ///< Select the vertical magnitude for the spectrums
+  QList<QHBoxLayout *> modeLayout; ///< Layout for the mode and the count
+  QList<QComboBox *> modeComboBox; ///< Select averaging or max-hold
+  QList<QSpinBox *> countSpinBox;  ///< Averaged spectrums or Welch segments
 
   DsoSettings *settings; ///< The settings provided by the parent class
 
@@ -239,6 +259,8 @@ protected:
 public slots:
   void magnitudeSelected(int index);
   void usedSwitched(bool checked);
+  void modeSelected(int index);
+  void countSelected(int count);
 
 signals:
   void magnitudeChanged(unsigned int channel,
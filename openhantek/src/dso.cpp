@@ -21,7 +21,7 @@
 //
 ////////////////////////////////////////////////////////////////////////////////
 
-#include <QApplication>
+#include <QCoreApplication>
 
 #include "dso.h"
 
@@ -32,9 +32,9 @@ namespace Dso {
 QString channelModeString(ChannelMode mode) {
   switch (mode) {
   case CHANNELMODE_VOLTAGE:
-    return QApplication::tr("Voltage");
+    return QCoreApplication::tr("Voltage");
   case CHANNELMODE_SPECTRUM:
-    return QApplication::tr("Spectrum");
+    return QCoreApplication::tr("Spectrum");
   default:
     return QString();
   }
@@ -46,9 +46,9 @@ QString channelModeString(ChannelMode mode) {
 QString graphFormatString(GraphFormat format) {
   switch (format) {
   case GRAPHFORMAT_TY:
-    return QApplication::tr("T - Y");
+    return QCoreApplication::tr("T - Y");
   case GRAPHFORMAT_XY:
-    return QApplication::tr("X - Y");
+    return QCoreApplication::tr("X - Y");
   default:
     return QString();
   }
@@ -60,11 +60,11 @@ QString graphFormatString(GraphFormat format) {
 QString couplingString(Coupling coupling) {
   switch (coupling) {
   case COUPLING_AC:
-    return QApplication::tr("AC");
+    return QCoreApplication::tr("AC");
   case COUPLING_DC:
-    return QApplication::tr("DC");
+    return QCoreApplication::tr("DC");
   case COUPLING_GND:
-    return QApplication::tr("GND");
+    return QCoreApplication::tr("GND");
   default:
     return QString();
   }
@@ -76,11 +76,13 @@ QString couplingString(Coupling coupling) {
 QString mathModeString(MathMode mode) {
   switch (mode) {
   case MATHMODE_1ADD2:
-    return QApplication::tr("CH1 + CH2");
+    return QCoreApplication::tr("CH1 + CH2");
   case MATHMODE_1SUB2:
-    return QApplication::tr("CH1 - CH2");
+    return QCoreApplication::tr("CH1 - CH2");
   case MATHMODE_2SUB1:
-    return QApplication::tr("CH2 - CH1");
+    return QCoreApplication::tr("CH2 - CH1");
+  case MATHMODE_EXPRESSION:
+    return QCoreApplication::tr("Expression");
   default:
     return QString();
   }
@@ -92,13 +94,13 @@ QString mathModeString(MathMode mode) {
 QString triggerModeString(TriggerMode mode) {
   switch (mode) {
   case TRIGGERMODE_AUTO:
-    return QApplication::tr("Auto");
+    return QCoreApplication::tr("Auto");
   case TRIGGERMODE_NORMAL:
-    return QApplication::tr("Normal");
+    return QCoreApplication::tr("Normal");
   case TRIGGERMODE_SINGLE:
-    return QApplication::tr("Single");
+    return QCoreApplication::tr("Single");
   case TRIGGERMODE_SOFTWARE:
-    return QApplication::tr("Software");
+    return QCoreApplication::tr("Software");
   default:
     return QString();
   }
@@ -124,35 +126,35 @@ QString slopeString(Slope slope) {
 QString windowFunctionString(WindowFunction window) {
   switch (window) {
   case WINDOW_RECTANGULAR:
-    return QApplication::tr("Rectangular");
+    return QCoreApplication::tr("Rectangular");
   case WINDOW_HAMMING:
-    return QApplication::tr("Hamming");
+    return QCoreApplication::tr("Hamming");
   case WINDOW_HANN:
-    return QApplication::tr("Hann");
+    return QCoreApplication::tr("Hann");
   case WINDOW_COSINE:
-    return QApplication::tr("Cosine");
+    return QCoreApplication::tr("Cosine");
   case WINDOW_LANCZOS:
-    return QApplication::tr("Lanczos");
+    return QCoreApplication::tr("Lanczos");
   case WINDOW_BARTLETT:
-    return QApplication::tr("Bartlett");
+    return QCoreApplication::tr("Bartlett");
   case WINDOW_TRIANGULAR:
-    return QApplication::tr("Triangular");
+    return QCoreApplication::tr("Triangular");
   case WINDOW_GAUSS:
-    return QApplication::tr("Gauss");
+    return QCoreApplication::tr("Gauss");
   case WINDOW_BARTLETTHANN:
-    return QApplication::tr("Bartlett-Hann");
+    return QCoreApplication::tr("Bartlett-Hann");
   case WINDOW_BLACKMAN:
-    return QApplication::tr("Blackman");
+    return QCoreApplication::tr("Blackman");
   // case WINDOW_KAISER:
-  //	return QApplication::tr("Kaiser");
+  //	return QCoreApplication::tr("Kaiser");
   case WINDOW_NUTTALL:
-    return QApplication::tr("Nuttall");
+    return QCoreApplication::tr("Nuttall");
   case WINDOW_BLACKMANHARRIS:
-    return QApplication::tr("Blackman-Harris");
+    return QCoreApplication::tr("Blackman-Harris");
   case WINDOW_BLACKMANNUTTALL:
-    return QApplication::tr("Blackman-Nuttall");
+    return QCoreApplication::tr("Blackman-Nuttall");
   case WINDOW_FLATTOP:
-    return QApplication::tr("Flat top");
+    return QCoreApplication::tr("Flat top");
   default:
     return QString();
   }
@@ -165,13 +167,95 @@ QString windowFunctionString(WindowFunction window) {
 QString interpolationModeString(InterpolationMode interpolation) {
   switch (interpolation) {
   case INTERPOLATION_OFF:
-    return QApplication::tr("Off");
+    return QCoreApplication::tr("Off");
   case INTERPOLATION_LINEAR:
-    return QApplication::tr("Linear");
+    return QCoreApplication::tr("Linear");
   case INTERPOLATION_SINC:
-    return QApplication::tr("Sinc");
+    return QCoreApplication::tr("Sinc");
   default:
     return QString();
   }
 }
+
+/// \brief Return string representation of the given acquisition mode.
+/// \param mode The ::AcquisitionMode that should be returned as string.
+/// \return The string that should be used in labels etc.
+QString acquisitionModeString(AcquisitionMode mode) {
+  switch (mode) {
+  case ACQUISITIONMODE_NORMAL:
+    return QCoreApplication::tr("Normal");
+  case ACQUISITIONMODE_AVERAGE:
+    return QCoreApplication::tr("Average");
+  case ACQUISITIONMODE_EXPONENTIAL:
+    return QCoreApplication::tr("Exponential average");
+  case ACQUISITIONMODE_HIGHRES:
+    return QCoreApplication::tr("High resolution");
+  case ACQUISITIONMODE_ENVELOPE:
+    return QCoreApplication::tr("Envelope");
+  default:
+    return QString();
+  }
+}
+
+/// \brief Return string representation of the given spectrum mode.
+/// \param mode The ::SpectrumMode that should be returned as string.
+/// \return The string that should be used in labels etc.
+QString spectrumModeString(SpectrumMode mode) {
+  switch (mode) {
+  case SPECTRUMMODE_NORMAL:
+    return QCoreApplication::tr("Normal");
+  case SPECTRUMMODE_AVERAGE:
+    return QCoreApplication::tr("Average");
+  case SPECTRUMMODE_EXPONENTIAL:
+    return QCoreApplication::tr("Exponential average");
+  case SPECTRUMMODE_MAXHOLD:
+    return QCoreApplication::tr("Max hold");
+  case SPECTRUMMODE_WELCH:
+    return QCoreApplication::tr("Welch");
+  default:
+    return QString();
+  }
+}
+
+/// \brief Return string representation of the given filter type.
+/// \param type The ::FilterType that should be returned as string.
+/// \return The string that should be used in labels etc.
+QString filterTypeString(FilterType type) {
+  switch (type) {
+  case FILTERTYPE_NONE:
+    return QCoreApplication::tr("None");
+  case FILTERTYPE_LOWPASS:
+    return QCoreApplication::tr("Low-pass");
+  case FILTERTYPE_HIGHPASS:
+    return QCoreApplication::tr("High-pass");
+  case FILTERTYPE_BANDPASS:
+    return QCoreApplication::tr("Band-pass");
+  case FILTERTYPE_NOTCH:
+    return QCoreApplication::tr("Notch");
+  default:
+    return QString();
+  }
+}
+
+/// \brief Return string representation of the given filter design.
+/// \param design The ::FilterDesign that should be returned as string.
+/// \return The string that should be used in labels etc.
+QString filterDesignString(FilterDesign design) {
+  switch (design) {
+  case FILTERDESIGN_IIR:
+    return QCoreApplication::tr("IIR");
+  case FILTERDESIGN_FIR:
+    return QCoreApplication::tr("FIR");
+  default:
+    return QString();
+  }
+}
+
+/// \brief Get the gains that can be selected for the voltage channels.
+/// \return The gains in V/div in ascending order.
+QList<double> gainSteps() {
+  QList<double> steps;
+  steps << 1e-2 << 2e-2 << 5e-2 << 1e-1 << 2e-1 << 5e-1 << 1e0 << 2e0 << 5e0;
+  return steps;
+}
 }
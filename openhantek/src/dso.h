@@ -25,10 +25,18 @@
 #ifndef DSO_H
 #define DSO_H
 
+#include <QList>
 #include <QString>
 
 #define MARKER_COUNT 2 ///< Number of markers
 
+#define DIVS_TIME 10.0   ///< Number of horizontal screen divs
+#define DIVS_VOLTAGE 8.0 ///< Number of vertical screen divs
+#define DIVS_SUB 5       ///< Number of sub-divisions per div
+
+#define TIMEBASE_MINIMUM 1e-9  ///< Shortest selectable timebase in s/div
+#define TIMEBASE_MAXIMUM 3.6e3 ///< Longest selectable timebase in s/div
+
 ////////////////////////////////////////////////////////////////////////////////
 /// \namespace Dso                                                         dso.h
 /// \brief All DSO specific things for different modes and so on.
@@ -75,10 +83,11 @@ enum Coupling {
 /// \enum MathMode                                                       dso.h
 /// \brief The different math modes for the math-channel.
 enum MathMode {
-  MATHMODE_1ADD2, ///< Add the values of the channels
-  MATHMODE_1SUB2, ///< Subtract CH2 from CH1
-  MATHMODE_2SUB1, ///< Subtract CH1 from CH2
-  MATHMODE_COUNT  ///< The total number of math modes
+  MATHMODE_1ADD2,      ///< Add the values of the channels
+  MATHMODE_1SUB2,      ///< Subtract CH2 from CH1
+  MATHMODE_2SUB1,      ///< Subtract CH1 from CH2
+  MATHMODE_EXPRESSION, ///< Evaluate the user defined formula
+  MATHMODE_COUNT       ///< The total number of math modes
 };
 
 //////////////////////////////////////////////////////////////////////////////
@@ -135,6 +144,51 @@ enum InterpolationMode {
   INTERPOLATION_COUNT    ///< Total number of interpolation modes
 };
 
+////////////////////////////////////////////////////////////////////////////////
+/// \enum AcquisitionMode                                                  dso.h
+/// \brief The processing applied to the acquired samples before analysis.
+enum AcquisitionMode {
+  ACQUISITIONMODE_NORMAL,      ///< The samples are used as received
+  ACQUISITIONMODE_AVERAGE,     ///< Average of the last N acquisitions
+  ACQUISITIONMODE_EXPONENTIAL, ///< Exponential moving average over N
+  ACQUISITIONMODE_HIGHRES,     ///< Boxcar average of N samples per point
+  ACQUISITIONMODE_ENVELOPE,    ///< Min/max hold of N samples per bucket
+  ACQUISITIONMODE_COUNT        ///< Total number of acquisition modes
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \enum SpectrumMode                                                     dso.h
+/// \brief The processing of the spectrum power before the dB conversion.
+enum SpectrumMode {
+  SPECTRUMMODE_NORMAL,      ///< The spectrum of the current acquisition
+  SPECTRUMMODE_AVERAGE,     ///< Power average of the last N spectrums
+  SPECTRUMMODE_EXPONENTIAL, ///< Exponential power average over N spectrums
+  SPECTRUMMODE_MAXHOLD,     ///< The highest power seen in each bin
+  SPECTRUMMODE_WELCH,       ///< Average of N overlapping record segments
+  SPECTRUMMODE_COUNT        ///< Total number of spectrum modes
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \enum FilterType                                                       dso.h
+/// \brief The frequency response of the channel filters.
+enum FilterType {
+  FILTERTYPE_NONE,     ///< The samples aren't filtered
+  FILTERTYPE_LOWPASS,  ///< Attenuate frequencies above the cutoff frequency
+  FILTERTYPE_HIGHPASS, ///< Attenuate frequencies below the cutoff frequency
+  FILTERTYPE_BANDPASS, ///< Pass only the band around the center frequency
+  FILTERTYPE_NOTCH,    ///< Remove the band around the center frequency
+  FILTERTYPE_COUNT     ///< Total number of filter types
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \enum FilterDesign                                                     dso.h
+/// \brief The implementation of the channel filters.
+enum FilterDesign {
+  FILTERDESIGN_IIR,  ///< Cascade of Butterworth biquad sections
+  FILTERDESIGN_FIR,  ///< Windowed sinc FIR filter
+  FILTERDESIGN_COUNT ///< Total number of filter designs
+};
+
 QString channelModeString(ChannelMode mode);
 QString graphFormatString(GraphFormat format);
 QString couplingString(Coupling coupling);
@@ -143,6 +197,12 @@ QString triggerModeString(TriggerMode mode);
 QString slopeString(Slope slope);
 QString windowFunctionString(WindowFunction window);
 QString interpolationModeString(InterpolationMode interpolation);
+QString acquisitionModeString(AcquisitionMode mode);
+QString spectrumModeString(SpectrumMode mode);
+QString filterTypeString(FilterType type);
+QString filterDesignString(FilterDesign design);
+
+QList<double> gainSteps();
 }
 
 #endif
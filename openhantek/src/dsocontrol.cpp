@@ -28,6 +28,7 @@
 /// \brief Initialize variables.
 DsoControl::DsoControl(QObject *parent) : QThread(parent) {
   this->sampling = false;
+  this->autoConnect = true;
 }
 
 /// \brief Start sampling process.
@@ -47,11 +48,42 @@ const QStringList *DsoControl::getSpecialTriggerSources() {
   return &(this->specialTriggerSources);
 }
 
+/// \brief Selects who connects oscilloscopes that have been plugged in.
+/// \param enabled true to connect them directly, false to only emit
+/// deviceAvailable() and let the owner of the control connect it.
+void DsoControl::setAutoConnect(bool enabled) { this->autoConnect = enabled; }
+
 /// \brief Try to connect to the oscilloscope.
 void DsoControl::connectDevice() {
   this->sampling = false;
   this->start();
+
+  emit deviceConnected();
 }
 
 /// \brief Disconnect the oscilloscope.
 void DsoControl::disconnectDevice() { this->quit(); }
+
+/// \brief Set the number of acquisitions kept in memory.
+/// \param segments The number of segments, 0 disables the history.
+/// \param memoryLimit The maximum memory used in bytes, 0 for no limit.
+/// \param spillFileName Template for the temporary file that is mapped when
+/// the limit is exceeded.
+/// \return See ::Dso::ErrorCode.
+int DsoControl::setHistorySize(unsigned int segments, unsigned long memoryLimit,
+                               const QString &spillFileName) {
+  Q_UNUSED(segments);
+  Q_UNUSED(memoryLimit);
+  Q_UNUSED(spillFileName);
+
+  return Dso::ERROR_UNSUPPORTED;
+}
+
+/// \brief Send a stored acquisition to the data analyzer again.
+/// \param index The age of the segment, 0 is the latest acquisition.
+/// \return See ::Dso::ErrorCode.
+int DsoControl::replayHistory(unsigned int index) {
+  Q_UNUSED(index);
+
+  return Dso::ERROR_UNSUPPORTED;
+}
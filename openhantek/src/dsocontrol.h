@@ -52,15 +52,18 @@ public:
   virtual double getMaxSamplerate() = 0; ///< The maximum samplerate supported
 
   const QStringList *getSpecialTriggerSources();
+  void setAutoConnect(bool enabled);
 
 protected:
-  bool sampling; ///< true, if the oscilloscope is taking samples
+  bool sampling;    ///< true, if the oscilloscope is taking samples
+  bool autoConnect; ///< true, if plugged in oscilloscopes are connected
 
   QStringList specialTriggerSources; ///< Names of the special trigger sources
 
 signals:
   void deviceConnected();    ///< The oscilloscope device has been disconnected
   void deviceDisconnected(); ///< The oscilloscope device has been connected
+  void deviceAvailable();    ///< A plugged in oscilloscope can be connected
   void
   samplingStarted(); ///< The oscilloscope started sampling/waiting for trigger
   void
@@ -127,6 +130,13 @@ public slots:
   setOffset(unsigned int channel,
             double offset) = 0; ///< Set the graph offset of a channel
 
+  virtual int setHistorySize(
+      unsigned int segments, unsigned long memoryLimit = 0,
+      const QString &spillFileName =
+          QString()); ///< Set the number of acquisitions kept in memory
+  virtual int replayHistory(
+      unsigned int index); ///< Send a stored acquisition again, 0 is the latest
+
 #ifdef DEBUG
   virtual int stringCommand(
       QString command) = 0; ///< Sends commands directly, for debugging
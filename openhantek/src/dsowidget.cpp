@@ -64,6 +64,8 @@ DsoWidget::DsoWidget(DsoSettings *settings, DataAnalyzer *dataAnalyzer,
   this->zoomScope = new GlScope(this->settings);
   this->zoomScope->setGenerator(this->generator);
   this->zoomScope->setZoomMode(true);
+  this->waterfall = new GlWaterfall(this->settings);
+  this->waterfall->setDataAnalyzer(this->dataAnalyzer);
 
 #ifdef OS_DARWIN
   // Workaround for https://bugreports.qt-project.org/browse/QTBUG-8580
@@ -259,7 +261,8 @@ DsoWidget::DsoWidget(DsoSettings *settings, DataAnalyzer *dataAnalyzer,
   this->mainLayout->setRowMinimumHeight(4, this->offsetSlider->postMargin());
   this->mainLayout->setRowMinimumHeight(6, 4);
   this->mainLayout->setRowMinimumHeight(8, 4);
-  this->mainLayout->setRowMinimumHeight(10, 8);
+  this->mainLayout->setRowMinimumHeight(10, 4);
+  this->mainLayout->setRowMinimumHeight(12, 8);
   this->mainLayout->setSpacing(0);
   this->mainLayout->addLayout(this->settingsLayout, 0, 0, 1, 5);
   this->mainLayout->addWidget(this->mainScope, 3, 2);
@@ -271,7 +274,8 @@ DsoWidget::DsoWidget(DsoSettings *settings, DataAnalyzer *dataAnalyzer,
   this->mainLayout->addWidget(this->markerSlider, 4, 1, 2, 3, Qt::AlignTop);
   this->mainLayout->addLayout(this->markerLayout, 7, 0, 1, 5);
   this->mainLayout->addWidget(this->zoomScope, 9, 2);
-  this->mainLayout->addLayout(this->measurementLayout, 11, 0, 1, 5);
+  this->mainLayout->addWidget(this->waterfall, 11, 2);
+  this->mainLayout->addLayout(this->measurementLayout, 13, 0, 1, 5);
 
   // Apply settings and update measured values
   this->updateTriggerDetails();
@@ -280,6 +284,7 @@ DsoWidget::DsoWidget(DsoSettings *settings, DataAnalyzer *dataAnalyzer,
   this->updateSamplerate(this->settings->scope.horizontal.samplerate);
   this->updateTimebase(this->settings->scope.horizontal.timebase);
   this->updateZoom(this->settings->view.zoom);
+  this->updateWaterfall(this->settings->view.waterfall);
 
   // The widget itself
   this->setPalette(palette);
@@ -426,6 +431,9 @@ void DsoWidget::updateVoltageDetails(unsigned int channel) {
 void DsoWidget::updateFrequencybase(double frequencybase) {
   this->settingsFrequencybaseLabel->setText(
       Helper::valueToString(frequencybase, Helper::UNIT_HERTZ, 4) + tr("/div"));
+
+  // The rows of the history don't match the new frequency axis
+  this->waterfall->clearHistory();
 }
 
 /// \brief Updates the samplerate field after changing the samplerate.
@@ -506,10 +514,15 @@ void DsoWidget::updateVoltageCoupling(unsigned int channel) {
 
 /// \brief Handles modeChanged signal from the voltage dock.
 void DsoWidget::updateMathMode() {
-  this->measurementMiscLabel[this->settings->scope.physicalChannels]->setText(
-      Dso::mathModeString((Dso::MathMode)this->settings->scope
-                              .voltage[this->settings->scope.physicalChannels]
-                              .misc));
+  Dso::MathMode mode = (Dso::MathMode)this->settings->scope
+                           .voltage[this->settings->scope.physicalChannels]
+                           .misc;
+  if (mode == Dso::MATHMODE_EXPRESSION)
+    this->measurementMiscLabel[this->settings->scope.physicalChannels]->setText(
+        this->settings->scope.mathExpression);
+  else
+    this->measurementMiscLabel[this->settings->scope.physicalChannels]->setText(
+        Dso::mathModeString(mode));
 }
 
 /// \brief Handles gainChanged signal from the voltage dock.
@@ -551,7 +564,11 @@ bool DsoWidget::exportAs() {
   QStringList filters;
   filters << tr("Portable Document Format (*.pdf)")
           << tr("Image (*.png *.xpm *.jpg)")
-          << tr("Comma-Separated Values (*.csv)");
+          << tr("Comma-Separated Values (*.csv)")
+          << tr("Raw 32-bit float with JSON description (*.f32)")
+          << tr("Raw 8-bit integer with JSON description (*.i8)")
+          << tr("NumPy array (*.npy)") << tr("Waveform Audio (*.wav)")
+          << tr("Comma-Separated Values, one column per channel (*.csv)");
 
   QFileDialog fileDialog(static_cast<QWidget *>(this->parent()),
                          tr("Export file..."), QString(), filters.join(";;"));
@@ -566,7 +583,15 @@ bool DsoWidget::exportAs() {
   exporter.setFormat((ExportFormat)(
       EXPORT_FORMAT_PDF + filters.indexOf(fileDialog.selectedNameFilter())));
 
-  return exporter.doExport();
+  if (!exporter.doExport())
+    return false;
+
+  if (exporter.getThroughput() > 0)
+    emit statusMessage(tr("Data exported with %1 MB/s")
+                           .arg(exporter.getThroughput(), 0, 'f', 1),
+                       5000);
+
+  return true;
 }
 
 /// \brief Print the oscilloscope screen.
@@ -579,6 +604,22 @@ bool DsoWidget::print() {
   return exporter.doExport();
 }
 
+/// \brief Moves the level sliders to the values of the settings.
+void DsoWidget::updateLevels() {
+  for (int channel = 0; channel < this->settings->scope.voltage.count();
+       ++channel)
+    this->offsetSlider->setValue(channel,
+                                 this->settings->scope.voltage[channel].offset);
+  for (int channel = 0; channel < (int)this->settings->scope.physicalChannels;
+       ++channel) {
+    this->adaptTriggerLevelSlider(channel);
+    this->triggerLevelSlider->setValue(
+        channel, this->settings->scope.voltage[channel].trigger);
+  }
+  this->triggerPositionSlider->setValue(0,
+                                        this->settings->scope.trigger.position);
+}
+
 /// \brief Stop the oscilloscope.
 void DsoWidget::updateZoom(bool enabled) {
   this->mainLayout->setRowStretch(9, enabled ? 1 : 0);
@@ -597,6 +638,15 @@ void DsoWidget::updateZoom(bool enabled) {
   this->repaint();
 }
 
+/// \brief Show/hide the spectrum history.
+/// \param enabled true shows the waterfall below the scopes.
+void DsoWidget::updateWaterfall(bool enabled) {
+  this->mainLayout->setRowStretch(11, enabled ? 1 : 0);
+  this->waterfall->setVisible(enabled);
+
+  this->repaint();
+}
+
 /// \brief Prints analyzed data.
 void DsoWidget::dataAnalyzed() {
   for (int channel = 0; channel < this->settings->scope.voltage.count();
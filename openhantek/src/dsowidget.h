@@ -29,6 +29,7 @@
 
 #include "dockwindows.h"
 #include "glscope.h"
+#include "glwaterfall.h"
 #include "levelslider.h"
 
 class DataAnalyzer;
@@ -59,6 +60,7 @@ protected:
   GlGenerator *generator;    ///< The generator for the OpenGL vertex arrays
   GlScope *mainScope;        ///< The main scope screen
   GlScope *zoomScope;        ///< The optional magnified scope screen
+  GlWaterfall *waterfall;    ///< The optional spectrum history
   LevelSlider *offsetSlider; ///< The sliders for the graph offsets
   LevelSlider *triggerPositionSlider; ///< The slider for the pretrigger
   LevelSlider *triggerLevelSlider;    ///< The sliders for the trigger level
@@ -116,12 +118,16 @@ public slots:
   // Menus
   void updateRecordLength(unsigned long size);
 
+  // Sliders
+  void updateLevels();
+
   // Export
   bool exportAs();
   bool print();
 
   // Scope control
   void updateZoom(bool enabled);
+  void updateWaterfall(bool enabled);
 
   // Data analyzer
   void dataAnalyzed();
@@ -143,6 +149,10 @@ signals:
                            double value); ///< A trigger level has been changed
   void markerChanged(unsigned int marker,
                      double value); ///< A marker position has been changed
+
+  // Export
+  void statusMessage(const QString &message,
+                     int timeout); ///< A message for the status bar
 };
 
 #endif
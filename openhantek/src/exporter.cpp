@@ -22,18 +22,25 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <cmath>
+#include <limits>
 
+#include <QByteArray>
+#include <QDataStream>
 #include <QFile>
 #include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QMutex>
 #include <QPainter>
 #include <QPixmap>
 #include <QPrintDialog>
 #include <QPrinter>
-#include <QTextStream>
+#include <QtEndian>
 
 #include "exporter.h"
 
+#include "csvwriter.h"
 #include "dataanalyzer.h"
 #include "dso.h"
 #include "glgenerator.h"
@@ -50,6 +57,7 @@ Exporter::Exporter(DsoSettings *settings, DataAnalyzer *dataAnalyzer,
   this->dataAnalyzer = dataAnalyzer;
 
   this->format = EXPORT_FORMAT_PRINTER;
+  this->throughput = 0.0;
 }
 
 /// \brief Cleans up everything.
@@ -63,10 +71,14 @@ void Exporter::setFilename(QString filename) {
 
 /// \brief Set the output format.
 void Exporter::setFormat(ExportFormat format) {
-  if (format >= EXPORT_FORMAT_PRINTER && format <= EXPORT_FORMAT_CSV)
+  if (format >= EXPORT_FORMAT_PRINTER && format <= EXPORT_FORMAT_CSV_COLUMNS)
     this->format = format;
 }
 
+/// \brief Returns the speed of the last data export.
+/// \return The throughput of the last CSV export in MB/s, 0 otherwise.
+double Exporter::getThroughput() const { return this->throughput; }
+
 /// \brief Print the document (May be a file too)
 bool Exporter::doExport() {
   if (this->format < EXPORT_FORMAT_CSV) {
@@ -192,6 +204,11 @@ bool Exporter::doExport() {
               QRectF(lineHeight * 4, top, lineHeight * 2, lineHeight),
               Dso::couplingString(
                   (Dso::Coupling)this->settings->scope.voltage[channel].misc));
+        else if (this->settings->scope.voltage[channel].misc ==
+                 Dso::MATHMODE_EXPRESSION)
+          painter.drawText(
+              QRectF(lineHeight * 4, top, lineHeight * 2, lineHeight),
+              this->settings->scope.mathExpression);
         else
           painter.drawText(
               QRectF(lineHeight * 4, top, lineHeight * 2, lineHeight),
@@ -308,6 +325,11 @@ bool Exporter::doExport() {
 
     for (int zoomed = 0; zoomed < (this->settings->view.zoom ? 2 : 1);
          ++zoomed) {
+      // The width of one output pixel in divs, limits the drawn points
+      double columnWidth = DIVS_TIME / qMax(paintDevice->width() - 1, 1);
+      if (zoomed)
+        columnWidth /= zoomFactor;
+
       switch (this->settings->scope.horizontal.format) {
       case Dso::GRAPHFORMAT_TY:
         // Add graphs for channels
@@ -339,19 +361,13 @@ bool Exporter::doExport() {
                          1);
 
             // Draw graph
-            QPointF *graph = new QPointF[lastPosition - firstPosition + 1];
-
-            for (unsigned int position = firstPosition;
-                 position <= lastPosition; ++position)
-              graph[position - firstPosition] =
-                  QPointF(position * horizontalFactor - DIVS_TIME / 2,
-                          this->dataAnalyzer->data(channel)
-                                      ->samples.voltage.sample[position] /
-                                  this->settings->scope.voltage[channel].gain +
-                              this->settings->scope.voltage[channel].offset);
-
-            painter.drawPolyline(graph, lastPosition - firstPosition + 1);
-            delete[] graph;
+            this->drawGraph(&painter,
+                            this->dataAnalyzer->data(channel)
+                                ->samples.voltage.sample,
+                            horizontalFactor,
+                            this->settings->scope.voltage[channel].gain,
+                            this->settings->scope.voltage[channel].offset,
+                            firstPosition, lastPosition, columnWidth);
           }
         }
 
@@ -384,19 +400,13 @@ bool Exporter::doExport() {
                          1);
 
             // Draw graph
-            QPointF *graph = new QPointF[lastPosition - firstPosition + 1];
-
-            for (unsigned int position = firstPosition;
-                 position <= lastPosition; ++position)
-              graph[position - firstPosition] = QPointF(
-                  position * horizontalFactor - DIVS_TIME / 2,
-                  this->dataAnalyzer->data(channel)
-                              ->samples.spectrum.sample[position] /
-                          this->settings->scope.spectrum[channel].magnitude +
-                      this->settings->scope.spectrum[channel].offset);
-
-            painter.drawPolyline(graph, lastPosition - firstPosition + 1);
-            delete[] graph;
+            this->drawGraph(&painter,
+                            this->dataAnalyzer->data(channel)
+                                ->samples.spectrum.sample,
+                            horizontalFactor,
+                            this->settings->scope.spectrum[channel].magnitude,
+                            this->settings->scope.spectrum[channel].offset,
+                            firstPosition, lastPosition, columnWidth);
           }
         }
         break;
@@ -516,58 +526,372 @@ bool Exporter::doExport() {
     delete paintDevice;
 
     return true;
-  } else {
-    QFile csvFile(this->filename);
-    if (!csvFile.open(QIODevice::WriteOnly | QIODevice::Text))
-      return false;
-
-    QTextStream csvStream(&csvFile);
+  } else if (this->format == EXPORT_FORMAT_CSV ||
+             this->format == EXPORT_FORMAT_CSV_COLUMNS) {
+    const CsvLayout layout = (this->format == EXPORT_FORMAT_CSV)
+                                 ? CSV_LAYOUT_ROWS
+                                 : CSV_LAYOUT_COLUMNS;
+    CsvWriter csvWriter;
 
+    this->dataAnalyzer->mutex()->lock();
     for (int channel = 0; channel < this->settings->scope.voltage.count();
          ++channel) {
-      if (this->dataAnalyzer->data(channel)) {
-        if (this->settings->scope.voltage[channel].used) {
-          // Start with channel name and the sample interval
-          csvStream
-              << "\"" << this->settings->scope.voltage[channel].name << "\","
-              << this->dataAnalyzer->data(channel)->samples.voltage.interval;
-
-          // And now all sample values in volts
-          for (unsigned int position = 0;
-               position <
-               this->dataAnalyzer->data(channel)->samples.voltage.sample.size();
-               ++position)
-            csvStream << ","
-                      << this->dataAnalyzer->data(channel)
-                             ->samples.voltage.sample[position];
-
-          // Finally a newline
-          csvStream << '\n';
-        }
+      const AnalyzedData *channelData = this->dataAnalyzer->data(channel);
+      if (!channelData)
+        continue;
+
+      // Voltages in V and spectrums in dB, only voltages share a time axis
+      if (this->settings->scope.voltage[channel].used)
+        csvWriter.addSeries(this->settings->scope.voltage[channel].name,
+                            channelData->samples.voltage.interval,
+                            &channelData->samples.voltage.sample);
+      if (layout == CSV_LAYOUT_ROWS &&
+          this->settings->scope.spectrum[channel].used)
+        csvWriter.addSeries(this->settings->scope.spectrum[channel].name,
+                            channelData->samples.spectrum.interval,
+                            &channelData->samples.spectrum.sample);
+    }
+    bool success = csvWriter.write(this->filename, layout);
+    this->dataAnalyzer->mutex()->unlock();
 
-        if (this->settings->scope.spectrum[channel].used) {
-          // Start with channel name and the sample interval
-          csvStream
-              << "\"" << this->settings->scope.spectrum[channel].name << "\","
-              << this->dataAnalyzer->data(channel)->samples.spectrum.interval;
-
-          // And now all magnitudes in dB
-          for (unsigned int position = 0;
-               position < this->dataAnalyzer->data(channel)
-                              ->samples.spectrum.sample.size();
-               ++position)
-            csvStream << ","
-                      << this->dataAnalyzer->data(channel)
-                             ->samples.spectrum.sample[position];
-
-          // Finally a newline
-          csvStream << '\n';
-        }
+    this->throughput = csvWriter.getThroughput();
+
+    return success;
+  } else {
+    return this->exportBinary();
+  }
+}
+
+/// \brief Draws a graph with at most two points per output pixel column.
+/// If several samples fall into one column only their minimum and maximum are
+/// drawn, in the order they occur, so the printed graph looks the same while
+/// the number of points depends on the output width and not the record length.
+/// \param painter The painter with the scope matrix.
+/// \param samples The sample values of the graph.
+/// \param horizontalFactor The horizontal distance between samples in divs.
+/// \param gain The value per vertical div.
+/// \param offset The vertical offset in divs.
+/// \param firstPosition The first visible sample.
+/// \param lastPosition The last visible sample.
+/// \param columnWidth The width of one output pixel in divs.
+void Exporter::drawGraph(QPainter *painter, const std::vector<double> &samples,
+                         double horizontalFactor, double gain, double offset,
+                         unsigned int firstPosition, unsigned int lastPosition,
+                         double columnWidth) {
+  if (samples.empty() || firstPosition > lastPosition ||
+      lastPosition >= samples.size())
+    return;
+
+  this->graph.clear();
+  this->graph.reserve(EXPORTER_CHUNK);
+
+  if (horizontalFactor * 2 >= columnWidth) {
+    // Not more than two samples per column, draw all of them
+    for (unsigned int position = firstPosition; position <= lastPosition;
+         ++position)
+      this->appendPoint(painter,
+                        QPointF(position * horizontalFactor - DIVS_TIME / 2,
+                                samples[position] / gain + offset));
+  } else {
+    const double samplesPerColumn = columnWidth / horizontalFactor;
+    unsigned int position = firstPosition;
+    while (position <= lastPosition) {
+      // Find the extremes within this column
+      unsigned int columnEnd = (unsigned int)ceil(
+          (floor(position / samplesPerColumn) + 1) * samplesPerColumn);
+      if (columnEnd <= position)
+        columnEnd = position + 1;
+      if (columnEnd > lastPosition + 1)
+        columnEnd = lastPosition + 1;
+
+      unsigned int minimum = position, maximum = position;
+      for (++position; position < columnEnd; ++position) {
+        if (samples[position] < samples[minimum])
+          minimum = position;
+        else if (samples[position] > samples[maximum])
+          maximum = position;
       }
+
+      unsigned int first = qMin(minimum, maximum);
+      unsigned int second = qMax(minimum, maximum);
+      this->appendPoint(painter,
+                        QPointF(first * horizontalFactor - DIVS_TIME / 2,
+                                samples[first] / gain + offset));
+      if (second != first)
+        this->appendPoint(painter,
+                          QPointF(second * horizontalFactor - DIVS_TIME / 2,
+                                  samples[second] / gain + offset));
     }
+  }
+
+  this->flushGraph(painter);
+}
 
-    csvFile.close();
+/// \brief Adds a point to the current polyline chunk.
+/// \param painter The painter the full chunks are drawn with.
+/// \param point The new point of the graph.
+void Exporter::appendPoint(QPainter *painter, const QPointF &point) {
+  this->graph.push_back(point);
+  if (this->graph.size() >= EXPORTER_CHUNK) {
+    // Keep the last point so the chunks are connected
+    this->flushGraph(painter);
+    this->graph.push_back(point);
+  }
+}
 
-    return true;
+/// \brief Draws the points of the current polyline chunk.
+/// \param painter The painter the chunk is drawn with.
+void Exporter::flushGraph(QPainter *painter) {
+  if (this->graph.size() > 1)
+    painter->drawPolyline(&this->graph.front(), this->graph.size());
+  this->graph.clear();
+}
+
+/// \brief Exports the voltage samples of all used channels into a binary file.
+/// \return true if the file was written successfully.
+bool Exporter::exportBinary() {
+  QFile file(this->filename);
+  if (!file.open(QIODevice::WriteOnly))
+    return false;
+
+  this->dataAnalyzer->mutex()->lock();
+
+  std::vector<int> channels;
+  for (int channel = 0; channel < this->settings->scope.voltage.count();
+       ++channel) {
+    if (this->settings->scope.voltage[channel].used &&
+        this->dataAnalyzer->data(channel) &&
+        !this->dataAnalyzer->data(channel)->samples.voltage.sample.empty())
+      channels.push_back(channel);
   }
+
+  bool success;
+  switch (this->format) {
+  case EXPORT_FORMAT_NPY:
+    success = this->writeNpy(&file, channels);
+    break;
+  case EXPORT_FORMAT_WAV:
+    success = this->writeWav(&file, channels);
+    break;
+  default:
+    success = this->writeRaw(&file, channels);
+    break;
+  }
+
+  this->dataAnalyzer->mutex()->unlock();
+  file.close();
+
+  return success;
+}
+
+/// \brief Writes the channels one after another as raw float32 or int8 values.
+/// The layout, the sample intervals and the scaling of the 8-bit values are
+/// described in a JSON file with the name of the raw file and .json appended.
+/// 8-bit values cover the screen height like the ADC of the oscilloscope, so
+/// they include the vertical offset of the channel. The voltage of a value is
+/// value * scale + zero.
+/// \param file The opened output file.
+/// \param channels The channels that should be exported.
+/// \return true if both files were written successfully.
+bool Exporter::writeRaw(QFile *file, const std::vector<int> &channels) {
+  const bool int8 = this->format == EXPORT_FORMAT_INT8;
+  QJsonArray channelArray;
+  qint64 offset = 0;
+
+  for (unsigned int index = 0; index < channels.size(); ++index) {
+    const int channel = channels[index];
+    const SampleValues &voltage =
+        this->dataAnalyzer->data(channel)->samples.voltage;
+    const unsigned int sampleCount = voltage.sample.size();
+    const double gain = this->settings->scope.voltage[channel].gain;
+    const double scale = gain * DIVS_VOLTAGE / 256;
+    // The voltage at the center of the screen
+    const double zero = -this->settings->scope.voltage[channel].offset * gain;
+
+    QJsonObject channelObject;
+    channelObject["name"] = this->settings->scope.voltage[channel].name;
+    channelObject["offset"] = (double)offset;
+    channelObject["samples"] = (double)sampleCount;
+    channelObject["interval"] = voltage.interval;
+    channelObject["unit"] = QString("V");
+    if (int8) {
+      channelObject["scale"] = scale;
+      channelObject["zero"] = zero;
+    }
+    channelArray.append(channelObject);
+
+    // Convert and write the samples in large blocks
+    if (int8) {
+      std::vector<qint8> block(EXPORTER_BUFFER);
+      for (unsigned int position = 0; position < sampleCount;) {
+        unsigned int count =
+            qMin(sampleCount - position, (unsigned int)block.size());
+        for (unsigned int sample = 0; sample < count; ++sample)
+          block[sample] = (qint8)qBound(
+              -128.0,
+              floor((voltage.sample[position + sample] - zero) / scale + 0.5),
+              127.0);
+        if (file->write((const char *)&block.front(), count) != count)
+          return false;
+        position += count;
+      }
+      offset += sampleCount;
+    } else {
+      std::vector<float> block(EXPORTER_BUFFER / sizeof(float));
+      for (unsigned int position = 0; position < sampleCount;) {
+        unsigned int count =
+            qMin(sampleCount - position, (unsigned int)block.size());
+        for (unsigned int sample = 0; sample < count; ++sample)
+          block[sample] = voltage.sample[position + sample];
+        qint64 size = count * sizeof(float);
+        if (file->write((const char *)&block.front(), size) != size)
+          return false;
+        position += count;
+      }
+      offset += sampleCount * sizeof(float);
+    }
+  }
+
+  QJsonObject description;
+  description["format"] = QString(int8 ? "int8" : "float32");
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+  description["byteOrder"] = QString("big");
+#else
+  description["byteOrder"] = QString("little");
+#endif
+  description["layout"] = QString("planar");
+  description["channels"] = channelArray;
+
+  QFile sidecar(this->filename + ".json");
+  if (!sidecar.open(QIODevice::WriteOnly | QIODevice::Text))
+    return false;
+  QByteArray json = QJsonDocument(description).toJson();
+  bool success = sidecar.write(json) == json.size();
+  sidecar.close();
+
+  return success;
+}
+
+/// \brief Writes the channels as two-dimensional NumPy float64 array.
+/// The samples are written straight from the analyzer buffers, channels with
+/// less samples are padded with NaN.
+/// \param file The opened output file.
+/// \param channels The channels that should be exported, one row each.
+/// \return true if the file was written successfully.
+bool Exporter::writeNpy(QFile *file, const std::vector<int> &channels) {
+  unsigned int sampleCount = 0;
+  for (unsigned int index = 0; index < channels.size(); ++index)
+    sampleCount = qMax(sampleCount, (unsigned int)this->dataAnalyzer
+                                        ->data(channels[index])
+                                        ->samples.voltage.sample.size());
+
+  // Format version 1.0, the header is padded to a multiple of 64 bytes
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+  const char *descr = ">f8";
+#else
+  const char *descr = "<f8";
+#endif
+  QByteArray dictionary = QString("{'descr': '%1', 'fortran_order': False, "
+                                  "'shape': (%2, %3), }")
+                              .arg(descr)
+                              .arg(channels.size())
+                              .arg(sampleCount)
+                              .toLatin1();
+  int headerLength = 10 + dictionary.size() + 1;
+  dictionary += QByteArray((64 - headerLength % 64) % 64, ' ');
+  dictionary += '\n';
+
+  QByteArray header("\x93NUMPY\x01\x00", 8);
+  header += (char)(dictionary.size() & 0xff);
+  header += (char)(dictionary.size() >> 8);
+  header += dictionary;
+  if (file->write(header) != header.size())
+    return false;
+
+  const std::vector<double> padding(EXPORTER_BUFFER / sizeof(double),
+                                    std::numeric_limits<double>::quiet_NaN());
+  for (unsigned int index = 0; index < channels.size(); ++index) {
+    const std::vector<double> &samples =
+        this->dataAnalyzer->data(channels[index])->samples.voltage.sample;
+    qint64 size = samples.size() * sizeof(double);
+    if (file->write((const char *)&samples.front(), size) != size)
+      return false;
+
+    for (unsigned int position = samples.size(); position < sampleCount;) {
+      unsigned int count =
+          qMin(sampleCount - position, (unsigned int)padding.size());
+      size = count * sizeof(double);
+      if (file->write((const char *)&padding.front(), size) != size)
+        return false;
+      position += count;
+    }
+  }
+
+  return true;
+}
+
+/// \brief Writes the channels as interleaved 32-bit float WAV file.
+/// The samplerate of the first channel is used for the file, channels with
+/// less samples are padded with silence.
+/// \param file The opened output file.
+/// \param channels The channels that should be exported.
+/// \return true if the file was written successfully.
+bool Exporter::writeWav(QFile *file, const std::vector<int> &channels) {
+  if (channels.empty())
+    return false;
+
+  unsigned int sampleCount = 0;
+  for (unsigned int index = 0; index < channels.size(); ++index)
+    sampleCount = qMax(sampleCount, (unsigned int)this->dataAnalyzer
+                                        ->data(channels[index])
+                                        ->samples.voltage.sample.size());
+  const quint16 channelCount = channels.size();
+  const quint32 samplerate = (quint32)floor(
+      1.0 / this->dataAnalyzer->data(channels[0])->samples.voltage.interval +
+      0.5);
+  const quint32 dataSize = sampleCount * channelCount * sizeof(float);
+
+  // RIFF header with IEEE float format, fact and data chunk
+  QByteArray header;
+  QDataStream stream(&header, QIODevice::WriteOnly);
+  stream.setByteOrder(QDataStream::LittleEndian);
+  stream.writeRawData("RIFF", 4);
+  stream << (quint32)(4 + 8 + 16 + 8 + 4 + 8 + dataSize);
+  stream.writeRawData("WAVEfmt ", 8);
+  stream << (quint32)16 << (quint16)3 << channelCount << samplerate
+         << (quint32)(samplerate * channelCount * sizeof(float))
+         << (quint16)(channelCount * sizeof(float)) << (quint16)32;
+  stream.writeRawData("fact", 4);
+  stream << (quint32)4 << (quint32)sampleCount;
+  stream.writeRawData("data", 4);
+  stream << dataSize;
+  if (file->write(header) != header.size())
+    return false;
+
+  // Interleave the channels in large blocks
+  const unsigned int frameCount =
+      EXPORTER_BUFFER / sizeof(float) / channelCount;
+  std::vector<float> block(frameCount * channelCount);
+  for (unsigned int position = 0; position < sampleCount;) {
+    unsigned int count = qMin(sampleCount - position, frameCount);
+    for (unsigned int index = 0; index < channelCount; ++index) {
+      const std::vector<double> &samples =
+          this->dataAnalyzer->data(channels[index])->samples.voltage.sample;
+      for (unsigned int frame = 0; frame < count; ++frame)
+        block[frame * channelCount + index] =
+            (position + frame < samples.size()) ? samples[position + frame]
+                                                : 0.0;
+    }
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    quint32 *words = (quint32 *)&block.front();
+    for (unsigned int word = 0; word < count * channelCount; ++word)
+      words[word] = qToLittleEndian(words[word]);
+#endif
+    qint64 size = count * channelCount * sizeof(float);
+    if (file->write((const char *)&block.front(), size) != size)
+      return false;
+    position += count;
+  }
+
+  return true;
 }
@@ -25,11 +25,19 @@
 #ifndef EXPORTER_H
 #define EXPORTER_H
 
+#include <vector>
+
 #include <QObject>
+#include <QPointF>
 #include <QSize>
 
+#define EXPORTER_CHUNK 4096   ///< Maximum points drawn by one polyline call
+#define EXPORTER_BUFFER 65536 ///< Bytes buffered before writing to the file
+
 class DsoSettings;
 class DataAnalyzer;
+class QFile;
+class QPainter;
 
 ////////////////////////////////////////////////////////////////////////////////
 /// \enum ExportFormat                                                exporter.h
@@ -38,7 +46,12 @@ enum ExportFormat {
   EXPORT_FORMAT_PRINTER,
   EXPORT_FORMAT_PDF,
   EXPORT_FORMAT_IMAGE,
-  EXPORT_FORMAT_CSV
+  EXPORT_FORMAT_CSV,
+  EXPORT_FORMAT_FLOAT32,    ///< Raw float32 samples with a JSON description
+  EXPORT_FORMAT_INT8,       ///< Raw 8-bit samples with a JSON description
+  EXPORT_FORMAT_NPY,        ///< NumPy float64 array
+  EXPORT_FORMAT_WAV,        ///< 32-bit float WAV file
+  EXPORT_FORMAT_CSV_COLUMNS ///< CSV with a time column and one per channel
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -56,14 +69,31 @@ public:
   void setFormat(ExportFormat format);
 
   bool doExport();
+  double getThroughput() const;
 
 private:
+  void drawGraph(QPainter *painter, const std::vector<double> &samples,
+                 double horizontalFactor, double gain, double offset,
+                 unsigned int firstPosition, unsigned int lastPosition,
+                 double columnWidth);
+  void appendPoint(QPainter *painter, const QPointF &point);
+  void flushGraph(QPainter *painter);
+
+  bool exportBinary();
+  bool writeRaw(QFile *file, const std::vector<int> &channels);
+  bool writeNpy(QFile *file, const std::vector<int> &channels);
+  bool writeWav(QFile *file, const std::vector<int> &channels);
+
   DataAnalyzer *dataAnalyzer;
   DsoSettings *settings;
 
   QString filename;
   ExportFormat format;
   QSize size;
+
+  double throughput; ///< Speed of the last CSV export in MB/s
+
+  std::vector<QPointF> graph; ///< The points of the current polyline chunk
 };
 
 #endif
@@ -21,13 +21,18 @@
 //
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <cmath>
+
+#include <QColor>
 #include <QGLWidget>
 #include <QMutex>
 
 #include "glgenerator.h"
 
+#include "counters.h"
 #include "dataanalyzer.h"
 #include "settings.h"
+#include "tracing.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // class GlGenerator
@@ -39,7 +44,7 @@ GlGenerator::GlGenerator(DsoSettings *settings, QObject *parent)
   this->settings = settings;
 
   this->dataAnalyzer = 0;
-  this->digitalPhosphorDepth = 0;
+  this->persistenceFrame = 0;
 
   this->generateGrid();
 }
@@ -61,32 +66,17 @@ void GlGenerator::setDataAnalyzer(DataAnalyzer *dataAnalyzer) {
 
 /// \brief Prepare arrays for drawing the data we get from the data analyzer.
 void GlGenerator::generateGraphs() {
+  Tracing::Scope span("GlGenerator::generateGraphs");
   if (!this->dataAnalyzer)
     return;
 
   // Adapt the number of graphs
-  for (int mode = Dso::CHANNELMODE_VOLTAGE; mode < Dso::CHANNELMODE_COUNT;
-       ++mode)
-    this->vaChannel[mode].resize(this->settings->scope.voltage.count());
-
-  // Set digital phosphor depth to one if we don't use it
-  if (this->settings->view.digitalPhosphor)
-    this->digitalPhosphorDepth = this->settings->view.digitalPhosphorDepth;
-  else
-    this->digitalPhosphorDepth = 1;
-
-  // Handle all digital phosphor related list manipulations
   for (int mode = Dso::CHANNELMODE_VOLTAGE; mode < Dso::CHANNELMODE_COUNT;
        ++mode) {
-    for (unsigned int channel = 0; channel < this->vaChannel[mode].size();
-         ++channel) {
-      // Move the last list element to the front
-      this->vaChannel[mode][channel].push_front(std::vector<GLfloat>());
-
-      // Resize lists for vector array to fit the digital phosphor depth
-      this->vaChannel[mode][channel].resize(this->digitalPhosphorDepth);
-    }
+    this->vaChannel[mode].resize(this->settings->scope.voltage.count());
+    this->persistence[mode].resize(this->settings->scope.voltage.count());
   }
+  this->vaEnvelope.resize(this->settings->scope.voltage.count());
 
   this->dataAnalyzer->mutex()->lock();
 
@@ -108,7 +98,8 @@ void GlGenerator::generateGraphs() {
             this->dataAnalyzer->data(channel)->samples.voltage.sample.size();
         double timeDisplay = this->settings->scope.horizontal.timebase * 10;
         double samplesDisplay =
-            timeDisplay * this->settings->scope.horizontal.samplerate;
+            timeDisplay /
+            this->dataAnalyzer->data(channel)->samples.voltage.interval;
         if (samplesDisplay >= sampleCount) {
 // For sure not enough samples to adjust for jitter.
 // Following options exist:
@@ -202,19 +193,12 @@ void GlGenerator::generateGraphs() {
             sampleCount -= (swTriggerStart - preTrigSamples);
           unsigned int neededSize = sampleCount * 2;
 
-#if 0
-						for(unsigned int index = 0; index < this->digitalPhosphorDepth; ++index) {
-							if(this->vaChannel[mode][channel][index].size() != neededSize)
-								this->vaChannel[mode][channel][index].clear(); // Something was changed, drop old traces
-						}
-#endif
-
           // Set size directly to avoid reallocations
-          this->vaChannel[mode][channel].front().resize(neededSize);
+          this->vaChannel[mode][channel].resize(neededSize);
 
           // Iterator to data for direct access
           std::vector<GLfloat>::iterator glIterator =
-              this->vaChannel[mode][channel].front().begin();
+              this->vaChannel[mode][channel].begin();
 
           // What's the horizontal distance between sampling points?
           double horizontalFactor;
@@ -242,6 +226,39 @@ void GlGenerator::generateGraphs() {
               *(glIterator++) = position * horizontalFactor - DIVS_TIME / 2;
               *(glIterator++) = *(dataIterator++) / gain + offset;
             }
+
+            // Envelope as triangle strip between the minimum and maximum
+            const SampleEnvelope &envelope =
+                this->dataAnalyzer->data(channel)->samples.envelope;
+            if (!envelope.minimum.empty()) {
+              const double startTime =
+                  (swTriggerStart - preTrigSamples) *
+                  this->dataAnalyzer->data(channel)->samples.voltage.interval;
+              const unsigned int firstBucket =
+                  qMin((unsigned int)(startTime / envelope.interval),
+                       (unsigned int)envelope.minimum.size());
+              const double envelopeFactor =
+                  envelope.interval / this->settings->scope.horizontal.timebase;
+              const double startPosition =
+                  startTime / this->settings->scope.horizontal.timebase +
+                  DIVS_TIME / 2;
+
+              this->vaEnvelope[channel].resize(
+                  (envelope.minimum.size() - firstBucket) * 4);
+              std::vector<GLfloat>::iterator envelopeIterator =
+                  this->vaEnvelope[channel].begin();
+              for (unsigned int bucket = firstBucket;
+                   bucket < envelope.minimum.size(); ++bucket) {
+                const GLfloat x = bucket * envelopeFactor - startPosition;
+                *(envelopeIterator++) = x;
+                *(envelopeIterator++) =
+                    envelope.maximum[bucket] / gain + offset;
+                *(envelopeIterator++) = x;
+                *(envelopeIterator++) =
+                    envelope.minimum[bucket] / gain + offset;
+              }
+            } else
+              this->vaEnvelope[channel].clear();
           } else {
             std::vector<double>::const_iterator dataIterator =
                 this->dataAnalyzer->data(channel)
@@ -258,10 +275,10 @@ void GlGenerator::generateGraphs() {
             }
           }
         } else {
-          // Delete all vector arrays
-          for (unsigned int index = 0; index < this->digitalPhosphorDepth;
-               ++index)
-            this->vaChannel[mode][channel][index].clear();
+          // Delete the vector array
+          this->vaChannel[mode][channel].clear();
+          if (mode == Dso::CHANNELMODE_VOLTAGE)
+            this->vaEnvelope[channel].clear();
         }
       }
     }
@@ -286,21 +303,13 @@ void GlGenerator::generateGraphs() {
             this->dataAnalyzer->data(channel + 1)
                 ->samples.voltage.sample.size());
         const unsigned int neededSize = sampleCount * 2;
-        for (unsigned int index = 0; index < this->digitalPhosphorDepth;
-             ++index) {
-          if (this->vaChannel[Dso::CHANNELMODE_VOLTAGE][channel][index]
-                  .size() != neededSize)
-            this->vaChannel[Dso::CHANNELMODE_VOLTAGE][channel][index]
-                .clear(); // Something was changed, drop old traces
-        }
 
         // Set size directly to avoid reallocations
-        this->vaChannel[Dso::CHANNELMODE_VOLTAGE][channel].front().resize(
-            neededSize);
+        this->vaChannel[Dso::CHANNELMODE_VOLTAGE][channel].resize(neededSize);
 
         // Iterator to data for direct access
         std::vector<GLfloat>::iterator glIterator =
-            this->vaChannel[Dso::CHANNELMODE_VOLTAGE][channel].front().begin();
+            this->vaChannel[Dso::CHANNELMODE_VOLTAGE][channel].begin();
 
         // Fill vector array
         unsigned int xChannel = channel;
@@ -319,15 +328,13 @@ void GlGenerator::generateGraphs() {
           *(glIterator++) = *(yIterator++) / yGain + yOffset;
         }
       } else {
-        // Delete all vector arrays
-        for (unsigned int index = 0; index < this->digitalPhosphorDepth;
-             ++index)
-          this->vaChannel[Dso::CHANNELMODE_VOLTAGE][channel][index].clear();
+        // Delete the vector array
+        this->vaChannel[Dso::CHANNELMODE_VOLTAGE][channel].clear();
       }
 
       // Delete all spectrum graphs
-      for (unsigned int index = 0; index < this->digitalPhosphorDepth; ++index)
-        this->vaChannel[Dso::CHANNELMODE_SPECTRUM][channel][index].clear();
+      this->vaChannel[Dso::CHANNELMODE_SPECTRUM][channel].clear();
+      this->vaEnvelope[channel].clear();
     }
     break;
 
@@ -337,9 +344,172 @@ void GlGenerator::generateGraphs() {
 
   this->dataAnalyzer->mutex()->unlock();
 
+  if (this->settings->view.digitalPhosphor)
+    this->accumulatePersistence();
+  else
+    this->clearPersistence();
+
+  // Counted here, since every view paints the same frame
+  Counters::add(Counters::FRAMES_RENDERED);
   emit graphsGenerated();
 }
 
+/// \brief Adds the new graphs to the persistence maps and renders the image.
+/// The hit counts of all cells are decayed once per frame, then the new
+/// graphs are rasterized into them. The cost per frame doesn't depend on the
+/// persistence, a depth of 0 keeps the hits forever. Every pixel of the image
+/// is written once per frame, so it is neither cleared nor reallocated.
+void GlGenerator::accumulatePersistence() {
+  const int depth = this->settings->view.digitalPhosphorDepth;
+  // Hits fade to 1 % after depth frames like the old layered graphs did
+  const float decay = (depth > 0) ? pow(0.01, 1.0 / depth) : 1.0;
+  const unsigned int cellCount = PERSISTENCE_COLUMNS * PERSISTENCE_ROWS;
+  const bool lines =
+      this->settings->view.interpolation != Dso::INTERPOLATION_OFF;
+
+  if (this->persistenceImage.size() != cellCount * 4)
+    this->persistenceImage.resize(cellCount * 4);
+  this->persistenceLayers.clear();
+
+  for (int mode = Dso::CHANNELMODE_VOLTAGE; mode < Dso::CHANNELMODE_COUNT;
+       ++mode) {
+    for (unsigned int channel = 0; channel < this->persistence[mode].size();
+         ++channel) {
+      std::vector<float> &hits = this->persistence[mode][channel];
+      if (this->vaChannel[mode][channel].empty()) {
+        // Drop the history of disabled graphs like the graph itself
+        hits.clear();
+        continue;
+      }
+      if (hits.empty())
+        hits.assign(cellCount, 0.0);
+
+      // Decay the old hits and find the most hit cell in the same pass
+      float maximum = 0.0;
+      if (decay < 1.0) {
+        for (unsigned int cell = 0; cell < cellCount; ++cell) {
+          float count = hits[cell] * decay;
+          if (count < PERSISTENCE_MINIMUM)
+            count = 0.0;
+          hits[cell] = count;
+          maximum = qMax(maximum, count);
+        }
+      } else {
+        for (unsigned int cell = 0; cell < cellCount; ++cell)
+          maximum = qMax(maximum, hits[cell]);
+      }
+
+      float drawn =
+          this->rasterizeGraph(this->vaChannel[mode][channel], lines, &hits);
+      maximum = qMax(maximum, drawn);
+      if (maximum <= 0.0)
+        continue;
+
+      // Intensity grading, logarithmic relative to the most hit cell
+      const QColor &color =
+          (mode == Dso::CHANNELMODE_VOLTAGE)
+              ? this->settings->view.color.screen.voltage[channel]
+              : this->settings->view.color.screen.spectrum[channel];
+      PersistenceLayer layer;
+      layer.hits = hits.data();
+      layer.scale = 1.0 / log1p(maximum);
+      layer.red = color.redF() * color.alphaF() * 255;
+      layer.green = color.greenF() * color.alphaF() * 255;
+      layer.blue = color.blueF() * color.alphaF() * 255;
+      layer.alpha = color.alphaF() * 255;
+      this->persistenceLayers.push_back(layer);
+    }
+  }
+
+  // Premultiplied colours, overlapping graphs are added
+  const unsigned int layerCount = this->persistenceLayers.size();
+  const PersistenceLayer *layers = this->persistenceLayers.data();
+  GLubyte *pixel = &this->persistenceImage.front();
+  for (unsigned int cell = 0; cell < cellCount; ++cell, pixel += 4) {
+    float red = 0.0, green = 0.0, blue = 0.0, alpha = 0.0;
+    for (unsigned int layer = 0; layer < layerCount; ++layer) {
+      const float count = layers[layer].hits[cell];
+      if (count <= 0.0)
+        continue;
+      const float intensity = log1p(count) * layers[layer].scale;
+      red += layers[layer].red * intensity;
+      green += layers[layer].green * intensity;
+      blue += layers[layer].blue * intensity;
+      alpha = qMax(alpha, layers[layer].alpha * intensity);
+    }
+    pixel[0] = (GLubyte)qMin(red, 255.0f);
+    pixel[1] = (GLubyte)qMin(green, 255.0f);
+    pixel[2] = (GLubyte)qMin(blue, 255.0f);
+    pixel[3] = (GLubyte)qMin(alpha, 255.0f);
+  }
+
+  ++this->persistenceFrame;
+}
+
+/// \brief Drops the persistence maps when digital phosphor is disabled.
+void GlGenerator::clearPersistence() {
+  if (this->persistenceImage.empty())
+    return;
+
+  for (int mode = Dso::CHANNELMODE_VOLTAGE; mode < Dso::CHANNELMODE_COUNT;
+       ++mode) {
+    for (unsigned int channel = 0; channel < this->persistence[mode].size();
+         ++channel)
+      this->persistence[mode][channel].clear();
+  }
+  this->persistenceImage.clear();
+  ++this->persistenceFrame;
+}
+
+/// \brief Adds one hit to every cell of a persistence map a graph touches.
+/// \param vertices The vertex array of the graph in screen divs.
+/// \param lines true connects the samples, false only hits the samples.
+/// \param hits The persistence map.
+/// \return The highest hit count of the cells the graph touched.
+float GlGenerator::rasterizeGraph(const std::vector<GLfloat> &vertices,
+                                  bool lines, std::vector<float> *hits) {
+  const float xScale = PERSISTENCE_COLUMNS / DIVS_TIME;
+  const float yScale = PERSISTENCE_ROWS / DIVS_VOLTAGE;
+  const unsigned int pointCount = vertices.size() / 2;
+
+  float maximum = 0.0;
+  float lastX = 0.0, lastY = 0.0;
+  for (unsigned int point = 0; point < pointCount; ++point) {
+    // Cell coordinates, limited to one cell beyond the screen
+    float x = (vertices[point * 2] + DIVS_TIME / 2) * xScale;
+    float y = (vertices[point * 2 + 1] + DIVS_VOLTAGE / 2) * yScale;
+    x = qBound(-1.0f, x, (float)PERSISTENCE_COLUMNS);
+    y = qBound(-1.0f, y, (float)PERSISTENCE_ROWS);
+
+    // Step through the cells between the last and this sample
+    unsigned int steps = 1;
+    if (lines && point > 0)
+      steps = (unsigned int)qMax(fabs(x - lastX), fabs(y - lastY)) + 1;
+    else {
+      lastX = x;
+      lastY = y;
+    }
+    const float xStep = (x - lastX) / steps;
+    const float yStep = (y - lastY) / steps;
+
+    for (unsigned int step = 1; step <= steps; ++step) {
+      const int column = (int)floor(lastX + xStep * step);
+      const int row = (int)floor(lastY + yStep * step);
+      if (column >= 0 && column < PERSISTENCE_COLUMNS && row >= 0 &&
+          row < PERSISTENCE_ROWS) {
+        float &count = (*hits)[row * PERSISTENCE_COLUMNS + column];
+        count += 1.0;
+        maximum = qMax(maximum, count);
+      }
+    }
+
+    lastX = x;
+    lastY = y;
+  }
+
+  return maximum;
+}
+
 /// \brief Create the needed OpenGL vertex arrays for the grid.
 void GlGenerator::generateGrid() {
   // Grid
@@ -27,16 +27,16 @@
 #ifndef GLGENERATOR_H
 #define GLGENERATOR_H
 
-#include <deque>
+#include <vector>
 
 #include <QGLWidget>
 #include <QObject>
 
 #include "dso.h"
 
-#define DIVS_TIME 10.0   ///< Number of horizontal screen divs
-#define DIVS_VOLTAGE 8.0 ///< Number of vertical screen divs
-#define DIVS_SUB 5       ///< Number of sub-divisions per div
+#define PERSISTENCE_COLUMNS 1024 ///< Horizontal resolution of the persistence
+#define PERSISTENCE_ROWS 512     ///< Vertical resolution of the persistence
+#define PERSISTENCE_MINIMUM 0.01 ///< Hit count below which a cell is cleared
 
 class DataAnalyzer;
 class DsoSettings;
@@ -58,16 +58,33 @@ public:
 
 protected:
   void generateGrid();
+  void accumulatePersistence();
+  void clearPersistence();
+  float rasterizeGraph(const std::vector<GLfloat> &vertices, bool lines,
+                       std::vector<float> *hits);
 
 private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \struct PersistenceLayer                                   glgenerator.h
+  /// \brief A persistence map and the colour it is drawn with.
+  struct PersistenceLayer {
+    const float *hits;             ///< The decayed hit counts of the graph
+    float scale;                   ///< Normalizes the logarithmic intensity
+    float red, green, blue, alpha; ///< Premultiplied colour, 0 to 255
+  };
+
   DataAnalyzer *dataAnalyzer;
   DsoSettings *settings;
 
-  std::vector<std::deque<std::vector<GLfloat>>>
-      vaChannel[Dso::CHANNELMODE_COUNT];
+  std::vector<std::vector<GLfloat>> vaChannel[Dso::CHANNELMODE_COUNT];
+  std::vector<std::vector<GLfloat>> vaEnvelope;
   std::vector<GLfloat> vaGrid[3];
 
-  unsigned int digitalPhosphorDepth;
+  std::vector<std::vector<float>>
+      persistence[Dso::CHANNELMODE_COUNT]; ///< Decayed hit counts per cell
+  std::vector<GLubyte> persistenceImage;   ///< Premultiplied RGBA hit image
+  std::vector<PersistenceLayer> persistenceLayers; ///< The visible graphs
+  unsigned int persistenceFrame; ///< Incremented when the image changes
 
 public slots:
   void generateGraphs();
@@ -26,12 +26,15 @@
 #include <cmath>
 
 #include <QColor>
+#include <QElapsedTimer>
 
 #include "glscope.h"
 
+#include "counters.h"
 #include "dataanalyzer.h"
 #include "glgenerator.h"
 #include "settings.h"
+#include "tracing.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // class GlScope
@@ -43,10 +46,17 @@ GlScope::GlScope(DsoSettings *settings, QWidget *parent) : QGLWidget(parent) {
 
   this->generator = 0;
   this->zoomed = false;
+  this->persistenceTexture = 0;
+  this->persistenceFrame = 0;
 }
 
 /// \brief Deletes OpenGL objects.
-GlScope::~GlScope() {}
+GlScope::~GlScope() {
+  if (this->persistenceTexture) {
+    this->makeCurrent();
+    glDeleteTextures(1, &this->persistenceTexture);
+  }
+}
 
 /// \brief Initializes OpenGL output.
 void GlScope::initializeGL() {
@@ -62,19 +72,33 @@ void GlScope::initializeGL() {
   glLineStipple(1, 0x3333);
 
   glEnableClientState(GL_VERTEX_ARRAY);
+
+  // The texture for the persistence image is only updated afterwards
+  glGenTextures(1, &this->persistenceTexture);
+  glBindTexture(GL_TEXTURE_2D, this->persistenceTexture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, PERSISTENCE_COLUMNS,
+               PERSISTENCE_ROWS, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
 }
 
 /// \brief Draw the graphs and the grid.
 void GlScope::paintGL() {
+  Tracing::Scope span("GlScope::paintGL");
   if (!this->isVisible())
     return;
 
+  QElapsedTimer timer;
+  timer.start();
+
   // Clear OpenGL buffer and configure settings
   glClear(GL_COLOR_BUFFER_BIT);
   glLineWidth(1);
 
   // Draw the graphs
-  if (this->generator && this->generator->digitalPhosphorDepth > 0) {
+  if (this->generator) {
     if (this->settings->view.antialiasing) {
       glEnable(GL_POINT_SMOOTH);
       glEnable(GL_LINE_SMOOTH);
@@ -93,13 +117,10 @@ void GlScope::paintGL() {
                    0.0, 0.0);
     }
 
-    // Values we need for the fading of the digital phosphor
-    double *fadingFactor = new double[this->generator->digitalPhosphorDepth];
-    fadingFactor[0] = 100;
-    double fadingRatio = pow(10.0, 2.0 / this->generator->digitalPhosphorDepth);
-    for (unsigned int index = 1; index < this->generator->digitalPhosphorDepth;
-         ++index)
-      fadingFactor[index] = fadingFactor[index - 1] * fadingRatio;
+    // The history of the graphs as one texture behind the new graphs
+    if (this->settings->view.digitalPhosphor &&
+        !this->generator->persistenceImage.empty())
+      this->drawPersistence();
 
     switch (this->settings->scope.horizontal.format) {
     case Dso::GRAPHFORMAT_TY:
@@ -111,29 +132,35 @@ void GlScope::paintGL() {
           if ((mode == Dso::CHANNELMODE_VOLTAGE)
                   ? this->settings->scope.voltage[channel].used
                   : this->settings->scope.spectrum[channel].used) {
-            // Draw graph for all available depths
-            for (int index = this->generator->digitalPhosphorDepth - 1;
-                 index >= 0; index--) {
-              if (!this->generator->vaChannel[mode][channel][index].empty()) {
-                if (mode == Dso::CHANNELMODE_VOLTAGE)
-                  this->qglColor(
-                      this->settings->view.color.screen.voltage[channel].darker(
-                          fadingFactor[index]));
-                else
-                  this->qglColor(
-                      this->settings->view.color.screen.spectrum[channel]
-                          .darker(fadingFactor[index]));
-                glVertexPointer(
-                    2, GL_FLOAT, 0,
-                    &this->generator->vaChannel[mode][channel][index].front());
-                glDrawArrays(
-                    (this->settings->view.interpolation ==
-                     Dso::INTERPOLATION_OFF)
-                        ? GL_POINTS
-                        : GL_LINE_STRIP,
-                    0, this->generator->vaChannel[mode][channel][index].size() /
-                           2);
-              }
+            // Draw the envelope as translucent band behind the graph
+            if (mode == Dso::CHANNELMODE_VOLTAGE &&
+                !this->generator->vaEnvelope[channel].empty()) {
+              QColor envelopeColor =
+                  this->settings->view.color.screen.voltage[channel];
+              envelopeColor.setAlphaF(envelopeColor.alphaF() * 0.4);
+              this->qglColor(envelopeColor);
+              glVertexPointer(2, GL_FLOAT, 0,
+                              &this->generator->vaEnvelope[channel].front());
+              glDrawArrays(GL_TRIANGLE_STRIP, 0,
+                           this->generator->vaEnvelope[channel].size() / 2);
+            }
+
+            // Draw the newest graph
+            if (!this->generator->vaChannel[mode][channel].empty()) {
+              if (mode == Dso::CHANNELMODE_VOLTAGE)
+                this->qglColor(
+                    this->settings->view.color.screen.voltage[channel]);
+              else
+                this->qglColor(
+                    this->settings->view.color.screen.spectrum[channel]);
+              glVertexPointer(
+                  2, GL_FLOAT, 0,
+                  &this->generator->vaChannel[mode][channel].front());
+              glDrawArrays(
+                  (this->settings->view.interpolation == Dso::INTERPOLATION_OFF)
+                      ? GL_POINTS
+                      : GL_LINE_STRIP,
+                  0, this->generator->vaChannel[mode][channel].size() / 2);
             }
           }
         }
@@ -145,30 +172,22 @@ void GlScope::paintGL() {
       for (int channel = 0; channel < this->settings->scope.voltage.count() - 1;
            channel += 2) {
         if (this->settings->scope.voltage[channel].used) {
-          // Draw graph for all available depths
-          for (int index = this->generator->digitalPhosphorDepth - 1;
-               index >= 0; index--) {
-            if (!this->generator
-                     ->vaChannel[Dso::CHANNELMODE_VOLTAGE][channel][index]
-                     .empty()) {
-              this->qglColor(
-                  this->settings->view.color.screen.voltage[channel].darker(
-                      fadingFactor[index]));
-              glVertexPointer(
-                  2, GL_FLOAT, 0,
-                  &this->generator
-                       ->vaChannel[Dso::CHANNELMODE_VOLTAGE][channel][index]
-                       .front());
-              glDrawArrays(
-                  (this->settings->view.interpolation == Dso::INTERPOLATION_OFF)
-                      ? GL_POINTS
-                      : GL_LINE_STRIP,
-                  0,
-                  this->generator
-                          ->vaChannel[Dso::CHANNELMODE_VOLTAGE][channel][index]
-                          .size() /
-                      2);
-            }
+          // Draw the newest graph
+          if (!this->generator->vaChannel[Dso::CHANNELMODE_VOLTAGE][channel]
+                   .empty()) {
+            this->qglColor(this->settings->view.color.screen.voltage[channel]);
+            glVertexPointer(
+                2, GL_FLOAT, 0,
+                &this->generator->vaChannel[Dso::CHANNELMODE_VOLTAGE][channel]
+                     .front());
+            glDrawArrays(
+                (this->settings->view.interpolation == Dso::INTERPOLATION_OFF)
+                    ? GL_POINTS
+                    : GL_LINE_STRIP,
+                0,
+                this->generator->vaChannel[Dso::CHANNELMODE_VOLTAGE][channel]
+                        .size() /
+                    2);
           }
         }
       }
@@ -178,8 +197,6 @@ void GlScope::paintGL() {
       break;
     }
 
-    delete[] fadingFactor;
-
     glDisable(GL_POINT_SMOOTH);
     glDisable(GL_LINE_SMOOTH);
 
@@ -215,6 +232,8 @@ void GlScope::paintGL() {
 
   // Draw grid
   this->drawGrid();
+
+  Counters::add(Counters::RENDER_TIME, timer.nsecsElapsed());
 }
 
 /// \brief Resize the widget.
@@ -253,6 +272,37 @@ void GlScope::setGenerator(GlGenerator *generator) {
 /// \param zoomed true magnifies the area between the markers.
 void GlScope::setZoomMode(bool zoomed) { this->zoomed = zoomed; }
 
+/// \brief Draw the persistence image of the generator across the screen.
+/// The texture is only uploaded again if the generator has a new image.
+void GlScope::drawPersistence() {
+  static const GLfloat vertices[8] = {
+      -DIVS_TIME / 2, -DIVS_VOLTAGE / 2, DIVS_TIME / 2,  -DIVS_VOLTAGE / 2,
+      DIVS_TIME / 2,  DIVS_VOLTAGE / 2,  -DIVS_TIME / 2, DIVS_VOLTAGE / 2};
+  static const GLfloat texCoords[8] = {0.0, 0.0, 1.0, 0.0,
+                                       1.0, 1.0, 0.0, 1.0};
+
+  glEnable(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, this->persistenceTexture);
+  if (this->persistenceFrame != this->generator->persistenceFrame) {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, PERSISTENCE_COLUMNS,
+                    PERSISTENCE_ROWS, GL_RGBA, GL_UNSIGNED_BYTE,
+                    &this->generator->persistenceImage.front());
+    this->persistenceFrame = this->generator->persistenceFrame;
+  }
+
+  // The image has premultiplied colours
+  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+  glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glVertexPointer(2, GL_FLOAT, 0, vertices);
+  glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
+  glDrawArrays(GL_QUADS, 0, 4);
+  glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glDisable(GL_TEXTURE_2D);
+}
+
 /// \brief Draw the grid.
 void GlScope::drawGrid() {
   glDisable(GL_POINT_SMOOTH);
@@ -54,11 +54,15 @@ protected:
   void resizeGL(int width, int height);
 
   void drawGrid();
+  void drawPersistence();
 
 private:
   GlGenerator *generator;
   DsoSettings *settings;
 
+  GLuint persistenceTexture;     ///< The texture for the persistence image
+  unsigned int persistenceFrame; ///< The frame uploaded into the texture
+
   std::vector<GLfloat> vaMarker[2];
   bool zoomed;
 };
@@ -0,0 +1,269 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  glwaterfall.cpp
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+
+#include <QMutex>
+
+#include "glwaterfall.h"
+
+#include "dataanalyzer.h"
+#include "glgenerator.h"
+#include "settings.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// class GlWaterfall
+/// \brief Initializes the waterfall widget.
+/// \param settings The settings that should be used.
+/// \param parent The parent widget.
+GlWaterfall::GlWaterfall(DsoSettings *settings, QWidget *parent)
+    : QGLWidget(parent) {
+  this->settings = settings;
+
+  this->dataAnalyzer = 0;
+  this->depth = 0;
+  this->depthSetting = 0;
+  this->row = 0;
+  this->initialized = false;
+  this->rowBuffer.resize(GLWATERFALL_COLUMNS * 3);
+
+  // Black, blue, red, yellow and white for rising intensities
+  static const GLubyte colorStops[5][3] = {
+      {0, 0, 0}, {0, 0, 255}, {255, 0, 0}, {255, 255, 0}, {255, 255, 255}};
+  this->colorTable.resize(256 * 3);
+  for (unsigned int intensity = 0; intensity < 256; ++intensity) {
+    unsigned int stop = qMin(intensity / 64, 3u);
+    double fraction = (intensity - stop * 64) / 64.0;
+    for (unsigned int component = 0; component < 3; ++component)
+      this->colorTable[intensity * 3 + component] =
+          (GLubyte)(colorStops[stop][component] +
+                    (colorStops[stop + 1][component] -
+                     colorStops[stop][component]) *
+                        fraction);
+  }
+}
+
+/// \brief Deletes OpenGL objects.
+GlWaterfall::~GlWaterfall() {
+  if (this->initialized) {
+    this->makeCurrent();
+    this->deleteTextures();
+  }
+}
+
+/// \brief Set the data analyzer whose spectrums will be drawn.
+/// \param dataAnalyzer Pointer to the DataAnalyzer class.
+void GlWaterfall::setDataAnalyzer(DataAnalyzer *dataAnalyzer) {
+  if (this->dataAnalyzer)
+    disconnect(this->dataAnalyzer, SIGNAL(finished()), this,
+               SLOT(appendSpectrums()));
+  this->dataAnalyzer = dataAnalyzer;
+  connect(this->dataAnalyzer, SIGNAL(finished()), this,
+          SLOT(appendSpectrums()));
+}
+
+/// \brief Initializes OpenGL output.
+void GlWaterfall::initializeGL() {
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_BLEND);
+
+  qglClearColor(this->settings->view.color.screen.background);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+  this->initialized = true;
+  this->createTextures();
+}
+
+/// \brief Draw the history of all used spectrums.
+void GlWaterfall::paintGL() {
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  if (this->textures.empty())
+    return;
+
+  // Every used spectrum gets a strip of equal height
+  std::vector<unsigned int> usedChannels;
+  for (unsigned int channel = 0; channel < this->textures.size(); ++channel) {
+    if ((int)channel < this->settings->scope.spectrum.count() &&
+        this->settings->scope.spectrum[channel].used)
+      usedChannels.push_back(channel);
+  }
+  if (usedChannels.empty())
+    return;
+
+  // The newest row is at the top, the repeated texture wraps around
+  const GLfloat top = (GLfloat)(this->row + 1) / this->depth;
+  const GLfloat bottom = top - 1.0;
+  const GLfloat texCoords[8] = {0.0, bottom, 1.0, bottom,
+                                1.0, top,    0.0, top};
+
+  glEnable(GL_TEXTURE_2D);
+  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+  for (unsigned int strip = 0; strip < usedChannels.size(); ++strip) {
+    const GLfloat stripTop = 1.0 - (GLfloat)strip / usedChannels.size();
+    const GLfloat stripBottom =
+        1.0 - (GLfloat)(strip + 1) / usedChannels.size();
+    const GLfloat vertices[8] = {0.0, stripBottom, 1.0, stripBottom,
+                                 1.0, stripTop,    0.0, stripTop};
+
+    glBindTexture(GL_TEXTURE_2D, this->textures[usedChannels[strip]]);
+    glVertexPointer(2, GL_FLOAT, 0, vertices);
+    glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
+    glDrawArrays(GL_QUADS, 0, 4);
+  }
+  glDisable(GL_TEXTURE_2D);
+}
+
+/// \brief Resize the widget.
+/// \param width The new width of the widget.
+/// \param height The new height of the widget.
+void GlWaterfall::resizeGL(int width, int height) {
+  glViewport(0, 0, (GLint)width, (GLint)height);
+
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  glOrtho(0.0, 1.0, 0.0, 1.0, -1.0, 1.0);
+
+  glMatrixMode(GL_MODELVIEW);
+}
+
+/// \brief Creates the empty history textures for all channels.
+/// The depth is rounded up to a power of two, so that the ring buffer can
+/// wrap around with GL_REPEAT on every OpenGL implementation.
+void GlWaterfall::createTextures() {
+  this->deleteTextures();
+
+  GLint maxSize = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+  unsigned int depth = 1;
+  while (depth < (unsigned int)this->settings->view.waterfallDepth &&
+         depth < (unsigned int)maxSize)
+    depth *= 2;
+  this->depth = depth;
+  this->depthSetting = this->settings->view.waterfallDepth;
+  this->row = 0;
+
+  std::vector<GLubyte> blank(GLWATERFALL_COLUMNS * this->depth * 3, 0);
+  this->textures.resize(this->settings->scope.spectrum.count());
+  glGenTextures(this->textures.size(), &this->textures.front());
+  for (unsigned int channel = 0; channel < this->textures.size(); ++channel) {
+    glBindTexture(GL_TEXTURE_2D, this->textures[channel]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, GLWATERFALL_COLUMNS, this->depth, 0,
+                 GL_RGB, GL_UNSIGNED_BYTE, &blank.front());
+  }
+}
+
+/// \brief Deletes the history textures.
+void GlWaterfall::deleteTextures() {
+  if (this->textures.empty())
+    return;
+
+  glDeleteTextures(this->textures.size(), &this->textures.front());
+  this->textures.clear();
+}
+
+/// \brief Converts the spectrum of a channel into the colours of rowBuffer.
+/// Each texture column covers the frequency range of one screen column, the
+/// highest level of the bins within a column is used to keep narrow peaks.
+/// \param channel The channel whose spectrum should be converted.
+void GlWaterfall::quantizeSpectrum(unsigned int channel) {
+  const AnalyzedData *channelData = this->dataAnalyzer->data(channel);
+  if (!channelData || !this->settings->scope.spectrum[channel].used ||
+      channelData->samples.spectrum.sample.empty() ||
+      channelData->samples.spectrum.interval <= 0) {
+    std::fill(this->rowBuffer.begin(), this->rowBuffer.end(), 0);
+    return;
+  }
+
+  const std::vector<double> &spectrum = channelData->samples.spectrum.sample;
+  const double binsPerColumn = DIVS_TIME *
+                               this->settings->scope.horizontal.frequencybase /
+                               channelData->samples.spectrum.interval /
+                               GLWATERFALL_COLUMNS;
+  const double magnitude = this->settings->scope.spectrum[channel].magnitude;
+  const double offset = this->settings->scope.spectrum[channel].offset;
+
+  GLubyte *color = &this->rowBuffer.front();
+  for (unsigned int column = 0; column < GLWATERFALL_COLUMNS; ++column) {
+    unsigned int firstBin = (unsigned int)(column * binsPerColumn);
+    unsigned int lastBin = (unsigned int)((column + 1) * binsPerColumn);
+    if (lastBin <= firstBin)
+      lastBin = firstBin + 1;
+    if (lastBin > spectrum.size())
+      lastBin = spectrum.size();
+
+    unsigned int intensity = 0;
+    if (firstBin < lastBin) {
+      double value = spectrum[firstBin];
+      for (unsigned int bin = firstBin + 1; bin < lastBin; ++bin)
+        value = qMax(value, spectrum[bin]);
+
+      // Same vertical position as the graph, bottom to top of the screen
+      double level = (value / magnitude + offset) / DIVS_VOLTAGE + 0.5;
+      intensity = (unsigned int)qBound(0.0, level * 255.0, 255.0);
+    }
+
+    for (unsigned int component = 0; component < 3; ++component)
+      *(color++) = this->colorTable[intensity * 3 + component];
+  }
+}
+
+/// \brief Appends the latest spectrums as new rows to the history.
+void GlWaterfall::appendSpectrums() {
+  if (!this->dataAnalyzer || !this->initialized || !this->isVisible())
+    return;
+
+  this->makeCurrent();
+  if (this->textures.size() !=
+          (unsigned int)this->settings->scope.spectrum.count() ||
+      this->depthSetting != this->settings->view.waterfallDepth)
+    this->createTextures();
+
+  this->row = (this->row + 1) % this->depth;
+
+  this->dataAnalyzer->mutex()->lock();
+  for (unsigned int channel = 0; channel < this->textures.size(); ++channel) {
+    this->quantizeSpectrum(channel);
+
+    glBindTexture(GL_TEXTURE_2D, this->textures[channel]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, this->row, GLWATERFALL_COLUMNS, 1,
+                    GL_RGB, GL_UNSIGNED_BYTE, &this->rowBuffer.front());
+  }
+  this->dataAnalyzer->mutex()->unlock();
+
+  this->updateGL();
+}
+
+/// \brief Drops the history, e.g. when the frequency axis has changed.
+void GlWaterfall::clearHistory() {
+  if (!this->initialized)
+    return;
+
+  this->makeCurrent();
+  this->createTextures();
+  this->updateGL();
+}
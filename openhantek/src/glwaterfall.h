@@ -0,0 +1,76 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file glwaterfall.h
+/// \brief Declares the GlWaterfall class.
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef GLWATERFALL_H
+#define GLWATERFALL_H
+
+#include <vector>
+
+#include <QtOpenGL>
+
+#define GLWATERFALL_COLUMNS 1024 ///< Width of the history textures
+
+class DataAnalyzer;
+class DsoSettings;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class GlWaterfall                                             glwaterfall.h
+/// \brief OpenGL widget that displays the history of the spectrums.
+/// Every analyzed spectrum is quantized into one colour-mapped texture row.
+/// The rows are written into a ring buffer texture for each channel, so only
+/// the newest row is uploaded per frame and the older rows stay on the GPU.
+/// The frequency axis matches the one of the main scope.
+class GlWaterfall : public QGLWidget {
+  Q_OBJECT
+
+public:
+  GlWaterfall(DsoSettings *settings, QWidget *parent = 0);
+  ~GlWaterfall();
+
+  void setDataAnalyzer(DataAnalyzer *dataAnalyzer);
+
+protected:
+  void initializeGL();
+  void paintGL();
+  void resizeGL(int width, int height);
+
+  void createTextures();
+  void deleteTextures();
+  void quantizeSpectrum(unsigned int channel);
+
+private:
+  DataAnalyzer *dataAnalyzer;
+  DsoSettings *settings;
+
+  std::vector<GLuint> textures;    ///< The ring buffer texture of each channel
+  unsigned int depth;              ///< Number of rows in the textures
+  int depthSetting;                ///< The setting the depth was chosen for
+  unsigned int row;                ///< The row that was written last
+  std::vector<GLubyte> rowBuffer;  ///< RGB values of the row to upload
+  std::vector<GLubyte> colorTable; ///< RGB values for the 256 intensities
+  bool initialized;                ///< true, if the GL context is ready
+
+public slots:
+  void appendSpectrums();
+  void clearHistory();
+};
+
+#endif
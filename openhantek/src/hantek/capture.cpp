@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  hantek/capture.cpp
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstring>
+
+#include <libusb-1.0/libusb.h>
+
+#include "hantek/capture.h"
+
+namespace Hantek {
+////////////////////////////////////////////////////////////////////////////////
+// struct Hantek::CaptureTransfer
+/// \brief Checks the direction of the transfer.
+/// \return true, if data was sent from the device to the host.
+bool CaptureTransfer::isInput() const {
+  return (this->endpoint & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class Hantek::CaptureFile
+/// \brief Initializes a closed capture.
+CaptureFile::CaptureFile() {}
+
+/// \brief Closes the file.
+CaptureFile::~CaptureFile() { this->close(); }
+
+/// \brief Creates a new capture file for recording.
+/// \param fileName The name of the file, it's overwritten.
+/// \param header The properties of the recorded device.
+/// \return true if the header was written.
+bool CaptureFile::create(const QString &fileName,
+                         const CaptureHeader &header) {
+  this->close();
+
+  this->file.setFileName(fileName);
+  if (!this->file.open(QIODevice::WriteOnly))
+    return false;
+  this->stream.setDevice(&this->file);
+
+  this->stream.writeRawData(CAPTURE_MAGIC, 8);
+  this->stream << header.model << header.outPacketLength
+               << header.inPacketLength;
+  this->timer.start();
+
+  return this->stream.status() == QDataStream::Ok;
+}
+
+/// \brief Opens a capture file for replaying.
+/// \param fileName The name of the file.
+/// \param header Receives the properties of the recorded device.
+/// \return true if the file is a valid capture.
+bool CaptureFile::open(const QString &fileName, CaptureHeader *header) {
+  this->close();
+
+  this->file.setFileName(fileName);
+  if (!this->file.open(QIODevice::ReadOnly))
+    return false;
+  this->stream.setDevice(&this->file);
+
+  char magic[8];
+  if (this->stream.readRawData(magic, 8) != 8 ||
+      memcmp(magic, CAPTURE_MAGIC, 8)) {
+    this->close();
+    return false;
+  }
+  this->stream >> header->model >> header->outPacketLength >>
+      header->inPacketLength;
+
+  return this->stream.status() == QDataStream::Ok;
+}
+
+/// \brief Closes the capture file.
+void CaptureFile::close() {
+  this->stream.setDevice(0);
+  if (this->file.isOpen())
+    this->file.close();
+}
+
+/// \brief Checks if a capture file is open.
+/// \return true if the file is open.
+bool CaptureFile::isOpen() const { return this->file.isOpen(); }
+
+/// \brief Appends a transfer to a created capture.
+/// \param transfer The transfer, its time is set to the current time.
+/// \return true if the transfer was written.
+bool CaptureFile::write(CaptureTransfer *transfer) {
+  transfer->time = this->timer.nsecsElapsed() / 1000;
+
+  this->stream << transfer->time << transfer->kind << transfer->endpoint
+               << transfer->request << transfer->value << transfer->index
+               << transfer->length << transfer->result << transfer->data;
+
+  return this->stream.status() == QDataStream::Ok;
+}
+
+/// \brief Reads the next transfer of an opened capture.
+/// \param transfer Receives the transfer.
+/// \return false at the end of the capture.
+bool CaptureFile::read(CaptureTransfer *transfer) {
+  if (this->stream.atEnd())
+    return false;
+
+  this->stream >> transfer->time >> transfer->kind >> transfer->endpoint >>
+      transfer->request >> transfer->value >> transfer->index >>
+      transfer->length >> transfer->result >> transfer->data;
+
+  return this->stream.status() == QDataStream::Ok;
+}
+}
@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file hantek/capture.h
+/// \brief Declares the Hantek::CaptureFile class.
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HANTEK_CAPTURE_H
+#define HANTEK_CAPTURE_H
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+
+#define CAPTURE_MAGIC "OHUSB001" ///< The first bytes of every capture file
+
+namespace Hantek {
+//////////////////////////////////////////////////////////////////////////////
+/// \enum CaptureKind                                         hantek/capture.h
+/// \brief The USB transfer types stored in a capture.
+enum CaptureKind {
+  CAPTURE_BULK,   ///< A bulk transfer, the endpoint sets the direction
+  CAPTURE_CONTROL ///< A control transfer, the request type sets the direction
+};
+
+//////////////////////////////////////////////////////////////////////////////
+/// \struct CaptureHeader                                     hantek/capture.h
+/// \brief The properties of the recorded device.
+struct CaptureHeader {
+  qint32 model;           ///< The ::Model of the oscilloscope
+  qint32 outPacketLength; ///< Packet length for the OUT endpoint
+  qint32 inPacketLength;  ///< Packet length for the IN endpoint
+};
+
+//////////////////////////////////////////////////////////////////////////////
+/// \struct CaptureTransfer                                   hantek/capture.h
+/// \brief One recorded USB transfer.
+struct CaptureTransfer {
+  qint64 time;     ///< Time since the capture was created in us
+  quint8 kind;     ///< The ::CaptureKind of the transfer
+  quint8 endpoint; ///< Bulk endpoint or control request type
+  quint8 request;  ///< Control request, 0 for bulk transfers
+  quint16 value;   ///< Control value, 0 for bulk transfers
+  quint16 index;   ///< Control index, 0 for bulk transfers
+  quint32 length;  ///< The requested length in bytes
+  qint32 result;   ///< Transferred bytes or libusb error code
+  QByteArray data; ///< Sent data for OUT, received data for IN transfers
+
+  bool isInput() const;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+/// \class CaptureFile                                        hantek/capture.h
+/// \brief Reads and writes the USB transfers of a device session.
+/// The file starts with CAPTURE_MAGIC and the CaptureHeader, followed by the
+/// CaptureTransfer entries in the order they happened. All values are stored
+/// big endian by QDataStream.
+class CaptureFile {
+public:
+  CaptureFile();
+  ~CaptureFile();
+
+  bool create(const QString &fileName, const CaptureHeader &header);
+  bool open(const QString &fileName, CaptureHeader *header);
+  void close();
+  bool isOpen() const;
+
+  bool write(CaptureTransfer *transfer);
+  bool read(CaptureTransfer *transfer);
+
+private:
+  QFile file;          ///< The capture file
+  QDataStream stream;  ///< Serializes the entries
+  QElapsedTimer timer; ///< Time since the file was created
+};
+}
+
+#endif
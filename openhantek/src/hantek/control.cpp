@@ -27,6 +27,7 @@
 #include <limits>
 #include <vector>
 
+#include <QDateTime>
 #include <QList>
 #include <QMutex>
 #include <QTimer>
@@ -34,8 +35,10 @@
 #include "hantek/control.h"
 
 #include "hantek/device.h"
+#include "hantek/replaydevice.h"
 #include "hantek/types.h"
 #include "helper.h"
+#include "tracing.h"
 
 namespace Hantek {
 /// \brief Initializes the command buffers and lists.
@@ -121,12 +124,36 @@ Control::Control(QObject *parent) : DsoControl(parent) {
   this->samples.resize(HANTEK_CHANNELS);
 
   this->previousSampleCount = 0;
+  this->frameRoundTrips = 0;
+  this->roundTripsPerFrame.storeRelease(0);
 
+  // Segmented memory, disabled until setHistorySize is called
+  this->historyId = 0;
+  this->historySegments = 0;
+  this->historyMemoryLimit = 0;
+  this->replayIndex.storeRelease(-1);
+
+  this->connectDeviceSignals();
+
+  // Connect plugged in devices when the thread has stopped
+  this->arrivalPending = false;
+  connect(this, SIGNAL(finished()), this, SLOT(threadFinished()));
+  this->device->startHotplug();
+}
+
+/// \brief Connects the signals of the device to the control.
+/// Plugged in devices are connected, the thread stops as soon as the device
+/// is unplugged.
+void Control::connectDeviceSignals() {
   connect(this->device, SIGNAL(disconnected()), this, SLOT(disconnectDevice()));
+  connect(this->device, SIGNAL(arrived()), this, SLOT(deviceArrived()));
+  connect(this->device, SIGNAL(unplugged()), this, SLOT(disconnectDevice()),
+          Qt::DirectConnection);
 }
 
 /// \brief Disconnects the device.
 Control::~Control() {
+  this->device->stopHotplug();
   this->device->disconnect();
 
   // Clean up commands
@@ -163,6 +190,13 @@ double Control::getMaxSamplerate() {
   return limits->max;
 }
 
+/// \brief Get the number of USB round trips the last acquisition needed.
+/// This method can be called from any thread.
+/// \return The USB transfers done between the last two received frames.
+unsigned int Control::getRoundTripsPerFrame() {
+  return this->roundTripsPerFrame.loadAcquire();
+}
+
 /// \brief Handles all USB things until the device gets disconnected.
 void Control::run() {
   // Initialize communication thread state
@@ -192,6 +226,7 @@ void Control::run() {
   this->timer = 0;
 
   emit statusMessage(tr("The device has been disconnected"), 0);
+  emit deviceDisconnected();
 }
 
 /// \brief Updates the interval of the periodic thread timer.
@@ -264,6 +299,7 @@ int Control::getCaptureState() {
 /// \brief Gets sample data from the oscilloscope and converts it.
 /// \return sample count on success, libusb error code on error.
 int Control::getSamples(bool process) {
+  Tracing::Scope span("Control::getSamples");
   int errorCode;
 
   if (this->device->getModel() != MODEL_DSO6022BE) {
@@ -291,205 +327,235 @@ int Control::getSamples(bool process) {
     this->previousSampleCount = totalSampleCount;
   }
 
-  unsigned int sampleCount = totalSampleCount;
-  if (!fastRate)
-    sampleCount /= HANTEK_CHANNELS;
   unsigned int dataLength = totalSampleCount;
   if (this->specification.sampleSize > 8)
     dataLength *= 2;
 
-  std::vector<unsigned char> data(dataLength);
-  errorCode = this->device->bulkReadMulti(data.data(), dataLength);
+  if (this->rawData.size() < dataLength)
+    this->rawData.resize(dataLength);
+  errorCode = this->device->bulkReadMulti(this->rawData.data(), dataLength);
   if (errorCode < 0)
     return errorCode;
 
   // Process the data only if we want it
   if (process) {
+    // Store the raw data with everything needed to convert it again later
+    HistorySegment segment;
+    segment.id = this->historyId++;
+    Tracing::setFrame(segment.id);
+    span.setFrame(segment.id);
+    segment.timestamp = QDateTime::currentMSecsSinceEpoch();
+    segment.samplerate = this->settings.samplerate.current;
+    segment.append = this->settings.samplerate.limits
+                         ->recordLengths[this->settings.recordLengthId] ==
+                     UINT_MAX;
+    segment.fastRate = fastRate;
+    segment.triggerPoint = this->settings.trigger.point;
+    for (int channel = 0; channel < HANTEK_CHANNELS; ++channel) {
+      segment.gain[channel] = this->settings.voltage[channel].gain;
+      segment.offsetReal[channel] = this->settings.voltage[channel].offsetReal;
+      segment.used[channel] = this->settings.voltage[channel].used;
+    }
     // How much data did we really receive?
-    dataLength = errorCode;
-    if (this->specification.sampleSize > 8)
-      totalSampleCount = dataLength / 2;
-    else
-      totalSampleCount = dataLength;
+    segment.dataLength = errorCode;
+    this->history.store(segment, this->rawData.data());
 
-    this->samplesMutex.lock();
+    this->convertSamples(segment, this->rawData.data());
 
-    // Convert channel data
-    if (fastRate) {
-      // Fast rate mode, one channel is using all buffers
-      sampleCount = totalSampleCount;
-      int channel = 0;
-      for (; channel < HANTEK_CHANNELS; ++channel) {
-        if (this->settings.voltage[channel].used)
-          break;
-      }
+    // USB transfers needed since the previous frame
+    unsigned long roundTrips = this->device->getRoundTrips();
+    this->roundTripsPerFrame.storeRelease(
+        (int)(roundTrips - this->frameRoundTrips));
+    this->frameRoundTrips = roundTrips;
+#ifdef DEBUG
+    static unsigned int id = 0;
+    ++id;
+    Helper::timestampDebug(QString("Received packet %1 after %2 round trips")
+                               .arg(id)
+                               .arg(this->roundTripsPerFrame.loadAcquire()));
+#endif
+    emit samplesAvailable(&(this->samples), segment.samplerate, segment.append,
+                          &(this->samplesMutex));
+  }
 
-      // Clear unused channels
-      for (int channelCounter = 0; channelCounter < HANTEK_CHANNELS;
-           ++channelCounter)
-        if (channelCounter != channel) {
+  return errorCode;
+}
 
-          this->samples[channelCounter].clear();
-        }
+/// \brief Converts raw data from the oscilloscope into the sample buffers.
+/// \param segment The settings that were used for the acquisition.
+/// \param data The raw data with segment.dataLength bytes.
+void Control::convertSamples(const HistorySegment &segment,
+                             const unsigned char *data) {
+  unsigned int totalSampleCount = segment.dataLength;
+  if (this->specification.sampleSize > 8)
+    totalSampleCount /= 2;
+  unsigned int sampleCount;
+
+  this->samplesMutex.lock();
+
+  // Convert channel data
+  if (segment.fastRate) {
+    // Fast rate mode, one channel is using all buffers
+    sampleCount = totalSampleCount;
+    int channel = 0;
+    for (; channel < HANTEK_CHANNELS; ++channel) {
+      if (segment.used[channel])
+        break;
+    }
 
-      if (channel < HANTEK_CHANNELS) {
+    // Clear unused channels
+    for (int channelCounter = 0; channelCounter < HANTEK_CHANNELS;
+         ++channelCounter)
+      if (channelCounter != channel) {
+
+        this->samples[channelCounter].clear();
+      }
+
+    if (channel < HANTEK_CHANNELS) {
+      // Resize sample vector
+      this->samples[channel].resize(sampleCount);
+
+      // Convert data from the oscilloscope and write it into the sample
+      // buffer
+      unsigned int bufferPosition = segment.triggerPoint * 2;
+      if (this->specification.sampleSize > 8) {
+        // Additional most significant bits after the normal data
+        unsigned int extraBitsPosition; // Track the position of the extra
+                                        // bits in the additional byte
+        unsigned int extraBitsSize =
+            this->specification.sampleSize - 8; // Number of extra bits
+        unsigned short int extraBitsMask =
+            (0x00ff << extraBitsSize) &
+            0xff00; // Mask for extra bits extraction
+
+        for (unsigned int realPosition = 0; realPosition < sampleCount;
+             ++realPosition, ++bufferPosition) {
+          if (bufferPosition >= sampleCount)
+            bufferPosition %= sampleCount;
+
+          extraBitsPosition = bufferPosition % HANTEK_CHANNELS;
+
+          this->samples[channel][realPosition] =
+              ((double)((unsigned short int)data[bufferPosition] +
+                        (((unsigned short int)
+                              data[sampleCount + bufferPosition -
+                                   extraBitsPosition]
+                          << (8 -
+                              (HANTEK_CHANNELS - 1 - extraBitsPosition) *
+                                  extraBitsSize)) &
+                         extraBitsMask)) /
+                   this->specification
+                       .voltageLimit[channel]
+                                    [segment.gain[channel]] -
+               segment.offsetReal[channel]) *
+              this->specification
+                  .gainSteps[segment.gain[channel]];
+        }
+      } else {
+        for (unsigned int realPosition = 0; realPosition < sampleCount;
+             ++realPosition, ++bufferPosition) {
+          if (bufferPosition >= sampleCount)
+            bufferPosition %= sampleCount;
+
+          double dataBuf = (double)((int)data[bufferPosition]);
+          this->samples[channel][realPosition] =
+              (dataBuf /
+                   this->specification
+                       .voltageLimit[channel]
+                                    [segment.gain[channel]] -
+               segment.offsetReal[channel]) *
+              this->specification
+                  .gainSteps[segment.gain[channel]];
+        }
+      }
+    }
+  } else {
+    // Normal mode, channels are using their separate buffers
+    sampleCount = totalSampleCount / HANTEK_CHANNELS;
+    // if device is 6022BE, drop first 1000 samples
+    if (this->device->getModel() == MODEL_DSO6022BE)
+      sampleCount -= 1000;
+    for (int channel = 0; channel < HANTEK_CHANNELS; ++channel) {
+      if (segment.used[channel]) {
         // Resize sample vector
         this->samples[channel].resize(sampleCount);
 
         // Convert data from the oscilloscope and write it into the sample
         // buffer
-        unsigned int bufferPosition = this->settings.trigger.point * 2;
+        unsigned int bufferPosition = segment.triggerPoint * 2;
         if (this->specification.sampleSize > 8) {
           // Additional most significant bits after the normal data
-          unsigned int extraBitsPosition; // Track the position of the extra
-                                          // bits in the additional byte
           unsigned int extraBitsSize =
               this->specification.sampleSize - 8; // Number of extra bits
           unsigned short int extraBitsMask =
               (0x00ff << extraBitsSize) &
               0xff00; // Mask for extra bits extraction
+          unsigned int extraBitsIndex =
+              8 -
+              channel * 2; // Bit position offset for extra bits extraction
 
           for (unsigned int realPosition = 0; realPosition < sampleCount;
-               ++realPosition, ++bufferPosition) {
-            if (bufferPosition >= sampleCount)
-              bufferPosition %= sampleCount;
-
-            extraBitsPosition = bufferPosition % HANTEK_CHANNELS;
+               ++realPosition, bufferPosition += HANTEK_CHANNELS) {
+            if (bufferPosition >= totalSampleCount)
+              bufferPosition %= totalSampleCount;
 
             this->samples[channel][realPosition] =
-                ((double)((unsigned short int)data[bufferPosition] +
+                ((double)((unsigned short int)
+                              data[bufferPosition + HANTEK_CHANNELS - 1 -
+                                   channel] +
                           (((unsigned short int)
-                                data[sampleCount + bufferPosition -
-                                     extraBitsPosition]
-                            << (8 -
-                                (HANTEK_CHANNELS - 1 - extraBitsPosition) *
-                                    extraBitsSize)) &
+                                data[totalSampleCount + bufferPosition]
+                            << extraBitsIndex) &
                            extraBitsMask)) /
                      this->specification
                          .voltageLimit[channel]
-                                      [this->settings.voltage[channel].gain] -
-                 this->settings.voltage[channel].offsetReal) *
+                                      [segment.gain[channel]] -
+                 segment.offsetReal[channel]) *
                 this->specification
-                    .gainSteps[this->settings.voltage[channel].gain];
+                    .gainSteps[segment.gain[channel]];
           }
         } else {
-          for (unsigned int realPosition = 0; realPosition < sampleCount;
-               ++realPosition, ++bufferPosition) {
-            if (bufferPosition >= sampleCount)
-              bufferPosition %= sampleCount;
+          if (this->device->getModel() == MODEL_DSO6022BE) {
+            bufferPosition += channel;
+            // if device is 6022BE, offset 1000 incrementally
+            bufferPosition += 1000 * 2;
+          } else
+            bufferPosition += HANTEK_CHANNELS - 1 - channel;
 
-            double dataBuf = (double)((int)data[bufferPosition]);
-            this->samples[channel][realPosition] =
-                (dataBuf /
-                     this->specification
-                         .voltageLimit[channel]
-                                      [this->settings.voltage[channel].gain] -
-                 this->settings.voltage[channel].offsetReal) *
-                this->specification
-                    .gainSteps[this->settings.voltage[channel].gain];
-          }
-        }
-      }
-    } else {
-      // Normal mode, channels are using their separate buffers
-      sampleCount = totalSampleCount / HANTEK_CHANNELS;
-      // if device is 6022BE, drop first 1000 samples
-      if (this->device->getModel() == MODEL_DSO6022BE)
-        sampleCount -= 1000;
-      for (int channel = 0; channel < HANTEK_CHANNELS; ++channel) {
-        if (this->settings.voltage[channel].used) {
-          // Resize sample vector
-          this->samples[channel].resize(sampleCount);
-
-          // Convert data from the oscilloscope and write it into the sample
-          // buffer
-          unsigned int bufferPosition = this->settings.trigger.point * 2;
-          if (this->specification.sampleSize > 8) {
-            // Additional most significant bits after the normal data
-            unsigned int extraBitsSize =
-                this->specification.sampleSize - 8; // Number of extra bits
-            unsigned short int extraBitsMask =
-                (0x00ff << extraBitsSize) &
-                0xff00; // Mask for extra bits extraction
-            unsigned int extraBitsIndex =
-                8 -
-                channel * 2; // Bit position offset for extra bits extraction
-
-            for (unsigned int realPosition = 0; realPosition < sampleCount;
-                 ++realPosition, bufferPosition += HANTEK_CHANNELS) {
-              if (bufferPosition >= totalSampleCount)
-                bufferPosition %= totalSampleCount;
+          for (unsigned int realPosition = 0; realPosition < sampleCount;
+               ++realPosition, bufferPosition += HANTEK_CHANNELS) {
+            if (bufferPosition >= totalSampleCount)
+              bufferPosition %= totalSampleCount;
 
+            if (this->device->getModel() == MODEL_DSO6022BE) {
+              double dataBuf = (double)((int)(data[bufferPosition] - 0x83));
               this->samples[channel][realPosition] =
-                  ((double)((unsigned short int)
-                                data[bufferPosition + HANTEK_CHANNELS - 1 -
-                                     channel] +
-                            (((unsigned short int)
-                                  data[totalSampleCount + bufferPosition]
-                              << extraBitsIndex) &
-                             extraBitsMask)) /
-                       this->specification
-                           .voltageLimit[channel]
-                                        [this->settings.voltage[channel].gain] -
-                   this->settings.voltage[channel].offsetReal) *
+                  (dataBuf /
+                   this->specification
+                       .voltageLimit[channel]
+                                    [segment.gain[channel]]) *
                   this->specification
-                      .gainSteps[this->settings.voltage[channel].gain];
-            }
-          } else {
-            if (this->device->getModel() == MODEL_DSO6022BE) {
-              bufferPosition += channel;
-              // if device is 6022BE, offset 1000 incrementally
-              bufferPosition += 1000 * 2;
-            } else
-              bufferPosition += HANTEK_CHANNELS - 1 - channel;
-
-            for (unsigned int realPosition = 0; realPosition < sampleCount;
-                 ++realPosition, bufferPosition += HANTEK_CHANNELS) {
-              if (bufferPosition >= totalSampleCount)
-                bufferPosition %= totalSampleCount;
-
-              if (this->device->getModel() == MODEL_DSO6022BE) {
-                double dataBuf = (double)((int)(data[bufferPosition] - 0x83));
-                this->samples[channel][realPosition] =
-                    (dataBuf /
-                     this->specification
-                         .voltageLimit[channel]
-                                      [this->settings.voltage[channel].gain]) *
-                    this->specification
-                        .gainSteps[this->settings.voltage[channel].gain];
-              } else {
-                double dataBuf = (double)((int)(data[bufferPosition]));
-                this->samples[channel][realPosition] =
-                    (dataBuf /
-                         this->specification.voltageLimit
-                             [channel][this->settings.voltage[channel].gain] -
-                     this->settings.voltage[channel].offsetReal) *
-                    this->specification
-                        .gainSteps[this->settings.voltage[channel].gain];
-              }
+                      .gainSteps[segment.gain[channel]];
+            } else {
+              double dataBuf = (double)((int)(data[bufferPosition]));
+              this->samples[channel][realPosition] =
+                  (dataBuf /
+                       this->specification.voltageLimit
+                           [channel][segment.gain[channel]] -
+                   segment.offsetReal[channel]) *
+                  this->specification
+                      .gainSteps[segment.gain[channel]];
             }
           }
-        } else {
-          // Clear unused channels
-          this->samples[channel].clear();
         }
+      } else {
+        // Clear unused channels
+        this->samples[channel].clear();
       }
     }
-
-    this->samplesMutex.unlock();
-#ifdef DEBUG
-    static unsigned int id = 0;
-    ++id;
-    Helper::timestampDebug(QString("Received packet %1").arg(id));
-#endif
-    emit samplesAvailable(
-        &(this->samples), this->settings.samplerate.current,
-        this->settings.samplerate.limits
-                ->recordLengths[this->settings.recordLengthId] == UINT_MAX,
-        &(this->samplesMutex));
   }
 
-  return errorCode;
+  this->samplesMutex.unlock();
 }
 
 /// \brief Calculated the nearest samplerate supported by the oscilloscope.
@@ -864,6 +930,39 @@ void Control::updateSamplerateLimits() {
           this->specification.bufferDividers[this->settings.recordLengthId]);
 }
 
+/// \brief Records all USB transfers of the device into a capture file.
+/// \param fileName The name of the capture file.
+/// \return false if the file can't be created.
+bool Control::startCapture(const QString &fileName) {
+  return this->device->startCapture(fileName);
+}
+
+/// \brief Replaces the USB device by a recorded capture.
+/// Has to be called before connectDevice().
+/// \param fileName The name of the capture file.
+/// \param realtime true to keep the recorded timing, false for maximum speed.
+void Control::useReplay(const QString &fileName, bool realtime) {
+  delete this->device;
+  this->device = new ReplayDevice(fileName, realtime, this);
+
+  this->connectDeviceSignals();
+}
+
+/// \brief Selects one of several connected oscilloscopes.
+/// Has to be called before connectDevice().
+/// \param index The position of the oscilloscope among the compatible USB
+/// devices.
+void Control::setDeviceIndex(unsigned int index) {
+  this->device->setIndex(index);
+}
+
+/// \brief Sets where the firmware for oscilloscopes without one is read from.
+/// \param directory The directory with the Intel HEX files, an empty string
+/// disables the upload.
+void Control::setFirmwareDirectory(const QString &directory) {
+  this->device->setFirmwareDirectory(directory);
+}
+
 /// \brief Try to connect to the oscilloscope.
 void Control::connectDevice() {
   int errorCode;
@@ -1180,6 +1279,38 @@ void Control::connectDevice() {
   DsoControl::connectDevice();
 }
 
+/// \brief Connects an oscilloscope that has been plugged in.
+/// Sampling continues if it was running before the device was unplugged. If
+/// the thread is still stopping, the device is connected when it finished.
+void Control::deviceArrived() {
+  if (this->isRunning()) {
+    this->arrivalPending = true;
+    return;
+  }
+  this->arrivalPending = false;
+  if (this->device->isConnected())
+    return;
+
+  if (!this->autoConnect) {
+    emit deviceAvailable();
+    return;
+  }
+
+  bool sampling = this->sampling;
+  this->connectDevice();
+  if (sampling && this->device->isConnected())
+    this->startSampling();
+}
+
+/// \brief Connects a device that arrived while the thread was stopping.
+void Control::threadFinished() {
+  if (!this->arrivalPending)
+    return;
+
+  this->wait();
+  this->deviceArrived();
+}
+
 /// \brief Sets the size of the oscilloscopes sample buffer.
 /// \param index The record length index that should be set.
 /// \return The record length that has been set, 0 on error.
@@ -1808,6 +1939,88 @@ double Control::setPretriggerPosition(double position) {
   return (double)positionSamples / this->settings.samplerate.current;
 }
 
+/// \brief Set the number of acquisitions kept in the segmented memory.
+/// \param segments The number of segments, 0 disables the history.
+/// \param memoryLimit The maximum pool size in bytes kept in RAM, 0 for no
+/// limit.
+/// \param spillFileName Template for the temporary file that is memory mapped
+/// when the pool exceeds the limit, "XXXXXX" is replaced by a unique part.
+/// The segment count is reduced instead if it's empty.
+/// \return See ::Dso::ErrorCode.
+int Control::setHistorySize(unsigned int segments, unsigned long memoryLimit,
+                            const QString &spillFileName) {
+  // Keep the stored segments if nothing has changed
+  if (segments == this->historySegments &&
+      memoryLimit == this->historyMemoryLimit &&
+      spillFileName == this->historySpillFileName)
+    return Dso::ERROR_NONE;
+
+  // Size the slots for the largest transfer, like getSampleCount() computes
+  // it: all channels in normal mode, one channel in fast rate mode
+  unsigned int segmentSize = 0;
+  QList<unsigned int> *recordLengths[] = {
+      &this->specification.samplerate.single.recordLengths,
+      &this->specification.samplerate.multi.recordLengths};
+  unsigned int channels[] = {HANTEK_CHANNELS, 1};
+  for (int mode = 0; mode < 2; ++mode) {
+    for (int id = 0; id < recordLengths[mode]->size(); ++id) {
+      if ((*recordLengths[mode])[id] != UINT_MAX)
+        segmentSize = qMax(segmentSize,
+                           (*recordLengths[mode])[id] * channels[mode]);
+    }
+  }
+  if (this->specification.sampleSize > 8)
+    segmentSize *= 2;
+
+  if (!this->history.allocate(segments, segmentSize, memoryLimit,
+                              spillFileName))
+    return Dso::ERROR_PARAMETER;
+
+  // Only remember a history that has been allocated, so a retry allocates it
+  this->historySegments = segments;
+  this->historyMemoryLimit = memoryLimit;
+  this->historySpillFileName = spillFileName;
+
+  return Dso::ERROR_NONE;
+}
+
+/// \brief Converts a stored acquisition again and sends it to the analyzer.
+/// While the control thread is running, the segment is replayed by the thread
+/// in its next cycle, so it never converts samples at the same time.
+/// \param index The age of the segment, 0 is the latest acquisition.
+/// \return See ::Dso::ErrorCode.
+int Control::replayHistory(unsigned int index) {
+  if (index >= this->history.getCount())
+    return Dso::ERROR_PARAMETER;
+
+  if (this->isRunning())
+    this->replayIndex.storeRelease((int)index);
+  else
+    this->replaySegment(index);
+
+  return Dso::ERROR_NONE;
+}
+
+/// \brief Converts a stored acquisition again and sends it to the analyzer.
+/// \param index The age of the segment, 0 is the latest acquisition.
+void Control::replaySegment(unsigned int index) {
+  HistorySegment segment;
+  if (!this->history.get(index, &segment, &this->replayData))
+    return;
+
+  this->convertSamples(segment, this->replayData.data());
+
+  emit statusMessage(
+      tr("Segment %1 of %2, acquired %3")
+          .arg(index + 1)
+          .arg(this->history.getCount())
+          .arg(QDateTime::fromMSecsSinceEpoch(segment.timestamp)
+                   .toString("hh:mm:ss.zzz")),
+      0);
+  emit samplesAvailable(&(this->samples), segment.samplerate, segment.append,
+                        &(this->samplesMutex));
+}
+
 #ifdef DEBUG
 /// \brief Sends bulk/control commands directly.
 /// <p>
@@ -1878,9 +2091,20 @@ int Control::stringCommand(QString command) {
 
 /// \brief Called periodically in the control thread by a timer.
 void Control::handler() {
+  Tracing::Scope span("Control::handler");
   int errorCode = 0;
 
-  // Send all pending bulk commands
+  // Replay a stored acquisition, one that is still in flight would replace it
+  int replay = this->replayIndex.fetchAndStoreAcquire(-1);
+  if (replay >= 0) {
+    if (!this->sampling)
+      this->samplingStarted = false;
+    this->replaySegment(replay);
+  }
+
+  // Send all pending bulk and control commands as one transaction
+  QList<bool *> queued;
+  this->device->beginTransaction();
   for (int command = 0; command < BULK_COUNT; ++command) {
     if (!this->commandPending[command])
       continue;
@@ -1892,20 +2116,10 @@ void Control::handler() {
                                  this->command[command]->getSize())));
 #endif
 
-    errorCode = this->device->bulkCommand(this->command[command]);
-    if (errorCode < 0) {
-      qWarning("Sending bulk command %02x failed: %s", command,
-               Helper::libUsbErrorString(errorCode).toLocal8Bit().data());
-
-      if (errorCode == LIBUSB_ERROR_NO_DEVICE) {
-        this->quit();
-        return;
-      }
-    } else
-      this->commandPending[command] = false;
+    this->device->queueBulkCommand(this->command[command]);
+    queued.append(&this->commandPending[command]);
   }
 
-  // Send all pending control commands
   for (int control = 0; control < CONTROLINDEX_COUNT; ++control) {
     if (!this->controlPending[control])
       continue;
@@ -1918,20 +2132,32 @@ void Control::handler() {
                                  this->control[control]->getSize())));
 #endif
 
-    errorCode = this->device->controlWrite(this->controlCode[control],
-                                           this->control[control]->data(),
-                                           this->control[control]->getSize());
+    this->device->queueControlWrite(this->controlCode[control],
+                                    this->control[control]->data(),
+                                    this->control[control]->getSize());
+    queued.append(&this->controlPending[control]);
+  }
+
+  if (!queued.isEmpty()) {
+    errorCode = this->device->commitTransaction();
+
+    // Commands that weren't sent stay pending for the next cycle
+    const QList<int> &failed = this->device->getFailed();
+    for (int index = 0; index < queued.size(); ++index) {
+      if (!failed.contains(index))
+        *queued[index] = false;
+    }
+
     if (errorCode < 0) {
-      qWarning("Sending control command %2x failed: %s",
-               this->controlCode[control],
+      qWarning("Sending %d of %d pending commands failed: %s", failed.size(),
+               queued.size(),
                Helper::libUsbErrorString(errorCode).toLocal8Bit().data());
 
       if (errorCode == LIBUSB_ERROR_NO_DEVICE) {
         this->quit();
         return;
       }
-    } else
-      this->controlPending[control] = false;
+    }
   }
 
   // State machine for the device communication
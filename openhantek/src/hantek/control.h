@@ -27,9 +27,11 @@
 #ifndef HANTEK_CONTROL_H
 #define HANTEK_CONTROL_H
 
+#include <QAtomicInt>
 #include <QMutex>
 
 #include "dsocontrol.h"
+#include "hantek/history.h"
 #include "hantek/types.h"
 #include "helper.h"
 
@@ -218,14 +220,23 @@ public:
   QList<unsigned int> *getAvailableRecordLengths();
   double getMinSamplerate();
   double getMaxSamplerate();
+  unsigned int getRoundTripsPerFrame();
+
+  bool startCapture(const QString &fileName);
+  void useReplay(const QString &fileName, bool realtime);
+  void setDeviceIndex(unsigned int index);
+  void setFirmwareDirectory(const QString &directory);
 
 protected:
   void run();
+  void connectDeviceSignals();
   void updateInterval();
 
   unsigned int calculateTriggerPoint(unsigned int value);
   int getCaptureState();
   int getSamples(bool process);
+  void convertSamples(const HistorySegment &segment, const unsigned char *data);
+  void replaySegment(unsigned int index);
   double getBestSamplerate(double samplerate, bool fastRate = false,
                            bool maximum = false, unsigned int *downsampler = 0);
   unsigned int getSampleCount(bool *fastRate = 0);
@@ -260,6 +271,18 @@ protected:
   unsigned int previousSampleCount; ///< The expected total number of samples at
                                     ///the last check before sampling started
   QMutex samplesMutex;              ///< Mutex for the sample data
+  std::vector<unsigned char> rawData; ///< Raw data of the last acquisition
+  unsigned long frameRoundTrips;   ///< Device round trips at the last frame
+  QAtomicInt roundTripsPerFrame;   ///< Round trips needed for the last frame
+
+  // Segmented memory
+  History history;                       ///< The last acquisitions
+  unsigned int historyId;                ///< Id of the next acquisition
+  unsigned int historySegments;          ///< Requested number of segments
+  unsigned long historyMemoryLimit;      ///< Pool size kept in RAM in bytes
+  QString historySpillFileName;          ///< File for the pool beyond limit
+  std::vector<unsigned char> replayData; ///< Raw data of the replayed segment
+  QAtomicInt replayIndex;                ///< Segment replayed next, -1 if none
 
   // State of the communication thread
   int captureState;
@@ -268,6 +291,7 @@ protected:
   Dso::TriggerMode lastTriggerMode;
   int cycleCounter;
   int startCycle;
+  bool arrivalPending; ///< A device arrived while the thread was stopping
 
 public slots:
   virtual void connectDevice();
@@ -288,12 +312,18 @@ public slots:
   double setPretriggerPosition(double position);
   int forceTrigger();
 
+  int setHistorySize(unsigned int segments, unsigned long memoryLimit = 0,
+                     const QString &spillFileName = QString());
+  int replayHistory(unsigned int index);
+
 #ifdef DEBUG
   int stringCommand(QString command);
 #endif
 
 protected slots:
   void handler();
+  void deviceArrived();
+  void threadFinished();
 };
 }
 
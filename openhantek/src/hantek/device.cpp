@@ -23,14 +23,47 @@
 //
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <cstring>
+
+#include <QElapsedTimer>
 #include <QList>
+#include <QTimer>
 
 #include "hantek/device.h"
 
+#include "counters.h"
 #include "hantek/types.h"
 #include "helper.h"
 
 namespace Hantek {
+////////////////////////////////////////////////////////////////////////////////
+// class Hantek::EventThread
+/// \brief Prepares the thread, start() begins to handle the events.
+/// \param context The libusb context whose events should be handled.
+/// \param parent The parent object.
+EventThread::EventThread(libusb_context *context, QObject *parent)
+    : QThread(parent) {
+  this->context = context;
+  this->running.storeRelease(1);
+}
+
+/// \brief Stops handling events and waits until the thread has finished.
+void EventThread::stop() {
+  this->running.storeRelease(0);
+  this->wait();
+}
+
+/// \brief Handles events until stop() is called.
+void EventThread::run() {
+  while (this->running.loadAcquire()) {
+    // The timeout limits the time stop() has to wait for the thread
+    timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = HANTEK_HOTPLUG_INTERVAL * 1000;
+    libusb_handle_events_timeout_completed(this->context, &timeout, 0);
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // class Hantek::Device
 /// \brief Initializes the usb things and lists.
@@ -44,6 +77,14 @@ Device::Device(QObject *parent) : QObject(parent) {
                      << "DSO-5200"
                      << "DSO-5200A"
                      << "DSO-6022BE";
+  this->firmwareNames << "dso2090x86"
+                      << "dso2150x86"
+                      << "dso2250x86"
+                      << "dso5200x86"
+                      << "dso5200ax86"
+                      << "dso6022be";
+  this->firmwareUploaded = 0;
+  this->index = 0;
   this->model = MODEL_UNKNOWN;
 
   this->beginCommandControl = new ControlBeginCommand();
@@ -53,15 +94,49 @@ Device::Device(QObject *parent) : QObject(parent) {
 
   this->outPacketLength = 0;
   this->inPacketLength = 0;
+  this->connectionSpeed = -1;
+  this->roundTrips = 0;
+
+  this->transactionCommands = 0;
+
+  this->capture = 0;
+
+  this->eventThread = 0;
+  this->usbDevice = 0;
+  this->arrival = 0;
+  this->removed.storeRelease(0);
 
   this->error = LIBUSB_SUCCESS;
   this->error = libusb_init(&(this->context));
 }
 
 /// \brief Disconnects the device.
-Device::~Device() { this->disconnect(); }
+Device::~Device() {
+  this->stopHotplug();
+  this->disconnect();
+  this->stopCapture();
+}
+
+/// \brief Selects which of several compatible devices search() connects.
+/// \param index The position of the device in the USB device list, 0 for the
+/// first one.
+void Device::setIndex(unsigned int index) { this->index = index; }
+
+/// \brief Sets where search() gets the firmware for devices without one.
+/// The directory contains the Intel HEX files of the firmware directory of
+/// the source tree, ":/firmware" has the ones built into the program. The
+/// upload is disabled by default, so it doesn't race with the udev rules.
+/// \param directory The directory or Qt resource path of the HEX files, an
+/// empty string disables the upload.
+void Device::setFirmwareDirectory(const QString &directory) {
+  this->firmwareDirectory = directory;
+}
 
 /// \brief Search for compatible devices.
+/// A device announced by the hotplug callback is opened directly, otherwise
+/// all USB devices are enumerated. If no oscilloscope is found, the firmware
+/// is uploaded to the devices that don't have one yet. They are connected by
+/// a later search when they have reconnected as oscilloscopes.
 /// \return A string with the result of the search.
 QString Device::search() {
   if (this->error)
@@ -69,116 +144,349 @@ QString Device::search() {
         .arg(Helper::libUsbErrorString(this->error));
 
   QString message;
-  QString deviceAddress;
-  int errorCode = LIBUSB_SUCCESS;
-
-  libusb_device **deviceList;
-  libusb_device *device;
 
-  if (this->handle)
+  if (this->handle) {
     libusb_close(this->handle);
+    this->handle = 0;
+  }
+  this->connectionSpeed = -1;
+  this->model = MODEL_UNKNOWN;
+
+  QElapsedTimer timer;
+  this->hotplugMutex.lock();
+  libusb_device *arrival = this->arrival;
+  this->arrival = 0;
+  this->hotplugMutex.unlock();
+  if (arrival) {
+    timer.start();
+    message = this->open(arrival);
+    libusb_unref_device(arrival);
+    if (this->handle)
+      return this->firmwareSummary(message, timer.elapsed());
+  }
 
+  libusb_device **deviceList;
   ssize_t deviceCount = libusb_get_device_list(this->context, &deviceList);
   if (deviceCount < 0)
     return tr("Failed to get device list: %1")
-        .arg(Helper::libUsbErrorString(errorCode));
+        .arg(Helper::libUsbErrorString(deviceCount));
+
+  unsigned int compatible;
+  libusb_device *device = this->find(deviceList, deviceCount, &compatible);
+
+  // Devices without firmware reconnect as oscilloscopes after the upload
+  if (!device && !this->firmwareDirectory.isEmpty()) {
+    QString error;
+    FirmwareTiming timing;
+    unsigned int uploaded =
+        this->uploadFirmware(deviceList, deviceCount, &timing, &error);
+    if (!error.isEmpty()) {
+      libusb_free_device_list(deviceList, true);
+      return error;
+    }
+    if (uploaded) {
+      libusb_free_device_list(deviceList, true);
+      this->firmwareUploaded = uploaded;
+      this->firmwareTiming = timing;
+      this->reconnectionTimer.start();
+      this->waitForReconnection();
+      return tr("Firmware uploaded to %1 device(s), waiting until they "
+                "reconnect")
+          .arg(uploaded);
+    }
+  }
+
+  if (device) {
+    timer.start();
+    message = this->open(device);
+    message = this->firmwareSummary(message, timer.elapsed());
+  } else if (this->firmwareUploaded &&
+             this->reconnectionTimer.elapsed() < HANTEK_RENUMERATION_TIMEOUT) {
+    this->waitForReconnection();
+    message = tr("Waiting until the Hantek oscilloscope reconnects after the "
+                 "firmware upload");
+  } else if (this->firmwareUploaded) {
+    message = tr("Hantek oscilloscope didn't reconnect within %1 ms after "
+                 "the firmware upload")
+                  .arg(this->reconnectionTimer.elapsed());
+    this->firmwareUploaded = 0;
+  } else if (this->index)
+    message = tr("Hantek oscilloscope %1 not found, %2 connected")
+                  .arg(this->index + 1)
+                  .arg(compatible);
+  else
+    message = tr("No Hantek oscilloscope found");
+
+  libusb_free_device_list(deviceList, true);
+
+  return message;
+}
+
+/// \brief Finds the selected oscilloscope in a USB device list.
+/// \param deviceList The list of all USB devices.
+/// \param deviceCount The number of devices in the list.
+/// \param compatible Receives the number of compatible devices in the list.
+/// \return The device setIndex() selected, null if it's not in the list.
+libusb_device *Device::find(libusb_device **deviceList, ssize_t deviceCount,
+                            unsigned int *compatible) {
+  libusb_device *device = 0;
 
   // Iterate through all usb devices
-  this->model = MODEL_UNKNOWN;
+  *compatible = 0;
   for (ssize_t deviceIterator = 0; deviceIterator < deviceCount;
        ++deviceIterator) {
-    device = deviceList[deviceIterator];
     // Get device descriptor
-    if (libusb_get_device_descriptor(device, &(this->descriptor)) < 0)
+    libusb_device_descriptor descriptor;
+    if (libusb_get_device_descriptor(deviceList[deviceIterator], &descriptor) <
+        0)
       continue;
 
     // Check VID and PID
-    if (this->descriptor.idVendor == HANTEK_VENDOR_ID) {
-      this->model = (Model)this->modelIds.indexOf(this->descriptor.idProduct);
-      if (this->model >= 0)
-        break; // Found a compatible device, ignore others
-    }
+    if (descriptor.idVendor != HANTEK_VENDOR_ID ||
+        !this->modelIds.contains(descriptor.idProduct))
+      continue;
+    // Skip the compatible devices before the selected one
+    if ((*compatible)++ == this->index)
+      device = deviceList[deviceIterator];
   }
 
-  if (this->model >= 0) {
-    // Open device
-    deviceAddress =
-        QString("%1:%2")
-            .arg(libusb_get_bus_number(device), 3, 10, QLatin1Char('0'))
-            .arg(libusb_get_device_address(device), 3, 10, QLatin1Char('0'));
-    errorCode = libusb_open(device, &(this->handle));
-    if (errorCode == LIBUSB_SUCCESS) {
-      libusb_config_descriptor *configDescriptor;
-      const libusb_interface *interface;
-      const libusb_interface_descriptor *interfaceDescriptor;
-
-      // Search for the needed interface
-      libusb_get_config_descriptor(device, 0, &configDescriptor);
-      for (int interfaceIndex = 0;
-           interfaceIndex < (int)configDescriptor->bNumInterfaces;
-           ++interfaceIndex) {
-        interface = &configDescriptor->interface[interfaceIndex];
-        if (interface->num_altsetting < 1)
-          continue;
-
-        interfaceDescriptor = &interface->altsetting[0];
-        if (interfaceDescriptor->bInterfaceClass == LIBUSB_CLASS_VENDOR_SPEC &&
-            interfaceDescriptor->bInterfaceSubClass == 0 &&
-            interfaceDescriptor->bInterfaceProtocol == 0 &&
-            interfaceDescriptor->bNumEndpoints == 2) {
-          // That's the interface we need, claim it
-          errorCode = libusb_claim_interface(
-              this->handle, interfaceDescriptor->bInterfaceNumber);
-          if (errorCode < 0) {
-            libusb_close(this->handle);
-            this->handle = 0;
-            message =
-                tr("Failed to claim interface %1 of device %2: %3")
-                    .arg(QString::number(interfaceDescriptor->bInterfaceNumber),
-                         deviceAddress, Helper::libUsbErrorString(errorCode));
-          } else {
-            this->interface = interfaceDescriptor->bInterfaceNumber;
-
-            // Check the maximum endpoint packet size
-            const libusb_endpoint_descriptor *endpointDescriptor;
-            this->outPacketLength = 0;
-            this->inPacketLength = 0;
-            for (int endpoint = 0;
-                 endpoint < interfaceDescriptor->bNumEndpoints; ++endpoint) {
-              endpointDescriptor = &(interfaceDescriptor->endpoint[endpoint]);
-              switch (endpointDescriptor->bEndpointAddress) {
-              case HANTEK_EP_OUT:
-                this->outPacketLength = endpointDescriptor->wMaxPacketSize;
-                break;
-              case HANTEK_EP_IN:
-                if (this->getModel() == MODEL_DSO6022BE)
-                  this->inPacketLength = 16384;
-                else
-                  this->inPacketLength = endpointDescriptor->wMaxPacketSize;
-                break;
-              }
+  return device;
+}
+
+/// \brief Opens a compatible device and claims its interface.
+/// \param device The USB device, it has to be one of the supported models.
+/// \return A string with the result of the connection attempt.
+QString Device::open(libusb_device *device) {
+  QString message;
+  QString deviceAddress =
+      QString("%1:%2")
+          .arg(libusb_get_bus_number(device), 3, 10, QLatin1Char('0'))
+          .arg(libusb_get_device_address(device), 3, 10, QLatin1Char('0'));
+
+  int errorCode = libusb_get_device_descriptor(device, &(this->descriptor));
+  if (errorCode < 0)
+    return tr("Couldn't open device %1: %2")
+        .arg(deviceAddress, Helper::libUsbErrorString(errorCode));
+  this->model = (Model)this->modelIds.indexOf(this->descriptor.idProduct);
+
+  // Open device
+  errorCode = libusb_open(device, &(this->handle));
+  if (errorCode == LIBUSB_SUCCESS) {
+    libusb_config_descriptor *configDescriptor;
+    const libusb_interface *interface;
+    const libusb_interface_descriptor *interfaceDescriptor;
+
+    // Search for the needed interface
+    libusb_get_config_descriptor(device, 0, &configDescriptor);
+    for (int interfaceIndex = 0;
+         interfaceIndex < (int)configDescriptor->bNumInterfaces;
+         ++interfaceIndex) {
+      interface = &configDescriptor->interface[interfaceIndex];
+      if (interface->num_altsetting < 1)
+        continue;
+
+      interfaceDescriptor = &interface->altsetting[0];
+      if (interfaceDescriptor->bInterfaceClass == LIBUSB_CLASS_VENDOR_SPEC &&
+          interfaceDescriptor->bInterfaceSubClass == 0 &&
+          interfaceDescriptor->bInterfaceProtocol == 0 &&
+          interfaceDescriptor->bNumEndpoints == 2) {
+        // That's the interface we need, claim it
+        errorCode = libusb_claim_interface(
+            this->handle, interfaceDescriptor->bInterfaceNumber);
+        if (errorCode < 0) {
+          libusb_close(this->handle);
+          this->handle = 0;
+          message =
+              tr("Failed to claim interface %1 of device %2: %3")
+                  .arg(QString::number(interfaceDescriptor->bInterfaceNumber),
+                       deviceAddress, Helper::libUsbErrorString(errorCode));
+        } else {
+          this->interface = interfaceDescriptor->bInterfaceNumber;
+
+          // Let the hotplug callback recognize the removal of this device
+          this->hotplugMutex.lock();
+          this->usbDevice = device;
+          this->hotplugMutex.unlock();
+          this->removed.storeRelease(0);
+
+          // Check the maximum endpoint packet size
+          const libusb_endpoint_descriptor *endpointDescriptor;
+          this->outPacketLength = 0;
+          this->inPacketLength = 0;
+          for (int endpoint = 0; endpoint < interfaceDescriptor->bNumEndpoints;
+               ++endpoint) {
+            endpointDescriptor = &(interfaceDescriptor->endpoint[endpoint]);
+            switch (endpointDescriptor->bEndpointAddress) {
+            case HANTEK_EP_OUT:
+              this->outPacketLength = endpointDescriptor->wMaxPacketSize;
+              break;
+            case HANTEK_EP_IN:
+              if (this->getModel() == MODEL_DSO6022BE)
+                this->inPacketLength = 16384;
+              else
+                this->inPacketLength = endpointDescriptor->wMaxPacketSize;
+              break;
             }
-            message = tr("Device found: Hantek %1 (%2)")
-                          .arg(this->modelStrings[this->model], deviceAddress);
-            emit connected();
           }
+          message = tr("Device found: Hantek %1 (%2)")
+                        .arg(this->modelStrings[this->model], deviceAddress);
+          if (!this->captureFileName.isEmpty() && !this->createCapture())
+            message += ", " + tr("can't create capture %1")
+                                  .arg(this->captureFileName);
+          emit connected();
         }
       }
-
-      libusb_free_config_descriptor(configDescriptor);
-    } else {
-      this->handle = 0;
-      message = tr("Couldn't open device %1: %2")
-                    .arg(deviceAddress, Helper::libUsbErrorString(errorCode));
     }
-  } else
-    message = tr("No Hantek oscilloscope found");
 
-  libusb_free_device_list(deviceList, true);
+    libusb_free_config_descriptor(configDescriptor);
+  } else {
+    this->handle = 0;
+    message = tr("Couldn't open device %1: %2")
+                  .arg(deviceAddress, Helper::libUsbErrorString(errorCode));
+  }
 
   return message;
 }
 
+/// \brief Uploads the firmware to all compatible devices without firmware.
+/// \param deviceList The list of all USB devices.
+/// \param deviceCount The number of devices in the list.
+/// \param timing The durations of the phases are added to it.
+/// \param error Receives the error message if an upload failed.
+/// \return The number of devices that got their firmware.
+unsigned int Device::uploadFirmware(libusb_device **deviceList,
+                                    ssize_t deviceCount, FirmwareTiming *timing,
+                                    QString *error) {
+  unsigned int uploaded = 0;
+  for (ssize_t deviceIterator = 0; deviceIterator < deviceCount;
+       ++deviceIterator) {
+    libusb_device_descriptor descriptor;
+    if (libusb_get_device_descriptor(deviceList[deviceIterator], &descriptor) <
+        0)
+      continue;
+
+    // Other FX2 boards use the generic id 0x8613 too, it's left to udev
+    if (descriptor.idVendor != EZUSB_VENDOR_ID ||
+        !this->modelIds.contains(descriptor.idProduct))
+      continue;
+
+    *error = this->uploadFirmware(deviceList[deviceIterator], timing);
+    if (!error->isEmpty())
+      break;
+    ++uploaded;
+  }
+
+  return uploaded;
+}
+
+/// \brief Uploads the firmware to a device without firmware.
+/// Does the same as "fxload -t fx2 -s loader -I firmware", but the loader is
+/// only used if the firmware has data outside of the internal RAM. The
+/// device disconnects when the firmware starts and reconnects with the
+/// Hantek vendor id.
+/// \param device The USB device with the EZUSB_VENDOR_ID.
+/// \param timing The durations of the phases are added to it.
+/// \return An error message, empty on success.
+QString Device::uploadFirmware(libusb_device *device, FirmwareTiming *timing) {
+  QElapsedTimer timer;
+  timer.start();
+
+  libusb_device_descriptor descriptor;
+  int errorCode = libusb_get_device_descriptor(device, &descriptor);
+  if (errorCode < 0)
+    return tr("Can't upload the firmware: %1")
+        .arg(Helper::libUsbErrorString(errorCode));
+  int model = this->modelIds.indexOf(descriptor.idProduct);
+  QString fileName = this->firmwareDirectory + "/" + this->firmwareNames[model];
+
+  Firmware firmware, loader;
+  if (!firmware.load(fileName + "-firmware.hex"))
+    return firmware.getErrorString();
+  bool useLoader = firmware.needsLoader();
+  if (useLoader && !loader.load(fileName + "-loader.hex"))
+    return loader.getErrorString();
+  timing->parse += timer.restart();
+
+  libusb_device_handle *handle;
+  errorCode = libusb_open(device, &handle);
+  if (errorCode < 0)
+    return tr("Couldn't open the %1 for the firmware upload: %2")
+        .arg(this->modelStrings[model], Helper::libUsbErrorString(errorCode));
+
+  // The chip writes the internal RAM itself while the CPU is halted
+  if (useLoader) {
+    errorCode = this->resetCpu(handle, true);
+    if (errorCode >= 0)
+      errorCode = this->writeFirmware(handle, loader, true);
+    if (errorCode >= 0)
+      errorCode = this->resetCpu(handle, false);
+    if (errorCode >= 0)
+      errorCode = this->writeFirmware(handle, firmware, false);
+    timing->loader += timer.restart();
+  }
+  if (errorCode >= 0)
+    errorCode = this->resetCpu(handle, true);
+  if (errorCode >= 0)
+    errorCode = this->writeFirmware(handle, firmware, true);
+  if (errorCode >= 0) {
+    // The device may be gone as soon as the firmware is running
+    errorCode = this->resetCpu(handle, false);
+    if (errorCode == LIBUSB_ERROR_NO_DEVICE)
+      errorCode = LIBUSB_SUCCESS;
+  }
+  timing->firmware += timer.restart();
+
+  libusb_close(handle);
+
+  if (errorCode < 0)
+    return tr("Firmware upload to the %1 failed: %2")
+        .arg(this->modelStrings[model], Helper::libUsbErrorString(errorCode));
+  return QString();
+}
+
+/// \brief Writes the segments of a firmware into the RAM of the EZ-USB chip.
+/// \param handle The handle of the device without firmware.
+/// \param firmware The firmware that should be written.
+/// \param internal true to write the segments in the internal RAM with the
+/// request of the chip, false to write the other ones with the loader.
+/// \return 0 on success, libusb error code on error.
+int Device::writeFirmware(libusb_device_handle *handle,
+                          const Firmware &firmware, bool internal) {
+  const QList<FirmwareSegment> &segments = firmware.getSegments();
+  for (int segment = 0; segment < segments.size(); ++segment) {
+    const FirmwareSegment &current = segments[segment];
+    if (current.isInternal() != internal)
+      continue;
+    // The address is sent as the 16 bit value of the request
+    if (current.address + current.data.size() > 0x10000)
+      return LIBUSB_ERROR_INVALID_PARAM;
+
+    int errorCode = libusb_control_transfer(
+        handle, LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_ENDPOINT_OUT,
+        internal ? EZUSB_REQUEST_INTERNAL : EZUSB_REQUEST_EXTERNAL,
+        current.address, 0, (unsigned char *)current.data.constData(),
+        current.data.size(), HANTEK_TIMEOUT);
+    if (errorCode < 0)
+      return errorCode;
+  }
+
+  return LIBUSB_SUCCESS;
+}
+
+/// \brief Halts or starts the CPU of the EZ-USB chip.
+/// \param handle The handle of the device without firmware.
+/// \param reset true to halt the CPU, false to run the code in the RAM.
+/// \return 0 on success, libusb error code on error.
+int Device::resetCpu(libusb_device_handle *handle, bool reset) {
+  unsigned char value = reset ? 1 : 0;
+  int errorCode = libusb_control_transfer(
+      handle, LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_ENDPOINT_OUT,
+      EZUSB_REQUEST_INTERNAL, EZUSB_CPUCS, 0, &value, 1, HANTEK_TIMEOUT);
+  if (errorCode < 0)
+    return errorCode;
+  return LIBUSB_SUCCESS;
+}
+
 /// \brief Disconnect the device.
 void Device::disconnect() {
   if (!this->handle)
@@ -191,14 +499,230 @@ void Device::disconnect() {
   // Close device handle
   libusb_close(this->handle);
   this->handle = 0;
+  this->connectionSpeed = -1;
+
+  this->hotplugMutex.lock();
+  this->usbDevice = 0;
+  this->hotplugMutex.unlock();
 
   emit disconnected();
 }
 
+/// \brief Adds the duration of the firmware upload to a connection message.
+/// \param message The result of open().
+/// \param connection The time open() took in ms.
+/// \return The message, with the timing if the device reconnected after an
+/// upload.
+QString Device::firmwareSummary(const QString &message, qint64 connection) {
+  if (!this->handle || !this->firmwareUploaded)
+    return message;
+
+  this->firmwareTiming.enumeration =
+      this->reconnectionTimer.elapsed() - connection;
+  this->firmwareTiming.connection = connection;
+  QString summary =
+      message + ", " + tr("firmware uploaded to %1 device(s) (parsing %2 "
+                          "ms, loader %3 ms, firmware %4 ms, reconnection "
+                          "%5 ms, connection %6 ms)")
+                           .arg(this->firmwareUploaded)
+                           .arg(this->firmwareTiming.parse)
+                           .arg(this->firmwareTiming.loader)
+                           .arg(this->firmwareTiming.firmware)
+                           .arg(this->firmwareTiming.enumeration)
+                           .arg(this->firmwareTiming.connection);
+  this->firmwareUploaded = 0;
+
+  return summary;
+}
+
+/// \brief Lets the next search() run when the flashed devices reconnect.
+/// The hotplug callback emits arrived() when they are back. Without hotplug
+/// support, arrived() is emitted after a short delay instead, the search
+/// repeats this until the devices are back or the timeout expired.
+void Device::waitForReconnection() {
+  if (this->eventThread)
+    return;
+
+  QTimer::singleShot(HANTEK_RENUMERATION_INTERVAL, this, SIGNAL(arrived()));
+}
+
+/// \brief Handles plugged in and unplugged devices as soon as libusb notices.
+/// A compatible device that is plugged in while none is connected emits
+/// arrived() and is opened by the next search() without an enumeration. The
+/// removal of the connected device emits unplugged() and lets all following
+/// transfers fail immediately instead of waiting for their timeouts. Devices
+/// without firmware emit arrived() too, search() uploads the firmware.
+/// \return false if libusb has no hotplug support on this platform.
+bool Device::startHotplug() {
+  if (this->eventThread)
+    return true;
+  if (this->error || !libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG))
+    return false;
+
+  int errorCode = libusb_hotplug_register_callback(
+      this->context,
+      (libusb_hotplug_event)(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED |
+                             LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
+      (libusb_hotplug_flag)0, LIBUSB_HOTPLUG_MATCH_ANY,
+      LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+      Device::hotplugCallback, this, &(this->hotplugHandle));
+  if (errorCode != LIBUSB_SUCCESS)
+    return false;
+
+  this->eventThread = new EventThread(this->context, this);
+  this->eventThread->start();
+
+  return true;
+}
+
+/// \brief Stops handling plugged in and unplugged devices.
+void Device::stopHotplug() {
+  if (!this->eventThread)
+    return;
+
+  libusb_hotplug_deregister_callback(this->context, this->hotplugHandle);
+  this->eventThread->stop();
+  delete this->eventThread;
+  this->eventThread = 0;
+
+  if (this->arrival) {
+    libusb_unref_device(this->arrival);
+    this->arrival = 0;
+  }
+}
+
+/// \brief Handles a hotplug event in the event thread.
+/// \param context The libusb context of the device.
+/// \param device The device that has been plugged in or unplugged.
+/// \param event The kind of the event.
+/// \param userData The Device that registered the callback.
+/// \return 0 to stay registered.
+int LIBUSB_CALL Device::hotplugCallback(libusb_context *context,
+                                        libusb_device *device,
+                                        libusb_hotplug_event event,
+                                        void *userData) {
+  Q_UNUSED(context);
+
+  Device *owner = (Device *)userData;
+
+  if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT) {
+    owner->hotplugMutex.lock();
+    bool opened = device == owner->usbDevice;
+    if (opened)
+      owner->removed.storeRelease(1);
+    owner->hotplugMutex.unlock();
+
+    if (opened)
+      emit owner->unplugged();
+    return 0;
+  }
+
+  libusb_device_descriptor descriptor;
+  if (libusb_get_device_descriptor(device, &descriptor) < 0 ||
+      !owner->modelIds.contains(descriptor.idProduct))
+    return 0;
+  // Devices without firmware get it from the next search()
+  bool flashed = descriptor.idVendor == HANTEK_VENDOR_ID;
+  if (!flashed && descriptor.idVendor != EZUSB_VENDOR_ID)
+    return 0;
+
+  // Only the first compatible device can be opened without enumeration, the
+  // unplugged device is still set until the control thread has stopped
+  owner->hotplugMutex.lock();
+  bool waiting = !owner->usbDevice || owner->removed.loadAcquire();
+  if (waiting && flashed && !owner->index) {
+    if (owner->arrival)
+      libusb_unref_device(owner->arrival);
+    owner->arrival = libusb_ref_device(device);
+  }
+  owner->hotplugMutex.unlock();
+
+  if (waiting)
+    emit owner->arrived();
+  return 0;
+}
+
 /// \brief Check if the oscilloscope is connected.
 /// \return true, if a connection is up.
 bool Device::isConnected() { return this->handle != 0; }
 
+/// \brief Record all following USB transfers into a capture file.
+/// The file is created when the device is connected, it can be replayed with
+/// the ReplayDevice.
+/// \param fileName The name of the capture file.
+/// \return false if the device is connected and the file can't be created.
+bool Device::startCapture(const QString &fileName) {
+  this->stopCapture();
+
+  this->captureFileName = fileName;
+  if (this->isConnected())
+    return this->createCapture();
+
+  return true;
+}
+
+/// \brief Stop recording the USB transfers.
+void Device::stopCapture() {
+  this->captureFileName.clear();
+  if (this->capture) {
+    delete this->capture;
+    this->capture = 0;
+  }
+}
+
+/// \brief Creates the capture file for the connected device.
+/// \return true if the file was created.
+bool Device::createCapture() {
+  if (!this->capture)
+    this->capture = new CaptureFile();
+
+  CaptureHeader header;
+  header.model = this->model;
+  header.outPacketLength = this->outPacketLength;
+  header.inPacketLength = this->inPacketLength;
+  if (this->capture->create(this->captureFileName, header))
+    return true;
+
+  delete this->capture;
+  this->capture = 0;
+  return false;
+}
+
+/// \brief Appends a finished transfer to the capture.
+/// \param kind The type of the transfer.
+/// \param endpoint The bulk endpoint or the control request type.
+/// \param request The control request.
+/// \param value The control value.
+/// \param index The control index.
+/// \param data The transferred data.
+/// \param length The requested length.
+/// \param result Number of transferred bytes or the libusb error code.
+void Device::recordTransfer(CaptureKind kind, unsigned char endpoint,
+                            unsigned char request, int value, int index,
+                            const unsigned char *data, unsigned int length,
+                            int result) {
+  CaptureTransfer transfer;
+  transfer.kind = kind;
+  transfer.endpoint = endpoint;
+  transfer.request = request;
+  transfer.value = value;
+  transfer.index = index;
+  transfer.length = length;
+  transfer.result = result;
+
+  // Received data is only valid up to the transferred length
+  unsigned int dataLength = length;
+  if (transfer.isInput())
+    dataLength = result > 0 ? qMin((unsigned int)result, length) : 0;
+  if (data && dataLength > 0)
+    transfer.data = QByteArray((const char *)data, dataLength);
+
+  if (!this->capture->write(&transfer)) {
+    delete this->capture;
+    this->capture = 0;
+  }
+}
+
 /// \brief Bulk transfer to/from the oscilloscope.
 /// \param endpoint Endpoint number, also sets the direction of the transfer.
 /// \param data Buffer for the sent/recieved data.
@@ -209,16 +733,37 @@ bool Device::isConnected() { return this->handle != 0; }
 int Device::bulkTransfer(unsigned char endpoint, unsigned char *data,
                          unsigned int length, int attempts,
                          unsigned int timeout) {
-  if (!this->handle)
+  if (!this->isConnected())
     return LIBUSB_ERROR_NO_DEVICE;
 
   int errorCode = LIBUSB_ERROR_TIMEOUT;
   int transferred;
   for (int attempt = 0; (attempt < attempts || attempts == -1) &&
                         errorCode == LIBUSB_ERROR_TIMEOUT;
-       ++attempt)
+       ++attempt) {
+    // Don't wait for the timeouts of an unplugged device
+    if (this->removed.loadAcquire()) {
+      errorCode = LIBUSB_ERROR_NO_DEVICE;
+      break;
+    }
+
+    if (attempt > 0)
+      Counters::add(Counters::USB_RETRIES);
+    ++this->roundTrips;
+    Counters::add(Counters::USB_TRANSFERS);
     errorCode = libusb_bulk_transfer(this->handle, endpoint, data, length,
                                      &transferred, timeout);
+    if (errorCode == LIBUSB_ERROR_TIMEOUT)
+      Counters::add(Counters::USB_TIMEOUTS);
+  }
+
+  if (this->capture)
+    this->recordTransfer(CAPTURE_BULK, endpoint, 0, 0, 0, data, length,
+                         errorCode < 0 ? errorCode : transferred);
+  if (errorCode >= 0)
+    Counters::add((endpoint & LIBUSB_ENDPOINT_IN) ? Counters::USB_BYTES_IN
+                                                  : Counters::USB_BYTES_OUT,
+                  transferred);
 
   if (errorCode == LIBUSB_ERROR_NO_DEVICE)
     this->disconnect();
@@ -234,7 +779,7 @@ int Device::bulkTransfer(unsigned char endpoint, unsigned char *data,
 /// \param attempts The number of attempts, that are done on timeouts.
 /// \return Number of sent bytes on success, libusb error code on error.
 int Device::bulkWrite(unsigned char *data, unsigned int length, int attempts) {
-  if (!this->handle)
+  if (!this->isConnected())
     return LIBUSB_ERROR_NO_DEVICE;
 
   int errorCode = this->getConnectionSpeed();
@@ -250,7 +795,7 @@ int Device::bulkWrite(unsigned char *data, unsigned int length, int attempts) {
 /// \param attempts The number of attempts, that are done on timeouts.
 /// \return Number of received bytes on success, libusb error code on error.
 int Device::bulkRead(unsigned char *data, unsigned int length, int attempts) {
-  if (!this->handle)
+  if (!this->isConnected())
     return LIBUSB_ERROR_NO_DEVICE;
 
   int errorCode = this->getConnectionSpeed();
@@ -266,7 +811,7 @@ int Device::bulkRead(unsigned char *data, unsigned int length, int attempts) {
 /// \return Number of sent bytes on success, libusb error code on error.
 int Device::bulkCommand(Helper::DataArray<unsigned char> *command,
                         int attempts) {
-  if (!this->handle)
+  if (!this->isConnected())
     return LIBUSB_ERROR_NO_DEVICE;
 
   // don't send bulk command if dso6022be
@@ -291,7 +836,7 @@ int Device::bulkCommand(Helper::DataArray<unsigned char> *command,
 /// \return Number of received bytes on success, libusb error code on error.
 int Device::bulkReadMulti(unsigned char *data, unsigned int length,
                           int attempts) {
-  if (!this->handle)
+  if (!this->isConnected())
     return LIBUSB_ERROR_NO_DEVICE;
 
   int errorCode = 0;
@@ -330,15 +875,34 @@ int Device::bulkReadMulti(unsigned char *data, unsigned int length,
 int Device::controlTransfer(unsigned char type, unsigned char request,
                             unsigned char *data, unsigned int length, int value,
                             int index, int attempts) {
-  if (!this->handle)
+  if (!this->isConnected())
     return LIBUSB_ERROR_NO_DEVICE;
 
   int errorCode = LIBUSB_ERROR_TIMEOUT;
   for (int attempt = 0; (attempt < attempts || attempts == -1) &&
                         errorCode == LIBUSB_ERROR_TIMEOUT;
-       ++attempt)
+       ++attempt) {
+    if (this->removed.loadAcquire()) {
+      errorCode = LIBUSB_ERROR_NO_DEVICE;
+      break;
+    }
+    if (attempt > 0)
+      Counters::add(Counters::USB_RETRIES);
+    ++this->roundTrips;
+    Counters::add(Counters::USB_TRANSFERS);
     errorCode = libusb_control_transfer(this->handle, type, request, value,
                                         index, data, length, HANTEK_TIMEOUT);
+    if (errorCode == LIBUSB_ERROR_TIMEOUT)
+      Counters::add(Counters::USB_TIMEOUTS);
+  }
+
+  if (this->capture)
+    this->recordTransfer(CAPTURE_CONTROL, type, request, value, index, data,
+                         length, errorCode);
+  if (errorCode >= 0)
+    Counters::add((type & LIBUSB_ENDPOINT_IN) ? Counters::USB_BYTES_IN
+                                              : Counters::USB_BYTES_OUT,
+                  errorCode);
 
   if (errorCode == LIBUSB_ERROR_NO_DEVICE)
     this->disconnect();
@@ -356,7 +920,7 @@ int Device::controlTransfer(unsigned char type, unsigned char request,
 int Device::controlWrite(unsigned char request, unsigned char *data,
                          unsigned int length, int value, int index,
                          int attempts) {
-  if (!this->handle)
+  if (!this->isConnected())
     return LIBUSB_ERROR_NO_DEVICE;
 
   return this->controlTransfer(LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_ENDPOINT_OUT,
@@ -374,16 +938,273 @@ int Device::controlWrite(unsigned char request, unsigned char *data,
 int Device::controlRead(unsigned char request, unsigned char *data,
                         unsigned int length, int value, int index,
                         int attempts) {
-  if (!this->handle)
+  if (!this->isConnected())
     return LIBUSB_ERROR_NO_DEVICE;
 
   return this->controlTransfer(LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_ENDPOINT_IN,
                                request, data, length, value, index, attempts);
 }
 
+/// \brief Starts queueing commands for commitTransaction().
+void Device::beginTransaction() {
+  this->transactionSteps.clear();
+  this->transactionCommands = 0;
+  this->transactionFailed.clear();
+}
+
+/// \brief Queues a bulk command including its CONTROL_BEGINCOMMAND.
+/// \param command The command, that should be sent.
+void Device::queueBulkCommand(Helper::DataArray<unsigned char> *command) {
+  // don't send bulk command if dso6022be
+  if (this->getModel() != MODEL_DSO6022BE) {
+    TransactionStep step;
+    step.kind = CAPTURE_CONTROL;
+    step.request = CONTROL_BEGINCOMMAND;
+    step.data = this->beginCommandControl->data();
+    step.length = this->beginCommandControl->getSize();
+    step.value = 0;
+    step.index = 0;
+    step.command = this->transactionCommands;
+    this->transactionSteps.append(step);
+
+    step.kind = CAPTURE_BULK;
+    step.request = 0;
+    step.data = command->data();
+    step.length = command->getSize();
+    this->transactionSteps.append(step);
+  }
+
+  ++this->transactionCommands;
+}
+
+/// \brief Queues a control write.
+/// \param request The request field of the packet.
+/// \param data Buffer for the sent data, has to stay valid until the commit.
+/// \param length The length field of the packet.
+/// \param value The value field of the packet.
+/// \param index The index field of the packet.
+void Device::queueControlWrite(unsigned char request, unsigned char *data,
+                               unsigned int length, int value, int index) {
+  TransactionStep step;
+  step.kind = CAPTURE_CONTROL;
+  step.request = request;
+  step.data = data;
+  step.length = length;
+  step.value = value;
+  step.index = index;
+  step.command = this->transactionCommands++;
+  this->transactionSteps.append(step);
+}
+
+/// \brief Sends all queued commands in their order.
+/// The transfers are chained, each one is submitted as soon as the previous
+/// one completed, so the thread only waits once for the whole transaction.
+/// If a transfer fails, the other transfers of its command are skipped and the
+/// chain continues with the next command, see getFailed().
+/// \param attempts The number of attempts per transfer on timeouts.
+/// \return 0 on success, the libusb error code of the last failed transfer.
+int Device::commitTransaction(int attempts) {
+  this->transactionFailed.clear();
+  if (!this->isConnected()) {
+    for (int command = 0; command < this->transactionCommands; ++command)
+      this->transactionFailed.append(command);
+    return LIBUSB_ERROR_NO_DEVICE;
+  }
+
+  int errorCode = LIBUSB_SUCCESS;
+  this->transactionStep = 0;
+  while (this->transactionStep < this->transactionSteps.size()) {
+    int result = this->transferPipelined(attempts);
+    if (result >= 0)
+      break;
+    errorCode = result;
+
+    // Without the device none of the remaining commands can be sent
+    int command = this->transactionSteps[this->transactionStep].command;
+    if (result == LIBUSB_ERROR_NO_DEVICE) {
+      for (; command < this->transactionCommands; ++command)
+        this->transactionFailed.append(command);
+      break;
+    }
+
+    // Skip the rest of the failed command
+    this->transactionFailed.append(command);
+    while (this->transactionStep < this->transactionSteps.size() &&
+           this->transactionSteps[this->transactionStep].command == command)
+      ++this->transactionStep;
+  }
+
+  this->transactionSteps.clear();
+  this->transactionCommands = 0;
+
+  if (errorCode == LIBUSB_ERROR_NO_DEVICE)
+    this->disconnect();
+  return errorCode;
+}
+
+/// \brief Get the commands the last commit couldn't send.
+/// \return The numbers of the failed commands in the order they were queued.
+const QList<int> &Device::getFailed() const {
+  return this->transactionFailed;
+}
+
+/// \brief Sends the queued transfers as one chain of asynchronous transfers.
+/// \param attempts The number of attempts per transfer on timeouts.
+/// \return 0 on success, libusb error code on error.
+int Device::transferPipelined(int attempts) {
+  libusb_transfer *transfer = libusb_alloc_transfer(0);
+  if (!transfer)
+    return this->transferSequential(attempts);
+
+  this->transactionAttempt = 0;
+  this->transactionAttempts = attempts;
+  this->transactionResult = LIBUSB_SUCCESS;
+  this->transactionDone = 0;
+  this->submitStep(transfer);
+
+  while (!this->transactionDone) {
+    int errorCode = libusb_handle_events_completed(this->context,
+                                                   &(this->transactionDone));
+    if (errorCode < 0 && errorCode != LIBUSB_ERROR_INTERRUPTED)
+      libusb_cancel_transfer(transfer);
+  }
+
+  libusb_free_transfer(transfer);
+  return this->transactionResult;
+}
+
+/// \brief Sends the queued transfers one after another.
+/// \param attempts The number of attempts per transfer on timeouts.
+/// \return 0 on success, libusb error code on error.
+int Device::transferSequential(int attempts) {
+  for (; this->transactionStep < this->transactionSteps.size();
+       ++this->transactionStep) {
+    const TransactionStep &step = this->transactionSteps[this->transactionStep];
+    int errorCode;
+    if (step.kind == CAPTURE_CONTROL)
+      errorCode = this->controlWrite(step.request, step.data, step.length,
+                                     step.value, step.index, attempts);
+    else
+      errorCode =
+          this->bulkTransfer(HANTEK_EP_OUT, step.data, step.length, attempts);
+    if (errorCode < 0)
+      return errorCode;
+  }
+
+  return LIBUSB_SUCCESS;
+}
+
+/// \brief Submits the current step of the transaction.
+/// \param transfer The transfer that is reused for all steps.
+void Device::submitStep(libusb_transfer *transfer) {
+  const TransactionStep &step = this->transactionSteps[this->transactionStep];
+
+  if (step.kind == CAPTURE_CONTROL) {
+    this->transactionBuffer.resize(LIBUSB_CONTROL_SETUP_SIZE + step.length);
+    unsigned char *buffer = this->transactionBuffer.data();
+    libusb_fill_control_setup(
+        buffer, LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_ENDPOINT_OUT, step.request,
+        step.value, step.index, step.length);
+    if (step.length > 0)
+      memcpy(buffer + LIBUSB_CONTROL_SETUP_SIZE, step.data, step.length);
+    libusb_fill_control_transfer(transfer, this->handle, buffer,
+                                 Device::transactionCallback, this,
+                                 HANTEK_TIMEOUT);
+  } else {
+    libusb_fill_bulk_transfer(transfer, this->handle, HANTEK_EP_OUT, step.data,
+                              step.length, Device::transactionCallback, this,
+                              HANTEK_TIMEOUT);
+  }
+
+  ++this->roundTrips;
+  Counters::add(Counters::USB_TRANSFERS);
+  int errorCode = libusb_submit_transfer(transfer);
+  if (errorCode < 0) {
+    this->transactionResult = errorCode;
+    this->transactionDone = 1;
+  }
+}
+
+/// \brief Handles a completed step and submits the next one.
+/// \param transfer The completed transfer, its user data is the device.
+void LIBUSB_CALL Device::transactionCallback(libusb_transfer *transfer) {
+  Device *device = (Device *)transfer->user_data;
+  const TransactionStep &step =
+      device->transactionSteps[device->transactionStep];
+
+  int result;
+  switch (transfer->status) {
+  case LIBUSB_TRANSFER_COMPLETED:
+    result = transfer->actual_length;
+    break;
+  case LIBUSB_TRANSFER_TIMED_OUT:
+    result = LIBUSB_ERROR_TIMEOUT;
+    break;
+  case LIBUSB_TRANSFER_CANCELLED:
+    result = LIBUSB_ERROR_INTERRUPTED;
+    break;
+  case LIBUSB_TRANSFER_STALL:
+    result = LIBUSB_ERROR_PIPE;
+    break;
+  case LIBUSB_TRANSFER_NO_DEVICE:
+    result = LIBUSB_ERROR_NO_DEVICE;
+    break;
+  case LIBUSB_TRANSFER_OVERFLOW:
+    result = LIBUSB_ERROR_OVERFLOW;
+    break;
+  default:
+    result = LIBUSB_ERROR_IO;
+    break;
+  }
+
+  // Retry on timeouts like the synchronous transfers do
+  if (result == LIBUSB_ERROR_TIMEOUT && device->removed.loadAcquire())
+    result = LIBUSB_ERROR_NO_DEVICE;
+  if (result == LIBUSB_ERROR_TIMEOUT) {
+    Counters::add(Counters::USB_TIMEOUTS);
+    ++device->transactionAttempt;
+    if (device->transactionAttempt < device->transactionAttempts ||
+        device->transactionAttempts == -1) {
+      Counters::add(Counters::USB_RETRIES);
+      device->submitStep(transfer);
+      return;
+    }
+  }
+
+  if (device->capture) {
+    if (step.kind == CAPTURE_CONTROL)
+      device->recordTransfer(CAPTURE_CONTROL, LIBUSB_REQUEST_TYPE_VENDOR |
+                                                  LIBUSB_ENDPOINT_OUT,
+                             step.request, step.value, step.index, step.data,
+                             step.length, result);
+    else
+      device->recordTransfer(CAPTURE_BULK, HANTEK_EP_OUT, 0, 0, 0, step.data,
+                             step.length, result);
+  }
+
+  if (result < 0) {
+    device->transactionResult = result;
+    device->transactionDone = 1;
+    return;
+  }
+
+  // Continue with the next step
+  Counters::add(Counters::USB_BYTES_OUT, result);
+  device->transactionAttempt = 0;
+  ++device->transactionStep;
+  if (device->transactionStep < device->transactionSteps.size())
+    device->submitStep(transfer);
+  else
+    device->transactionDone = 1;
+}
+
 /// \brief Gets the speed of the connection.
+/// The speed can't change while connected, so it's only requested once.
 /// \return The ::ConnectionSpeed of the USB connection.
 int Device::getConnectionSpeed() {
+  if (this->connectionSpeed >= 0)
+    return this->connectionSpeed;
+
   int errorCode;
   ControlGetSpeed response;
 
@@ -392,7 +1213,8 @@ int Device::getConnectionSpeed() {
   if (errorCode < 0)
     return errorCode;
 
-  return response.getSpeed();
+  this->connectionSpeed = response.getSpeed();
+  return this->connectionSpeed;
 }
 
 /// \brief Gets the maximum size of one packet transmitted via bulk transfer.
@@ -414,4 +1236,9 @@ int Device::getPacketSize() {
 /// \brief Get the oscilloscope model.
 /// \return The ::Model of the connected Hantek DSO.
 Model Device::getModel() { return this->model; }
+
+/// \brief Get the number of USB transfers since the device was created.
+/// Every attempt counts, since each one waits for the oscilloscope.
+/// \return The number of round trips to the oscilloscope.
+unsigned long Device::getRoundTrips() { return this->roundTrips; }
 }
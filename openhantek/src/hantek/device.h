@@ -25,14 +25,56 @@
 #ifndef HANTEK_DEVICE_H
 #define HANTEK_DEVICE_H
 
+#include <vector>
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
 #include <QObject>
 #include <QStringList>
+#include <QThread>
 #include <libusb-1.0/libusb.h>
 
+#include "hantek/capture.h"
+#include "hantek/firmware.h"
 #include "hantek/types.h"
 #include "helper.h"
 
 namespace Hantek {
+//////////////////////////////////////////////////////////////////////////////
+/// \struct TransactionStep                                   hantek/device.h
+/// \brief One OUT transfer queued for a transaction.
+struct TransactionStep {
+  CaptureKind kind;      ///< Bulk or control transfer
+  unsigned char request; ///< The control request
+  unsigned char *data;   ///< The sent data, has to stay valid until the commit
+  unsigned int length;   ///< The length of the data
+  int value;             ///< The control value
+  int index;             ///< The control index
+  int command;           ///< Number of the queued command this step belongs to
+};
+
+//////////////////////////////////////////////////////////////////////////////
+/// \class EventThread                                         hantek/device.h
+/// \brief Handles the libusb events of a context between the transfers.
+/// The transfers only handle events while they wait for their completion, the
+/// hotplug callbacks need a thread that handles them all the time.
+class EventThread : public QThread {
+  Q_OBJECT
+
+public:
+  EventThread(libusb_context *context, QObject *parent = 0);
+
+  void stop();
+
+protected:
+  void run();
+
+  libusb_context *context; ///< The context whose events are handled
+  QAtomicInt running;      ///< 1 until stop() has been called
+};
+
 //////////////////////////////////////////////////////////////////////////////
 /// \class Device                                              hantek/device.h
 /// \brief This class handles the USB communication with the oscilloscope.
@@ -43,14 +85,22 @@ public:
   Device(QObject *parent = 0);
   ~Device();
 
-  QString search();
-  void disconnect();
-  bool isConnected();
+  void setIndex(unsigned int index);
+  void setFirmwareDirectory(const QString &directory);
+  virtual QString search();
+  virtual void disconnect();
+  virtual bool isConnected();
+
+  bool startHotplug();
+  void stopHotplug();
+
+  bool startCapture(const QString &fileName);
+  void stopCapture();
 
   // Various methods to handle USB transfers
-  int bulkTransfer(unsigned char endpoint, unsigned char *data,
-                   unsigned int length, int attempts = HANTEK_ATTEMPTS,
-                   unsigned int timeout = HANTEK_TIMEOUT);
+  virtual int bulkTransfer(unsigned char endpoint, unsigned char *data,
+                           unsigned int length, int attempts = HANTEK_ATTEMPTS,
+                           unsigned int timeout = HANTEK_TIMEOUT);
   int bulkWrite(unsigned char *data, unsigned int length,
                 int attempts = HANTEK_ATTEMPTS);
   int bulkRead(unsigned char *data, unsigned int length,
@@ -61,9 +111,10 @@ public:
   int bulkReadMulti(unsigned char *data, unsigned int length,
                     int attempts = HANTEK_ATTEMPTS_MULTI);
 
-  int controlTransfer(unsigned char type, unsigned char request,
-                      unsigned char *data, unsigned int length, int value,
-                      int index, int attempts = HANTEK_ATTEMPTS);
+  virtual int controlTransfer(unsigned char type, unsigned char request,
+                              unsigned char *data, unsigned int length,
+                              int value, int index,
+                              int attempts = HANTEK_ATTEMPTS);
   int controlWrite(unsigned char request, unsigned char *data,
                    unsigned int length, int value = 0, int index = 0,
                    int attempts = HANTEK_ATTEMPTS);
@@ -71,14 +122,52 @@ public:
                   unsigned int length, int value = 0, int index = 0,
                   int attempts = HANTEK_ATTEMPTS);
 
+  void beginTransaction();
+  void queueBulkCommand(Helper::DataArray<unsigned char> *command);
+  void queueControlWrite(unsigned char request, unsigned char *data,
+                         unsigned int length, int value = 0, int index = 0);
+  int commitTransaction(int attempts = HANTEK_ATTEMPTS);
+  const QList<int> &getFailed() const;
+
   int getConnectionSpeed();
   int getPacketSize();
   Model getModel();
+  unsigned long getRoundTrips();
 
 protected:
+  libusb_device *find(libusb_device **deviceList, ssize_t deviceCount,
+                      unsigned int *compatible);
+  QString open(libusb_device *device);
+
+  unsigned int uploadFirmware(libusb_device **deviceList, ssize_t deviceCount,
+                              FirmwareTiming *timing, QString *error);
+  QString uploadFirmware(libusb_device *device, FirmwareTiming *timing);
+  QString firmwareSummary(const QString &message, qint64 connection);
+  void waitForReconnection();
+  int writeFirmware(libusb_device_handle *handle, const Firmware &firmware,
+                    bool internal);
+  int resetCpu(libusb_device_handle *handle, bool reset);
+
+  static int LIBUSB_CALL hotplugCallback(libusb_context *context,
+                                         libusb_device *device,
+                                         libusb_hotplug_event event,
+                                         void *userData);
+
+  virtual int transferPipelined(int attempts);
+  int transferSequential(int attempts);
+  void submitStep(libusb_transfer *transfer);
+  static void LIBUSB_CALL transactionCallback(libusb_transfer *transfer);
+
+  bool createCapture();
+  void recordTransfer(CaptureKind kind, unsigned char endpoint,
+                      unsigned char request, int value, int index,
+                      const unsigned char *data, unsigned int length,
+                      int result);
+
   // Lists for enums
   QList<unsigned short int> modelIds; ///< Product ID for each ::Model
   QStringList modelStrings;           ///< The name as QString for each ::Model
+  QStringList firmwareNames;          ///< Firmware file prefix for each ::Model
 
   // Command buffers
   ControlBeginCommand *beginCommandControl; ///< Buffer for the
@@ -87,6 +176,7 @@ protected:
 
   // Libusb specific variables
   libusb_context *context;      ///< The usb context used for this device
+  unsigned int index;           ///< Compatible devices skipped by search()
   Model model;                  ///< The model of the connected oscilloscope
   libusb_device_handle *handle; ///< The USB handle for the oscilloscope
   libusb_device_descriptor
@@ -95,10 +185,44 @@ protected:
   int error;           ///< The libusb error, that happened on initialization
   int outPacketLength; ///< Packet length for the OUT endpoint
   int inPacketLength;  ///< Packet length for the IN endpoint
+  int connectionSpeed;      ///< Cached ::ConnectionSpeed, -1 if unknown
+  unsigned long roundTrips; ///< Number of USB transfers done so far
+
+  // Hotplug
+  EventThread *eventThread;                     ///< Handles the hotplug events
+  libusb_hotplug_callback_handle hotplugHandle; ///< The registered callback
+  QMutex hotplugMutex;                          ///< Protects the devices below
+  libusb_device *usbDevice;                     ///< The opened device or null
+  libusb_device *arrival;                       ///< Plugged in, not opened yet
+  QAtomicInt removed;                           ///< Set when usbDevice unplugs
+
+  // Transactions
+  QList<TransactionStep> transactionSteps; ///< The queued transfers
+  int transactionCommands;                 ///< Number of queued commands
+  int transactionStep;                     ///< Index of the current step
+  int transactionAttempt;                  ///< Attempts of the current step
+  int transactionAttempts;                 ///< Attempts allowed per step
+  int transactionResult;                   ///< The libusb error of the chain
+  int transactionDone;                     ///< Set when the chain ended
+  QList<int> transactionFailed;            ///< Commands the last commit missed
+  std::vector<unsigned char>
+      transactionBuffer; ///< Setup packet and data of a control step
+
+  // Firmware upload
+  QString firmwareDirectory;       ///< Location of the HEX files, or empty
+  unsigned int firmwareUploaded;   ///< Flashed devices that didn't reconnect
+  FirmwareTiming firmwareTiming;   ///< The phases of the last upload
+  QElapsedTimer reconnectionTimer; ///< Started when the last upload finished
+
+  // Recording
+  CaptureFile *capture;    ///< The capture that records all transfers
+  QString captureFileName; ///< File name for the capture, empty if disabled
 
 signals:
   void connected();    ///< The device has been connected and initialized
   void disconnected(); ///< The device has been disconnected
+  void arrived();      ///< A compatible device has been plugged in
+  void unplugged();    ///< The connected device has been unplugged
 
 public slots:
 };
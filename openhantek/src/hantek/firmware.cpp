@@ -0,0 +1,201 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  hantek/firmware.cpp
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <QCoreApplication>
+#include <QFile>
+
+#include "hantek/firmware.h"
+
+namespace Hantek {
+////////////////////////////////////////////////////////////////////////////////
+// struct Hantek::FirmwareSegment
+/// \brief Checks if the EZ-USB chip can write the segment without a loader.
+/// \return true, if the segment is in the internal RAM of the FX2.
+bool FirmwareSegment::isInternal() const {
+  return Firmware::isInternal(this->address, this->data.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// struct Hantek::FirmwareTiming
+/// \brief Initializes all durations with 0.
+FirmwareTiming::FirmwareTiming() {
+  this->parse = 0;
+  this->loader = 0;
+  this->firmware = 0;
+  this->enumeration = 0;
+  this->connection = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class Hantek::Firmware
+/// \brief Initializes an empty firmware.
+Firmware::Firmware() {}
+
+/// \brief Reads the firmware from an Intel HEX file.
+/// \param fileName The name of the file, can be a Qt resource.
+/// \return true if the file has been read, see getErrorString() otherwise.
+bool Firmware::load(const QString &fileName) {
+  this->segments.clear();
+
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly)) {
+    this->errorString =
+        QCoreApplication::translate("Firmware", "Can't read %1: %2")
+            .arg(fileName, file.errorString());
+    return false;
+  }
+
+  if (this->parse(file.readAll()))
+    return true;
+
+  this->errorString = fileName + ": " + this->errorString;
+  return false;
+}
+
+/// \brief Reads the firmware from the contents of an Intel HEX file.
+/// \param hex The records of the file.
+/// \return true if all records are valid, see getErrorString() otherwise.
+bool Firmware::parse(const QByteArray &hex) {
+  this->segments.clear();
+  this->errorString.clear();
+
+  QList<QByteArray> lines = hex.split('\n');
+  unsigned int base = 0;
+  for (int line = 0; line < lines.size(); ++line) {
+    QByteArray record = lines[line].trimmed();
+    if (record.isEmpty())
+      continue;
+
+    // Every record is ":LLAAAATT" followed by the data and the checksum
+    QByteArray bytes = QByteArray::fromHex(record.mid(1));
+    if (record[0] != ':' || record.size() != 1 + 2 * bytes.size() ||
+        bytes.size() < 5 || bytes.size() != 5 + (unsigned char)bytes[0]) {
+      this->errorString =
+          QCoreApplication::translate("Firmware", "Invalid record in line %1")
+              .arg(line + 1);
+      return false;
+    }
+    unsigned char checksum = 0;
+    for (int byte = 0; byte < bytes.size(); ++byte)
+      checksum += (unsigned char)bytes[byte];
+    if (checksum) {
+      this->errorString =
+          QCoreApplication::translate("Firmware", "Wrong checksum in line %1")
+              .arg(line + 1);
+      return false;
+    }
+
+    unsigned int address =
+        ((unsigned char)bytes[1] << 8) | (unsigned char)bytes[2];
+    QByteArray data = bytes.mid(4, bytes.size() - 5);
+    unsigned int value = 0;
+    if (data.size() >= 2)
+      value = ((unsigned char)data[0] << 8) | (unsigned char)data[1];
+    switch (bytes[3]) {
+    case 0x00: // Data
+      this->append(base + address, data);
+      break;
+    case 0x01: // End of file
+      return true;
+    case 0x02: // Extended segment address
+      base = value << 4;
+      break;
+    case 0x04: // Extended linear address
+      base = value << 16;
+      break;
+    case 0x03: // Start segment address
+    case 0x05: // Start linear address
+      break;
+    default:
+      this->errorString =
+          QCoreApplication::translate("Firmware", "Unknown record in line %1")
+              .arg(line + 1);
+      return false;
+    }
+  }
+
+  this->errorString =
+      QCoreApplication::translate("Firmware", "End of file record missing");
+  return false;
+}
+
+/// \brief Get the data of the firmware.
+/// \return The segments in the order of the file.
+const QList<FirmwareSegment> &Firmware::getSegments() const {
+  return this->segments;
+}
+
+/// \brief Get the size of the firmware.
+/// \return The number of bytes in all segments.
+unsigned int Firmware::getSize() const {
+  unsigned int size = 0;
+  for (int segment = 0; segment < this->segments.size(); ++segment)
+    size += this->segments[segment].data.size();
+  return size;
+}
+
+/// \brief Checks if the firmware can only be written by a loader.
+/// \return true, if a segment is outside of the internal RAM.
+bool Firmware::needsLoader() const {
+  for (int segment = 0; segment < this->segments.size(); ++segment) {
+    if (!this->segments[segment].isInternal())
+      return true;
+  }
+  return false;
+}
+
+/// \brief Get the reason why the last load() or parse() failed.
+/// \return A translated error message.
+QString Firmware::getErrorString() const { return this->errorString; }
+
+/// \brief Checks if a memory range is in the internal RAM of the FX2.
+/// The internal RAM has 8 KiB for code and data at 0x0000 and 512 bytes for
+/// data at 0xe000, like fxload expects it for the FX2.
+/// \param address The first address of the range.
+/// \param length The number of bytes.
+/// \return true, if the chip can write the range without a loader.
+bool Firmware::isInternal(unsigned int address, unsigned int length) {
+  if (address < 0x2000)
+    return address + length <= 0x2000;
+  if (address >= 0xe000 && address < 0xe200)
+    return address + length <= 0xe200;
+  return false;
+}
+
+/// \brief Adds data to the last segment or starts a new one.
+/// \param address The address of the first byte.
+/// \param data The bytes of the record.
+void Firmware::append(unsigned int address, const QByteArray &data) {
+  if (!this->segments.isEmpty()) {
+    FirmwareSegment &last = this->segments.last();
+    unsigned int end = last.address + last.data.size();
+    if (end == address && last.data.size() + data.size() <= EZUSB_CHUNK &&
+        last.isInternal() == isInternal(address, data.size())) {
+      last.data.append(data);
+      return;
+    }
+  }
+
+  FirmwareSegment segment;
+  segment.address = address;
+  segment.data = data;
+  this->segments.append(segment);
+}
+}
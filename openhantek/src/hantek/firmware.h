@@ -0,0 +1,88 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file hantek/firmware.h
+/// \brief Declares the Hantek::Firmware class.
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HANTEK_FIRMWARE_H
+#define HANTEK_FIRMWARE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#define EZUSB_VENDOR_ID 0x04b4      ///< VID for Hantek DSOs without firmware
+#define EZUSB_REQUEST_INTERNAL 0xa0 ///< Writes RAM, handled by the chip
+#define EZUSB_REQUEST_EXTERNAL 0xa3 ///< Writes RAM, handled by the loader
+#define EZUSB_CPUCS 0xe600          ///< CPU control and status register
+#define EZUSB_CHUNK 1023            ///< Maximum bytes per control transfer
+
+namespace Hantek {
+//////////////////////////////////////////////////////////////////////////////
+/// \struct FirmwareSegment                                  hantek/firmware.h
+/// \brief Bytes at consecutive addresses in the memory of the EZ-USB chip.
+struct FirmwareSegment {
+  unsigned int address; ///< The address of the first byte
+  QByteArray data;      ///< The bytes, at most EZUSB_CHUNK of them
+
+  bool isInternal() const;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+/// \struct FirmwareTiming                                   hantek/firmware.h
+/// \brief The duration of each phase of the firmware upload in ms.
+struct FirmwareTiming {
+  qint64 parse;       ///< Reading the Intel HEX files
+  qint64 loader;      ///< Writing and starting the loader
+  qint64 firmware;    ///< Writing and starting the firmware
+  qint64 enumeration; ///< Waiting until the devices reconnect
+  qint64 connection;  ///< Opening the reconnected device
+
+  FirmwareTiming();
+};
+
+//////////////////////////////////////////////////////////////////////////////
+/// \class Firmware                                          hantek/firmware.h
+/// \brief A firmware image read from an Intel HEX file.
+/// The data records are merged into segments that can be written with one
+/// control transfer each. A segment is either completely inside the internal
+/// RAM of the FX2 or completely outside of it.
+class Firmware {
+public:
+  Firmware();
+
+  bool load(const QString &fileName);
+  bool parse(const QByteArray &hex);
+
+  const QList<FirmwareSegment> &getSegments() const;
+  unsigned int getSize() const;
+  bool needsLoader() const;
+  QString getErrorString() const;
+
+  static bool isInternal(unsigned int address, unsigned int length);
+
+protected:
+  void append(unsigned int address, const QByteArray &data);
+
+private:
+  QList<FirmwareSegment> segments; ///< The data in the order of the file
+  QString errorString;             ///< The reason why the last read failed
+};
+}
+
+#endif
@@ -0,0 +1,240 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  hantek/history.cpp
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstring>
+#include <new>
+
+#include <QMutexLocker>
+#include <QTemporaryFile>
+
+#include "hantek/history.h"
+
+namespace Hantek {
+////////////////////////////////////////////////////////////////////////////////
+// class History
+/// \brief Initializes an empty history without pool.
+History::History() {
+  this->pool = 0;
+  this->segmentSize = 0;
+  this->first = 0;
+  this->count = 0;
+  this->memoryLimit = 0;
+  this->spillFile = 0;
+}
+
+/// \brief Releases the pool.
+History::~History() { this->release(); }
+
+/// \brief Allocates the pool, all stored segments are dropped.
+/// \param segmentCount The number of acquisitions that should be kept.
+/// \param segmentSize The maximum size of the raw data of one acquisition, 0
+/// if it should be set by the first stored acquisition.
+/// \param memoryLimit The maximum pool size in bytes that is kept in RAM, 0
+/// for no limit.
+/// \param spillFileName The template for the temporary file that is mapped if
+/// the pool exceeds the limit, "XXXXXX" in it is replaced by a unique part.
+/// The segment count is reduced to fit into the limit if it's empty.
+/// \return true on success, false if the pool couldn't be allocated. The
+/// previous pool is kept in this case.
+bool History::allocate(unsigned int segmentCount, unsigned int segmentSize,
+                       unsigned long memoryLimit,
+                       const QString &spillFileName) {
+  QMutexLocker locker(&this->mutex);
+
+  // The slot size isn't known yet, the pool is allocated by store()
+  if (segmentCount == 0 || segmentSize == 0) {
+    this->release();
+    this->memoryLimit = memoryLimit;
+    this->spillFileName = spillFileName;
+    this->segments.resize(segmentCount);
+    return true;
+  }
+
+  return this->reallocate(segmentCount, segmentSize, memoryLimit,
+                          spillFileName);
+}
+
+/// \brief Drops all stored segments but keeps the pool.
+void History::clear() {
+  QMutexLocker locker(&this->mutex);
+
+  this->first = 0;
+  this->count = 0;
+}
+
+/// \brief Gets the number of stored segments.
+/// \return The number of segments that can be read with get().
+unsigned int History::getCount() {
+  QMutexLocker locker(&this->mutex);
+
+  return this->count;
+}
+
+/// \brief Gets the number of segments the pool can hold.
+/// \return The number of slots in the pool.
+unsigned int History::getCapacity() {
+  QMutexLocker locker(&this->mutex);
+
+  return this->segments.size();
+}
+
+/// \brief Gets the maximum raw data size of a segment.
+/// \return The slot size in bytes.
+unsigned int History::getSegmentSize() {
+  QMutexLocker locker(&this->mutex);
+
+  return this->segmentSize;
+}
+
+/// \brief Checks if the pool is placed in a memory mapped file.
+/// \return true, if the pool has been spilled into the history file.
+bool History::isMapped() {
+  QMutexLocker locker(&this->mutex);
+
+  return this->spillFile != 0;
+}
+
+/// \brief Stores an acquisition, overwriting the oldest one when full.
+/// When the raw data doesn't fit into the slots anymore because the record
+/// length has grown, the pool is reallocated with bigger slots and all stored
+/// segments are dropped. If that fails, the old pool is kept and only the
+/// oversized acquisition is rejected.
+/// \param segment The metadata of the acquisition.
+/// \param data The raw data with segment.dataLength bytes.
+/// \return true on success, false if the history is disabled or the segment
+/// doesn't fit.
+bool History::store(const HistorySegment &segment, const unsigned char *data) {
+  QMutexLocker locker(&this->mutex);
+
+  if (this->segments.empty())
+    return false;
+
+  // The record length has grown, reallocate the pool with bigger slots
+  if (segment.dataLength > this->segmentSize &&
+      !this->reallocate(this->segments.size(), segment.dataLength,
+                        this->memoryLimit, this->spillFileName))
+    return false;
+
+  unsigned int slot = (this->first + this->count) % this->segments.size();
+  if (this->count < this->segments.size())
+    ++this->count;
+  else
+    this->first = (this->first + 1) % this->segments.size();
+
+  this->segments[slot] = segment;
+  memcpy(this->pool + (size_t)slot * this->segmentSize, data,
+         segment.dataLength);
+
+  return true;
+}
+
+/// \brief Reads a stored acquisition.
+/// \param index The age of the segment, 0 is the newest one.
+/// \param segment Pointer to where the metadata should be written.
+/// \param data The raw data is copied into this buffer.
+/// \return true on success, false if there's no segment with this index.
+bool History::get(unsigned int index, HistorySegment *segment,
+                  std::vector<unsigned char> *data) {
+  QMutexLocker locker(&this->mutex);
+
+  if (index >= this->count)
+    return false;
+
+  unsigned int slot =
+      (this->first + this->count - 1 - index) % this->segments.size();
+  *segment = this->segments[slot];
+  if (data->size() < segment->dataLength)
+    data->resize(segment->dataLength);
+  memcpy(data->data(), this->pool + (size_t)slot * this->segmentSize,
+         segment->dataLength);
+
+  return true;
+}
+
+/// \brief Replaces the pool by a new one, the mutex has to be locked.
+/// The new pool is set up completely before the old one is released, so the
+/// old one stays usable if the allocation fails.
+/// \param segmentCount The number of acquisitions that should be kept.
+/// \param segmentSize The maximum size of the raw data of one acquisition.
+/// \param memoryLimit The maximum pool size in bytes that is kept in RAM.
+/// \param spillFileName The template for the temporary file.
+/// \return true on success, false if the old pool has been kept.
+bool History::reallocate(unsigned int segmentCount, unsigned int segmentSize,
+                         unsigned long memoryLimit,
+                         const QString &spillFileName) {
+  unsigned char *pool = 0;
+  QTemporaryFile *spillFile = 0;
+
+  qint64 poolSize = (qint64)segmentCount * segmentSize;
+  if (memoryLimit && poolSize > (qint64)memoryLimit) {
+    if (spillFileName.isEmpty()) {
+      // No spill file, keep as many segments as the limit allows
+      segmentCount = memoryLimit / segmentSize;
+      if (segmentCount == 0)
+        return false;
+      poolSize = (qint64)segmentCount * segmentSize;
+    } else {
+      spillFile = new QTemporaryFile(spillFileName);
+      if (!spillFile->open() || !spillFile->resize(poolSize) ||
+          !(pool = spillFile->map(0, poolSize))) {
+        qWarning("Can't map history file %s",
+                 spillFileName.toLocal8Bit().data());
+        delete spillFile;
+        return false;
+      }
+    }
+  }
+
+  if (!spillFile) {
+    pool = new (std::nothrow) unsigned char[poolSize];
+    if (!pool)
+      return false;
+  }
+
+  this->release();
+  this->pool = pool;
+  this->spillFile = spillFile;
+  this->segments.resize(segmentCount);
+  this->segmentSize = segmentSize;
+  this->memoryLimit = memoryLimit;
+  this->spillFileName = spillFileName;
+
+  return true;
+}
+
+/// \brief Frees the pool and unmaps the history file.
+void History::release() {
+  if (this->spillFile) {
+    this->spillFile->unmap(this->pool);
+    this->spillFile->close();
+    this->spillFile->remove();
+    delete this->spillFile;
+    this->spillFile = 0;
+  } else if (this->pool) {
+    delete[] this->pool;
+  }
+  this->pool = 0;
+
+  this->segments.clear();
+  this->segmentSize = 0;
+  this->first = 0;
+  this->count = 0;
+}
+}
@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file hantek/history.h
+/// \brief Declares the Hantek::History class.
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HANTEK_HISTORY_H
+#define HANTEK_HISTORY_H
+
+#include <vector>
+
+#include <QMutex>
+#include <QString>
+
+#include "hantek/types.h"
+
+class QTemporaryFile;
+
+namespace Hantek {
+//////////////////////////////////////////////////////////////////////////////
+/// \struct HistorySegment                                    hantek/history.h
+/// \brief The metadata needed to convert the raw data of an acquisition.
+struct HistorySegment {
+  unsigned int id;                    ///< Running number of the acquisition
+  qint64 timestamp;                   ///< Time of the acquisition in ms (UTC)
+  double samplerate;                  ///< The samplerate in S/s
+  bool append;                        ///< true, if it is a roll mode block
+  bool fastRate;                      ///< true, if the fast rate mode was used
+  unsigned int triggerPoint;          ///< The trigger position in Hantek coding
+  unsigned int gain[HANTEK_CHANNELS]; ///< The gain id for each channel
+  double offsetReal[HANTEK_CHANNELS]; ///< The real offset for each channel
+  bool used[HANTEK_CHANNELS];         ///< true, if the channel was enabled
+  unsigned int dataLength;            ///< Number of valid raw bytes
+};
+
+//////////////////////////////////////////////////////////////////////////////
+/// \class History                                            hantek/history.h
+/// \brief Ring of the last acquisitions with their raw data and metadata.
+/// The raw data is stored in one preallocated pool, that is placed into a
+/// memory mapped temporary file when it doesn't fit into the memory limit.
+/// Every history creates its own file, so several devices and processes
+/// never share one.
+class History {
+public:
+  History();
+  ~History();
+
+  bool allocate(unsigned int segmentCount, unsigned int segmentSize,
+                unsigned long memoryLimit = 0,
+                const QString &spillFileName = QString());
+  void clear();
+
+  unsigned int getCount();
+  unsigned int getCapacity();
+  unsigned int getSegmentSize();
+  bool isMapped();
+
+  bool store(const HistorySegment &segment, const unsigned char *data);
+  bool get(unsigned int index, HistorySegment *segment,
+           std::vector<unsigned char> *data);
+
+private:
+  bool reallocate(unsigned int segmentCount, unsigned int segmentSize,
+                  unsigned long memoryLimit, const QString &spillFileName);
+  void release();
+
+  QMutex mutex; ///< Locks the pool and the segment list
+
+  std::vector<HistorySegment> segments; ///< Metadata for every slot
+  unsigned char *pool;      ///< The raw data of all slots
+  unsigned int segmentSize; ///< Size of one slot in bytes
+  unsigned int first;       ///< Slot of the oldest segment
+  unsigned int count;       ///< Number of stored segments
+
+  unsigned long memoryLimit; ///< Pool size that is kept in RAM
+  QString spillFileName;     ///< Template for the file beyond memoryLimit
+  QTemporaryFile *spillFile; ///< The mapped file, 0 if pool is on the heap
+};
+}
+
+#endif
@@ -0,0 +1,186 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  hantek/replaydevice.cpp
+//
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <cstring>
+
+#include <QThread>
+
+#include "hantek/replaydevice.h"
+
+namespace Hantek {
+////////////////////////////////////////////////////////////////////////////////
+// class Hantek::ReplayDevice
+/// \brief Initializes the replay, the capture is opened by search().
+/// \param fileName The name of the capture file.
+/// \param realtime true to keep the recorded timing, false for maximum speed.
+/// \param parent The parent widget.
+ReplayDevice::ReplayDevice(const QString &fileName, bool realtime,
+                           QObject *parent)
+    : Device(parent) {
+  this->fileName = fileName;
+  this->realtime = realtime;
+  this->nextValid = false;
+}
+
+/// \brief Closes the capture.
+ReplayDevice::~ReplayDevice() { this->disconnect(); }
+
+/// \brief Opens the capture file.
+/// \return A string with the result of the search.
+QString ReplayDevice::search() {
+  CaptureHeader header;
+  if (!this->file.open(this->fileName, &header))
+    return tr("Can't open capture %1").arg(this->fileName);
+
+  this->model = (Model)header.model;
+  if (this->model < 0 || this->model >= this->modelStrings.size()) {
+    this->file.close();
+    return tr("Unknown model in capture %1").arg(this->fileName);
+  }
+  this->outPacketLength = header.outPacketLength;
+  this->inPacketLength = header.inPacketLength;
+  this->connectionSpeed = -1;
+
+  this->nextValid = this->file.read(&this->next);
+  this->timer.start();
+
+  emit connected();
+
+  return tr("Replaying Hantek %1 from %2")
+      .arg(this->modelStrings[this->model], this->fileName);
+}
+
+/// \brief Closes the capture file.
+void ReplayDevice::disconnect() {
+  if (!this->file.isOpen())
+    return;
+
+  this->file.close();
+  this->nextValid = false;
+  this->connectionSpeed = -1;
+
+  emit disconnected();
+}
+
+/// \brief Check if the capture is being replayed.
+/// \return true, if the capture is open.
+bool ReplayDevice::isConnected() { return this->file.isOpen(); }
+
+/// \brief Replays a bulk transfer.
+/// \param endpoint Endpoint number, also sets the direction of the transfer.
+/// \param data Buffer for the sent/recieved data.
+/// \param length The length of the packet.
+/// \param attempts Unused, the recorded result is returned.
+/// \param timeout Unused, the recorded result is returned.
+/// \return Number of transferred bytes on success, libusb error code on error.
+int ReplayDevice::bulkTransfer(unsigned char endpoint, unsigned char *data,
+                               unsigned int length, int attempts,
+                               unsigned int timeout) {
+  Q_UNUSED(attempts);
+  Q_UNUSED(timeout);
+
+  return this->replay(CAPTURE_BULK, endpoint, 0, data, length);
+}
+
+/// \brief Replays a control transfer.
+/// \param type The request type, also sets the direction of the transfer.
+/// \param request The request field of the packet.
+/// \param data Buffer for the sent/recieved data.
+/// \param length The length field of the packet.
+/// \param value Unused, the recorded result is returned.
+/// \param index Unused, the recorded result is returned.
+/// \param attempts Unused, the recorded result is returned.
+/// \return Number of transferred bytes on success, libusb error code on error.
+int ReplayDevice::controlTransfer(unsigned char type, unsigned char request,
+                                  unsigned char *data, unsigned int length,
+                                  int value, int index, int attempts) {
+  Q_UNUSED(value);
+  Q_UNUSED(index);
+  Q_UNUSED(attempts);
+
+  return this->replay(CAPTURE_CONTROL, type, request, data, length);
+}
+
+/// \brief Replays the queued transfers of a transaction one after another.
+/// \param attempts Unused, the recorded results are returned.
+/// \return 0 on success, libusb error code on error.
+int ReplayDevice::transferPipelined(int attempts) {
+  return this->transferSequential(attempts);
+}
+
+/// \brief Returns the result of the next matching recorded transfer.
+/// \param kind The type of the transfer.
+/// \param endpoint The bulk endpoint or the control request type.
+/// \param request The control request.
+/// \param data Buffer for the sent/recieved data.
+/// \param length The requested length.
+/// \return Number of transferred bytes on success, libusb error code on error.
+int ReplayDevice::replay(CaptureKind kind, unsigned char endpoint,
+                         unsigned char request, unsigned char *data,
+                         unsigned int length) {
+  if (!this->isConnected())
+    return LIBUSB_ERROR_NO_DEVICE;
+
+  ++this->roundTrips;
+  bool input = (endpoint & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN;
+
+  // Writes that weren't recorded are acknowledged without consuming anything
+  if (!input && !(this->nextValid && this->matches(kind, endpoint, request)))
+    return length;
+
+  // Reads skip everything until the same request was recorded
+  while (this->nextValid && !this->matches(kind, endpoint, request))
+    this->nextValid = this->file.read(&this->next);
+  if (!this->nextValid) {
+    this->disconnect();
+    return LIBUSB_ERROR_NO_DEVICE;
+  }
+
+  if (this->realtime)
+    this->wait();
+
+  int result = this->next.result;
+  if (input && result > 0) {
+    result = qMin((unsigned int)this->next.data.size(), length);
+    memcpy(data, this->next.data.constData(), result);
+  }
+
+  this->nextValid = this->file.read(&this->next);
+  return result;
+}
+
+/// \brief Checks if the next recorded transfer is the requested one.
+/// \param kind The type of the transfer.
+/// \param endpoint The bulk endpoint or the control request type.
+/// \param request The control request.
+/// \return true, if the recorded transfer can be returned.
+bool ReplayDevice::matches(CaptureKind kind, unsigned char endpoint,
+                           unsigned char request) const {
+  return this->next.kind == kind && this->next.endpoint == endpoint &&
+         this->next.request == request;
+}
+
+/// \brief Sleeps until the next transfer happened during the recording.
+void ReplayDevice::wait() {
+  qint64 delay = this->next.time - this->timer.nsecsElapsed() / 1000;
+  if (delay > 0)
+    QThread::usleep(delay);
+}
+}
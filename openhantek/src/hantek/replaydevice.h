@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file hantek/replaydevice.h
+/// \brief Declares the Hantek::ReplayDevice class.
+//
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef HANTEK_REPLAYDEVICE_H
+#define HANTEK_REPLAYDEVICE_H
+
+#include <QElapsedTimer>
+#include <QString>
+
+#include "hantek/capture.h"
+#include "hantek/device.h"
+
+namespace Hantek {
+//////////////////////////////////////////////////////////////////////////////
+/// \class ReplayDevice                                  hantek/replaydevice.h
+/// \brief Serves the transfers of a capture file instead of a real device.
+/// IN transfers return the recorded data, OUT transfers are acknowledged with
+/// their recorded result. Recorded transfers that weren't requested again are
+/// skipped, so changed settings only affect the OUT transfers. The device
+/// disconnects at the end of the capture.
+class ReplayDevice : public Device {
+  Q_OBJECT
+
+public:
+  ReplayDevice(const QString &fileName, bool realtime, QObject *parent = 0);
+  ~ReplayDevice();
+
+  QString search();
+  void disconnect();
+  bool isConnected();
+
+  int bulkTransfer(unsigned char endpoint, unsigned char *data,
+                   unsigned int length, int attempts = HANTEK_ATTEMPTS,
+                   unsigned int timeout = HANTEK_TIMEOUT);
+  int controlTransfer(unsigned char type, unsigned char request,
+                      unsigned char *data, unsigned int length, int value,
+                      int index, int attempts = HANTEK_ATTEMPTS);
+
+protected:
+  int transferPipelined(int attempts);
+  int replay(CaptureKind kind, unsigned char endpoint, unsigned char request,
+             unsigned char *data, unsigned int length);
+  bool matches(CaptureKind kind, unsigned char endpoint,
+               unsigned char request) const;
+  void wait();
+
+private:
+  QString fileName;     ///< The name of the capture file
+  bool realtime;        ///< true replays at the recorded speed
+  CaptureFile file;     ///< The opened capture
+  CaptureTransfer next; ///< The next transfer of the capture
+  bool nextValid;       ///< false at the end of the capture
+  QElapsedTimer timer;  ///< Time since the replay started
+};
+}
+
+#endif
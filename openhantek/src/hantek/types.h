@@ -40,6 +40,11 @@
 #define HANTEK_ATTEMPTS 3 ///< The number of transfer attempts
 #define HANTEK_ATTEMPTS_MULTI                                                  \
   1 ///< The number of multi packet transfer attempts
+#define HANTEK_HOTPLUG_INTERVAL 100 ///< Hotplug event polling interval in ms
+#define HANTEK_RENUMERATION_INTERVAL                                           \
+  50 ///< Search interval after a firmware upload without hotplug in ms
+#define HANTEK_RENUMERATION_TIMEOUT                                            \
+  5000 ///< Maximum time until devices reconnect after the upload in ms
 
 #define HANTEK_CHANNELS 2         ///< Number of physical channels
 #define HANTEK_SPECIAL_CHANNELS 2 ///< Number of special channels
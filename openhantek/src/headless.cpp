@@ -0,0 +1,221 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  headless.cpp
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <iostream>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QMutex>
+
+#include "headless.h"
+
+#include "acquisition.h"
+#include "csvwriter.h"
+#include "dataanalyzer.h"
+#include "dsocontrol.h"
+#include "settings.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// class HeadlessAcquisition
+/// \brief Creates the acquisition, the output goes to stdout by default.
+/// \param dsoControl The controller for the oscilloscope.
+/// \param settings The settings the oscilloscope is configured with.
+/// \param parent The parent widget.
+HeadlessAcquisition::HeadlessAcquisition(DsoControl *dsoControl,
+                                         DsoSettings *settings,
+                                         QObject *parent)
+    : QObject(parent) {
+  this->dsoControl = dsoControl;
+  this->settings = settings;
+  // Every acquisition is analyzed as it arrives, nothing is pulled
+  this->acquisition = new Acquisition(this->dsoControl, this->settings, this);
+  this->acquisition->setQueueLength(0);
+  this->dataAnalyzer = this->acquisition->getDataAnalyzer();
+
+  this->frameLimit = 0;
+  this->frames = 0;
+}
+
+/// \brief Waits for the running analysis.
+HeadlessAcquisition::~HeadlessAcquisition() { this->dataAnalyzer->wait(); }
+
+/// \brief Sets the file that receives the measurements.
+/// \param fileName The name of the file, "-" for stdout.
+/// \return true if the file was opened.
+bool HeadlessAcquisition::setOutput(const QString &fileName) {
+  this->output.close();
+
+  if (fileName == "-")
+    return this->output.open(stdout, QIODevice::WriteOnly);
+
+  this->output.setFileName(fileName);
+  return this->output.open(QIODevice::WriteOnly | QIODevice::Truncate);
+}
+
+/// \brief Writes the samples of every acquisition into an own CSV file.
+/// \param directory The directory for the files, empty to disable them.
+void HeadlessAcquisition::setSamplesDirectory(const QString &directory) {
+  this->samplesDirectory = directory;
+}
+
+/// \brief Sets the number of acquisitions after which the program exits.
+/// \param frames The number of acquisitions, 0 to run until interrupted.
+void HeadlessAcquisition::setFrameLimit(unsigned int frames) {
+  this->frameLimit = frames;
+}
+
+/// \brief Get the data analyzer that analyzes the acquisitions.
+/// \return The data analyzer, its mutex protects the analyzed data.
+DataAnalyzer *HeadlessAcquisition::getDataAnalyzer() {
+  return this->dataAnalyzer;
+}
+
+/// \brief Connects the oscilloscope and starts sampling.
+/// \return false if the oscilloscope couldn't be connected.
+bool HeadlessAcquisition::start() {
+  if (!this->output.isOpen() && !this->setOutput("-"))
+    return false;
+
+  connect(this->dsoControl, SIGNAL(statusMessage(QString, int)), this,
+          SLOT(statusMessage(QString, int)));
+  connect(this->dsoControl, SIGNAL(finished()), this, SLOT(deviceStopped()));
+  connect(this->dsoControl,
+          SIGNAL(samplesAvailable(const std::vector<std::vector<double>> *,
+                                  double, bool, QMutex *)),
+          this->dataAnalyzer,
+          SLOT(analyze(const std::vector<std::vector<double>> *, double, bool,
+                       QMutex *)));
+  connect(this->dataAnalyzer, SIGNAL(analyzed(unsigned long)), this,
+          SLOT(analyzed(unsigned long)));
+
+  if (!this->acquisition->open())
+    return false;
+
+  this->acquisition->configure();
+  this->writeHeader();
+
+  this->timer.start();
+  this->acquisition->start();
+
+  return true;
+}
+
+/// \brief Writes the column names of the measurements.
+void HeadlessAcquisition::writeHeader() {
+  QString header("frame,time");
+  for (int channel = 0; channel < this->settings->scope.voltage.size();
+       ++channel) {
+    if (!this->settings->scope.voltage[channel].used)
+      continue;
+
+    const QString &name = this->settings->scope.voltage[channel].name;
+    header += QString(",%1 amplitude,%1 frequency").arg(name);
+  }
+  header += '\n';
+
+  this->output.write(header.toUtf8());
+  this->output.flush();
+}
+
+/// \brief Writes the samples of the last analyzed acquisition.
+/// \return true if the file was written.
+bool HeadlessAcquisition::writeSamples() {
+  CsvWriter writer;
+  for (int channel = 0; channel < this->settings->scope.voltage.size();
+       ++channel) {
+    const AnalyzedData *data = this->dataAnalyzer->data(channel);
+    if (!data)
+      continue;
+
+    if (this->settings->scope.voltage[channel].used)
+      writer.addSeries(this->settings->scope.voltage[channel].name,
+                       data->samples.voltage.interval,
+                       &data->samples.voltage.sample);
+    if (this->settings->scope.spectrum[channel].used)
+      writer.addSeries(this->settings->scope.spectrum[channel].name,
+                       data->samples.spectrum.interval,
+                       &data->samples.spectrum.sample);
+  }
+
+  return writer.write(
+      QDir(this->samplesDirectory)
+          .filePath(QString("frame-%1.csv").arg(this->frames, 6, 10,
+                                                QLatin1Char('0'))),
+      CSV_LAYOUT_ROWS);
+}
+
+/// \brief Exits when the device has been disconnected.
+void HeadlessAcquisition::deviceStopped() {
+  std::cerr << "Device stopped after " << this->frames << " frames"
+            << std::endl;
+  QCoreApplication::exit(1);
+}
+
+/// \brief Prints the status messages of the oscilloscope to stderr.
+/// \param message The status message.
+/// \param timeout Unused, the messages aren't hidden.
+void HeadlessAcquisition::statusMessage(const QString &message, int timeout) {
+  Q_UNUSED(timeout);
+
+  if (!message.isEmpty())
+    std::cerr << message.toLocal8Bit().constData() << std::endl;
+}
+
+/// \brief Writes the measurements of an analyzed acquisition.
+/// \param samples The sample count of the analyzed data.
+void HeadlessAcquisition::analyzed(unsigned long samples) {
+  Q_UNUSED(samples);
+
+  if (this->frameLimit && this->frames >= this->frameLimit)
+    return;
+
+  QMutexLocker locker(this->dataAnalyzer->mutex());
+
+  QString line = QString("%1,%2").arg(this->frames).arg(
+      this->timer.nsecsElapsed() / 1e9, 0, 'f', 6);
+  for (int channel = 0; channel < this->settings->scope.voltage.size();
+       ++channel) {
+    if (!this->settings->scope.voltage[channel].used)
+      continue;
+
+    const AnalyzedData *data = this->dataAnalyzer->data(channel);
+    line += QString(",%1,%2")
+                .arg(data ? data->amplitude : 0.0, 0, 'g', 9)
+                .arg(data ? data->frequency : 0.0, 0, 'g', 9);
+  }
+  line += '\n';
+
+  bool success = this->output.write(line.toUtf8()) >= 0;
+  this->output.flush();
+  if (success && !this->samplesDirectory.isEmpty())
+    success = this->writeSamples();
+  if (!success) {
+    std::cerr << "Can't write the acquisition " << this->frames << std::endl;
+    QCoreApplication::exit(1);
+    return;
+  }
+
+  ++this->frames;
+  if (this->frameLimit && this->frames >= this->frameLimit) {
+    this->acquisition->stop();
+    QCoreApplication::exit(0);
+  }
+}
@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file headless.h
+/// \brief Declares the HeadlessAcquisition class.
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QObject>
+#include <QString>
+
+class Acquisition;
+class DataAnalyzer;
+class DsoControl;
+class DsoSettings;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class HeadlessAcquisition                                        headless.h
+/// \brief Runs the oscilloscope without any widgets.
+/// The oscilloscope is configured from the settings and every analyzed
+/// acquisition is written as one line of measurements, optionally with a CSV
+/// file containing its samples.
+class HeadlessAcquisition : public QObject {
+  Q_OBJECT
+
+public:
+  HeadlessAcquisition(DsoControl *dsoControl, DsoSettings *settings,
+                      QObject *parent = 0);
+  ~HeadlessAcquisition();
+
+  bool setOutput(const QString &fileName);
+  void setSamplesDirectory(const QString &directory);
+  void setFrameLimit(unsigned int frames);
+
+  DataAnalyzer *getDataAnalyzer();
+
+  bool start();
+
+protected:
+  void writeHeader();
+  bool writeSamples();
+
+private:
+  DsoControl *dsoControl;     ///< The controller for the oscilloscope
+  DsoSettings *settings;      ///< The oscilloscope settings
+  Acquisition *acquisition;   ///< Configures the oscilloscope
+  DataAnalyzer *dataAnalyzer; ///< Analyzes the acquisitions
+
+  QFile output;             ///< Receives the measurements
+  QString samplesDirectory; ///< Directory for the sample files, or empty
+  unsigned int frameLimit;  ///< Stop after this many frames, 0 for never
+  unsigned int frames;      ///< Number of written frames
+  QElapsedTimer timer;      ///< Time since the acquisition started
+
+private slots:
+  void deviceStopped();
+  void statusMessage(const QString &message, int timeout);
+  void analyzed(unsigned long samples);
+};
+
+#endif
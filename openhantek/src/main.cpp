@@ -22,33 +22,297 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QFile>
 #include <QLibraryInfo>
 #include <QLocale>
+#include <QScopedPointer>
 #include <QTranslator>
 #include <iostream>
 
 #include "openhantek.h"
 
+#include "hantek/control.h"
+#include "headless.h"
+#include "multicontrol.h"
+#include "remoteserver.h"
+#include "settings.h"
+#include "sharedring.h"
+#include "synthetic/control.h"
+#include "tracing.h"
+
+/// \brief Starts the remote control server.
+/// \param server The server that should listen.
+/// \param address The TCP port or the path of the Unix socket.
+/// \return false if the server couldn't listen.
+static bool startRemoteServer(RemoteServer *server, const QString &address) {
+  if (server->listen(address))
+    return true;
+
+  std::cerr << "Can't listen on " << address.toLocal8Bit().constData() << ": "
+            << server->getErrorString().toLocal8Bit().constData()
+            << std::endl;
+  return false;
+}
+
 /// \brief Initialize resources and translations and show the main window.
 int main(int argc, char *argv[]) {
-  std::cout << "Version " << VERSION << std::endl;
+  // The headless mode doesn't need a display and keeps stdout for the data
+  bool headless = false;
+  for (int arg = 1; arg < argc; ++arg) {
+    if (QLatin1String(argv[arg]) == QLatin1String("--headless"))
+      headless = true;
+  }
+
+  (headless ? std::cerr : std::cout) << "Version " << VERSION << std::endl;
   Q_INIT_RESOURCE(application);
 
-  QApplication openHantekApplication(argc, argv);
+  QScopedPointer<QCoreApplication> openHantekApplication(
+      headless ? new QCoreApplication(argc, argv)
+               : new QApplication(argc, argv));
 
   QTranslator qtTranslator;
   if (qtTranslator.load("qt_" + QLocale::system().name(),
                         QLibraryInfo::location(QLibraryInfo::TranslationsPath)))
-    openHantekApplication.installTranslator(&qtTranslator);
+    openHantekApplication->installTranslator(&qtTranslator);
 
   QTranslator openHantekTranslator;
   if (openHantekTranslator.load(QLocale(), QLatin1String("openhantek"),
                                 QLatin1String("_"),
                                 QLatin1String(":/translations")))
-    openHantekApplication.installTranslator(&openHantekTranslator);
+    openHantekApplication->installTranslator(&openHantekTranslator);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      QCoreApplication::translate("main", "Hantek USB oscilloscope software"));
+  parser.addHelpOption();
+  QCommandLineOption recordOption(
+      "record", QCoreApplication::translate(
+                    "main", "Record all USB transfers to <file>."),
+      QCoreApplication::translate("main", "file"));
+  parser.addOption(recordOption);
+  QCommandLineOption replayOption(
+      "replay",
+      QCoreApplication::translate(
+          "main", "Replay the USB transfers from <file> instead of a device."),
+      QCoreApplication::translate("main", "file"));
+  parser.addOption(replayOption);
+  QCommandLineOption realtimeOption(
+      "realtime", QCoreApplication::translate(
+                      "main", "Replay with the recorded timing instead of "
+                              "the maximum speed."));
+  parser.addOption(realtimeOption);
+  QCommandLineOption syntheticOption(
+      "synthetic",
+      QCoreApplication::translate(
+          "main", "Generate the comma separated <signals> instead of using a "
+                  "device, e.g. sine:1kHz:1V,am:100kHz:2V:1kHz."),
+      QCoreApplication::translate("main", "signals"));
+  parser.addOption(syntheticOption);
+  QCommandLineOption traceOption(
+      "trace",
+      QCoreApplication::translate(
+          "main", "Trace the processing stages and write them to <file> as "
+                  "Chrome trace event JSON on exit."),
+      QCoreApplication::translate("main", "file"));
+  parser.addOption(traceOption);
+  QCommandLineOption headlessOption(
+      "headless",
+      QCoreApplication::translate(
+          "main", "Acquire without the graphical interface and write the "
+                  "measurements of every acquisition as CSV lines."));
+  parser.addOption(headlessOption);
+  QCommandLineOption settingsOption(
+      "settings",
+      QCoreApplication::translate(
+          "main", "Headless: Configure the oscilloscope from the settings "
+                  "<file> instead of the saved configuration."),
+      QCoreApplication::translate("main", "file"));
+  parser.addOption(settingsOption);
+  QCommandLineOption outputOption(
+      "output",
+      QCoreApplication::translate(
+          "main", "Headless: Write the measurements to <file>, - for stdout."),
+      QCoreApplication::translate("main", "file"), "-");
+  parser.addOption(outputOption);
+  QCommandLineOption samplesOption(
+      "samples",
+      QCoreApplication::translate(
+          "main", "Headless: Write the samples of every acquisition as CSV "
+                  "file into <directory>."),
+      QCoreApplication::translate("main", "directory"));
+  parser.addOption(samplesOption);
+  QCommandLineOption framesOption(
+      "frames",
+      QCoreApplication::translate(
+          "main", "Headless: Exit after <count> acquisitions."),
+      QCoreApplication::translate("main", "count"));
+  parser.addOption(framesOption);
+  QCommandLineOption listenOption(
+      "listen",
+      QCoreApplication::translate(
+          "main", "Accept SCPI commands on the local TCP port or Unix socket "
+                  "<address>."),
+      QCoreApplication::translate("main", "address"));
+  parser.addOption(listenOption);
+  QCommandLineOption sharedMemoryOption(
+      "shared-memory",
+      QCoreApplication::translate(
+          "main", "Publish every acquisition into the shared memory ring "
+                  "<name> for other processes."),
+      QCoreApplication::translate("main", "name"));
+  parser.addOption(sharedMemoryOption);
+  QCommandLineOption devicesOption(
+      "devices",
+      QCoreApplication::translate(
+          "main", "Combine <count> oscilloscopes into one with the channels of "
+                  "all of them."),
+      QCoreApplication::translate("main", "count"), "1");
+  parser.addOption(devicesOption);
+  QCommandLineOption firmwareOption(
+      "firmware",
+      QCoreApplication::translate(
+          "main", "Upload the firmware from the HEX files in <directory> to "
+                  "oscilloscopes without firmware, :/firmware uses the files "
+                  "built into the program."),
+      QCoreApplication::translate("main", "directory"));
+  parser.addOption(firmwareOption);
+  parser.process(*openHantekApplication);
+
+  if (parser.isSet(traceOption))
+    Tracing::setEnabled(true);
+
+  bool ok;
+  unsigned int deviceCount = parser.value(devicesOption).toUInt(&ok);
+  if (!ok || deviceCount == 0) {
+    std::cerr << "Invalid device count" << std::endl;
+    return 1;
+  }
+  if (deviceCount > 1 &&
+      (parser.isSet(replayOption) || parser.isSet(recordOption))) {
+    std::cerr << "Recording and replaying support only one device"
+              << std::endl;
+    return 1;
+  }
+
+  // Every device has its own control thread
+  QList<DsoControl *> devices;
+  for (unsigned int device = 0; device < deviceCount; ++device) {
+    if (parser.isSet(syntheticOption)) {
+      Synthetic::Control *syntheticControl = new Synthetic::Control();
+      QStringList signalList = parser.value(syntheticOption).split(',');
+      for (int channel = 0; channel < signalList.size(); ++channel) {
+        Synthetic::Signal signal;
+        if (!signal.parse(signalList[channel]) ||
+            syntheticControl->setSignal(channel, signal) != Dso::ERROR_NONE) {
+          std::cerr << "Invalid signal: "
+                    << signalList[channel].toLocal8Bit().constData()
+                    << std::endl;
+          return 1;
+        }
+      }
+      devices << syntheticControl;
+    } else {
+      Hantek::Control *hantekControl = new Hantek::Control();
+      hantekControl->setDeviceIndex(device);
+      if (parser.isSet(firmwareOption))
+        hantekControl->setFirmwareDirectory(parser.value(firmwareOption));
+      if (parser.isSet(replayOption))
+        hantekControl->useReplay(parser.value(replayOption),
+                                 parser.isSet(realtimeOption));
+      if (parser.isSet(recordOption))
+        hantekControl->startCapture(parser.value(recordOption));
+      devices << hantekControl;
+    }
+  }
+  DsoControl *dsoControl = devices.first();
+  if (deviceCount > 1)
+    dsoControl = new MultiControl(devices);
+
+  // Published in the control thread, so readers get the frames immediately
+  SharedRing sharedRing;
+  if (parser.isSet(sharedMemoryOption)) {
+    if (!sharedRing.open(parser.value(sharedMemoryOption),
+                         dsoControl->getChannelCount())) {
+      std::cerr << "Can't create the shared memory ring: "
+                << sharedRing.getErrorString().toLocal8Bit().constData()
+                << std::endl;
+      return 1;
+    }
+    QObject::connect(
+        dsoControl,
+        SIGNAL(samplesAvailable(const std::vector<std::vector<double>> *,
+                                double, bool, QMutex *)),
+        &sharedRing,
+        SLOT(publish(const std::vector<std::vector<double>> *, double, bool,
+                     QMutex *)),
+        Qt::DirectConnection);
+  }
+
+  int result;
+  if (headless) {
+    DsoSettings settings;
+    settings.setChannelCount(dsoControl->getChannelCount());
+    if (parser.isSet(settingsOption) &&
+        !QFile::exists(parser.value(settingsOption))) {
+      std::cerr << "Settings file not found: "
+                << parser.value(settingsOption).toLocal8Bit().constData()
+                << std::endl;
+      return 1;
+    }
+    settings.load(parser.value(settingsOption));
+
+    HeadlessAcquisition acquisition(dsoControl, &settings);
+    if (!acquisition.setOutput(parser.value(outputOption))) {
+      std::cerr << "Can't open output: "
+                << parser.value(outputOption).toLocal8Bit().constData()
+                << std::endl;
+      return 1;
+    }
+    acquisition.setSamplesDirectory(parser.value(samplesOption));
+    acquisition.setFrameLimit(parser.value(framesOption).toUInt());
+    if (parser.isSet(listenOption) &&
+        !startRemoteServer(new RemoteServer(dsoControl, &settings,
+                                            acquisition.getDataAnalyzer(),
+                                            &acquisition),
+                           parser.value(listenOption)))
+      return 1;
+    if (!acquisition.start())
+      return 1;
+
+    result = openHantekApplication->exec();
+
+    dsoControl->quit();
+    dsoControl->wait();
+  } else {
+    OpenHantekMainWindow *openHantekMainWindow =
+        new OpenHantekMainWindow(dsoControl);
+    openHantekMainWindow->show();
+    if (parser.isSet(listenOption)) {
+      RemoteServer *server =
+          new RemoteServer(dsoControl, openHantekMainWindow->getSettings(),
+                           openHantekMainWindow->getDataAnalyzer(),
+                           openHantekMainWindow);
+      QObject::connect(server, SIGNAL(settingsChanged()),
+                       openHantekMainWindow, SLOT(updateWidgets()));
+      if (!startRemoteServer(server, parser.value(listenOption)))
+        return 1;
+    }
+
+    result = openHantekApplication->exec();
+
+    // The ring is unmapped on return, the control thread must not publish
+    dsoControl->quit();
+    dsoControl->wait();
+  }
 
-  OpenHantekMainWindow *openHantekMainWindow = new OpenHantekMainWindow();
-  openHantekMainWindow->show();
+  if (parser.isSet(traceOption)) {
+    Tracing::setEnabled(false);
+    if (!Tracing::exportChrome(parser.value(traceOption)))
+      std::cerr << "Can't write trace: "
+                << parser.value(traceOption).toLocal8Bit().constData()
+                << std::endl;
+  }
 
-  return openHantekApplication.exec();
+  return result;
 }
@@ -0,0 +1,669 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  mathexpression.cpp
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cmath>
+
+#include <QCoreApplication>
+
+#include "mathexpression.h"
+
+#define MATHEXPRESSION_AVGMAX 1048576 ///< Longest moving average in samples
+
+////////////////////////////////////////////////////////////////////////////////
+// class MathExpression
+/// \brief Initializes an empty expression.
+MathExpression::MathExpression() {
+  this->channelCount = 0;
+  this->clear();
+}
+
+/// \brief Parses the formula and compiles it into the stack machine code.
+/// \param source The formula.
+/// \param channelCount The number of channels that can be referenced.
+/// \return true on success, getError() describes the problem otherwise.
+bool MathExpression::compile(const QString &source,
+                             unsigned int channelCount) {
+  this->clear();
+  this->source = source;
+  this->channelCount = channelCount;
+  this->channelUsed.assign(channelCount, false);
+
+  if (!this->parseSum())
+    return false;
+  this->skipSpaces();
+  if (this->position < this->source.length())
+    return this->fail(QCoreApplication::tr("Unexpected '%1'")
+                          .arg(this->source.at(this->position)));
+
+  // Allocate one block for every stack entry and the instruction states
+  this->registers.resize(this->maxDepth * MATHEXPRESSION_BLOCK);
+  this->states.resize(this->code.size());
+  for (unsigned int index = 0; index < this->code.size(); ++index) {
+    if (this->code[index].opcode == OPCODE_AVG)
+      this->states[index].history.resize(this->code[index].operand);
+  }
+
+  this->valid = true;
+  return true;
+}
+
+/// \brief Drops the compiled code.
+void MathExpression::clear() {
+  this->source.clear();
+  this->error.clear();
+  this->valid = false;
+  this->channelUsed.clear();
+
+  this->position = 0;
+  this->code.clear();
+  this->depth = 0;
+  this->maxDepth = 0;
+
+  this->registers.clear();
+  this->states.clear();
+}
+
+/// \brief Checks if the expression can be evaluated.
+/// \return true, if the last compile() was successful.
+bool MathExpression::isValid() const { return this->valid; }
+
+/// \brief Returns the formula.
+/// \return The source passed to the last compile().
+const QString &MathExpression::getSource() const { return this->source; }
+
+/// \brief Returns the reason why the compilation failed.
+/// \return The error message, empty if the expression is valid.
+const QString &MathExpression::getError() const { return this->error; }
+
+/// \brief Checks if a channel is referenced by the expression.
+/// \param channel The channel index, 0 for CH1.
+/// \return true, if the samples of the channel are needed.
+bool MathExpression::usesChannel(unsigned int channel) const {
+  if (channel >= this->channelUsed.size())
+    return false;
+
+  return this->channelUsed[channel];
+}
+
+/// \brief Evaluates the expression for the given samples.
+/// \param channels The samples of all channels, the used ones need at least
+/// count samples.
+/// \param interval The time between two samples in seconds.
+/// \param count The number of result samples.
+/// \param result The vector the results are written to.
+void MathExpression::evaluate(
+    const std::vector<const std::vector<double> *> &channels, double interval,
+    unsigned int count, std::vector<double> *result) {
+  if (!this->valid) {
+    result->clear();
+    return;
+  }
+  for (unsigned int channel = 0; channel < this->channelUsed.size();
+       ++channel) {
+    if (this->channelUsed[channel] &&
+        (channel >= channels.size() || channels[channel]->size() < count)) {
+      result->clear();
+      return;
+    }
+  }
+
+  result->resize(count);
+
+  // Reset the stateful instructions, every evaluation starts from scratch
+  for (std::vector<State>::iterator state = this->states.begin();
+       state != this->states.end(); ++state) {
+    state->accumulator = 0.0;
+    state->previous = 0.0;
+    state->filled = 0;
+    state->position = 0;
+    std::fill(state->history.begin(), state->history.end(), 0.0);
+  }
+
+  for (unsigned int blockStart = 0; blockStart < count;
+       blockStart += MATHEXPRESSION_BLOCK) {
+    unsigned int blockSize =
+        qMin(count - blockStart, (unsigned int)MATHEXPRESSION_BLOCK);
+    unsigned int depth = 0;
+
+    for (unsigned int index = 0; index < this->code.size(); ++index) {
+      const Instruction &instruction = this->code[index];
+
+      // Push instructions use the next free register
+      if (instruction.opcode <= OPCODE_CONSTANT)
+        ++depth;
+      double *top = this->registers.data() + (depth - 1) * MATHEXPRESSION_BLOCK;
+      double *below = (depth >= 2) ? top - MATHEXPRESSION_BLOCK : top;
+
+      switch (instruction.opcode) {
+      case OPCODE_CHANNEL: {
+        const double *samples =
+            channels[instruction.operand]->data() + blockStart;
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          top[sample] = samples[sample];
+        break;
+      }
+      case OPCODE_TIME:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          top[sample] = (blockStart + sample) * interval;
+        break;
+      case OPCODE_CONSTANT:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          top[sample] = instruction.value;
+        break;
+
+      case OPCODE_ADD:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          below[sample] += top[sample];
+        --depth;
+        break;
+      case OPCODE_SUB:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          below[sample] -= top[sample];
+        --depth;
+        break;
+      case OPCODE_MUL:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          below[sample] *= top[sample];
+        --depth;
+        break;
+      case OPCODE_DIV:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          below[sample] /= top[sample];
+        --depth;
+        break;
+      case OPCODE_POW:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          below[sample] = std::pow(below[sample], top[sample]);
+        --depth;
+        break;
+      case OPCODE_MIN:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          below[sample] = qMin(below[sample], top[sample]);
+        --depth;
+        break;
+      case OPCODE_MAX:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          below[sample] = qMax(below[sample], top[sample]);
+        --depth;
+        break;
+
+      case OPCODE_NEG:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          top[sample] = -top[sample];
+        break;
+      case OPCODE_ABS:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          top[sample] = std::abs(top[sample]);
+        break;
+      case OPCODE_SQRT:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          top[sample] = std::sqrt(top[sample]);
+        break;
+      case OPCODE_SIN:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          top[sample] = std::sin(top[sample]);
+        break;
+      case OPCODE_COS:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          top[sample] = std::cos(top[sample]);
+        break;
+      case OPCODE_TAN:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          top[sample] = std::tan(top[sample]);
+        break;
+      case OPCODE_EXP:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          top[sample] = std::exp(top[sample]);
+        break;
+      case OPCODE_LOG:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          top[sample] = std::log(top[sample]);
+        break;
+      case OPCODE_LOG10:
+        for (unsigned int sample = 0; sample < blockSize; ++sample)
+          top[sample] = std::log10(top[sample]);
+        break;
+
+      case OPCODE_INTEG: {
+        State &state = this->states[index];
+        for (unsigned int sample = 0; sample < blockSize; ++sample) {
+          state.accumulator += top[sample] * interval;
+          top[sample] = state.accumulator;
+        }
+        break;
+      }
+      case OPCODE_DIFF: {
+        State &state = this->states[index];
+        // The first sample has no predecessor, its derivative is 0
+        if (!state.filled) {
+          state.previous = top[0];
+          state.filled = 1;
+        }
+        double previous = state.previous;
+        for (unsigned int sample = 0; sample < blockSize; ++sample) {
+          double current = top[sample];
+          top[sample] = (current - previous) / interval;
+          previous = current;
+        }
+        state.previous = previous;
+        break;
+      }
+      case OPCODE_AVG: {
+        State &state = this->states[index];
+        for (unsigned int sample = 0; sample < blockSize; ++sample) {
+          state.accumulator += top[sample] - state.history[state.position];
+          state.history[state.position] = top[sample];
+          if (++state.position == instruction.operand)
+            state.position = 0;
+          if (state.filled < instruction.operand)
+            ++state.filled;
+          top[sample] = state.accumulator / state.filled;
+        }
+        break;
+      }
+      }
+    }
+
+    const double *values = this->registers.data();
+    double *destination = result->data() + blockStart;
+    for (unsigned int sample = 0; sample < blockSize; ++sample)
+      destination[sample] = values[sample];
+  }
+}
+
+/// \brief Parses a sum or difference of products.
+/// \return true on success, false on a syntax error.
+bool MathExpression::parseSum() {
+  if (!this->parseProduct())
+    return false;
+
+  for (;;) {
+    this->skipSpaces();
+    if (this->position >= this->source.length())
+      return true;
+
+    QChar character = this->source.at(this->position);
+    if (character == '+' || character == '-') {
+      ++this->position;
+      if (!this->parseProduct())
+        return false;
+      this->append(character == '+' ? OPCODE_ADD : OPCODE_SUB);
+    } else
+      return true;
+  }
+}
+
+/// \brief Parses a product or quotient of signed factors.
+/// \return true on success, false on a syntax error.
+bool MathExpression::parseProduct() {
+  if (!this->parseUnary())
+    return false;
+
+  for (;;) {
+    this->skipSpaces();
+    if (this->position >= this->source.length())
+      return true;
+
+    QChar character = this->source.at(this->position);
+    if (character == '*' || character == '/') {
+      ++this->position;
+      if (!this->parseUnary())
+        return false;
+      this->append(character == '*' ? OPCODE_MUL : OPCODE_DIV);
+    } else
+      return true;
+  }
+}
+
+/// \brief Parses a factor with an optional sign.
+/// \return true on success, false on a syntax error.
+bool MathExpression::parseUnary() {
+  this->skipSpaces();
+  if (this->position < this->source.length()) {
+    QChar character = this->source.at(this->position);
+    if (character == '-') {
+      ++this->position;
+      if (!this->parseUnary())
+        return false;
+      this->append(OPCODE_NEG);
+      return true;
+    } else if (character == '+') {
+      ++this->position;
+      return this->parseUnary();
+    }
+  }
+
+  return this->parsePower();
+}
+
+/// \brief Parses a value with an optional exponent.
+/// \return true on success, false on a syntax error.
+bool MathExpression::parsePower() {
+  if (!this->parsePrimary())
+    return false;
+
+  this->skipSpaces();
+  if (this->position < this->source.length() &&
+      this->source.at(this->position) == '^') {
+    ++this->position;
+    // The exponent may have a sign and is right associative
+    if (!this->parseUnary())
+      return false;
+    this->append(OPCODE_POW);
+  }
+
+  return true;
+}
+
+/// \brief Parses a number, name, function call or bracketed expression.
+/// \return true on success, false on a syntax error.
+bool MathExpression::parsePrimary() {
+  this->skipSpaces();
+  if (this->position >= this->source.length())
+    return this->fail(QCoreApplication::tr("Unexpected end of expression"));
+
+  QChar character = this->source.at(this->position);
+  if (character == '(') {
+    ++this->position;
+    if (!this->parseSum())
+      return false;
+    this->skipSpaces();
+    if (this->position >= this->source.length() ||
+        this->source.at(this->position) != ')')
+      return this->fail(QCoreApplication::tr("Missing ')'"));
+    ++this->position;
+    return true;
+  }
+
+  if (character.isDigit() || character == '.') {
+    int start = this->position;
+    while (this->position < this->source.length() &&
+           (this->source.at(this->position).isDigit() ||
+            this->source.at(this->position) == '.'))
+      ++this->position;
+    // Exponent, but only if it isn't followed by something else like "e"
+    if (this->position < this->source.length() &&
+        this->source.at(this->position).toLower() == 'e') {
+      int exponent = this->position + 1;
+      if (exponent < this->source.length() &&
+          (this->source.at(exponent) == '+' ||
+           this->source.at(exponent) == '-'))
+        ++exponent;
+      if (exponent < this->source.length() &&
+          this->source.at(exponent).isDigit()) {
+        this->position = exponent;
+        while (this->position < this->source.length() &&
+               this->source.at(this->position).isDigit())
+          ++this->position;
+      }
+    }
+
+    bool ok;
+    double value =
+        this->source.mid(start, this->position - start).toDouble(&ok);
+    if (!ok) {
+      this->position = start;
+      return this->fail(QCoreApplication::tr("Invalid number"));
+    }
+    this->append(OPCODE_CONSTANT, 0, value);
+    return true;
+  }
+
+  if (character.isLetter() || character == '_') {
+    int start = this->position;
+    while (this->position < this->source.length() &&
+           (this->source.at(this->position).isLetterOrNumber() ||
+            this->source.at(this->position) == '_'))
+      ++this->position;
+    QString name = this->source.mid(start, this->position - start).toLower();
+
+    this->skipSpaces();
+    if (this->position < this->source.length() &&
+        this->source.at(this->position) == '(')
+      return this->parseFunction(name);
+
+    if (name == "t")
+      this->append(OPCODE_TIME);
+    else if (name == "pi")
+      this->append(OPCODE_CONSTANT, 0, M_PI);
+    else if (name == "e")
+      this->append(OPCODE_CONSTANT, 0, M_E);
+    else if (name.startsWith("ch")) {
+      bool ok;
+      unsigned int channel = name.mid(2).toUInt(&ok);
+      if (!ok || channel < 1 || channel > this->channelCount) {
+        this->position = start;
+        return this->fail(
+            QCoreApplication::tr("Unknown channel '%1'").arg(name));
+      }
+      this->channelUsed[channel - 1] = true;
+      this->append(OPCODE_CHANNEL, channel - 1);
+    } else {
+      this->position = start;
+      return this->fail(QCoreApplication::tr("Unknown name '%1'").arg(name));
+    }
+    return true;
+  }
+
+  return this->fail(QCoreApplication::tr("Unexpected '%1'").arg(character));
+}
+
+/// \brief Parses the arguments of a function and appends the function call.
+/// \param name The lower case function name, the position is at the '('.
+/// \return true on success, false on a syntax error.
+bool MathExpression::parseFunction(const QString &name) {
+  int start = this->position;
+  ++this->position;
+
+  unsigned int arguments = 0;
+  for (;;) {
+    if (!this->parseSum())
+      return false;
+    ++arguments;
+
+    this->skipSpaces();
+    if (this->position < this->source.length() &&
+        this->source.at(this->position) == ',') {
+      ++this->position;
+    } else if (this->position < this->source.length() &&
+               this->source.at(this->position) == ')') {
+      ++this->position;
+      break;
+    } else
+      return this->fail(QCoreApplication::tr("Missing ')'"));
+  }
+
+  Opcode opcode;
+  unsigned int expected = 1;
+  if (name == "abs")
+    opcode = OPCODE_ABS;
+  else if (name == "sqrt")
+    opcode = OPCODE_SQRT;
+  else if (name == "sin")
+    opcode = OPCODE_SIN;
+  else if (name == "cos")
+    opcode = OPCODE_COS;
+  else if (name == "tan")
+    opcode = OPCODE_TAN;
+  else if (name == "exp")
+    opcode = OPCODE_EXP;
+  else if (name == "log")
+    opcode = OPCODE_LOG;
+  else if (name == "log10")
+    opcode = OPCODE_LOG10;
+  else if (name == "integ")
+    opcode = OPCODE_INTEG;
+  else if (name == "diff")
+    opcode = OPCODE_DIFF;
+  else if (name == "min") {
+    opcode = OPCODE_MIN;
+    expected = 2;
+  } else if (name == "max") {
+    opcode = OPCODE_MAX;
+    expected = 2;
+  } else if (name == "avg") {
+    opcode = OPCODE_AVG;
+    expected = 2;
+  } else {
+    this->position = start;
+    return this->fail(QCoreApplication::tr("Unknown function '%1'").arg(name));
+  }
+
+  if (arguments != expected)
+    return this->fail(QCoreApplication::tr("%1() expects %2 argument(s)")
+                          .arg(name)
+                          .arg(expected));
+
+  if (opcode == OPCODE_AVG) {
+    // The averaging length has to be known at compile time
+    if (this->code.back().opcode != OPCODE_CONSTANT)
+      return this->fail(
+          QCoreApplication::tr("The length for avg() has to be a constant"));
+    double length = this->code.back().value;
+    if (!(length >= 1 && length <= MATHEXPRESSION_AVGMAX))
+      return this->fail(QCoreApplication::tr("The length for avg() has to be "
+                                         "between 1 and %1")
+                            .arg(MATHEXPRESSION_AVGMAX));
+    this->code.pop_back();
+    --this->depth;
+    this->append(OPCODE_AVG, (unsigned int)length);
+  } else
+    this->append(opcode);
+
+  return true;
+}
+
+/// \brief Stores the error message and drops the incomplete code.
+/// \param error The description of the syntax error.
+/// \return Always false.
+bool MathExpression::fail(const QString &error) {
+  this->error = QCoreApplication::tr("%1 at position %2")
+                    .arg(error)
+                    .arg(this->position + 1);
+  this->valid = false;
+  this->code.clear();
+  return false;
+}
+
+/// \brief Moves the parser position behind whitespace.
+void MathExpression::skipSpaces() {
+  while (this->position < this->source.length() &&
+         this->source.at(this->position).isSpace())
+    ++this->position;
+}
+
+/// \brief Appends an instruction, operations on constants are calculated
+/// directly.
+/// \param opcode The operation.
+/// \param operand The channel or averaging length.
+/// \param value The value for OPCODE_CONSTANT.
+void MathExpression::append(Opcode opcode, unsigned int operand,
+                            double value) {
+  unsigned int arguments = 0;
+  if (opcode >= OPCODE_ADD && opcode <= OPCODE_MAX)
+    arguments = 2;
+  else if (opcode >= OPCODE_NEG)
+    arguments = 1;
+
+  // The topmost stack entries are constants when the last instructions are
+  if (isFoldable(opcode) && this->code.size() >= arguments) {
+    bool constant = true;
+    for (unsigned int argument = 1; argument <= arguments; ++argument) {
+      if (this->code[this->code.size() - argument].opcode != OPCODE_CONSTANT)
+        constant = false;
+    }
+
+    if (constant) {
+      double second = 0.0;
+      if (arguments == 2) {
+        second = this->code.back().value;
+        this->code.pop_back();
+        --this->depth;
+      }
+      this->code.back().value = apply(opcode, this->code.back().value, second);
+      return;
+    }
+  }
+
+  Instruction instruction;
+  instruction.opcode = opcode;
+  instruction.operand = operand;
+  instruction.value = value;
+  this->code.push_back(instruction);
+
+  if (arguments == 0) {
+    ++this->depth;
+    if (this->depth > this->maxDepth)
+      this->maxDepth = this->depth;
+  } else if (arguments == 2)
+    --this->depth;
+}
+
+/// \brief Checks if an operation can be calculated at compile time.
+/// \param opcode The operation.
+/// \return true for stateless operations that take arguments.
+bool MathExpression::isFoldable(Opcode opcode) {
+  return opcode >= OPCODE_ADD && opcode <= OPCODE_LOG10;
+}
+
+/// \brief Calculates a stateless operation for single values.
+/// \param opcode The operation.
+/// \param first The first (or only) argument.
+/// \param second The second argument of binary operations.
+/// \return The result of the operation.
+double MathExpression::apply(Opcode opcode, double first, double second) {
+  switch (opcode) {
+  case OPCODE_ADD:
+    return first + second;
+  case OPCODE_SUB:
+    return first - second;
+  case OPCODE_MUL:
+    return first * second;
+  case OPCODE_DIV:
+    return first / second;
+  case OPCODE_POW:
+    return std::pow(first, second);
+  case OPCODE_MIN:
+    return qMin(first, second);
+  case OPCODE_MAX:
+    return qMax(first, second);
+  case OPCODE_NEG:
+    return -first;
+  case OPCODE_ABS:
+    return std::abs(first);
+  case OPCODE_SQRT:
+    return std::sqrt(first);
+  case OPCODE_SIN:
+    return std::sin(first);
+  case OPCODE_COS:
+    return std::cos(first);
+  case OPCODE_TAN:
+    return std::tan(first);
+  case OPCODE_EXP:
+    return std::exp(first);
+  case OPCODE_LOG:
+    return std::log(first);
+  case OPCODE_LOG10:
+    return std::log10(first);
+  default:
+    return first;
+  }
+}
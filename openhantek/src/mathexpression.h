@@ -0,0 +1,136 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file mathexpression.h
+/// \brief Declares the MathExpression class.
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MATHEXPRESSION_H
+#define MATHEXPRESSION_H
+
+#include <vector>
+
+#include <QString>
+
+#define MATHEXPRESSION_BLOCK 256 ///< Samples processed by one instruction
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class MathExpression                                       mathexpression.h
+/// \brief A formula for the math channel, compiled into stack machine code.
+/// The formula is parsed once, the code is then evaluated blockwise. Every
+/// instruction processes a whole block of samples in a tight loop, so the
+/// interpreter overhead is paid once per block and not once per sample.
+///
+/// Supported are the channels CH1 ... CHn, the time t in seconds, numbers, the
+/// constants pi and e, the operators + - * / ^ and the functions abs, sqrt,
+/// sin, cos, tan, exp, log, log10, min(a, b), max(a, b), integ(x) (running
+/// integral), diff(x) (derivative) and avg(x, n) (moving average over n
+/// samples).
+class MathExpression {
+public:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \enum Opcode                                            mathexpression.h
+  /// \brief The instructions of the stack machine.
+  enum Opcode {
+    OPCODE_CHANNEL,  ///< Push the samples of the channel given by the operand
+    OPCODE_TIME,     ///< Push the time of each sample
+    OPCODE_CONSTANT, ///< Push the constant value
+    OPCODE_ADD,      ///< Add the two topmost blocks
+    OPCODE_SUB,      ///< Subtract the topmost block from the one below
+    OPCODE_MUL,      ///< Multiply the two topmost blocks
+    OPCODE_DIV,      ///< Divide the block below by the topmost block
+    OPCODE_POW,      ///< Raise the block below to the power of the topmost
+    OPCODE_MIN,      ///< Minimum of the two topmost blocks
+    OPCODE_MAX,      ///< Maximum of the two topmost blocks
+    OPCODE_NEG,      ///< Negate the topmost block
+    OPCODE_ABS,      ///< Absolute value
+    OPCODE_SQRT,     ///< Square root
+    OPCODE_SIN,      ///< Sine
+    OPCODE_COS,      ///< Cosine
+    OPCODE_TAN,      ///< Tangent
+    OPCODE_EXP,      ///< Exponential function
+    OPCODE_LOG,      ///< Natural logarithm
+    OPCODE_LOG10,    ///< Decimal logarithm
+    OPCODE_INTEG,    ///< Running integral over the samples
+    OPCODE_DIFF,     ///< Derivative of the samples
+    OPCODE_AVG       ///< Moving average over operand samples
+  };
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// \struct Instruction                                     mathexpression.h
+  /// \brief One instruction of the compiled code.
+  struct Instruction {
+    Opcode opcode;        ///< The operation
+    unsigned int operand; ///< Channel or averaging length
+    double value;         ///< The value for OPCODE_CONSTANT
+  };
+
+  MathExpression();
+
+  bool compile(const QString &source, unsigned int channelCount);
+  void clear();
+
+  bool isValid() const;
+  const QString &getSource() const;
+  const QString &getError() const;
+  bool usesChannel(unsigned int channel) const;
+
+  void evaluate(const std::vector<const std::vector<double> *> &channels,
+                double interval, unsigned int count,
+                std::vector<double> *result);
+
+private:
+  //////////////////////////////////////////////////////////////////////////////
+  /// \struct State                                           mathexpression.h
+  /// \brief The values of stateful instructions that are kept between blocks.
+  struct State {
+    double accumulator;          ///< Running sum
+    double previous;             ///< The previous sample
+    unsigned int filled;         ///< Number of valid samples in history
+    unsigned int position;       ///< Next write position in history
+    std::vector<double> history; ///< The last samples for OPCODE_AVG
+  };
+
+  bool parseSum();
+  bool parseProduct();
+  bool parseUnary();
+  bool parsePower();
+  bool parsePrimary();
+  bool parseFunction(const QString &name);
+  bool fail(const QString &error);
+  void skipSpaces();
+
+  void append(Opcode opcode, unsigned int operand = 0, double value = 0.0);
+  static bool isFoldable(Opcode opcode);
+  static double apply(Opcode opcode, double first, double second);
+
+  QString source;                ///< The formula as entered by the user
+  QString error;                 ///< Description of the compile error
+  bool valid;                    ///< true, if the formula has been compiled
+  unsigned int channelCount;     ///< Number of channels that can be used
+  std::vector<bool> channelUsed; ///< true for each referenced channel
+
+  int position;                  ///< Parser position in the source
+  std::vector<Instruction> code; ///< The compiled instructions
+  unsigned int depth;            ///< Stack depth while compiling
+  unsigned int maxDepth;         ///< Maximum stack depth of the code
+
+  std::vector<double> registers; ///< One block for each stack entry
+  std::vector<State> states;     ///< The state of each instruction
+};
+
+#endif
@@ -0,0 +1,832 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  multicontrol.cpp
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <cstdint>
+
+#include <QMutexLocker>
+#include <QStringList>
+
+#include "multicontrol.h"
+
+#include "helper.h"
+#include "tracing.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// struct MultiControlStatistics
+/// \brief Initializes the counters.
+MultiControlStatistics::MultiControlStatistics() {
+  this->frames = 0;
+  this->samples = 0;
+  this->merged = 0;
+  this->dropped = 0;
+  this->skew = 0;
+  this->start = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// struct MultiControlFrame
+/// \brief Initializes an empty frame.
+MultiControlFrame::MultiControlFrame() {
+  this->samplerate = 0.0;
+  this->append = false;
+  this->pending = false;
+  this->time = 0;
+  this->sequence = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class MultiControlInput
+/// \brief Initializes the receiver for one device.
+/// \param control The control that merges the devices.
+/// \param index The index of the device in the control.
+MultiControlInput::MultiControlInput(MultiControl *control, unsigned int index)
+    : QObject(control) {
+  this->control = control;
+  this->index = index;
+}
+
+/// \brief Tells the control that the device has been connected.
+void MultiControlInput::deviceConnected() {
+  this->control->deviceConnected(this->index);
+}
+
+/// \brief Hands new samples of the device to the control.
+/// \param data The data arrays with the samples of each channel.
+/// \param samplerate The samplerate for all samples.
+/// \param append The samples continue the previous ones (Roll mode).
+/// \param mutex The mutex for the data arrays.
+void MultiControlInput::samplesAvailable(
+    const std::vector<std::vector<double>> *data, double samplerate,
+    bool append, QMutex *mutex) {
+  this->control->receive(this->index, data, samplerate, append, mutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class MultiControl
+/// \brief Combines the given devices, they become children of the control.
+/// \param devices The oscilloscopes, the first one provides the horizontal
+/// limits.
+/// \param parent The parent object.
+MultiControl::MultiControl(const QList<DsoControl *> &devices, QObject *parent)
+    : DsoControl(parent), framesMutex(QMutex::Recursive) {
+  this->devices = devices;
+  this->connectedDevices = 0;
+  this->mergeWindow = MULTICONTROL_MERGE_WINDOW;
+  this->externalTrigger = true;
+  this->triggerSpecial = false;
+  this->triggerSource = 0;
+  this->lastSummary = 0;
+  this->arrivalPending = false;
+  this->replaying = false;
+
+  unsigned int channels = 0;
+  for (int index = 0; index < this->devices.size(); ++index) {
+    DsoControl *device = this->devices[index];
+    device->setParent(this);
+    device->setAutoConnect(false);
+    this->channelOffsets << channels;
+    channels += device->getChannelCount();
+
+    MultiControlInput *input = new MultiControlInput(this, index);
+    this->inputs << input;
+    connect(device, SIGNAL(deviceConnected()), input, SLOT(deviceConnected()),
+            Qt::DirectConnection);
+    // The samples are merged in the thread of the device that completes them
+    connect(device,
+            SIGNAL(samplesAvailable(const std::vector<std::vector<double>> *,
+                                    double, bool, QMutex *)),
+            input,
+            SLOT(samplesAvailable(const std::vector<std::vector<double>> *,
+                                  double, bool, QMutex *)),
+            Qt::DirectConnection);
+    connect(device, SIGNAL(deviceDisconnected()), this, SLOT(deviceLost()));
+    connect(device, SIGNAL(deviceAvailable()), this, SLOT(deviceAvailable()));
+    connect(device, SIGNAL(statusMessage(QString, int)), this,
+            SIGNAL(statusMessage(QString, int)));
+  }
+
+  // The horizontal settings are the same for all devices
+  if (!this->devices.isEmpty()) {
+    DsoControl *first = this->devices.first();
+    connect(first,
+            SIGNAL(availableRecordLengthsChanged(const QList<unsigned int> &)),
+            this,
+            SIGNAL(availableRecordLengthsChanged(const QList<unsigned int> &)));
+    connect(first, SIGNAL(samplerateLimitsChanged(double, double)), this,
+            SIGNAL(samplerateLimitsChanged(double, double)));
+    connect(first, SIGNAL(recordLengthChanged(unsigned long)), this,
+            SIGNAL(recordLengthChanged(unsigned long)));
+    connect(first, SIGNAL(recordTimeChanged(double)), this,
+            SIGNAL(recordTimeChanged(double)));
+    connect(first, SIGNAL(samplerateChanged(double)), this,
+            SIGNAL(samplerateChanged(double)));
+    connect(first, SIGNAL(samplerateSet(int, QList<double>)), this,
+            SIGNAL(samplerateSet(int, QList<double>)));
+    this->specialTriggerSources = *first->getSpecialTriggerSources();
+  }
+
+  this->frames.resize(this->devices.size());
+  for (int index = 0; index < this->devices.size(); ++index)
+    this->statistics << MultiControlStatistics();
+  this->samples.resize(channels);
+
+  connect(this, SIGNAL(finished()), this, SLOT(threadFinished()));
+}
+
+/// \brief Stops the control threads of all devices.
+MultiControl::~MultiControl() {
+  this->quit();
+  this->wait();
+  for (int index = 0; index < this->devices.size(); ++index) {
+    this->devices[index]->quit();
+    this->devices[index]->wait();
+  }
+}
+
+/// \brief Gets the channel count of all devices together.
+/// \return The number of merged channels.
+unsigned int MultiControl::getChannelCount() { return this->samples.size(); }
+
+/// \brief Get available record lengths of the first device.
+/// \return The record lengths, UINT_MAX for roll mode.
+QList<unsigned int> *MultiControl::getAvailableRecordLengths() {
+  return this->devices.first()->getAvailableRecordLengths();
+}
+
+/// \brief Get the lowest samplerate all devices support.
+/// \return The minimum samplerate in S/s.
+double MultiControl::getMinSamplerate() {
+  double minimum = 0.0;
+  for (int index = 0; index < this->devices.size(); ++index)
+    minimum = qMax(minimum, this->devices[index]->getMinSamplerate());
+
+  return minimum;
+}
+
+/// \brief Get the highest samplerate all devices support.
+/// \return The maximum samplerate in S/s.
+double MultiControl::getMaxSamplerate() {
+  double maximum = this->devices.first()->getMaxSamplerate();
+  for (int index = 1; index < this->devices.size(); ++index)
+    maximum = qMin(maximum, this->devices[index]->getMaxSamplerate());
+
+  return maximum;
+}
+
+/// \brief Get the number of combined devices.
+/// \return The number of devices given to the constructor.
+unsigned int MultiControl::getDeviceCount() const {
+  return this->devices.size();
+}
+
+/// \brief Get one of the combined devices.
+/// \param index The index of the device.
+/// \return The device, its channels start at the sum of the channel counts of
+/// the devices before it.
+DsoControl *MultiControl::getDevice(unsigned int index) const {
+  return this->devices[index];
+}
+
+/// \brief Get the throughput of a device.
+/// \param index The index of the device.
+/// \return A copy of the statistics since sampling started.
+MultiControlStatistics MultiControl::getStatistics(unsigned int index) {
+  QMutexLocker locker(&this->framesMutex);
+  return this->statistics[index];
+}
+
+/// \brief Describes the throughput of all devices.
+/// \return One line with the rates, dropped frames and skew of each device.
+QString MultiControl::getStatisticsSummary() {
+  QMutexLocker locker(&this->framesMutex);
+  qint64 now = Tracing::now();
+
+  QStringList parts;
+  for (int index = 0; index < this->statistics.size(); ++index) {
+    const MultiControlStatistics &statistics = this->statistics[index];
+    double seconds = qMax(now - statistics.start, (qint64)1) / 1e9;
+    parts << tr("Device %1: %2 frames/s, %3/s, %4 dropped, skew %5")
+                 .arg(index + 1)
+                 .arg(statistics.frames / seconds, 0, 'f', 1)
+                 .arg(Helper::valueToString(statistics.samples / seconds,
+                                            Helper::UNIT_SAMPLES, 3))
+                 .arg(statistics.dropped)
+                 .arg(Helper::valueToString(statistics.skew / 1e9,
+                                            Helper::UNIT_SECONDS, 3));
+  }
+
+  return parts.join(" | ");
+}
+
+/// \brief Sets how far apart the roll blocks of the devices may arrive.
+/// Triggered acquisitions are limited to one record time instead.
+/// \param duration The merge window in s.
+void MultiControl::setMergeWindow(double duration) {
+  QMutexLocker locker(&this->framesMutex);
+  this->mergeWindow = duration;
+}
+
+/// \brief Selects how the devices without the trigger source are triggered.
+/// \param enabled true to trigger them on their EXT input, false to trigger
+/// every device on its own first channel.
+void MultiControl::setExternalTrigger(bool enabled) {
+  this->externalTrigger = enabled;
+  this->setTriggerSource(this->triggerSpecial, this->triggerSource);
+}
+
+/// \brief Keeps the devices running until the control gets disconnected.
+void MultiControl::run() {
+  exec();
+
+  for (int index = 0; index < this->devices.size(); ++index) {
+    this->devices[index]->quit();
+    this->devices[index]->wait();
+  }
+
+  emit statusMessage(tr("The devices have been disconnected"), 0);
+}
+
+/// \brief Finds the device a merged channel belongs to.
+/// \param channel The merged channel.
+/// \param device Receives the index of the device.
+/// \param deviceChannel Receives the channel on the device.
+/// \return false if the channel doesn't exist.
+bool MultiControl::findChannel(unsigned int channel, unsigned int *device,
+                               unsigned int *deviceChannel) const {
+  for (int index = this->devices.size() - 1; index >= 0; --index) {
+    if (channel < this->channelOffsets[index])
+      continue;
+
+    *device = index;
+    *deviceChannel = channel - this->channelOffsets[index];
+    return *deviceChannel < this->devices[index]->getChannelCount();
+  }
+
+  return false;
+}
+
+/// \brief Counts the connected devices.
+/// \param index The index of the device that has been connected.
+void MultiControl::deviceConnected(unsigned int index) {
+  Q_UNUSED(index);
+
+  ++this->connectedDevices;
+}
+
+/// \brief Stores new samples of a device and merges them if possible.
+/// \param index The index of the device that sent the samples.
+/// \param data The data arrays with the samples of each channel.
+/// \param samplerate The samplerate for all samples.
+/// \param append The samples continue the previous ones (Roll mode).
+/// \param mutex The mutex for the data arrays.
+void MultiControl::receive(unsigned int index,
+                           const std::vector<std::vector<double>> *data,
+                           double samplerate, bool append, QMutex *mutex) {
+  Tracing::Scope span("MultiControl::receive");
+
+  // Recursive, so the receivers of the merged samples may restart sampling
+  QMutexLocker locker(&this->framesMutex);
+  MultiControlFrame *frame = &(this->frames[index]);
+  MultiControlStatistics *statistics = &(this->statistics[index]);
+
+  // Roll blocks are collected, other acquisitions replace unmerged ones
+  bool collect = append && frame->pending && frame->append;
+  if (frame->pending && !collect)
+    ++statistics->dropped;
+
+  quint64 count = 0;
+  mutex->lock();
+  if (!collect)
+    frame->samples.resize(data->size());
+  for (unsigned int channel = 0; channel < data->size(); ++channel) {
+    const std::vector<double> &source = (*data)[channel];
+    if (collect)
+      frame->samples[channel].insert(frame->samples[channel].end(),
+                                     source.begin(), source.end());
+    else
+      frame->samples[channel] = source;
+    count += source.size();
+  }
+  mutex->unlock();
+
+  frame->samplerate = samplerate;
+  frame->append = append;
+  frame->pending = true;
+  frame->time = Tracing::now();
+  if (!collect)
+    ++frame->sequence;
+  ++statistics->frames;
+  statistics->samples += count;
+
+  if (this->merge()) {
+    const MultiControlFrame &first = this->frames.front();
+    emit samplesAvailable(&(this->samples), first.samplerate, first.append,
+                          &(this->samplesMutex));
+  }
+
+  if (frame->time - this->lastSummary >=
+      MULTICONTROL_STATISTICS_INTERVAL * 1000000LL) {
+    this->lastSummary = frame->time;
+    emit statusMessage(this->getStatisticsSummary(), 0);
+  }
+}
+
+/// \brief Merges the pending frames of all devices into the merged channels.
+/// Frames that can't belong to the same trigger event are dropped.
+/// \return true if the merged channels contain a new frame.
+bool MultiControl::merge() {
+  if (this->frames.empty())
+    return false;
+
+  // Every device has to contribute
+  qint64 oldest = 0;
+  qint64 newest = 0;
+  unsigned int newestIndex = 0;
+  quint64 sequence = 0;
+  double recordTime = 0.0;
+  for (unsigned int index = 0; index < this->frames.size(); ++index) {
+    const MultiControlFrame &frame = this->frames[index];
+    if (!frame.pending)
+      return false;
+
+    if (!index || frame.time < oldest)
+      oldest = frame.time;
+    if (!index || frame.time > newest) {
+      newest = frame.time;
+      newestIndex = index;
+    }
+    sequence = qMax(sequence, frame.sequence);
+    if (!frame.append && frame.samplerate > 0 && !frame.samples.empty())
+      recordTime = qMax(recordTime, frame.samples.front().size() /
+                                        frame.samplerate);
+  }
+
+  // Frames with other horizontal settings, or triggered frames of devices
+  // that don't share the trigger event
+  const MultiControlFrame &first = this->frames.front();
+  bool dropped = false;
+  for (unsigned int index = 0; index < this->frames.size(); ++index) {
+    MultiControlFrame *frame = &(this->frames[index]);
+    if (std::fabs(frame->samplerate - first.samplerate) >
+            first.samplerate * 1e-9 ||
+        frame->append != first.append ||
+        (!frame->append && !this->externalTrigger)) {
+      frame->pending = false;
+      ++this->statistics[index].dropped;
+      dropped = true;
+    }
+  }
+  if (dropped)
+    return false;
+
+  if (!first.append) {
+    // The partners of older acquisitions have been replaced already
+    for (unsigned int index = 0; index < this->frames.size(); ++index) {
+      MultiControlFrame *frame = &(this->frames[index]);
+      if (frame->sequence < sequence) {
+        frame->pending = false;
+        ++this->statistics[index].dropped;
+        dropped = true;
+      }
+    }
+    if (dropped)
+      return false;
+
+    // A device missed a trigger event, start counting at the newest frame.
+    // Replayed segments arrive when each device has converted them again.
+    if (!this->replaying && newest - oldest > (qint64)(recordTime * 1e9)) {
+      for (unsigned int index = 0; index < this->frames.size(); ++index) {
+        MultiControlFrame *frame = &(this->frames[index]);
+        if (index == newestIndex) {
+          frame->sequence = 1;
+          continue;
+        }
+        frame->pending = false;
+        frame->sequence = 0;
+        ++this->statistics[index].dropped;
+      }
+      return false;
+    }
+  } else if (newest - oldest > (qint64)(this->mergeWindow * 1e9)) {
+    // Roll blocks of one device are collected until the others catch up
+    for (unsigned int index = 0; index < this->frames.size(); ++index) {
+      MultiControlFrame *frame = &(this->frames[index]);
+      if (index == newestIndex)
+        continue;
+      frame->pending = false;
+      ++this->statistics[index].dropped;
+    }
+    return false;
+  }
+
+  // Roll blocks are merged as far as all devices have samples
+  size_t length = 0;
+  if (first.append) {
+    length = SIZE_MAX;
+    for (unsigned int index = 0; index < this->frames.size(); ++index) {
+      size_t deviceLength = 0;
+      const MultiControlFrame &frame = this->frames[index];
+      for (unsigned int channel = 0; channel < frame.samples.size(); ++channel)
+        deviceLength = qMax(deviceLength, frame.samples[channel].size());
+      length = qMin(length, deviceLength);
+    }
+    if (!length)
+      return false;
+  }
+
+  QMutexLocker locker(&this->samplesMutex);
+  for (unsigned int index = 0; index < this->frames.size(); ++index) {
+    MultiControlFrame *frame = &(this->frames[index]);
+    unsigned int channels =
+        qMin((unsigned int)frame->samples.size(),
+             this->devices[index]->getChannelCount());
+    for (unsigned int channel = 0; channel < channels; ++channel) {
+      std::vector<double> &source = frame->samples[channel];
+      std::vector<double> &target =
+          this->samples[this->channelOffsets[index] + channel];
+      if (first.append) {
+        size_t count = qMin(length, source.size());
+        target.assign(source.begin(), source.begin() + count);
+        source.erase(source.begin(), source.begin() + count);
+      } else {
+        target.swap(source);
+      }
+    }
+
+    frame->pending = false;
+    if (first.append)
+      for (unsigned int channel = 0; channel < frame->samples.size();
+           ++channel)
+        frame->pending = frame->pending || !frame->samples[channel].empty();
+
+    MultiControlStatistics *statistics = &(this->statistics[index]);
+    ++statistics->merged;
+    statistics->skew = frame->time - first.time;
+  }
+  this->replaying = false;
+
+  return true;
+}
+
+/// \brief Restarts the statistics and discards the unmerged frames.
+void MultiControl::resetStatistics() {
+  QMutexLocker locker(&this->framesMutex);
+  qint64 now = Tracing::now();
+  for (unsigned int index = 0; index < this->frames.size(); ++index) {
+    this->frames[index].pending = false;
+    this->frames[index].sequence = 0;
+    this->statistics[index] = MultiControlStatistics();
+    this->statistics[index].start = now;
+  }
+  this->lastSummary = now;
+}
+
+/// \brief Connects all devices, fails if one of them can't be connected.
+void MultiControl::connectDevice() {
+  this->connectedDevices = 0;
+  for (int index = 0; index < this->devices.size(); ++index)
+    this->devices[index]->connectDevice();
+
+  if (this->connectedDevices < (unsigned int)this->devices.size()) {
+    for (int index = 0; index < this->devices.size(); ++index) {
+      this->devices[index]->quit();
+      this->devices[index]->wait();
+    }
+    emit statusMessage(tr("Only %1 of %2 oscilloscopes connected")
+                           .arg(this->connectedDevices)
+                           .arg(this->devices.size()),
+                       0);
+    return;
+  }
+
+  this->resetStatistics();
+  DsoControl::connectDevice();
+}
+
+/// \brief Disconnects all devices.
+void MultiControl::disconnectDevice() {
+  for (int index = 0; index < this->devices.size(); ++index)
+    this->devices[index]->disconnectDevice();
+
+  DsoControl::disconnectDevice();
+}
+
+/// \brief Starts sampling on all devices.
+void MultiControl::startSampling() {
+  this->resetStatistics();
+  for (int index = 0; index < this->devices.size(); ++index)
+    this->devices[index]->startSampling();
+
+  DsoControl::startSampling();
+}
+
+/// \brief Stops sampling on all devices.
+void MultiControl::stopSampling() {
+  for (int index = 0; index < this->devices.size(); ++index)
+    this->devices[index]->stopSampling();
+
+  DsoControl::stopSampling();
+}
+
+/// \brief Sets the record length of all devices.
+/// \param index The record length index that should be set.
+/// \return The record length of the first device, 0 if a device failed.
+unsigned int MultiControl::setRecordLength(unsigned int index) {
+  unsigned int result = 0;
+  for (int device = 0; device < this->devices.size(); ++device) {
+    unsigned int recordLength = this->devices[device]->setRecordLength(index);
+    if (!device || !recordLength)
+      result = recordLength;
+  }
+
+  return result;
+}
+
+/// \brief Sets the samplerate of all devices.
+/// \param samplerate The samplerate that should be met (S/s).
+/// \return The samplerate of the first device, 0.0 if a device failed.
+double MultiControl::setSamplerate(double samplerate) {
+  double result = 0.0;
+  for (int device = 0; device < this->devices.size(); ++device) {
+    double deviceSamplerate = this->devices[device]->setSamplerate(samplerate);
+    if (!device || deviceSamplerate == 0.0)
+      result = deviceSamplerate;
+  }
+
+  return result;
+}
+
+/// \brief Sets the record time of all devices.
+/// \param duration The record time duration that should be met (s).
+/// \return The record time of the first device, 0.0 if a device failed.
+double MultiControl::setRecordTime(double duration) {
+  double result = 0.0;
+  for (int device = 0; device < this->devices.size(); ++device) {
+    double deviceDuration = this->devices[device]->setRecordTime(duration);
+    if (!device || deviceDuration == 0.0)
+      result = deviceDuration;
+  }
+
+  return result;
+}
+
+/// \brief Enables/disables sampling of the given channel.
+/// \param channel The merged channel that should be set.
+/// \param used true if the channel should be sampled.
+/// \return See ::Dso::ErrorCode.
+int MultiControl::setChannelUsed(unsigned int channel, bool used) {
+  unsigned int device, deviceChannel;
+  if (!this->findChannel(channel, &device, &deviceChannel))
+    return Dso::ERROR_PARAMETER;
+
+  return this->devices[device]->setChannelUsed(deviceChannel, used);
+}
+
+/// \brief Set the coupling for the given channel.
+/// \param channel The merged channel that should be set.
+/// \param coupling The new coupling for the channel.
+/// \return See ::Dso::ErrorCode.
+int MultiControl::setCoupling(unsigned int channel, Dso::Coupling coupling) {
+  unsigned int device, deviceChannel;
+  if (!this->findChannel(channel, &device, &deviceChannel))
+    return Dso::ERROR_PARAMETER;
+
+  return this->devices[device]->setCoupling(deviceChannel, coupling);
+}
+
+/// \brief Sets the gain for the given channel.
+/// \param channel The merged channel that should be set.
+/// \param gain The gain that should be met (V/div).
+/// \return The gain that has been set, ::Dso::ErrorCode on error.
+double MultiControl::setGain(unsigned int channel, double gain) {
+  unsigned int device, deviceChannel;
+  if (!this->findChannel(channel, &device, &deviceChannel))
+    return Dso::ERROR_PARAMETER;
+
+  return this->devices[device]->setGain(deviceChannel, gain);
+}
+
+/// \brief Set the offset for the given channel.
+/// \param channel The merged channel that should be set.
+/// \param offset The new offset value (0.0 - 1.0).
+/// \return The offset that has been set, ::Dso::ErrorCode on error.
+double MultiControl::setOffset(unsigned int channel, double offset) {
+  unsigned int device, deviceChannel;
+  if (!this->findChannel(channel, &device, &deviceChannel))
+    return Dso::ERROR_PARAMETER;
+
+  return this->devices[device]->setOffset(deviceChannel, offset);
+}
+
+/// \brief Set the trigger mode of all devices.
+/// \param mode The trigger mode.
+/// \return See ::Dso::ErrorCode.
+int MultiControl::setTriggerMode(Dso::TriggerMode mode) {
+  int result = Dso::ERROR_NONE;
+  for (int device = 0; device < this->devices.size(); ++device) {
+    int errorCode = this->devices[device]->setTriggerMode(mode);
+    if (errorCode < 0)
+      result = errorCode;
+  }
+
+  return result;
+}
+
+/// \brief Set the trigger source.
+/// The other devices trigger on their EXT input or on their first channel,
+/// see setExternalTrigger(). Devices without EXT input always use their first
+/// channel.
+/// \param special true for a special channel (EXT, ...) as trigger source.
+/// \param id The number of the merged channel, that should be used as
+/// trigger.
+/// \return See ::Dso::ErrorCode.
+int MultiControl::setTriggerSource(bool special, unsigned int id) {
+  unsigned int source = 0, sourceChannel = 0;
+  if (!special && !this->findChannel(id, &source, &sourceChannel))
+    return Dso::ERROR_PARAMETER;
+
+  this->triggerSpecial = special;
+  this->triggerSource = id;
+
+  int result = Dso::ERROR_NONE;
+  for (int device = 0; device < this->devices.size(); ++device) {
+    int errorCode;
+    if (special)
+      errorCode = this->devices[device]->setTriggerSource(true, id);
+    else if ((unsigned int)device == source)
+      errorCode = this->devices[device]->setTriggerSource(false, sourceChannel);
+    else
+      errorCode = this->devices[device]->setTriggerSource(
+          this->externalTrigger &&
+              !this->devices[device]->getSpecialTriggerSources()->isEmpty(),
+          0);
+    if (errorCode < 0)
+      result = errorCode;
+  }
+
+  return result;
+}
+
+/// \brief Set the trigger level.
+/// \param channel The merged channel that should be set.
+/// \param level The new trigger level (V).
+/// \return The trigger level that has been set, ::Dso::ErrorCode on error.
+double MultiControl::setTriggerLevel(unsigned int channel, double level) {
+  unsigned int device, deviceChannel;
+  if (!this->findChannel(channel, &device, &deviceChannel))
+    return Dso::ERROR_PARAMETER;
+
+  return this->devices[device]->setTriggerLevel(deviceChannel, level);
+}
+
+/// \brief Set the trigger slope of all devices.
+/// \param slope The Slope that should cause a trigger.
+/// \return See ::Dso::ErrorCode.
+int MultiControl::setTriggerSlope(Dso::Slope slope) {
+  int result = Dso::ERROR_NONE;
+  for (int device = 0; device < this->devices.size(); ++device) {
+    int errorCode = this->devices[device]->setTriggerSlope(slope);
+    if (errorCode < 0)
+      result = errorCode;
+  }
+
+  return result;
+}
+
+/// \brief Set the pretrigger position of all devices.
+/// \param position The new pretrigger position (s).
+/// \return The pretrigger position of the first device, ::Dso::ErrorCode on
+/// error.
+double MultiControl::setPretriggerPosition(double position) {
+  double result = 0.0;
+  for (int device = 0; device < this->devices.size(); ++device) {
+    double devicePosition =
+        this->devices[device]->setPretriggerPosition(position);
+    if (!device || devicePosition < 0)
+      result = devicePosition;
+  }
+
+  return result;
+}
+
+/// \brief Forces a trigger on all devices.
+/// \return See ::Dso::ErrorCode.
+int MultiControl::forceTrigger() {
+  int result = Dso::ERROR_NONE;
+  for (int device = 0; device < this->devices.size(); ++device) {
+    int errorCode = this->devices[device]->forceTrigger();
+    if (errorCode < 0)
+      result = errorCode;
+  }
+
+  return result;
+}
+
+/// \brief Sets the number of acquisitions all devices keep in memory.
+/// \param segments The number of segments, 0 disables the history.
+/// \param memoryLimit The maximum memory used by each device in bytes, 0 for
+/// no limit.
+/// \param spillFileName Template for the temporary file of each device.
+/// \return See ::Dso::ErrorCode, the error of a device that failed.
+int MultiControl::setHistorySize(unsigned int segments,
+                                 unsigned long memoryLimit,
+                                 const QString &spillFileName) {
+  int result = Dso::ERROR_NONE;
+  for (int device = 0; device < this->devices.size(); ++device) {
+    int errorCode = this->devices[device]->setHistorySize(
+        segments, memoryLimit, spillFileName);
+    if (errorCode < 0)
+      result = errorCode;
+  }
+
+  return result;
+}
+
+/// \brief Replays the same stored acquisition on all devices.
+/// The segments are merged like new acquisitions, without the skew check.
+/// \param index The age of the segment, 0 is the latest acquisition.
+/// \return See ::Dso::ErrorCode, the error of a device that failed.
+int MultiControl::replayHistory(unsigned int index) {
+  this->framesMutex.lock();
+  for (unsigned int device = 0; device < this->frames.size(); ++device) {
+    this->frames[device].pending = false;
+    this->frames[device].sequence = 0;
+  }
+  this->replaying = true;
+  this->framesMutex.unlock();
+
+  int result = Dso::ERROR_NONE;
+  for (int device = 0; device < this->devices.size(); ++device) {
+    int errorCode = this->devices[device]->replayHistory(index);
+    if (errorCode < 0)
+      result = errorCode;
+  }
+
+  if (result < 0) {
+    QMutexLocker locker(&this->framesMutex);
+    this->replaying = false;
+  }
+  return result;
+}
+
+#ifdef DEBUG
+/// \brief Sends a debug command to the first device.
+/// \param command The command as string (Has to be parsed).
+/// \return See ::Dso::ErrorCode.
+int MultiControl::stringCommand(QString command) {
+  return this->devices.first()->stringCommand(command);
+}
+#endif
+
+/// \brief Disconnects the other devices if one of them has been disconnected.
+void MultiControl::deviceLost() {
+  if (!this->isRunning())
+    return;
+
+  this->disconnectDevice();
+
+  emit deviceDisconnected();
+}
+
+/// \brief Connects all devices again when a lost one has been plugged in.
+/// Sampling continues if it was running before. If the thread is still
+/// stopping, the devices are connected when it finished.
+void MultiControl::deviceAvailable() {
+  if (this->isRunning()) {
+    this->arrivalPending = true;
+    return;
+  }
+  this->arrivalPending = false;
+
+  bool sampling = this->sampling;
+  this->connectDevice();
+  if (sampling && this->isRunning())
+    this->startSampling();
+}
+
+/// \brief Connects the devices if one arrived while the thread was stopping.
+void MultiControl::threadFinished() {
+  if (!this->arrivalPending)
+    return;
+
+  this->wait();
+  this->deviceAvailable();
+}
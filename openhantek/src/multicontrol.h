@@ -0,0 +1,191 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file multicontrol.h
+/// \brief Declares the MultiControl class.
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MULTICONTROL_H
+#define MULTICONTROL_H
+
+#include <vector>
+
+#include <QList>
+#include <QMutex>
+
+#include "dsocontrol.h"
+
+#define MULTICONTROL_MERGE_WINDOW 0.05       ///< Default roll skew in s
+#define MULTICONTROL_STATISTICS_INTERVAL 1000 ///< Statistics interval in ms
+
+class MultiControl;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \struct MultiControlStatistics                                multicontrol.h
+/// \brief The throughput of one device since sampling started.
+struct MultiControlStatistics {
+  quint64 frames;  ///< Acquisitions received from the device
+  quint64 samples; ///< Samples received from the device over all channels
+  quint64 merged;  ///< Acquisitions that were part of a merged frame
+  quint64 dropped; ///< Acquisitions without counterpart on the other devices
+  qint64 skew;     ///< Arrival time relative to the first device in ns
+  qint64 start;    ///< Tracing::now() when the counting started
+
+  MultiControlStatistics();
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \struct MultiControlFrame                                     multicontrol.h
+/// \brief The latest acquisition of one device that wasn't merged yet.
+struct MultiControlFrame {
+  std::vector<std::vector<double>> samples; ///< The voltages of each channel
+  double samplerate;                        ///< The samplerate in S/s
+  bool append;                              ///< Samples of the roll mode
+  bool pending;                             ///< The samples weren't merged
+  qint64 time;                              ///< Arrival time in ns
+  quint64 sequence; ///< Acquisitions since the devices were synchronized
+
+  MultiControlFrame();
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class MultiControlInput                                      multicontrol.h
+/// \brief Tells the MultiControl which of its devices sent a signal.
+class MultiControlInput : public QObject {
+  Q_OBJECT
+
+public:
+  MultiControlInput(MultiControl *control, unsigned int index);
+
+private:
+  MultiControl *control; ///< The control that merges the devices
+  unsigned int index;    ///< The index of the device in the control
+
+public slots:
+  void deviceConnected();
+  void samplesAvailable(const std::vector<std::vector<double>> *data,
+                        double samplerate, bool append, QMutex *mutex);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class MultiControl                                           multicontrol.h
+/// \brief Combines several oscilloscopes into one with all their channels.
+/// Every device keeps its own control thread. The acquisitions of the devices
+/// are merged into one frame with the channels of the first device first.
+/// Only the device with the trigger source triggers on its channel, the other
+/// ones trigger on their EXT input that has to be connected to the same
+/// signal. Every trigger event then gives one acquisition on each device and
+/// the acquisitions are paired by their number since sampling started.
+/// Acquisitions with a lower number than the newest one lost their partner and
+/// are dropped. If the acquisitions of a pair arrive more than one record time
+/// apart, a device missed a trigger event and the numbering starts again with
+/// the newest acquisition. Without the external trigger the devices trigger on
+/// unrelated events, so only roll blocks are merged then, as long as they
+/// arrive within the merge window. The horizontal settings are applied to all
+/// devices, acquisitions with different samplerates are never merged. The
+/// devices don't connect themselves when they are plugged in, the control
+/// stops all of them when one is lost and connects them again together.
+class MultiControl : public DsoControl {
+  Q_OBJECT
+
+public:
+  MultiControl(const QList<DsoControl *> &devices, QObject *parent = 0);
+  ~MultiControl();
+
+  unsigned int getChannelCount();
+  QList<unsigned int> *getAvailableRecordLengths();
+  double getMinSamplerate();
+  double getMaxSamplerate();
+
+  unsigned int getDeviceCount() const;
+  DsoControl *getDevice(unsigned int index) const;
+  MultiControlStatistics getStatistics(unsigned int index);
+  QString getStatisticsSummary();
+
+  void setMergeWindow(double duration);
+  void setExternalTrigger(bool enabled);
+
+protected:
+  void run();
+
+  bool findChannel(unsigned int channel, unsigned int *device,
+                   unsigned int *deviceChannel) const;
+  void deviceConnected(unsigned int index);
+  void receive(unsigned int index,
+               const std::vector<std::vector<double>> *data,
+               double samplerate, bool append, QMutex *mutex);
+  bool merge();
+  void resetStatistics();
+
+  QList<DsoControl *> devices;              ///< The merged oscilloscopes
+  QList<MultiControlInput *> inputs;        ///< Receivers of each device
+  QList<unsigned int> channelOffsets;       ///< First merged channel per device
+  unsigned int connectedDevices;            ///< Devices that have connected
+  double mergeWindow;                       ///< Allowed roll skew in s
+  bool externalTrigger;                     ///< Other devices trigger on EXT
+  bool triggerSpecial;                      ///< The trigger source is special
+  unsigned int triggerSource;               ///< The merged trigger source
+  std::vector<MultiControlFrame> frames;    ///< The unmerged frame per device
+  QList<MultiControlStatistics> statistics; ///< The throughput per device
+  qint64 lastSummary;                       ///< Time of the last summary
+  bool arrivalPending; ///< A device arrived while the thread was stopping
+  bool replaying;      ///< The pending frames are replayed segments
+  QMutex framesMutex;                       ///< Protects frames and statistics
+
+  std::vector<std::vector<double>> samples; ///< The merged channels
+  QMutex samplesMutex;                      ///< Mutex for the merged channels
+
+  friend class MultiControlInput;
+
+public slots:
+  virtual void connectDevice();
+  virtual void disconnectDevice();
+
+  virtual void startSampling();
+  virtual void stopSampling();
+
+  unsigned int setRecordLength(unsigned int index);
+  double setSamplerate(double samplerate);
+  double setRecordTime(double duration);
+
+  int setChannelUsed(unsigned int channel, bool used);
+  int setCoupling(unsigned int channel, Dso::Coupling coupling);
+  double setGain(unsigned int channel, double gain);
+  double setOffset(unsigned int channel, double offset);
+
+  int setTriggerMode(Dso::TriggerMode mode);
+  int setTriggerSource(bool special, unsigned int id);
+  double setTriggerLevel(unsigned int channel, double level);
+  int setTriggerSlope(Dso::Slope slope);
+  double setPretriggerPosition(double position);
+  int forceTrigger();
+
+  int setHistorySize(unsigned int segments, unsigned long memoryLimit = 0,
+                     const QString &spillFileName = QString());
+  int replayHistory(unsigned int index);
+
+#ifdef DEBUG
+  int stringCommand(QString command);
+#endif
+
+protected slots:
+  void deviceLost();
+  void deviceAvailable();
+  void threadFinished();
+};
+
+#endif
@@ -26,29 +26,34 @@
 #include <QApplication>
 #include <QDir>
 #include <QFileDialog>
+#include <QLabel>
 #include <QMainWindow>
 #include <QMenu>
 #include <QMenuBar>
 #include <QMessageBox>
 #include <QStatusBar>
+#include <QTimer>
 #include <QToolBar>
 
 #include "openhantek.h"
 
+#include "acquisition.h"
 #include "configdialog.h"
 #include "dataanalyzer.h"
+#include "datalogger.h"
 #include "dockwindows.h"
 #include "dsocontrol.h"
 #include "dsowidget.h"
-#include "hantek/control.h"
 #include "settings.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // class OpenHantekMainWindow
 /// \brief Initializes the gui elements of the main window.
+/// \param dsoControl The controller for the oscilloscope.
 /// \param parent The parent widget.
 /// \param flags Flags for the window manager.
-OpenHantekMainWindow::OpenHantekMainWindow(QWidget *parent,
+OpenHantekMainWindow::OpenHantekMainWindow(DsoControl *dsoControl,
+                                           QWidget *parent,
                                            Qt::WindowFlags flags)
     : QMainWindow(parent, flags) {
   // Set application information
@@ -60,9 +65,9 @@ OpenHantekMainWindow::OpenHantekMainWindow(QWidget *parent,
   this->setWindowIcon(QIcon(":openhantek.png"));
   this->setWindowTitle(tr("OpenHantek"));
 
-  // Create the controller for the oscilloscope, provides channel count for
+  // The controller for the oscilloscope provides the channel count for the
   // settings
-  this->dsoControl = new Hantek::Control();
+  this->dsoControl = dsoControl;
 
   // Application settings
   this->settings = new DsoSettings();
@@ -74,6 +79,8 @@ OpenHantekMainWindow::OpenHantekMainWindow(QWidget *parent,
 
   // The data analyzer
   this->dataAnalyzer = new DataAnalyzer(this->settings);
+  // The data logger
+  this->dataLogger = new DataLogger(this);
 
   // Central oszilloscope widget
   this->dsoWidget = new DsoWidget(this->settings, this->dataAnalyzer);
@@ -99,11 +106,25 @@ OpenHantekMainWindow::OpenHantekMainWindow(QWidget *parent,
   this->dsoControl->connectDevice();
   this->initializeDevice();
   this->dsoControl->startSampling();
+
+  // Oscilloscopes that are plugged in later need the settings too
+  connect(this->dsoControl, SIGNAL(deviceConnected()), this,
+          SLOT(deviceConnected()));
 }
 
 /// \brief Cleans up the main window.
 OpenHantekMainWindow::~OpenHantekMainWindow() {}
 
+/// \brief Get the settings the oscilloscope is configured with.
+/// \return The settings of the main window.
+DsoSettings *OpenHantekMainWindow::getSettings() { return this->settings; }
+
+/// \brief Get the data analyzer that feeds the scope.
+/// \return The data analyzer, its mutex protects the analyzed data.
+DataAnalyzer *OpenHantekMainWindow::getDataAnalyzer() {
+  return this->dataAnalyzer;
+}
+
 /// \brief Save the settings before exiting.
 /// \param event The close event that should be handled.
 void OpenHantekMainWindow::closeEvent(QCloseEvent *event) {
@@ -146,6 +167,8 @@ void OpenHantekMainWindow::createActions() {
       tr("Export the oscilloscope data to a file"));
   connect(this->exportAsAction, SIGNAL(triggered()), this->dsoWidget,
           SLOT(exportAs()));
+  connect(this->dsoWidget, SIGNAL(statusMessage(const QString &, int)),
+          this->statusBar(), SLOT(showMessage(const QString &, int)));
 
   this->exitAction = new QAction(tr("E&xit"), this);
   this->exitAction->setShortcut(tr("Ctrl+Q"));
@@ -161,6 +184,28 @@ void OpenHantekMainWindow::createActions() {
   this->startStopAction->setShortcut(tr("Space"));
   this->stopped();
 
+  this->historyIndex = 0;
+  this->historyPreviousAction = new QAction(tr("&Previous acquisition"), this);
+  this->historyPreviousAction->setShortcut(tr("PgUp"));
+  this->historyPreviousAction->setStatusTip(
+      tr("Stop and show the previous stored acquisition"));
+  connect(this->historyPreviousAction, SIGNAL(triggered()), this,
+          SLOT(historyPrevious()));
+
+  this->historyNextAction = new QAction(tr("&Next acquisition"), this);
+  this->historyNextAction->setShortcut(tr("PgDown"));
+  this->historyNextAction->setStatusTip(
+      tr("Show the next stored acquisition"));
+  connect(this->historyNextAction, SIGNAL(triggered()), this,
+          SLOT(historyNext()));
+
+  this->loggingAction = new QAction(tr("&Log acquisitions"), this);
+  this->loggingAction->setCheckable(true);
+  this->loggingAction->setStatusTip(
+      tr("Write all acquisitions to files in the logger directory"));
+  connect(this->loggingAction, SIGNAL(toggled(bool)), this,
+          SLOT(logging(bool)));
+
   this->digitalPhosphorAction = new QAction(
       QIcon(":actions/digitalphosphor.png"), tr("Digital &phosphor"), this);
   this->digitalPhosphorAction->setCheckable(true);
@@ -177,6 +222,22 @@ void OpenHantekMainWindow::createActions() {
   connect(this->zoomAction, SIGNAL(toggled(bool)), this->dsoWidget,
           SLOT(updateZoom(bool)));
 
+  this->waterfallAction = new QAction(tr("&Waterfall"), this);
+  this->waterfallAction->setCheckable(true);
+  this->waterfallAction->setChecked(this->settings->view.waterfall);
+  this->waterfall(this->settings->view.waterfall);
+  connect(this->waterfallAction, SIGNAL(toggled(bool)), this,
+          SLOT(waterfall(bool)));
+  connect(this->waterfallAction, SIGNAL(toggled(bool)), this->dsoWidget,
+          SLOT(updateWaterfall(bool)));
+
+  this->performanceAction = new QAction(tr("&Performance"), this);
+  this->performanceAction->setCheckable(true);
+  this->performanceAction->setStatusTip(
+      tr("Show the acquisition and drawing rates"));
+  connect(this->performanceAction, SIGNAL(toggled(bool)), this,
+          SLOT(performance(bool)));
+
   this->aboutAction = new QAction(tr("&About"), this);
   this->aboutAction->setStatusTip(tr("Show information about this program"));
   connect(this->aboutAction, SIGNAL(triggered()), this, SLOT(about()));
@@ -206,6 +267,8 @@ void OpenHantekMainWindow::createMenus() {
   this->viewMenu = this->menuBar()->addMenu(tr("&View"));
   this->viewMenu->addAction(this->digitalPhosphorAction);
   this->viewMenu->addAction(this->zoomAction);
+  this->viewMenu->addAction(this->waterfallAction);
+  this->viewMenu->addAction(this->performanceAction);
   this->viewMenu->addSeparator();
   this->dockMenu = this->viewMenu->addMenu(tr("&Docking windows"));
   this->dockMenu->addAction(this->horizontalDock->toggleViewAction());
@@ -221,6 +284,9 @@ void OpenHantekMainWindow::createMenus() {
   this->oscilloscopeMenu->addAction(this->configAction);
   this->oscilloscopeMenu->addSeparator();
   this->oscilloscopeMenu->addAction(this->startStopAction);
+  this->oscilloscopeMenu->addAction(this->historyPreviousAction);
+  this->oscilloscopeMenu->addAction(this->historyNextAction);
+  this->oscilloscopeMenu->addAction(this->loggingAction);
 #ifdef DEBUG
   this->oscilloscopeMenu->addSeparator();
   this->oscilloscopeMenu->addAction(this->commandAction);
@@ -250,6 +316,7 @@ void OpenHantekMainWindow::createToolBars() {
   this->viewToolBar = new QToolBar(tr("View"));
   this->viewToolBar->addAction(this->digitalPhosphorAction);
   this->viewToolBar->addAction(this->zoomAction);
+  this->viewToolBar->addAction(this->waterfallAction);
 }
 
 /// \brief Create the status bar.
@@ -262,6 +329,16 @@ void OpenHantekMainWindow::createStatusBar() {
   this->statusBar()->addPermanentWidget(this->commandEdit, 1);
 #endif
 
+  // Performance counters, updated every second while visible
+  this->performanceLabel = new QLabel();
+  this->performanceLabel->hide();
+  this->statusBar()->addPermanentWidget(this->performanceLabel);
+
+  this->performanceTimer = new QTimer(this);
+  this->performanceTimer->setInterval(1000);
+  connect(this->performanceTimer, SIGNAL(timeout()), this,
+          SLOT(updatePerformance()));
+
   this->statusBar()->showMessage(tr("Ready"));
 
 #ifdef DEBUG
@@ -296,6 +373,16 @@ void OpenHantekMainWindow::connectSignals() {
           this->dataAnalyzer,
           SLOT(analyze(const std::vector<std::vector<double>> *, double, bool,
                        QMutex *)));
+  // The logger copies the samples in the control thread without waiting
+  connect(this->dsoControl,
+          SIGNAL(samplesAvailable(const std::vector<std::vector<double>> *,
+                                  double, bool, QMutex *)),
+          this->dataLogger,
+          SLOT(log(const std::vector<std::vector<double>> *, double, bool,
+                   QMutex *)),
+          Qt::DirectConnection);
+  connect(this->dataLogger, SIGNAL(failed(const QString &)), this,
+          SLOT(loggingFailed(const QString &)));
 
   // Connect signals to DSO controller and widget
   connect(this->horizontalDock, SIGNAL(samplerateChanged(double)), this,
@@ -336,6 +423,8 @@ void OpenHantekMainWindow::connectSignals() {
   connect(this->voltageDock,
           SIGNAL(couplingChanged(unsigned int, Dso::Coupling)), this->dsoWidget,
           SLOT(updateVoltageCoupling(unsigned int)));
+  connect(this->voltageDock, SIGNAL(mathExpressionChanged(const QString &)),
+          this->dataAnalyzer, SLOT(setMathExpression(const QString &)));
   connect(this->voltageDock, SIGNAL(modeChanged(Dso::MathMode)),
           this->dsoWidget, SLOT(updateMathMode()));
   connect(this->voltageDock, SIGNAL(gainChanged(unsigned int, double)), this,
@@ -375,35 +464,7 @@ void OpenHantekMainWindow::connectSignals() {
 
 /// \brief Initialize the device with the current settings.
 void OpenHantekMainWindow::initializeDevice() {
-  for (unsigned int channel = 0;
-       channel < this->settings->scope.physicalChannels; ++channel) {
-    this->dsoControl->setCoupling(
-        channel, (Dso::Coupling)this->settings->scope.voltage[channel].misc);
-    this->updateVoltageGain(channel);
-    this->updateOffset(channel);
-    this->dsoControl->setTriggerLevel(
-        channel, this->settings->scope.voltage[channel].trigger);
-  }
-  this->updateUsed(this->settings->scope.physicalChannels);
-  if (this->settings->scope.horizontal.samplerateSet)
-    this->samplerateSelected();
-  else
-    this->timebaseSelected();
-  if (this->dsoControl->getAvailableRecordLengths()->isEmpty())
-    this->dsoControl->setRecordLength(
-        this->settings->scope.horizontal.recordLength);
-  else {
-    int index = this->dsoControl->getAvailableRecordLengths()->indexOf(
-        this->settings->scope.horizontal.recordLength);
-    this->dsoControl->setRecordLength(index < 0 ? 1 : index);
-  }
-  this->dsoControl->setTriggerMode(this->settings->scope.trigger.mode);
-  this->dsoControl->setPretriggerPosition(
-      this->settings->scope.trigger.position *
-      this->settings->scope.horizontal.timebase * DIVS_TIME);
-  this->dsoControl->setTriggerSlope(this->settings->scope.trigger.slope);
-  this->dsoControl->setTriggerSource(this->settings->scope.trigger.special,
-                                     this->settings->scope.trigger.source);
+  Acquisition::configure(this->dsoControl, this->settings);
 }
 
 /// \brief Read the settings from an ini file.
@@ -482,6 +543,8 @@ int OpenHantekMainWindow::saveAs() {
 
 /// \brief The oscilloscope started sampling.
 void OpenHantekMainWindow::started() {
+  this->historyIndex = 0;
+
   this->startStopAction->setText(tr("&Stop"));
   this->startStopAction->setIcon(QIcon(":actions/stop.png"));
   this->startStopAction->setStatusTip(tr("Stop the oscilloscope"));
@@ -504,6 +567,63 @@ void OpenHantekMainWindow::stopped() {
           SLOT(startSampling()));
 }
 
+/// \brief Applies the settings to an oscilloscope that has been plugged in.
+void OpenHantekMainWindow::deviceConnected() { this->initializeDevice(); }
+
+/// \brief Stop sampling and show the stored acquisition before the shown one.
+void OpenHantekMainWindow::historyPrevious() {
+  // The shown acquisition would be replaced by the next one otherwise
+  this->dsoControl->stopSampling();
+
+  if (this->dsoControl->replayHistory(this->historyIndex + 1) ==
+      Dso::ERROR_NONE)
+    ++this->historyIndex;
+}
+
+/// \brief Show the stored acquisition after the shown one.
+void OpenHantekMainWindow::historyNext() {
+  if (this->historyIndex == 0)
+    return;
+
+  if (this->dsoControl->replayHistory(this->historyIndex - 1) ==
+      Dso::ERROR_NONE)
+    --this->historyIndex;
+}
+
+/// \brief Start/stop logging all acquisitions to files.
+/// \param enabled true to start logging.
+void OpenHantekMainWindow::logging(bool enabled) {
+  if (!enabled) {
+    unsigned int dropped = this->dataLogger->getDropped();
+    this->dataLogger->close();
+    if (dropped > 0)
+      this->statusBar()->showMessage(
+          tr("Logging stopped, %1 acquisitions were dropped").arg(dropped));
+    return;
+  }
+
+  this->updateSettings();
+  if (this->dataLogger->open(
+          this->settings->scope.logger.directory,
+          (quint64)this->settings->scope.logger.rotateSize << 20,
+          this->settings->scope.logger.rotateTime * 60)) {
+    this->statusBar()->showMessage(
+        tr("Logging to %1").arg(this->dataLogger->getFileName()), 3000);
+  } else {
+    this->loggingFailed(
+        tr("Can't create log file in %1")
+            .arg(this->settings->scope.logger.directory));
+  }
+}
+
+/// \brief Stop logging after an error.
+/// \param message The description of the error.
+void OpenHantekMainWindow::loggingFailed(const QString &message) {
+  this->dataLogger->close();
+  this->loggingAction->setChecked(false);
+  this->statusBar()->showMessage(message);
+}
+
 /// \brief Configure the oscilloscope.
 void OpenHantekMainWindow::config() {
   this->updateSettings();
@@ -535,6 +655,39 @@ void OpenHantekMainWindow::zoom(bool enabled) {
     this->zoomAction->setStatusTip(tr("Show magnified scope"));
 }
 
+/// \brief Show/hide the spectrum history.
+void OpenHantekMainWindow::waterfall(bool enabled) {
+  this->settings->view.waterfall = enabled;
+
+  if (this->settings->view.waterfall)
+    this->waterfallAction->setStatusTip(tr("Hide spectrum waterfall"));
+  else
+    this->waterfallAction->setStatusTip(tr("Show spectrum waterfall"));
+}
+
+/// \brief Show/hide the performance counters in the status bar.
+/// \param enabled true to show the counters.
+void OpenHantekMainWindow::performance(bool enabled) {
+  if (enabled) {
+    Counters::takeSnapshot(&this->performanceSnapshot);
+    this->performanceLabel->setText(tr("Measuring..."));
+    this->performanceLabel->show();
+    this->performanceTimer->start();
+  } else {
+    this->performanceTimer->stop();
+    this->performanceLabel->hide();
+  }
+}
+
+/// \brief Shows the counter rates since the last update.
+void OpenHantekMainWindow::updatePerformance() {
+  Counters::Snapshot snapshot;
+  Counters::takeSnapshot(&snapshot);
+  this->performanceLabel->setText(
+      Counters::summary(this->performanceSnapshot, snapshot));
+  this->performanceSnapshot = snapshot;
+}
+
 /// \brief Show the about dialog.
 void OpenHantekMainWindow::about() {
   QMessageBox::about(
@@ -546,6 +699,16 @@ void OpenHantekMainWindow::about() {
 
 /// \brief The settings have changed.
 void OpenHantekMainWindow::applySettings() {
+  this->dataAnalyzer->setMathExpression(this->settings->scope.mathExpression);
+
+  // Segmented memory
+  this->dsoControl->setHistorySize(
+      this->settings->scope.history.segments,
+      (unsigned long)this->settings->scope.history.memoryLimit << 20,
+      this->settings->scope.history.spill
+          ? QDir::temp().filePath("openhantek-history-XXXXXX.bin")
+          : QString());
+
   // Main window
   if (!this->settings->options.window.position.isNull())
     this->move(this->settings->options.window.position);
@@ -685,6 +848,37 @@ void OpenHantekMainWindow::updateSettings() {
   }
 }
 
+/// \brief Shows settings that have been changed by another component.
+/// The signals of the widgets aren't blocked, a widget whose value changed
+/// sends it through the usual connections again.
+void OpenHantekMainWindow::updateWidgets() {
+  for (unsigned int channel = 0;
+       channel < this->settings->scope.physicalChannels; ++channel) {
+    this->voltageDock->setCoupling(
+        channel, (Dso::Coupling)this->settings->scope.voltage[channel].misc);
+    this->voltageDock->setGain(channel,
+                               this->settings->scope.voltage[channel].gain);
+    this->voltageDock->setUsed(channel,
+                               this->settings->scope.voltage[channel].used);
+  }
+
+  this->horizontalDock->setRecordLength(
+      this->settings->scope.horizontal.recordLength);
+  this->horizontalDock->setTimebase(this->settings->scope.horizontal.timebase);
+  this->horizontalDock->setSamplerate(
+      this->settings->scope.horizontal.samplerate);
+  this->dsoWidget->updateRecordLength(
+      this->settings->scope.horizontal.recordLength);
+  this->dsoWidget->updateTimebase(this->settings->scope.horizontal.timebase);
+
+  this->triggerDock->setMode(this->settings->scope.trigger.mode);
+  this->triggerDock->setSlope(this->settings->scope.trigger.slope);
+  this->triggerDock->setSource(this->settings->scope.trigger.special,
+                               this->settings->scope.trigger.source);
+
+  this->dsoWidget->updateLevels();
+}
+
 /// \brief The oscilloscope changed the record time.
 /// \param duration The new record time duration in seconds.
 void OpenHantekMainWindow::recordTimeChanged(double duration) {
@@ -27,10 +27,15 @@
 
 #include <QMainWindow>
 
+#include "counters.h"
+
 class QActionGroup;
+class QLabel;
 class QLineEdit;
+class QTimer;
 
 class DataAnalyzer;
+class DataLogger;
 class DsoControl;
 class DsoSettings;
 class DsoWidget;
@@ -48,9 +53,16 @@ class OpenHantekMainWindow : public QMainWindow {
   Q_OBJECT
 
 public:
-  OpenHantekMainWindow(QWidget *parent = 0, Qt::WindowFlags flags = 0);
+  OpenHantekMainWindow(DsoControl *dsoControl, QWidget *parent = 0,
+                       Qt::WindowFlags flags = 0);
   ~OpenHantekMainWindow();
 
+  DsoSettings *getSettings();
+  DataAnalyzer *getDataAnalyzer();
+
+public slots:
+  void updateWidgets();
+
 protected:
   void closeEvent(QCloseEvent *event);
 
@@ -81,7 +93,10 @@ private:
 
   QAction *configAction;
   QAction *startStopAction;
-  QAction *digitalPhosphorAction, *zoomAction;
+  QAction *historyPreviousAction, *historyNextAction;
+  QAction *loggingAction;
+  QAction *digitalPhosphorAction, *zoomAction, *waterfallAction;
+  QAction *performanceAction;
 
   QAction *aboutAction, *aboutQtAction;
 
@@ -111,13 +126,20 @@ private:
 #ifdef DEBUG
   QLineEdit *commandEdit;
 #endif
+  QLabel *performanceLabel; ///< Shows the rates of the performance counters
 
   // Data handling classes
   DataAnalyzer *dataAnalyzer;
+  DataLogger *dataLogger;
   DsoControl *dsoControl;
 
   // Other variables
   QString currentFile;
+  unsigned int historyIndex; ///< The shown segment, 0 is the latest one
+
+  // Performance counters
+  QTimer *performanceTimer;               ///< Updates the performance label
+  Counters::Snapshot performanceSnapshot; ///< Counters at the last update
 
   // Settings used for the whole program
   DsoSettings *settings;
@@ -130,9 +152,17 @@ private slots:
   // View
   void digitalPhosphor(bool enabled);
   void zoom(bool enabled);
+  void waterfall(bool enabled);
+  void performance(bool enabled);
+  void updatePerformance();
   // Oscilloscope control
   void started();
   void stopped();
+  void deviceConnected();
+  void historyPrevious();
+  void historyNext();
+  void logging(bool enabled);
+  void loggingFailed(const QString &message);
   // Other
   void config();
   void about();
@@ -0,0 +1,752 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  remoteserver.cpp
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstring>
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtEndian>
+
+#include "remoteserver.h"
+
+#include "dataanalyzer.h"
+#include "dsocontrol.h"
+#include "settings.h"
+
+/// \brief The SCPI mnemonics of the ::Dso::Coupling values.
+static const char *couplingNames[Dso::COUPLING_COUNT] = {"AC", "DC", "GND"};
+/// \brief The SCPI mnemonics of the ::Dso::TriggerMode values.
+static const char *triggerModeNames[Dso::TRIGGERMODE_COUNT] = {
+    "AUTO", "NORMal", "SINGle", "SOFTware"};
+/// \brief The SCPI mnemonics of the ::Dso::Slope values.
+static const char *slopeNames[Dso::SLOPE_COUNT] = {"POSitive", "NEGative"};
+
+////////////////////////////////////////////////////////////////////////////////
+// class RemoteServer
+/// \brief Initializes the server, it doesn't listen before listen() is called.
+/// \param dsoControl The controller for the oscilloscope.
+/// \param settings The settings that are changed together with the controller.
+/// \param dataAnalyzer The analyzer that provides the waveforms.
+/// \param parent The parent object.
+RemoteServer::RemoteServer(DsoControl *dsoControl, DsoSettings *settings,
+                           DataAnalyzer *dataAnalyzer, QObject *parent)
+    : QObject(parent) {
+  this->dsoControl = dsoControl;
+  this->settings = settings;
+  this->dataAnalyzer = dataAnalyzer;
+
+  this->tcpServer = 0;
+  this->localServer = 0;
+
+  this->frames = 0;
+  this->samplerate = this->settings->scope.horizontal.samplerate;
+  this->recordTime = this->settings->scope.horizontal.timebase * DIVS_TIME;
+
+  connect(this->dataAnalyzer, SIGNAL(analyzed(unsigned long)), this,
+          SLOT(analyzed(unsigned long)));
+  connect(this->dsoControl, SIGNAL(samplerateChanged(double)), this,
+          SLOT(samplerateChanged(double)));
+  connect(this->dsoControl, SIGNAL(recordTimeChanged(double)), this,
+          SLOT(recordTimeChanged(double)));
+}
+
+/// \brief Closes all connections.
+RemoteServer::~RemoteServer() { qDeleteAll(this->clients); }
+
+/// \brief Starts listening for clients.
+/// \param address A TCP port on the loopback interface or the path of a Unix
+/// socket.
+/// \return false if the server couldn't listen, see getErrorString().
+bool RemoteServer::listen(const QString &address) {
+  bool isPort;
+  unsigned int port = address.toUInt(&isPort);
+
+  if (isPort && port <= 65535) {
+    this->tcpServer = new QTcpServer(this);
+    connect(this->tcpServer, SIGNAL(newConnection()), this,
+            SLOT(newConnection()));
+    if (!this->tcpServer->listen(QHostAddress::LocalHost, (quint16)port)) {
+      this->errorString = this->tcpServer->errorString();
+      return false;
+    }
+  } else {
+    this->localServer = new QLocalServer(this);
+    connect(this->localServer, SIGNAL(newConnection()), this,
+            SLOT(newConnection()));
+    bool listening = this->localServer->listen(address);
+    if (!listening &&
+        this->localServer->serverError() ==
+            QAbstractSocket::AddressInUseError) {
+      // Remove the socket file of a previous run that wasn't closed, but
+      // only if no server accepts connections on it anymore
+      QLocalSocket probe;
+      probe.connectToServer(address);
+      if (!probe.waitForConnected(REMOTE_PROBE_TIMEOUT)) {
+        QLocalServer::removeServer(address);
+        listening = this->localServer->listen(address);
+      }
+    }
+    if (!listening) {
+      this->errorString = this->localServer->errorString();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// \brief Get the reason why listen() failed.
+/// \return The error description.
+const QString &RemoteServer::getErrorString() const {
+  return this->errorString;
+}
+
+/// \brief Starts handling the commands of a new connection.
+/// \param socket The connection to the client.
+void RemoteServer::addClient(QIODevice *socket) {
+  RemoteClient *client = new RemoteClient;
+  client->socket = socket;
+  client->source = 0;
+  client->spectrum = false;
+  // The first waveform query waits for a new frame
+  client->frame = this->frames;
+  client->samples = 0;
+  client->interval = 0.0;
+  this->clients.append(client);
+
+  connect(socket, SIGNAL(readyRead()), this, SLOT(readyRead()));
+  connect(socket, SIGNAL(disconnected()), this, SLOT(disconnected()));
+}
+
+/// \brief Executes the received commands until one has to wait for data.
+/// \param client The client whose commands should be executed.
+void RemoteServer::process(RemoteClient *client) {
+  while (!client->commands.isEmpty()) {
+    if (!this->execute(client, client->commands.first()))
+      return;
+
+    client->commands.removeFirst();
+  }
+}
+
+/// \brief Executes a single command.
+/// \param client The client that sent the command.
+/// \param command The command with its parameters.
+/// \return false if the command has to wait for the next analyzed frame.
+bool RemoteServer::execute(RemoteClient *client, const QString &command) {
+  int separator = command.indexOf(' ');
+  QString header = command.left(separator);
+  QString parameter =
+      separator < 0 ? QString() : command.mid(separator + 1).trimmed();
+  bool query = header.endsWith('?');
+  if (query)
+    header.chop(1);
+  if (header.startsWith(':'))
+    header.remove(0, 1);
+
+  // IEEE 488.2 common commands
+  if (header.startsWith('*')) {
+    QString common = header.toUpper();
+    if (common == "*IDN" && query)
+      this->writeResponse(client, QString("OpenHantek,DSO,0,%1").arg(VERSION));
+    else if (common == "*OPC" && query)
+      this->writeResponse(client, "1");
+    else if (common == "*CLS" && !query)
+      client->errors.clear();
+    else
+      this->addError(client, -113, "Undefined header");
+    return true;
+  }
+
+  QStringList nodes = header.split(':');
+  QString root;
+  unsigned int suffix;
+  if (nodes.size() > 2 || !splitSuffix(nodes[0], &root, &suffix)) {
+    this->addError(client, -113, "Undefined header");
+    return true;
+  }
+
+  if (nodes.size() == 1) {
+    if (query)
+      this->addError(client, -113, "Undefined header");
+    else if (matches(root, "RUN"))
+      this->dsoControl->startSampling();
+    else if (matches(root, "STOP"))
+      this->dsoControl->stopSampling();
+    else if (matches(root, "SINGle")) {
+      this->settings->scope.trigger.mode = Dso::TRIGGERMODE_SINGLE;
+      this->dsoControl->setTriggerMode(Dso::TRIGGERMODE_SINGLE);
+      this->dsoControl->startSampling();
+      emit settingsChanged();
+    } else
+      this->addError(client, -113, "Undefined header");
+    return true;
+  }
+
+  const QString &node = nodes[1];
+  if (matches(root, "SYSTem") && matches(node, "ERRor") && query) {
+    if (client->errors.isEmpty())
+      this->writeResponse(client, "0,\"No error\"");
+    else
+      this->writeResponse(client, client->errors.takeFirst());
+  } else if (matches(root, "ACQuire"))
+    this->executeAcquire(client, node, parameter, query);
+  else if (matches(root, "CHANnel")) {
+    if (suffix < 1 || suffix > this->settings->scope.physicalChannels)
+      this->addError(client, -114, "Header suffix out of range");
+    else
+      this->executeChannel(client, suffix - 1, node, parameter, query);
+  } else if (matches(root, "TRIGger"))
+    this->executeTrigger(client, node, parameter, query);
+  else if (matches(root, "WAVeform"))
+    return this->executeWaveform(client, node, parameter, query);
+  else if (matches(root, "MEASure"))
+    this->executeMeasure(client, node, query);
+  else
+    this->addError(client, -113, "Undefined header");
+
+  return true;
+}
+
+/// \brief Executes the commands of the ACQuire subsystem.
+/// \param client The client that sent the command.
+/// \param node The mnemonic after ACQuire.
+/// \param parameter The parameter of the command.
+/// \param query true if the command is a query.
+void RemoteServer::executeAcquire(RemoteClient *client, const QString &node,
+                                  const QString &parameter, bool query) {
+  DsoSettingsScopeHorizontal *horizontal =
+      &(this->settings->scope.horizontal);
+  bool ok;
+  double value = parameter.toDouble(&ok);
+
+  if (matches(node, "SRATe")) {
+    if (query)
+      this->writeResponse(client, QString::number(this->samplerate, 'g', 9));
+    else if (!ok || value <= 0)
+      this->addError(client, -224, "Illegal parameter value");
+    else {
+      horizontal->samplerate = value;
+      horizontal->samplerateSet = true;
+      if (this->dsoControl->setSamplerate(value) == 0.0)
+        this->addError(client, -200, "Execution error");
+      emit settingsChanged();
+    }
+  } else if (matches(node, "RTIMe")) {
+    if (query)
+      this->writeResponse(client, QString::number(this->recordTime, 'g', 9));
+    else if (!ok || value <= 0)
+      this->addError(client, -224, "Illegal parameter value");
+    else if (value < TIMEBASE_MINIMUM * DIVS_TIME ||
+             value > TIMEBASE_MAXIMUM * DIVS_TIME)
+      this->addError(client, -222, "Data out of range");
+    else {
+      horizontal->timebase = value / DIVS_TIME;
+      horizontal->samplerateSet = false;
+      if (this->dsoControl->setRecordTime(value) == 0.0)
+        this->addError(client, -200, "Execution error");
+      emit settingsChanged();
+    }
+  } else if (matches(node, "RLENgth")) {
+    if (query) {
+      this->writeResponse(client, QString::number(horizontal->recordLength));
+      return;
+    }
+
+    unsigned int length = parameter.toUInt(&ok);
+    const QList<unsigned int> *lengths =
+        this->dsoControl->getAvailableRecordLengths();
+    int index = lengths->isEmpty() ? (int)length : lengths->indexOf(length);
+    if (!ok || index < 0)
+      this->addError(client, -224, "Illegal parameter value");
+    else {
+      horizontal->recordLength = length;
+      if (this->dsoControl->setRecordLength((unsigned int)index) == 0)
+        this->addError(client, -200, "Execution error");
+      emit settingsChanged();
+    }
+  } else
+    this->addError(client, -113, "Undefined header");
+}
+
+/// \brief Executes the commands of the CHANnel<n> subsystem.
+/// \param client The client that sent the command.
+/// \param channel The physical channel, starting at 0.
+/// \param node The mnemonic after CHANnel<n>.
+/// \param parameter The parameter of the command.
+/// \param query true if the command is a query.
+void RemoteServer::executeChannel(RemoteClient *client, unsigned int channel,
+                                  const QString &node,
+                                  const QString &parameter, bool query) {
+  DsoSettingsScope *scope = &(this->settings->scope);
+  DsoSettingsScopeVoltage *voltage = &(scope->voltage[channel]);
+  bool ok;
+  double value = parameter.toDouble(&ok);
+
+  if (matches(node, "DISPlay")) {
+    if (query) {
+      this->writeResponse(client, voltage->used ? "1" : "0");
+      return;
+    }
+
+    QString state = parameter.toUpper();
+    if (state == "ON" || state == "1")
+      voltage->used = true;
+    else if (state == "OFF" || state == "0")
+      voltage->used = false;
+    else {
+      this->addError(client, -224, "Illegal parameter value");
+      return;
+    }
+
+    // The math channel needs all physical channels
+    bool mathUsed = scope->voltage[scope->physicalChannels].used ||
+                    scope->spectrum[scope->physicalChannels].used;
+    if (this->dsoControl->setChannelUsed(
+            channel,
+            mathUsed || voltage->used || scope->spectrum[channel].used) < 0)
+      this->addError(client, -200, "Execution error");
+    emit settingsChanged();
+  } else if (matches(node, "COUPling")) {
+    if (query) {
+      this->writeResponse(client, couplingNames[voltage->misc]);
+      return;
+    }
+
+    int coupling;
+    for (coupling = 0; coupling < Dso::COUPLING_COUNT; ++coupling) {
+      if (matches(parameter, couplingNames[coupling]))
+        break;
+    }
+    if (coupling >= Dso::COUPLING_COUNT)
+      this->addError(client, -224, "Illegal parameter value");
+    else {
+      voltage->misc = coupling;
+      if (this->dsoControl->setCoupling(channel, (Dso::Coupling)coupling) < 0)
+        this->addError(client, -200, "Execution error");
+      emit settingsChanged();
+    }
+  } else if (matches(node, "SCALe")) {
+    if (query)
+      this->writeResponse(client, QString::number(voltage->gain, 'g', 9));
+    else if (!ok || !Dso::gainSteps().contains(value))
+      this->addError(client, -224, "Illegal parameter value");
+    else {
+      voltage->gain = value;
+      if (this->dsoControl->setGain(channel, value * DIVS_VOLTAGE) < 0)
+        this->addError(client, -200, "Execution error");
+      emit settingsChanged();
+    }
+  } else if (matches(node, "OFFSet")) {
+    if (query)
+      this->writeResponse(client, QString::number(voltage->offset, 'g', 9));
+    else if (!ok)
+      this->addError(client, -224, "Illegal parameter value");
+    else if (value < -DIVS_VOLTAGE / 2 || value > DIVS_VOLTAGE / 2)
+      this->addError(client, -222, "Data out of range");
+    else {
+      voltage->offset = value;
+      double offset = (value / DIVS_VOLTAGE) + 0.5;
+      if (this->dsoControl->setOffset(channel, offset) < 0)
+        this->addError(client, -200, "Execution error");
+      emit settingsChanged();
+    }
+  } else
+    this->addError(client, -113, "Undefined header");
+}
+
+/// \brief Executes the commands of the TRIGger subsystem.
+/// \param client The client that sent the command.
+/// \param node The mnemonic after TRIGger.
+/// \param parameter The parameter of the command.
+/// \param query true if the command is a query.
+void RemoteServer::executeTrigger(RemoteClient *client, const QString &node,
+                                  const QString &parameter, bool query) {
+  DsoSettingsScopeTrigger *trigger = &(this->settings->scope.trigger);
+  bool ok;
+  double value = parameter.toDouble(&ok);
+
+  if (matches(node, "MODE")) {
+    if (query) {
+      this->writeResponse(client, shortForm(triggerModeNames[trigger->mode]));
+      return;
+    }
+
+    int mode;
+    for (mode = 0; mode < Dso::TRIGGERMODE_COUNT; ++mode) {
+      if (matches(parameter, triggerModeNames[mode]))
+        break;
+    }
+    if (mode >= Dso::TRIGGERMODE_COUNT)
+      this->addError(client, -224, "Illegal parameter value");
+    else {
+      trigger->mode = (Dso::TriggerMode)mode;
+      if (this->dsoControl->setTriggerMode(trigger->mode) < 0)
+        this->addError(client, -200, "Execution error");
+      emit settingsChanged();
+    }
+  } else if (matches(node, "SLOPe")) {
+    if (query) {
+      this->writeResponse(client, shortForm(slopeNames[trigger->slope]));
+      return;
+    }
+
+    int slope;
+    for (slope = 0; slope < Dso::SLOPE_COUNT; ++slope) {
+      if (matches(parameter, slopeNames[slope]))
+        break;
+    }
+    if (slope >= Dso::SLOPE_COUNT)
+      this->addError(client, -224, "Illegal parameter value");
+    else {
+      trigger->slope = (Dso::Slope)slope;
+      if (this->dsoControl->setTriggerSlope(trigger->slope) < 0)
+        this->addError(client, -200, "Execution error");
+      emit settingsChanged();
+    }
+  } else if (matches(node, "SOURce")) {
+    const QStringList *specialSources =
+        this->dsoControl->getSpecialTriggerSources();
+    if (query) {
+      if (trigger->special)
+        this->writeResponse(client, specialSources->value(trigger->source));
+      else
+        this->writeResponse(client,
+                            QString("CHAN%1").arg(trigger->source + 1));
+      return;
+    }
+
+    QString mnemonic;
+    unsigned int suffix;
+    int special = -1;
+    for (int index = 0; index < specialSources->size(); ++index) {
+      if (!parameter.compare(specialSources->at(index), Qt::CaseInsensitive))
+        special = index;
+    }
+    if (special >= 0) {
+      trigger->special = true;
+      trigger->source = special;
+    } else if (splitSuffix(parameter, &mnemonic, &suffix) &&
+               matches(mnemonic, "CHANnel") && suffix >= 1 &&
+               suffix <= this->settings->scope.physicalChannels) {
+      trigger->special = false;
+      trigger->source = suffix - 1;
+    } else {
+      this->addError(client, -224, "Illegal parameter value");
+      return;
+    }
+    if (this->dsoControl->setTriggerSource(trigger->special,
+                                           trigger->source) < 0)
+      this->addError(client, -200, "Execution error");
+    emit settingsChanged();
+  } else if (matches(node, "LEVel")) {
+    if (trigger->special) {
+      this->addError(client, -221, "Settings conflict");
+      return;
+    }
+
+    DsoSettingsScopeVoltage *voltage =
+        &(this->settings->scope.voltage[trigger->source]);
+    // The level has to be on the screen like the trigger level slider
+    double minimum = (-DIVS_VOLTAGE / 2 - voltage->offset) * voltage->gain;
+    double maximum = (DIVS_VOLTAGE / 2 - voltage->offset) * voltage->gain;
+    if (query)
+      this->writeResponse(client, QString::number(voltage->trigger, 'g', 9));
+    else if (!ok)
+      this->addError(client, -224, "Illegal parameter value");
+    else if (value < minimum || value > maximum)
+      this->addError(client, -222, "Data out of range");
+    else {
+      voltage->trigger = value;
+      this->dsoControl->setTriggerLevel(trigger->source, value);
+      emit settingsChanged();
+    }
+  } else if (matches(node, "POSition")) {
+    if (query)
+      this->writeResponse(client, QString::number(trigger->position, 'g', 9));
+    else if (!ok || value < 0.0 || value > 1.0)
+      this->addError(client, -224, "Illegal parameter value");
+    else {
+      trigger->position = value;
+      this->dsoControl->setPretriggerPosition(
+          value * this->settings->scope.horizontal.timebase * DIVS_TIME);
+      emit settingsChanged();
+    }
+  } else if (matches(node, "FORCe") && !query) {
+    if (this->dsoControl->forceTrigger() < 0)
+      this->addError(client, -200, "Execution error");
+  } else
+    this->addError(client, -113, "Undefined header");
+}
+
+/// \brief Executes the commands of the WAVeform subsystem.
+/// \param client The client that sent the command.
+/// \param node The mnemonic after WAVeform.
+/// \param parameter The parameter of the command.
+/// \param query true if the command is a query.
+/// \return false if the command has to wait for the next analyzed frame.
+bool RemoteServer::executeWaveform(RemoteClient *client, const QString &node,
+                                   const QString &parameter, bool query) {
+  unsigned int mathChannel = this->settings->scope.physicalChannels;
+
+  if (matches(node, "SOURce")) {
+    if (query) {
+      if (client->source == mathChannel)
+        this->writeResponse(client, "MATH");
+      else
+        this->writeResponse(client, QString("CHAN%1").arg(client->source + 1));
+      return true;
+    }
+
+    QString mnemonic;
+    unsigned int suffix;
+    if (matches(parameter, "MATH"))
+      client->source = mathChannel;
+    else if (splitSuffix(parameter, &mnemonic, &suffix) &&
+             matches(mnemonic, "CHANnel") && suffix >= 1 &&
+             suffix <= mathChannel)
+      client->source = suffix - 1;
+    else
+      this->addError(client, -224, "Illegal parameter value");
+  } else if (matches(node, "TYPE")) {
+    if (query)
+      this->writeResponse(client, client->spectrum ? "SPEC" : "VOLT");
+    else if (matches(parameter, "VOLTage"))
+      client->spectrum = false;
+    else if (matches(parameter, "SPECtrum"))
+      client->spectrum = true;
+    else
+      this->addError(client, -224, "Illegal parameter value");
+  } else if (matches(node, "DATA") && query) {
+    if (client->frame == this->frames)
+      return false;
+
+    this->writeWaveform(client);
+  } else if (matches(node, "PREamble") && query)
+    this->writeResponse(client, QString("%1,%2,%3")
+                                    .arg(client->samples)
+                                    .arg(client->interval, 0, 'g', 9)
+                                    .arg(client->frame));
+  else if (matches(node, "COUNt") && query)
+    this->writeResponse(client, QString::number(this->frames));
+  else
+    this->addError(client, -113, "Undefined header");
+
+  return true;
+}
+
+/// \brief Executes the queries of the MEASure subsystem.
+/// \param client The client that sent the command.
+/// \param node The mnemonic after MEASure.
+/// \param query true if the command is a query.
+void RemoteServer::executeMeasure(RemoteClient *client, const QString &node,
+                                  bool query) {
+  bool amplitude = matches(node, "AMPLitude");
+  if (!query || (!amplitude && !matches(node, "FREQuency"))) {
+    this->addError(client, -113, "Undefined header");
+    return;
+  }
+
+  double value = 0.0;
+  {
+    QMutexLocker locker(this->dataAnalyzer->mutex());
+    const AnalyzedData *data = this->dataAnalyzer->data(client->source);
+    if (data)
+      value = amplitude ? data->amplitude : data->frequency;
+  }
+  this->writeResponse(client, QString::number(value, 'g', 9));
+}
+
+/// \brief Sends the waveform of the waveform source as binary block.
+/// \param client The client that gets the waveform.
+void RemoteServer::writeWaveform(RemoteClient *client) {
+  QByteArray block;
+  {
+    QMutexLocker locker(this->dataAnalyzer->mutex());
+    const AnalyzedData *data = this->dataAnalyzer->data(client->source);
+    const SampleValues *values = 0;
+    if (data)
+      values = client->spectrum ? &data->samples.spectrum
+                                : &data->samples.voltage;
+
+    client->samples = values ? values->sample.size() : 0;
+    client->interval = values ? values->interval : 0.0;
+    client->frame = this->frames;
+
+    // Convert straight from the analyzer buffer into the block
+    block.resize(client->samples * sizeof(quint32));
+    uchar *output = (uchar *)block.data();
+    for (unsigned long sample = 0; sample < client->samples; ++sample) {
+      float value = (float)values->sample[sample];
+      quint32 bits;
+      memcpy(&bits, &value, sizeof(bits));
+      qToLittleEndian(bits, output + sample * sizeof(quint32));
+    }
+  }
+
+  // Definite length block: #, digit count, byte count, data
+  QByteArray length = QByteArray::number(block.size());
+  client->socket->write("#" + QByteArray::number(length.size()) + length);
+  client->socket->write(block);
+  client->socket->write("\n");
+}
+
+/// \brief Sends the response of a query.
+/// \param client The client that sent the query.
+/// \param response The response without line end.
+void RemoteServer::writeResponse(RemoteClient *client,
+                                 const QString &response) {
+  client->socket->write((response + '\n').toUtf8());
+}
+
+/// \brief Adds an error to the error queue of a client.
+/// \param client The client whose command failed.
+/// \param code The SCPI error code.
+/// \param message The description of the error.
+void RemoteServer::addError(RemoteClient *client, int code,
+                            const QString &message) {
+  if (client->errors.size() >= REMOTE_ERROR_LIMIT) {
+    client->errors.last() = "-350,\"Queue overflow\"";
+    return;
+  }
+
+  client->errors.append(QString("%1,\"%2\"").arg(code).arg(message));
+}
+
+/// \brief Checks a mnemonic against its long and short form.
+/// \param mnemonic The mnemonic that was received.
+/// \param pattern The long form, its upper case letters are the short form.
+/// \return true if the mnemonic is the long or the short form.
+bool RemoteServer::matches(const QString &mnemonic, const char *pattern) {
+  return mnemonic.compare(QLatin1String(pattern), Qt::CaseInsensitive) == 0 ||
+         mnemonic.compare(shortForm(pattern), Qt::CaseInsensitive) == 0;
+}
+
+/// \brief Get the short form of a mnemonic.
+/// \param pattern The long form, its upper case letters are the short form.
+/// \return The upper case letters of the pattern.
+QString RemoteServer::shortForm(const char *pattern) {
+  QString result;
+  for (const char *character = pattern; *character; ++character) {
+    if (!QChar(*character).isLower())
+      result += *character;
+  }
+
+  return result;
+}
+
+/// \brief Separates the numeric suffix of a mnemonic like CHANnel2.
+/// \param node The mnemonic with the suffix.
+/// \param mnemonic The mnemonic without the suffix.
+/// \param suffix The suffix, 1 if there is none.
+/// \return false if there is no mnemonic.
+bool RemoteServer::splitSuffix(const QString &node, QString *mnemonic,
+                               unsigned int *suffix) {
+  int digits = 0;
+  while (digits < node.size() && node[node.size() - digits - 1].isDigit())
+    ++digits;
+
+  *mnemonic = node.left(node.size() - digits);
+  *suffix = digits ? node.right(digits).toUInt() : 1;
+
+  return !mnemonic->isEmpty();
+}
+
+/// \brief Accepts the waiting connections.
+void RemoteServer::newConnection() {
+  if (this->tcpServer) {
+    while (this->tcpServer->hasPendingConnections()) {
+      QTcpSocket *socket = this->tcpServer->nextPendingConnection();
+      // Responses are small and a script waits for each of them
+      socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+      this->addClient(socket);
+    }
+  }
+  if (this->localServer) {
+    while (this->localServer->hasPendingConnections())
+      this->addClient(this->localServer->nextPendingConnection());
+  }
+}
+
+/// \brief Splits the received data into commands and executes them.
+void RemoteServer::readyRead() {
+  QIODevice *socket = qobject_cast<QIODevice *>(this->sender());
+  for (RemoteClient *client : this->clients) {
+    if (client->socket != socket)
+      continue;
+
+    client->input.append(socket->readAll());
+    int end;
+    while ((end = client->input.indexOf('\n')) >= 0) {
+      QString line = QString::fromLatin1(client->input.constData(), end);
+      client->input.remove(0, end + 1);
+      for (const QString &command : line.split(';')) {
+        if (!command.trimmed().isEmpty())
+          client->commands.append(command.trimmed());
+      }
+    }
+    if (client->input.size() > REMOTE_INPUT_LIMIT) {
+      client->input.clear();
+      this->addError(client, -223, "Too much data");
+    }
+
+    this->process(client);
+    return;
+  }
+}
+
+/// \brief Forgets a client that closed its connection.
+void RemoteServer::disconnected() {
+  QIODevice *socket = qobject_cast<QIODevice *>(this->sender());
+  for (int index = 0; index < this->clients.size(); ++index) {
+    if (this->clients[index]->socket != socket)
+      continue;
+
+    delete this->clients.takeAt(index);
+    socket->deleteLater();
+    return;
+  }
+}
+
+/// \brief Continues the clients that wait for a new frame.
+/// \param samples The sample count of the analyzed data.
+void RemoteServer::analyzed(unsigned long samples) {
+  Q_UNUSED(samples);
+
+  ++this->frames;
+  for (RemoteClient *client : this->clients)
+    this->process(client);
+}
+
+/// \brief Remembers the samplerate for queries.
+/// \param samplerate The samplerate set by the controller in S/s.
+void RemoteServer::samplerateChanged(double samplerate) {
+  this->samplerate = samplerate;
+}
+
+/// \brief Remembers the record time for queries.
+/// \param duration The record time set by the controller in s.
+void RemoteServer::recordTimeChanged(double duration) {
+  this->recordTime = duration;
+}
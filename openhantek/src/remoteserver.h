@@ -0,0 +1,147 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file remoteserver.h
+/// \brief Declares the RemoteServer class.
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef REMOTESERVER_H
+#define REMOTESERVER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#define REMOTE_INPUT_LIMIT 65536 ///< Longest accepted command line in bytes
+#define REMOTE_ERROR_LIMIT 32    ///< Maximum entries of the error queue
+#define REMOTE_PROBE_TIMEOUT 500 ///< Wait for a server on the socket in ms
+
+class DataAnalyzer;
+class DsoControl;
+class DsoSettings;
+class QIODevice;
+class QLocalServer;
+class QTcpServer;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \struct RemoteClient                                          remoteserver.h
+/// \brief The state of one connection to the remote server.
+struct RemoteClient {
+  QIODevice *socket;     ///< The connection to the client
+  QByteArray input;      ///< Received bytes without a line end yet
+  QStringList commands;  ///< Received commands that weren't executed yet
+  QStringList errors;    ///< The error queue, oldest error first
+  unsigned int source;   ///< Channel of the waveform queries
+  bool spectrum;         ///< Waveform queries return the spectrum
+  unsigned long frame;   ///< Number of the analyzed frame that was sent last
+  unsigned long samples; ///< Sample count of the last sent block
+  double interval;       ///< Sample interval of the last sent block
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class RemoteServer                                           remoteserver.h
+/// \brief Controls the oscilloscope with SCPI-like commands from a socket.
+/// Commands are separated by line ends or ';', each one starts at the root
+/// and every query is answered with an own line. Mnemonics can be given in
+/// their long or short form, e.g. TRIGger:LEVel or TRIG:LEV.
+/// <p>
+///   <b>Commands:</b><br />
+///   <pre>
+///   *IDN?, *OPC?, *CLS, SYSTem:ERRor?
+///   RUN, STOP, SINGle
+///   ACQuire:SRATe[?] <S/s>, ACQuire:RTIMe[?] <s>, ACQuire:RLENgth[?] <n>
+///   CHANnel<n>:DISPlay[?] ON|OFF, CHANnel<n>:COUPling[?] AC|DC|GND
+///   CHANnel<n>:SCALe[?] <V/div>, CHANnel<n>:OFFSet[?] <div>
+///   TRIGger:MODE[?] AUTO|NORMal|SINGle, TRIGger:SLOPe[?] POSitive|NEGative
+///   TRIGger:SOURce[?] CHANnel<n>|<special source>, TRIGger:LEVel[?] <V>
+///   TRIGger:POSition[?] <0..1>, TRIGger:FORCe
+///   WAVeform:SOURce[?] CHANnel<n>|MATH, WAVeform:TYPE[?] VOLTage|SPECtrum
+///   WAVeform:DATA?, WAVeform:PREamble?, WAVeform:COUNt?
+///   MEASure:AMPLitude?, MEASure:FREQuency?
+///   </pre>
+/// </p>
+/// WAVeform:DATA? waits for the next analyzed frame that wasn't sent to the
+/// client yet and returns its samples as IEEE 488.2 definite length block of
+/// little endian 32 bit floats. WAVeform:PREamble? describes the last block
+/// with its sample count, the interval between two samples and the frame.
+/// Settings are checked against the same steps and limits the widgets use and
+/// settingsChanged() is emitted, so a user interface can show the new values.
+class RemoteServer : public QObject {
+  Q_OBJECT
+
+public:
+  RemoteServer(DsoControl *dsoControl, DsoSettings *settings,
+               DataAnalyzer *dataAnalyzer, QObject *parent = 0);
+  ~RemoteServer();
+
+  bool listen(const QString &address);
+  const QString &getErrorString() const;
+
+protected:
+  void addClient(QIODevice *socket);
+  void process(RemoteClient *client);
+  bool execute(RemoteClient *client, const QString &command);
+
+  void executeAcquire(RemoteClient *client, const QString &node,
+                      const QString &parameter, bool query);
+  void executeChannel(RemoteClient *client, unsigned int channel,
+                      const QString &node, const QString &parameter,
+                      bool query);
+  void executeTrigger(RemoteClient *client, const QString &node,
+                      const QString &parameter, bool query);
+  bool executeWaveform(RemoteClient *client, const QString &node,
+                       const QString &parameter, bool query);
+  void executeMeasure(RemoteClient *client, const QString &node, bool query);
+
+  void writeWaveform(RemoteClient *client);
+  void writeResponse(RemoteClient *client, const QString &response);
+  void addError(RemoteClient *client, int code, const QString &message);
+
+  static bool matches(const QString &mnemonic, const char *pattern);
+  static QString shortForm(const char *pattern);
+  static bool splitSuffix(const QString &node, QString *mnemonic,
+                          unsigned int *suffix);
+
+private:
+  DsoControl *dsoControl;     ///< The controller for the oscilloscope
+  DsoSettings *settings;      ///< The oscilloscope settings
+  DataAnalyzer *dataAnalyzer; ///< Provides the waveforms
+
+  QTcpServer *tcpServer;     ///< Listens on a TCP port, or null
+  QLocalServer *localServer; ///< Listens on a Unix socket, or null
+  QString errorString;       ///< Why listen() failed
+
+  QList<RemoteClient *> clients; ///< The connected clients
+  unsigned long frames;          ///< Number of analyzed frames
+  double samplerate;             ///< Samplerate reported by the controller
+  double recordTime;             ///< Record time reported by the controller
+
+private slots:
+  void newConnection();
+  void readyRead();
+  void disconnected();
+  void analyzed(unsigned long samples);
+  void samplerateChanged(double samplerate);
+  void recordTimeChanged(double duration);
+
+signals:
+  void settingsChanged(); ///< A command changed the settings
+};
+
+#endif
@@ -22,17 +22,18 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <QColor>
+#include <QCoreApplication>
+#include <QDir>
 #include <QSettings>
 
 #include "settings.h"
 
 #include "dso.h"
-#include "dsowidget.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // class DsoSettings
 /// \brief Sets the values to their defaults.
-DsoSettings::DsoSettings(QWidget *parent) : QObject(parent) {
+DsoSettings::DsoSettings(QObject *parent) : QObject(parent) {
   // Options
   this->options.alwaysSave = true;
   this->options.imageSize = QSize(640, 480);
@@ -71,11 +72,23 @@ DsoSettings::DsoSettings(QWidget *parent) : QObject(parent) {
   this->scope.trigger.slope = Dso::SLOPE_POSITIVE;
   this->scope.trigger.source = 0;
   this->scope.trigger.special = false;
+  // Acquisition
+  this->scope.acquisition.mode = Dso::ACQUISITIONMODE_NORMAL;
+  this->scope.acquisition.count = 16;
+  // History
+  this->scope.history.segments = 100;
+  this->scope.history.memoryLimit = 64;
+  this->scope.history.spill = false;
+  // Logger
+  this->scope.logger.directory = QDir::homePath();
+  this->scope.logger.rotateSize = 100;
+  this->scope.logger.rotateTime = 0;
   // General
   this->scope.physicalChannels = 0;
   this->scope.spectrumLimit = -20.0;
   this->scope.spectrumReference = 0.0;
   this->scope.spectrumWindow = Dso::WINDOW_HANN;
+  this->scope.mathExpression = "CH1 * CH2";
 
   // View
   // Colors
@@ -100,6 +113,8 @@ DsoSettings::DsoSettings(QWidget *parent) : QObject(parent) {
   this->view.interpolation = Dso::INTERPOLATION_LINEAR;
   this->view.screenColorImages = false;
   this->view.zoom = false;
+  this->view.waterfall = false;
+  this->view.waterfallDepth = 256;
 }
 
 /// \brief Cleans up.
@@ -132,17 +147,24 @@ void DsoSettings::setChannelCount(unsigned int channels) {
     if (this->scope.spectrum.count() <= channel + 1) {
       DsoSettingsScopeSpectrum newSpectrum;
       newSpectrum.magnitude = 20.0;
-      newSpectrum.name = QApplication::tr("SP%1").arg(channel + 1);
+      newSpectrum.name = QCoreApplication::tr("SP%1").arg(channel + 1);
       newSpectrum.offset = 0.0;
       newSpectrum.used = false;
+      newSpectrum.mode = Dso::SPECTRUMMODE_NORMAL;
+      newSpectrum.count = 8;
       this->scope.spectrum.insert(channel, newSpectrum);
     }
     // Voltage
     if (this->scope.voltage.count() <= channel + 1) {
       DsoSettingsScopeVoltage newVoltage;
+      newVoltage.filter.type = Dso::FILTERTYPE_NONE;
+      newVoltage.filter.design = Dso::FILTERDESIGN_IIR;
+      newVoltage.filter.frequency = 1e3;
+      newVoltage.filter.bandwidth = 10.0;
+      newVoltage.filter.order = 4;
       newVoltage.gain = 1.0;
       newVoltage.misc = Dso::COUPLING_DC;
-      newVoltage.name = QApplication::tr("CH%1").arg(channel + 1);
+      newVoltage.name = QCoreApplication::tr("CH%1").arg(channel + 1);
       newVoltage.offset = 0.0;
       newVoltage.trigger = 0.0;
       newVoltage.used = false;
@@ -171,16 +193,23 @@ void DsoSettings::setChannelCount(unsigned int channels) {
   if (this->scope.spectrum.count() <= (int)channels) {
     DsoSettingsScopeSpectrum newSpectrum;
     newSpectrum.magnitude = 20.0;
-    newSpectrum.name = QApplication::tr("SPM");
+    newSpectrum.name = QCoreApplication::tr("SPM");
     newSpectrum.offset = 0.0;
     newSpectrum.used = false;
+    newSpectrum.mode = Dso::SPECTRUMMODE_NORMAL;
+    newSpectrum.count = 8;
     this->scope.spectrum.append(newSpectrum);
   }
   if (this->scope.voltage.count() <= (int)channels) {
     DsoSettingsScopeVoltage newVoltage;
+    newVoltage.filter.type = Dso::FILTERTYPE_NONE;
+    newVoltage.filter.design = Dso::FILTERDESIGN_IIR;
+    newVoltage.filter.frequency = 1e3;
+    newVoltage.filter.bandwidth = 10.0;
+    newVoltage.filter.order = 4;
     newVoltage.gain = 1.0;
     newVoltage.misc = Dso::MATHMODE_1ADD2;
-    newVoltage.name = QApplication::tr("MATH");
+    newVoltage.name = QCoreApplication::tr("MATH");
     newVoltage.offset = 0.0;
     newVoltage.trigger = 0.0;
     newVoltage.used = false;
@@ -321,6 +350,36 @@ int DsoSettings::load(const QString &fileName) {
   if (settingsLoader->contains("special"))
     this->scope.trigger.special = settingsLoader->value("special").toInt();
   settingsLoader->endGroup();
+  // Acquisition
+  settingsLoader->beginGroup("acquisition");
+  if (settingsLoader->contains("mode"))
+    this->scope.acquisition.mode =
+        (Dso::AcquisitionMode)settingsLoader->value("mode").toInt();
+  if (settingsLoader->contains("count"))
+    this->scope.acquisition.count = settingsLoader->value("count").toUInt();
+  settingsLoader->endGroup();
+  // History
+  settingsLoader->beginGroup("history");
+  if (settingsLoader->contains("segments"))
+    this->scope.history.segments = settingsLoader->value("segments").toUInt();
+  if (settingsLoader->contains("memoryLimit"))
+    this->scope.history.memoryLimit =
+        settingsLoader->value("memoryLimit").toUInt();
+  if (settingsLoader->contains("spill"))
+    this->scope.history.spill = settingsLoader->value("spill").toBool();
+  settingsLoader->endGroup();
+  // Logger
+  settingsLoader->beginGroup("logger");
+  if (settingsLoader->contains("directory"))
+    this->scope.logger.directory =
+        settingsLoader->value("directory").toString();
+  if (settingsLoader->contains("rotateSize"))
+    this->scope.logger.rotateSize =
+        settingsLoader->value("rotateSize").toUInt();
+  if (settingsLoader->contains("rotateTime"))
+    this->scope.logger.rotateTime =
+        settingsLoader->value("rotateTime").toUInt();
+  settingsLoader->endGroup();
   // Spectrum
   for (int channel = 0; channel < this->scope.spectrum.count(); ++channel) {
     settingsLoader->beginGroup(QString("spectrum%1").arg(channel));
@@ -333,11 +392,32 @@ int DsoSettings::load(const QString &fileName) {
     if (settingsLoader->contains("used"))
       this->scope.spectrum[channel].used =
           settingsLoader->value("used").toBool();
+    if (settingsLoader->contains("mode"))
+      this->scope.spectrum[channel].mode =
+          (Dso::SpectrumMode)settingsLoader->value("mode").toInt();
+    if (settingsLoader->contains("count"))
+      this->scope.spectrum[channel].count =
+          settingsLoader->value("count").toUInt();
     settingsLoader->endGroup();
   }
   // Vertical axis
   for (int channel = 0; channel < this->scope.voltage.count(); ++channel) {
     settingsLoader->beginGroup(QString("vertical%1").arg(channel));
+    if (settingsLoader->contains("filterType"))
+      this->scope.voltage[channel].filter.type =
+          (Dso::FilterType)settingsLoader->value("filterType").toInt();
+    if (settingsLoader->contains("filterDesign"))
+      this->scope.voltage[channel].filter.design =
+          (Dso::FilterDesign)settingsLoader->value("filterDesign").toInt();
+    if (settingsLoader->contains("filterFrequency"))
+      this->scope.voltage[channel].filter.frequency =
+          settingsLoader->value("filterFrequency").toDouble();
+    if (settingsLoader->contains("filterBandwidth"))
+      this->scope.voltage[channel].filter.bandwidth =
+          settingsLoader->value("filterBandwidth").toDouble();
+    if (settingsLoader->contains("filterOrder"))
+      this->scope.voltage[channel].filter.order =
+          settingsLoader->value("filterOrder").toUInt();
     if (settingsLoader->contains("gain"))
       this->scope.voltage[channel].gain =
           settingsLoader->value("gain").toDouble();
@@ -354,6 +434,9 @@ int DsoSettings::load(const QString &fileName) {
           settingsLoader->value("used").toBool();
     settingsLoader->endGroup();
   }
+  if (settingsLoader->contains("mathExpression"))
+    this->scope.mathExpression =
+        settingsLoader->value("mathExpression").toString();
   if (settingsLoader->contains("spectrumLimit"))
     this->scope.spectrumLimit =
         settingsLoader->value("spectrumLimit").toDouble();
@@ -418,6 +501,11 @@ int DsoSettings::load(const QString &fileName) {
   if (settingsLoader->contains("zoom"))
     this->view.zoom =
         (Dso::InterpolationMode)settingsLoader->value("zoom").toBool();
+  if (settingsLoader->contains("waterfall"))
+    this->view.waterfall = settingsLoader->value("waterfall").toBool();
+  if (settingsLoader->contains("waterfallDepth"))
+    this->view.waterfallDepth =
+        settingsLoader->value("waterfallDepth").toInt();
   settingsLoader->endGroup();
 
   delete settingsLoader;
@@ -513,6 +601,23 @@ int DsoSettings::save(const QString &fileName) {
   settingsSaver->setValue("source", this->scope.trigger.source);
   settingsSaver->setValue("special", this->scope.trigger.special);
   settingsSaver->endGroup();
+  // Acquisition
+  settingsSaver->beginGroup("acquisition");
+  settingsSaver->setValue("mode", this->scope.acquisition.mode);
+  settingsSaver->setValue("count", this->scope.acquisition.count);
+  settingsSaver->endGroup();
+  // History
+  settingsSaver->beginGroup("history");
+  settingsSaver->setValue("segments", this->scope.history.segments);
+  settingsSaver->setValue("memoryLimit", this->scope.history.memoryLimit);
+  settingsSaver->setValue("spill", this->scope.history.spill);
+  settingsSaver->endGroup();
+  // Logger
+  settingsSaver->beginGroup("logger");
+  settingsSaver->setValue("directory", this->scope.logger.directory);
+  settingsSaver->setValue("rotateSize", this->scope.logger.rotateSize);
+  settingsSaver->setValue("rotateTime", this->scope.logger.rotateTime);
+  settingsSaver->endGroup();
   // Spectrum
   for (int channel = 0; channel < this->scope.spectrum.count(); ++channel) {
     settingsSaver->beginGroup(QString("spectrum%1").arg(channel));
@@ -520,11 +625,23 @@ int DsoSettings::save(const QString &fileName) {
                             this->scope.spectrum[channel].magnitude);
     settingsSaver->setValue("offset", this->scope.spectrum[channel].offset);
     settingsSaver->setValue("used", this->scope.spectrum[channel].used);
+    settingsSaver->setValue("mode", this->scope.spectrum[channel].mode);
+    settingsSaver->setValue("count", this->scope.spectrum[channel].count);
     settingsSaver->endGroup();
   }
   // Vertical axis
   for (int channel = 0; channel < this->scope.voltage.count(); ++channel) {
     settingsSaver->beginGroup(QString("vertical%1").arg(channel));
+    settingsSaver->setValue("filterType",
+                            this->scope.voltage[channel].filter.type);
+    settingsSaver->setValue("filterDesign",
+                            this->scope.voltage[channel].filter.design);
+    settingsSaver->setValue("filterFrequency",
+                            this->scope.voltage[channel].filter.frequency);
+    settingsSaver->setValue("filterBandwidth",
+                            this->scope.voltage[channel].filter.bandwidth);
+    settingsSaver->setValue("filterOrder",
+                            this->scope.voltage[channel].filter.order);
     settingsSaver->setValue("gain", this->scope.voltage[channel].gain);
     settingsSaver->setValue("misc", this->scope.voltage[channel].misc);
     settingsSaver->setValue("offset", this->scope.voltage[channel].offset);
@@ -532,6 +649,7 @@ int DsoSettings::save(const QString &fileName) {
     settingsSaver->setValue("used", this->scope.voltage[channel].used);
     settingsSaver->endGroup();
   }
+  settingsSaver->setValue("mathExpression", this->scope.mathExpression);
   settingsSaver->setValue("spectrumLimit", this->scope.spectrumLimit);
   settingsSaver->setValue("spectrumReference", this->scope.spectrumReference);
   settingsSaver->setValue("spectrumWindow", this->scope.spectrumWindow);
@@ -573,8 +691,10 @@ int DsoSettings::save(const QString &fileName) {
   if (complete) {
     settingsSaver->setValue("interpolation", this->view.interpolation);
     settingsSaver->setValue("screenColorImages", this->view.screenColorImages);
+    settingsSaver->setValue("waterfallDepth", this->view.waterfallDepth);
   }
   settingsSaver->setValue("zoom", this->view.zoom);
+  settingsSaver->setValue("waterfall", this->view.waterfall);
   settingsSaver->endGroup();
 
   delete settingsSaver;
@@ -111,16 +111,30 @@ struct DsoSettingsScopeTrigger {
 /// \struct DsoSettingsScopeSpectrum                                  settings.h
 /// \brief Holds the settings for the spectrum analysis.
 struct DsoSettingsScopeSpectrum {
-  double magnitude; ///< The vertical resolution in dB/div
-  QString name;     ///< Name of this channel
-  double offset;    ///< Vertical offset in divs
-  bool used;        ///< true if the spectrum is turned on
+  double magnitude;       ///< The vertical resolution in dB/div
+  QString name;           ///< Name of this channel
+  double offset;          ///< Vertical offset in divs
+  bool used;              ///< true if the spectrum is turned on
+  Dso::SpectrumMode mode; ///< Averaging or max-hold of the power
+  unsigned int count;     ///< Averaged spectrums or Welch segments
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \struct DsoSettingsScopeFilter                                    settings.h
+/// \brief Holds the settings for the digital filter of a channel.
+struct DsoSettingsScopeFilter {
+  Dso::FilterType type;     ///< The frequency response, none disables it
+  Dso::FilterDesign design; ///< IIR biquad cascade or FIR filter
+  double frequency;         ///< Cutoff or center frequency in Hz
+  double bandwidth;         ///< Width of the band-pass and notch in Hz
+  unsigned int order;       ///< Filter order (IIR) or number of taps (FIR)
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 /// \struct DsoSettingsScopeVoltage                                   settings.h
 /// \brief Holds the settings for the normal voltage graphs.
 struct DsoSettingsScopeVoltage {
+  DsoSettingsScopeFilter filter; ///< The filter applied to the samples
   double gain; ///< The vertical resolution in V/div
   int misc; ///< Different enums, coupling for real- and mode for math-channels
   QString name;   ///< Name of this channel
@@ -129,12 +143,41 @@ struct DsoSettingsScopeVoltage {
   bool used;      ///< true if this channel is enabled
 };
 
+////////////////////////////////////////////////////////////////////////////////
+/// \struct DsoSettingsScopeAcquisition                               settings.h
+/// \brief Holds the settings for the processing of the acquired samples.
+struct DsoSettingsScopeAcquisition {
+  Dso::AcquisitionMode mode; ///< Averaging or high resolution processing
+  unsigned int count; ///< Averaged acquisitions or samples per point
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \struct DsoSettingsScopeHistory                                   settings.h
+/// \brief Holds the settings for the segmented acquisition memory.
+struct DsoSettingsScopeHistory {
+  unsigned int segments;    ///< Number of acquisitions kept, 0 disables it
+  unsigned int memoryLimit; ///< Memory used for the segments in MiB
+  bool spill; ///< true maps a temporary file when the limit is exceeded
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \struct DsoSettingsScopeLogger                                    settings.h
+/// \brief Holds the settings for the continuous data logger.
+struct DsoSettingsScopeLogger {
+  QString directory;       ///< The directory for the log files
+  unsigned int rotateSize; ///< Maximum file size in MiB, 0 for no limit
+  unsigned int rotateTime; ///< Maximum file age in minutes, 0 for no limit
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 /// \struct DsoSettingsScope                                          settings.h
 /// \brief Holds the settings for the oscilloscope.
 struct DsoSettingsScope {
   DsoSettingsScopeHorizontal horizontal; ///< Settings for the horizontal axis
   DsoSettingsScopeTrigger trigger;       ///< Settings for the trigger
+  DsoSettingsScopeAcquisition acquisition; ///< Settings for the processing
+  DsoSettingsScopeHistory history;       ///< Settings for the segments
+  DsoSettingsScopeLogger logger;         ///< Settings for the data logger
   QList<DsoSettingsScopeSpectrum> spectrum; ///< Spectrum analysis settings
   QList<DsoSettingsScopeVoltage> voltage;   ///< Settings for the normal graphs
 
@@ -142,6 +185,7 @@ struct DsoSettingsScope {
   Dso::WindowFunction spectrumWindow; ///< Window function for DFT
   double spectrumReference;           ///< Reference level for spectrum in dBm
   double spectrumLimit; ///< Minimum magnitude of the spectrum (Avoids peaks)
+  QString mathExpression; ///< Formula for Dso::MATHMODE_EXPRESSION
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -173,10 +217,12 @@ struct DsoSettingsView {
   DsoSettingsViewColor color; ///< Used colors
   bool antialiasing;          ///< Antialiasing for the graphs
   bool digitalPhosphor;       ///< true slowly fades out the previous graphs
-  int digitalPhosphorDepth;   ///< Number of channels shown at one time
+  int digitalPhosphorDepth;   ///< Frames until old graphs fade, 0 is infinite
   Dso::InterpolationMode interpolation; ///< Interpolation mode for the graph
   bool screenColorImages; ///< true exports images with screen colors
   bool zoom;              ///< true if the magnified scope is enabled
+  bool waterfall;         ///< true if the spectrum history is shown
+  int waterfallDepth;     ///< Number of spectrums in the history
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -186,7 +232,7 @@ class DsoSettings : public QObject {
   Q_OBJECT
 
 public:
-  DsoSettings(QWidget *parent = 0);
+  DsoSettings(QObject *parent = 0);
   ~DsoSettings();
 
   void setChannelCount(unsigned int channels);
@@ -0,0 +1,204 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  sharedring.cpp
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#include <QMutex>
+
+#include "sharedring.h"
+
+#include "tracing.h"
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// class SharedRing
+/// \brief Initializes a closed ring.
+/// \param parent The parent object.
+SharedRing::SharedRing(QObject *parent) : QObject(parent) {
+  this->memory = 0;
+  this->size = 0;
+  this->header = 0;
+}
+
+/// \brief Removes the shared memory object.
+SharedRing::~SharedRing() { this->close(); }
+
+/// \brief Creates the shared memory object and initializes the ring.
+/// \param name The name of the shared memory object, a leading '/' is added.
+/// \param channels The number of channels in every slot.
+/// \param slotCount The number of acquisitions the ring holds.
+/// \param capacity The maximum number of samples per channel, longer records
+/// are truncated.
+/// \return true if the ring has been created.
+bool SharedRing::open(const QString &name, unsigned int channels,
+                      unsigned int slotCount, unsigned long capacity) {
+  this->close();
+
+  if (!channels || channels > SHAREDRING_CHANNELS || !slotCount || !capacity) {
+    this->errorString = tr("Invalid ring size");
+    return false;
+  }
+
+#ifdef Q_OS_UNIX
+  this->name = name.toLocal8Bit();
+  if (!this->name.startsWith('/'))
+    this->name.prepend('/');
+
+  uint64_t slotSize = SHAREDRING_SLOT_HEADER_SIZE +
+                      (uint64_t)channels * capacity * sizeof(double);
+  slotSize = (slotSize + SHAREDRING_ALIGNMENT - 1) / SHAREDRING_ALIGNMENT *
+             SHAREDRING_ALIGNMENT;
+  this->size = SHAREDRING_HEADER_SIZE + slotCount * slotSize;
+
+  // A stale object of a crashed writer is replaced
+  shm_unlink(this->name.constData());
+  int fd = shm_open(this->name.constData(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    this->errorString = QString::fromLocal8Bit(strerror(errno));
+    return false;
+  }
+  if (ftruncate(fd, this->size) < 0) {
+    this->errorString = QString::fromLocal8Bit(strerror(errno));
+    ::close(fd);
+    shm_unlink(this->name.constData());
+    return false;
+  }
+  void *memory =
+      mmap(0, this->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (memory == MAP_FAILED) {
+    this->errorString = QString::fromLocal8Bit(strerror(errno));
+    shm_unlink(this->name.constData());
+    return false;
+  }
+  this->memory = (unsigned char *)memory;
+
+  // The new object is zeroed, so every slot sequence is 0 already
+  this->header = new (this->memory) SharedRingHeader;
+  this->header->version = SHAREDRING_VERSION;
+  this->header->slotCount = slotCount;
+  this->header->channelCount = channels;
+  this->header->capacity = capacity;
+  this->header->slotSize = slotSize;
+  this->header->sequence.store(0, std::memory_order_relaxed);
+  this->header->writerPid = getpid();
+  for (unsigned int slot = 0; slot < slotCount; ++slot)
+    new (this->memory + SHAREDRING_HEADER_SIZE + slot * slotSize)
+        SharedRingSlot;
+  // Readers check the magic before they trust the other fields
+  this->header->magic.store(SHAREDRING_MAGIC, std::memory_order_release);
+
+  return true;
+#else
+  Q_UNUSED(name);
+  this->errorString = tr("Shared memory isn't supported on this system");
+  return false;
+#endif
+}
+
+/// \brief Unmaps and removes the shared memory object.
+/// Readers that mapped it already keep their mapping.
+void SharedRing::close() {
+  if (!this->memory)
+    return;
+
+#ifdef Q_OS_UNIX
+  munmap(this->memory, this->size);
+  shm_unlink(this->name.constData());
+#endif
+  this->memory = 0;
+  this->size = 0;
+  this->header = 0;
+}
+
+/// \brief Check if the ring has been created.
+/// \return true if publish() writes into the shared memory.
+bool SharedRing::isOpen() const { return this->memory != 0; }
+
+/// \brief Get the reason why open() failed.
+/// \return The error message.
+const QString &SharedRing::getErrorString() const { return this->errorString; }
+
+/// \brief Copies new samples into the next slot of the ring.
+/// \param data The data arrays with the samples of each channel.
+/// \param samplerate The samplerate for all samples.
+/// \param append The samples continue the previous ones (Roll mode).
+/// \param mutex The mutex for the data arrays.
+void SharedRing::publish(const std::vector<std::vector<double>> *data,
+                         double samplerate, bool append, QMutex *mutex) {
+  if (!this->memory)
+    return;
+
+  Tracing::Scope span("SharedRing::publish");
+
+  // This is the only writer, so the sequence can't change meanwhile
+  uint64_t sequence =
+      this->header->sequence.load(std::memory_order_relaxed) + 1;
+  unsigned char *slotMemory =
+      this->memory + SHAREDRING_HEADER_SIZE +
+      ((sequence - 1) % this->header->slotCount) * this->header->slotSize;
+  SharedRingSlot *slot = (SharedRingSlot *)slotMemory;
+  double *samples = (double *)(slotMemory + SHAREDRING_SLOT_HEADER_SIZE);
+
+  // Mark the slot as busy before any of its data is changed
+  slot->sequence.store(sequence * 2 - 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  uint32_t flags = append ? SHAREDRING_FLAG_APPEND : 0;
+  mutex->lock();
+  unsigned int channels =
+      std::min<size_t>(data->size(), this->header->channelCount);
+  for (unsigned int channel = 0; channel < channels; ++channel) {
+    uint64_t count = (*data)[channel].size();
+    if (count > this->header->capacity) {
+      count = this->header->capacity;
+      flags |= SHAREDRING_FLAG_TRUNCATED;
+    }
+    if (count)
+      memcpy(samples + channel * this->header->capacity,
+             &(*data)[channel].front(), count * sizeof(double));
+    slot->samples[channel] = count;
+  }
+  mutex->unlock();
+  for (unsigned int channel = channels; channel < SHAREDRING_CHANNELS;
+       ++channel)
+    slot->samples[channel] = 0;
+
+  slot->channelCount = channels;
+  slot->flags = flags;
+  slot->samplerate = samplerate;
+#ifdef Q_OS_UNIX
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  slot->timestamp = (int64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+#endif
+
+  slot->sequence.store(sequence * 2, std::memory_order_release);
+  this->header->sequence.store(sequence, std::memory_order_release);
+}
@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file sharedring.h
+/// \brief Declares the SharedRing class.
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SHAREDRING_H
+#define SHAREDRING_H
+
+#include <vector>
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+
+#include "sharedringlayout.h"
+
+class QMutex;
+
+////////////////////////////////////////////////////////////////////////////////
+/// \class SharedRing                                               sharedring.h
+/// \brief Publishes every acquisition into a POSIX shared memory ring.
+/// The samples are copied in the thread that emits them, so other processes
+/// can read the newest acquisitions without locks. The layout is documented
+/// in sharedringlayout.h, ringreader/ringreader.h is a library for readers.
+class SharedRing : public QObject {
+  Q_OBJECT
+
+public:
+  SharedRing(QObject *parent = 0);
+  ~SharedRing();
+
+  bool open(const QString &name, unsigned int channels,
+            unsigned int slotCount = SHAREDRING_DEFAULT_SLOTS,
+            unsigned long capacity = SHAREDRING_DEFAULT_SAMPLES);
+  void close();
+  bool isOpen() const;
+  const QString &getErrorString() const;
+
+public slots:
+  void publish(const std::vector<std::vector<double>> *data, double samplerate,
+               bool append, QMutex *mutex);
+
+private:
+  QByteArray name;          ///< The name of the shared memory object
+  unsigned char *memory;    ///< The mapped shared memory, or null
+  size_t size;              ///< The size of the mapping in bytes
+  SharedRingHeader *header; ///< The header at the start of the memory
+  QString errorString;      ///< Why open() failed
+};
+
+#endif
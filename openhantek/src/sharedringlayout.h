@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file sharedringlayout.h
+/// \brief Defines the memory layout of the shared memory ring.
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SHAREDRINGLAYOUT_H
+#define SHAREDRINGLAYOUT_H
+
+#include <atomic>
+#include <cstdint>
+
+// This header is shared with external readers and must not use Qt.
+//
+// The POSIX shared memory object starts with a SharedRingHeader, the slots
+// follow at SHAREDRING_HEADER_SIZE. Every published acquisition gets the next
+// sequence number n, starting at 1, and is stored in the slot
+// (n - 1) % slotCount at the offset
+//   SHAREDRING_HEADER_SIZE + ((n - 1) % slotCount) * slotSize.
+// A slot starts with a SharedRingSlot, the samples of channel c follow as
+// doubles in the host byte order at the offset
+//   SHAREDRING_SLOT_HEADER_SIZE + c * capacity * sizeof(double).
+//
+// The single writer marks the slot as busy by setting its sequence to 2n - 1,
+// fills it, sets the slot sequence to 2n and finally the header sequence to n.
+// A reader checks that the slot sequence is 2n before and after reading the
+// slot, otherwise the writer has reused the slot in the meantime.
+
+#define SHAREDRING_MAGIC 0x4E52484FU    ///< "OHRN" in little endian
+#define SHAREDRING_VERSION 1            ///< Version of this layout
+#define SHAREDRING_CHANNELS 8           ///< Maximum number of channels
+#define SHAREDRING_HEADER_SIZE 4096     ///< Offset of the first slot in bytes
+#define SHAREDRING_SLOT_HEADER_SIZE 128 ///< Offset of the samples in a slot
+#define SHAREDRING_ALIGNMENT 64         ///< Slot sizes are multiples of this
+
+#define SHAREDRING_FLAG_APPEND 0x1    ///< Continues the previous slot (Roll)
+#define SHAREDRING_FLAG_TRUNCATED 0x2 ///< Samples beyond the capacity are lost
+
+#define SHAREDRING_DEFAULT_SLOTS 16       ///< Default number of slots
+#define SHAREDRING_DEFAULT_SAMPLES 262144 ///< Default samples per channel
+
+////////////////////////////////////////////////////////////////////////////////
+/// \struct SharedRingHeader                                 sharedringlayout.h
+/// \brief The description of the ring at the start of the shared memory.
+struct SharedRingHeader {
+  std::atomic<uint32_t> magic;    ///< SHAREDRING_MAGIC once initialized
+  uint32_t version;               ///< SHAREDRING_VERSION
+  uint32_t slotCount;             ///< Number of slots in the ring
+  uint32_t channelCount;          ///< Number of channels in every slot
+  uint64_t capacity;              ///< Samples per channel a slot can hold
+  uint64_t slotSize;              ///< Distance between two slots in bytes
+  std::atomic<uint64_t> sequence; ///< Newest complete slot, 0 for none
+  int64_t writerPid;              ///< Process id of the writer
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// \struct SharedRingSlot                                   sharedringlayout.h
+/// \brief The metadata of one acquisition in front of its samples.
+struct SharedRingSlot {
+  std::atomic<uint64_t> sequence;        ///< 2n if complete, 2n - 1 if busy
+  int64_t timestamp;                     ///< Publication in ns, CLOCK_MONOTONIC
+  double samplerate;                     ///< The samplerate in S/s
+  uint32_t flags;                        ///< SHAREDRING_FLAG_* values
+  uint32_t channelCount;                 ///< Number of channels with samples
+  uint64_t samples[SHAREDRING_CHANNELS]; ///< Sample count of each channel
+};
+
+static_assert(sizeof(SharedRingHeader) <= SHAREDRING_HEADER_SIZE,
+              "SharedRingHeader doesn't fit");
+static_assert(sizeof(SharedRingSlot) <= SHAREDRING_SLOT_HEADER_SIZE,
+              "SharedRingSlot doesn't fit");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "The sequences have to be lock-free to be shared");
+
+#endif
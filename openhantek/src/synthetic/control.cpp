@@ -0,0 +1,396 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  synthetic/control.cpp
+//
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <climits>
+
+#include <QTimer>
+
+#include "synthetic/control.h"
+
+namespace Synthetic {
+////////////////////////////////////////////////////////////////////////////////
+// class Synthetic::Control
+/// \brief Initializes the generators with their default settings.
+/// \param parent The parent widget.
+Control::Control(QObject *parent) : DsoControl(parent) {
+  this->timer = 0;
+
+  for (int channel = 0; channel < SYNTHETIC_CHANNELS; ++channel) {
+    this->channel[channel].used = false;
+    this->channel[channel].gain = 8.0;
+    this->channel[channel].offset = 0.5;
+  }
+  this->channel[0].used = true;
+
+  // The second channel shows a square wave by default
+  Signal signal;
+  signal.waveform = WAVEFORM_SQUARE;
+  this->generator[1].setSignal(signal);
+
+  this->recordLengths << UINT_MAX << 1024 << 10240 << 102400 << 1048576
+                      << 10485760;
+  this->recordLengthId = 2;
+  this->samplerate = 1e6;
+  this->targetDuration = 0.01;
+  this->samplerateSet = true;
+
+  this->triggerMode = Dso::TRIGGERMODE_NORMAL;
+  this->triggerSlope = Dso::SLOPE_POSITIVE;
+  this->triggerPosition = 0.0;
+
+  this->samples.resize(SYNTHETIC_CHANNELS);
+}
+
+/// \brief Stops the generation.
+Control::~Control() {
+  this->quit();
+  this->wait();
+}
+
+/// \brief Gets the generated channel count.
+/// \return The number of channels.
+unsigned int Control::getChannelCount() { return SYNTHETIC_CHANNELS; }
+
+/// \brief Get available record lengths.
+/// \return The record lengths, UINT_MAX for roll mode.
+QList<unsigned int> *Control::getAvailableRecordLengths() {
+  return &this->recordLengths;
+}
+
+/// \brief Get the minimum samplerate.
+/// \return The minimum samplerate in S/s.
+double Control::getMinSamplerate() { return SYNTHETIC_SAMPLERATE_MIN; }
+
+/// \brief Get the maximum samplerate.
+/// \return The maximum samplerate in S/s.
+double Control::getMaxSamplerate() { return SYNTHETIC_SAMPLERATE_MAX; }
+
+/// \brief Sets the signal generated for a channel.
+/// \param channel The channel that should be set.
+/// \param signal The parameters of the signal.
+/// \return See ::Dso::ErrorCode.
+int Control::setSignal(unsigned int channel, const Signal &signal) {
+  if (channel >= SYNTHETIC_CHANNELS)
+    return Dso::ERROR_PARAMETER;
+
+  this->generator[channel].setSignal(signal);
+  return Dso::ERROR_NONE;
+}
+
+/// \brief Generates acquisitions until the device gets disconnected.
+void Control::run() {
+  this->timer = new QTimer();
+  connect(this->timer, SIGNAL(timeout()), this, SLOT(handler()),
+          Qt::DirectConnection);
+
+  this->rollTimer.start();
+  this->updateInterval();
+  this->timer->start();
+
+  // The generation is running until the device is disconnected
+  exec();
+
+  this->timer->stop();
+  delete this->timer;
+  this->timer = 0;
+
+  emit statusMessage(tr("The device has been disconnected"), 0);
+}
+
+/// \brief Updates the interval of the periodic generation timer.
+void Control::updateInterval() {
+  if (!this->timer)
+    return;
+
+  // One acquisition per record time, as often as possible at high samplerates
+  int cycleTime = SYNTHETIC_ROLL_INTERVAL;
+  if (!this->isRollMode())
+    cycleTime = qBound(1,
+                       (int)(this->recordLengths[this->recordLengthId] /
+                             this->samplerate * 1000),
+                       1000);
+
+  this->timer->setInterval(cycleTime);
+}
+
+/// \brief Checks if the roll mode is selected.
+/// \return true, if the samples are sent as continuous blocks.
+bool Control::isRollMode() const {
+  return this->recordLengths[this->recordLengthId] == UINT_MAX;
+}
+
+/// \brief Generates the samples of all used channels.
+/// \param sampleCount The number of samples per channel.
+/// \param align true to move periodic signals to the trigger position.
+void Control::generateSamples(unsigned int sampleCount, bool align) {
+  this->samplesMutex.lock();
+
+  for (int channel = 0; channel < SYNTHETIC_CHANNELS; ++channel) {
+    if (!this->channel[channel].used) {
+      this->samples[channel].clear();
+      continue;
+    }
+
+    if (align) {
+      // Rising or falling edge at the trigger position
+      const Signal &signal = this->generator[channel].getSignal();
+      double phase = -this->triggerPosition * signal.frequency;
+      if (this->triggerSlope == Dso::SLOPE_NEGATIVE)
+        phase += 0.5;
+      this->generator[channel].setPhase(phase);
+    }
+
+    this->samples[channel].resize(sampleCount);
+    double *data = &this->samples[channel].front();
+    this->generator[channel].generate(data, sampleCount, this->samplerate);
+
+    // Clip like the ADC of a real oscilloscope
+    const double minimum =
+        -this->channel[channel].offset * this->channel[channel].gain;
+    const double maximum = minimum + this->channel[channel].gain;
+    for (unsigned int position = 0; position < sampleCount; ++position)
+      data[position] = qBound(minimum, data[position], maximum);
+  }
+
+  this->samplesMutex.unlock();
+}
+
+/// \brief Sends the next acquisition or roll block.
+void Control::handler() {
+  if (!this->sampling)
+    return;
+
+  if (this->isRollMode()) {
+    // Generate the samples of the time that passed since the last block
+    unsigned int sampleCount = (unsigned int)qMin(
+        this->rollTimer.restart() * this->samplerate / 1000,
+        (double)SYNTHETIC_ROLL_MAXIMUM);
+    if (sampleCount == 0)
+      return;
+
+    this->generateSamples(sampleCount, false);
+    emit samplesAvailable(&(this->samples), this->samplerate, true,
+                          &(this->samplesMutex));
+    return;
+  }
+
+  this->generateSamples(this->recordLengths[this->recordLengthId],
+                        this->triggerMode != Dso::TRIGGERMODE_AUTO);
+  emit samplesAvailable(&(this->samples), this->samplerate, false,
+                        &(this->samplesMutex));
+
+  if (this->triggerMode == Dso::TRIGGERMODE_SINGLE)
+    this->stopSampling();
+}
+
+/// \brief Starts the generation thread.
+void Control::connectDevice() {
+  emit statusMessage(tr("Synthetic signal source"), 0);
+
+  // Emit signals for initial settings
+  emit availableRecordLengthsChanged(this->recordLengths);
+  emit samplerateLimitsChanged(SYNTHETIC_SAMPLERATE_MIN,
+                               SYNTHETIC_SAMPLERATE_MAX);
+  emit recordLengthChanged(this->recordLengths[this->recordLengthId]);
+  if (!this->isRollMode())
+    emit recordTimeChanged(this->recordLengths[this->recordLengthId] /
+                           this->samplerate);
+  emit samplerateChanged(this->samplerate);
+
+  DsoControl::connectDevice();
+}
+
+/// \brief Sets the number of samples per acquisition.
+/// \param index The record length index that should be set.
+/// \return The record length that has been set, 0 on error.
+unsigned int Control::setRecordLength(unsigned int index) {
+  if (index >= (unsigned int)this->recordLengths.size())
+    return 0;
+
+  this->recordLengthId = index;
+  this->rollTimer.restart();
+
+  // Keep the requested samplerate or record time
+  if (this->samplerateSet)
+    this->setSamplerate();
+  else
+    this->setRecordTime();
+
+  emit recordLengthChanged(this->recordLengths[this->recordLengthId]);
+  return this->recordLengths[this->recordLengthId];
+}
+
+/// \brief Sets the samplerate, every samplerate within the limits is exact.
+/// \param samplerate The samplerate that should be met (S/s), 0.0 to restore
+/// current samplerate.
+/// \return The samplerate that has been set.
+double Control::setSamplerate(double samplerate) {
+  if (samplerate == 0.0)
+    samplerate = this->samplerate;
+  this->samplerate =
+      qBound(SYNTHETIC_SAMPLERATE_MIN, samplerate, SYNTHETIC_SAMPLERATE_MAX);
+  this->samplerateSet = true;
+
+  this->updateInterval();
+  if (!this->isRollMode())
+    emit recordTimeChanged(this->recordLengths[this->recordLengthId] /
+                           this->samplerate);
+  emit samplerateChanged(this->samplerate);
+
+  return this->samplerate;
+}
+
+/// \brief Sets the time duration of one aquisition by adapting the samplerate.
+/// \param duration The record time duration that should be met (s), 0.0 to
+/// restore current record time.
+/// \return The record time duration that has been set, 0.0 on error.
+double Control::setRecordTime(double duration) {
+  if (duration == 0.0)
+    duration = this->targetDuration;
+  if (duration <= 0.0)
+    return 0.0;
+  this->targetDuration = duration;
+
+  // The roll mode keeps the samplerate
+  if (!this->isRollMode())
+    this->setSamplerate(this->recordLengths[this->recordLengthId] / duration);
+  this->samplerateSet = false;
+
+  if (this->isRollMode())
+    return duration;
+  return this->recordLengths[this->recordLengthId] / this->samplerate;
+}
+
+/// \brief Enables/disables the generation for the given channel.
+/// \param channel The channel that should be set.
+/// \param used true if the channel should be generated.
+/// \return See ::Dso::ErrorCode.
+int Control::setChannelUsed(unsigned int channel, bool used) {
+  if (channel >= SYNTHETIC_CHANNELS)
+    return Dso::ERROR_PARAMETER;
+
+  this->channel[channel].used = used;
+  return Dso::ERROR_NONE;
+}
+
+/// \brief Set the coupling for the given channel, the signals have no DC part.
+/// \param channel The channel that should be set.
+/// \param coupling The new coupling for the channel.
+/// \return See ::Dso::ErrorCode.
+int Control::setCoupling(unsigned int channel, Dso::Coupling coupling) {
+  Q_UNUSED(coupling);
+
+  if (channel >= SYNTHETIC_CHANNELS)
+    return Dso::ERROR_PARAMETER;
+
+  return Dso::ERROR_NONE;
+}
+
+/// \brief Sets the gain for the given channel.
+/// \param channel The channel that should be set.
+/// \param gain The full scale voltage range (V).
+/// \return The gain that has been set, ::Dso::ErrorCode on error.
+double Control::setGain(unsigned int channel, double gain) {
+  if (channel >= SYNTHETIC_CHANNELS)
+    return Dso::ERROR_PARAMETER;
+
+  this->channel[channel].gain = gain;
+  return gain;
+}
+
+/// \brief Set the offset for the given channel.
+/// \param channel The channel that should be set.
+/// \param offset The new offset value (0.0 - 1.0).
+/// \return The offset that has been set, ::Dso::ErrorCode on error.
+double Control::setOffset(unsigned int channel, double offset) {
+  if (channel >= SYNTHETIC_CHANNELS)
+    return Dso::ERROR_PARAMETER;
+
+  this->channel[channel].offset = qBound(0.0, offset, 1.0);
+  return this->channel[channel].offset;
+}
+
+/// \brief Set the trigger mode.
+/// \return See ::Dso::ErrorCode.
+int Control::setTriggerMode(Dso::TriggerMode mode) {
+  if (mode < Dso::TRIGGERMODE_AUTO || mode >= Dso::TRIGGERMODE_COUNT)
+    return Dso::ERROR_PARAMETER;
+
+  this->triggerMode = mode;
+  return Dso::ERROR_NONE;
+}
+
+/// \brief Set the trigger source, every channel is aligned to the trigger.
+/// \param special true for a special channel, they aren't supported.
+/// \param id The number of the channel.
+/// \return See ::Dso::ErrorCode.
+int Control::setTriggerSource(bool special, unsigned int id) {
+  if (special || id >= SYNTHETIC_CHANNELS)
+    return Dso::ERROR_PARAMETER;
+
+  return Dso::ERROR_NONE;
+}
+
+/// \brief Set the trigger level, the signals are aligned to their zero
+/// crossing.
+/// \param channel The channel that should be set.
+/// \param level The new trigger level (V).
+/// \return The trigger level that has been set, ::Dso::ErrorCode on error.
+double Control::setTriggerLevel(unsigned int channel, double level) {
+  if (channel >= SYNTHETIC_CHANNELS)
+    return Dso::ERROR_PARAMETER;
+
+  return level;
+}
+
+/// \brief Set the trigger slope.
+/// \param slope The Slope that should cause a trigger.
+/// \return See ::Dso::ErrorCode.
+int Control::setTriggerSlope(Dso::Slope slope) {
+  if (slope != Dso::SLOPE_NEGATIVE && slope != Dso::SLOPE_POSITIVE)
+    return Dso::ERROR_PARAMETER;
+
+  this->triggerSlope = slope;
+  return Dso::ERROR_NONE;
+}
+
+/// \brief Set the trigger position.
+/// \param position The new trigger position (in s).
+/// \return The trigger position that has been set.
+double Control::setPretriggerPosition(double position) {
+  this->triggerPosition = qMax(0.0, position);
+  return this->triggerPosition;
+}
+
+/// \brief Forces a trigger event, the signals are always triggered.
+/// \return See ::Dso::ErrorCode.
+int Control::forceTrigger() { return Dso::ERROR_NONE; }
+
+#ifdef DEBUG
+/// \brief Sends commands directly, there's no device to send them to.
+/// \param command The command as string.
+/// \return See ::Dso::ErrorCode.
+int Control::stringCommand(QString command) {
+  Q_UNUSED(command);
+
+  return Dso::ERROR_UNSUPPORTED;
+}
+#endif
+}
@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file synthetic/control.h
+/// \brief Declares the Synthetic::Control class.
+//
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef SYNTHETIC_CONTROL_H
+#define SYNTHETIC_CONTROL_H
+
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QMutex>
+
+#include "dsocontrol.h"
+#include "synthetic/generator.h"
+
+#define SYNTHETIC_CHANNELS 2             ///< Number of generated channels
+#define SYNTHETIC_SAMPLERATE_MIN 1.0     ///< The lowest samplerate in S/s
+#define SYNTHETIC_SAMPLERATE_MAX 1e10    ///< The highest samplerate in S/s
+#define SYNTHETIC_ROLL_INTERVAL 20       ///< Time between roll blocks in ms
+#define SYNTHETIC_ROLL_MAXIMUM (1 << 24) ///< Maximum samples per roll block
+
+class QTimer;
+
+namespace Synthetic {
+//////////////////////////////////////////////////////////////////////////////
+/// \struct ControlChannel                                  synthetic/control.h
+/// \brief The settings of one generated channel.
+struct ControlChannel {
+  bool used;     ///< true, if the channel is generated
+  double gain;   ///< The full scale voltage range in V
+  double offset; ///< The offset as fraction of the range (0.0 - 1.0)
+};
+
+//////////////////////////////////////////////////////////////////////////////
+/// \class Control                                          synthetic/control.h
+/// \brief Virtual oscilloscope that generates synthetic signals.
+/// It supports arbitrary samplerates and record lengths far beyond the real
+/// devices, which makes it useful to load-test the analyzer and the graphs.
+/// Periodic signals are aligned to the trigger position, in roll mode the
+/// signals continue seamlessly from block to block.
+class Control : public DsoControl {
+  Q_OBJECT
+
+public:
+  Control(QObject *parent = 0);
+  ~Control();
+
+  unsigned int getChannelCount();
+  QList<unsigned int> *getAvailableRecordLengths();
+  double getMinSamplerate();
+  double getMaxSamplerate();
+
+  int setSignal(unsigned int channel, const Signal &signal);
+
+protected:
+  void run();
+  void updateInterval();
+
+  bool isRollMode() const;
+  void generateSamples(unsigned int sampleCount, bool align);
+
+  QTimer *timer; ///< Timer for periodic generation
+
+  Generator generator[SYNTHETIC_CHANNELS];    ///< Signal generator per channel
+  ControlChannel channel[SYNTHETIC_CHANNELS]; ///< Settings per channel
+
+  QList<unsigned int> recordLengths; ///< Available record lengths
+  unsigned int recordLengthId;       ///< The id in the record length array
+  double samplerate;                 ///< The current samplerate in S/s
+  double targetDuration;             ///< The requested record time in s
+  bool samplerateSet;                ///< true, if the samplerate was set last
+  Dso::TriggerMode triggerMode;      ///< The trigger mode
+  Dso::Slope triggerSlope;           ///< The slope the signals start with
+  double triggerPosition;            ///< Pretrigger position in s
+
+  std::vector<std::vector<double>>
+      samples;             ///< Sample data vectors sent to the data analyzer
+  QMutex samplesMutex;     ///< Mutex for the sample data
+  QElapsedTimer rollTimer; ///< Time since the last roll block
+
+public slots:
+  virtual void connectDevice();
+
+  unsigned int setRecordLength(unsigned int index);
+  double setSamplerate(double samplerate = 0.0);
+  double setRecordTime(double duration = 0.0);
+
+  int setChannelUsed(unsigned int channel, bool used);
+  int setCoupling(unsigned int channel, Dso::Coupling coupling);
+  double setGain(unsigned int channel, double gain);
+  double setOffset(unsigned int channel, double offset);
+
+  int setTriggerMode(Dso::TriggerMode mode);
+  int setTriggerSource(bool special, unsigned int id);
+  double setTriggerLevel(unsigned int channel, double level);
+  int setTriggerSlope(Dso::Slope slope);
+  double setPretriggerPosition(double position);
+  int forceTrigger();
+
+#ifdef DEBUG
+  int stringCommand(QString command);
+#endif
+
+protected slots:
+  void handler();
+};
+}
+
+#endif
@@ -0,0 +1,257 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  synthetic/generator.cpp
+//
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <cmath>
+
+#include <QStringList>
+
+#include "synthetic/generator.h"
+
+#include "helper.h"
+
+namespace Synthetic {
+////////////////////////////////////////////////////////////////////////////////
+// struct Synthetic::Signal
+/// \brief Initializes a 1 kHz sine wave with 1 V amplitude.
+Signal::Signal() {
+  this->waveform = WAVEFORM_SINE;
+  this->frequency = 1e3;
+  this->amplitude = 1.0;
+  this->modulation = 1e2;
+  this->noise = 0.0;
+}
+
+/// \brief Reads the signal from a description.
+/// The description has the form waveform[:frequency[:amplitude[:modulation[:
+/// noise]]]], for example "am:10kHz:2V:500Hz". The waveforms are sine,
+/// square, noise, burst, glitch and am.
+/// \param text The description of the signal.
+/// \return false if the description is invalid.
+bool Signal::parse(const QString &text) {
+  static const char *names[WAVEFORM_COUNT] = {"sine",  "square", "noise",
+                                              "burst", "glitch", "am"};
+
+  QStringList fields = text.split(':');
+  int waveform;
+  for (waveform = 0; waveform < WAVEFORM_COUNT; ++waveform)
+    if (fields[0].trimmed() == names[waveform])
+      break;
+  if (waveform == WAVEFORM_COUNT)
+    return false;
+  this->waveform = (Waveform)waveform;
+
+  double *values[] = {&this->frequency, &this->amplitude, &this->modulation,
+                      &this->noise};
+  const Helper::Unit units[] = {Helper::UNIT_HERTZ, Helper::UNIT_VOLTS,
+                                Helper::UNIT_HERTZ, Helper::UNIT_VOLTS};
+  for (int field = 1; field < fields.size(); ++field) {
+    if (field > 4)
+      return false;
+
+    bool ok;
+    double value = Helper::stringToValue(fields[field].trimmed(),
+                                         units[field - 1], &ok);
+    if (!ok || value < 0.0)
+      return false;
+    *values[field - 1] = value;
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class Synthetic::Generator
+/// \brief Initializes the generator with the default signal.
+Generator::Generator() {
+  this->phase = 0;
+  this->modulationPhase = 0;
+  this->noisePosition = 0;
+  this->random = 1;
+  this->phases.resize(SYNTHETIC_BLOCK);
+}
+
+/// \brief Sets the parameters of the generated signal.
+/// \param signal The new signal.
+void Generator::setSignal(const Signal &signal) { this->signal = signal; }
+
+/// \brief Returns the parameters of the generated signal.
+/// \return The current signal.
+const Signal &Generator::getSignal() const { return this->signal; }
+
+/// \brief Moves the signal to the given phase.
+/// \param phase The new phase in periods, only the fraction is used.
+void Generator::setPhase(double phase) {
+  this->phase = (quint32)(qint64)((phase - floor(phase)) * 4294967296.0);
+}
+
+/// \brief Generates the next samples of the signal.
+/// \param data Receives the samples in V.
+/// \param count The number of samples that should be generated.
+/// \param samplerate The samplerate in S/s.
+void Generator::generate(double *data, unsigned int count, double samplerate) {
+  // Phase increments per sample as fraction of 2^32
+  double step = this->signal.frequency / samplerate;
+  quint32 increment = (quint32)(qint64)((step - floor(step)) * 4294967296.0);
+  step = this->signal.modulation / samplerate;
+  quint32 modulationIncrement =
+      (quint32)(qint64)((step - floor(step)) * 4294967296.0);
+
+  for (unsigned int position = 0; position < count;
+       position += SYNTHETIC_BLOCK)
+    this->generateBlock(data + position,
+                        qMin(count - position, (unsigned int)SYNTHETIC_BLOCK),
+                        increment, modulationIncrement);
+}
+
+/// \brief Generates one block of samples.
+/// \param data Receives the samples in V.
+/// \param count The number of samples, at most SYNTHETIC_BLOCK.
+/// \param increment The phase increment per sample.
+/// \param modulationIncrement The modulation phase increment per sample.
+void Generator::generateBlock(double *data, unsigned int count,
+                              quint32 increment, quint32 modulationIncrement) {
+  const double *sine = &sineTable().front();
+  const double *noise = &noiseTable().front();
+  const int shift = 32 - SYNTHETIC_TABLE_BITS;
+  const double amplitude = this->signal.amplitude;
+  quint32 *phases = &this->phases.front();
+
+  // The phase of every sample in this block
+  switch (this->signal.waveform) {
+  case WAVEFORM_BURST:
+  case WAVEFORM_GLITCH:
+  case WAVEFORM_AM:
+    for (unsigned int index = 0; index < count; ++index)
+      phases[index] = this->modulationPhase + index * modulationIncrement;
+    break;
+  default:
+    break;
+  }
+
+  // Envelope or spikes from the modulation phase
+  switch (this->signal.waveform) {
+  case WAVEFORM_BURST:
+    for (unsigned int index = 0; index < count; ++index)
+      data[index] = (phases[index] >> 30) == 0;
+    break;
+  case WAVEFORM_GLITCH:
+    for (unsigned int index = 0; index < count; ++index)
+      data[index] = (phases[index] < modulationIncrement) * amplitude;
+    break;
+  case WAVEFORM_AM:
+    for (unsigned int index = 0; index < count; ++index)
+      data[index] = (2.0 + sine[phases[index] >> shift]) / 3.0;
+    break;
+  default:
+    break;
+  }
+
+  for (unsigned int index = 0; index < count; ++index)
+    phases[index] = this->phase + index * increment;
+
+  // The signal itself
+  switch (this->signal.waveform) {
+  case WAVEFORM_SINE:
+    for (unsigned int index = 0; index < count; ++index)
+      data[index] = amplitude * sine[phases[index] >> shift];
+    break;
+  case WAVEFORM_SQUARE:
+    for (unsigned int index = 0; index < count; ++index)
+      data[index] = amplitude * (1.0 - 2.0 * (phases[index] >> 31));
+    break;
+  case WAVEFORM_NOISE: {
+    this->random = this->random * 1664525 + 1013904223;
+    unsigned int position = this->random >> 16;
+    for (unsigned int index = 0; index < count; ++index)
+      data[index] =
+          amplitude * noise[(position + index) & (SYNTHETIC_NOISE_SIZE - 1)];
+    break;
+  }
+  case WAVEFORM_BURST:
+  case WAVEFORM_AM:
+    for (unsigned int index = 0; index < count; ++index)
+      data[index] *= amplitude * sine[phases[index] >> shift];
+    break;
+  case WAVEFORM_GLITCH:
+    for (unsigned int index = 0; index < count; ++index)
+      data[index] += amplitude * (1.0 - 2.0 * (phases[index] >> 31));
+    break;
+  default:
+    break;
+  }
+
+  // Additional noise
+  if (this->signal.noise > 0.0) {
+    this->random = this->random * 1664525 + 1013904223;
+    unsigned int position = this->random >> 16;
+    const double level = this->signal.noise;
+    for (unsigned int index = 0; index < count; ++index)
+      data[index] +=
+          level * noise[(position + index) & (SYNTHETIC_NOISE_SIZE - 1)];
+  }
+
+  this->phase += count * increment;
+  this->modulationPhase += count * modulationIncrement;
+}
+
+/// \brief Returns one period of a sine wave.
+/// \return The table with 2^SYNTHETIC_TABLE_BITS values.
+const std::vector<double> &Generator::sineTable() {
+  static const std::vector<double> table = createSineTable();
+  return table;
+}
+
+/// \brief Returns the precomputed gaussian noise.
+/// \return The table with SYNTHETIC_NOISE_SIZE values.
+const std::vector<double> &Generator::noiseTable() {
+  static const std::vector<double> table = createNoiseTable();
+  return table;
+}
+
+/// \brief Calculates one period of a sine wave.
+/// \return The table with 2^SYNTHETIC_TABLE_BITS values.
+std::vector<double> Generator::createSineTable() {
+  std::vector<double> table(1 << SYNTHETIC_TABLE_BITS);
+  for (unsigned int index = 0; index < table.size(); ++index)
+    table[index] = sin(2.0 * M_PI * index / table.size());
+
+  return table;
+}
+
+/// \brief Calculates gaussian noise with a standard deviation of 1/3.
+/// The values are the same on every run, so load tests are reproducible.
+/// \return The table with SYNTHETIC_NOISE_SIZE values.
+std::vector<double> Generator::createNoiseTable() {
+  std::vector<double> table(SYNTHETIC_NOISE_SIZE);
+  quint32 state = 12345;
+  for (unsigned int index = 0; index < table.size(); index += 2) {
+    // Box-Muller transform of two uniform values in (0, 1]
+    state = state * 1664525 + 1013904223;
+    double first = (state + 1.0) / 4294967296.0;
+    state = state * 1664525 + 1013904223;
+    double second = (state + 1.0) / 4294967296.0;
+    double radius = sqrt(-2.0 * log(first)) / 3.0;
+    table[index] = radius * cos(2.0 * M_PI * second);
+    table[index + 1] = radius * sin(2.0 * M_PI * second);
+  }
+
+  return table;
+}
+}
@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file synthetic/generator.h
+/// \brief Declares the Synthetic::Generator class.
+//
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef SYNTHETIC_GENERATOR_H
+#define SYNTHETIC_GENERATOR_H
+
+#include <vector>
+
+#include <QString>
+#include <QtGlobal>
+
+#define SYNTHETIC_TABLE_BITS 14    ///< log2 of the sine table size
+#define SYNTHETIC_NOISE_SIZE 65536 ///< Size of the noise table, power of two
+#define SYNTHETIC_BLOCK 1024       ///< Samples generated per inner loop
+
+namespace Synthetic {
+//////////////////////////////////////////////////////////////////////////////
+/// \enum Waveform                                        synthetic/generator.h
+/// \brief The signal shapes the generator can produce.
+enum Waveform {
+  WAVEFORM_SINE,   ///< Sine wave
+  WAVEFORM_SQUARE, ///< Square wave with 50 % duty cycle
+  WAVEFORM_NOISE,  ///< Gaussian white noise
+  WAVEFORM_BURST,  ///< Sine bursts, on for a quarter of the modulation period
+  WAVEFORM_GLITCH, ///< Square wave with a spike every modulation period
+  WAVEFORM_AM,     ///< Sine carrier, amplitude modulated by a sine
+  WAVEFORM_COUNT   ///< The total number of waveforms
+};
+
+//////////////////////////////////////////////////////////////////////////////
+/// \struct Signal                                        synthetic/generator.h
+/// \brief The parameters of a synthetic signal.
+struct Signal {
+  Waveform waveform; ///< The shape of the signal
+  double frequency;  ///< The frequency of the signal or carrier in Hz
+  double amplitude;  ///< The peak amplitude in V
+  double modulation; ///< Burst, glitch or modulation frequency in Hz
+  double noise;      ///< Amplitude of the added noise in V
+
+  Signal();
+  bool parse(const QString &text);
+};
+
+//////////////////////////////////////////////////////////////////////////////
+/// \class Generator                                      synthetic/generator.h
+/// \brief Generates a synthetic signal block by block with continuous phase.
+/// The waveforms are looked up in precomputed tables through 32 bit phase
+/// accumulators. Each block is generated in a few simple passes over
+/// contiguous arrays that the compiler can vectorize.
+class Generator {
+public:
+  Generator();
+
+  void setSignal(const Signal &signal);
+  const Signal &getSignal() const;
+
+  void setPhase(double phase);
+  void generate(double *data, unsigned int count, double samplerate);
+
+protected:
+  void generateBlock(double *data, unsigned int count, quint32 increment,
+                     quint32 modulationIncrement);
+
+private:
+  static const std::vector<double> &sineTable();
+  static const std::vector<double> &noiseTable();
+  static std::vector<double> createSineTable();
+  static std::vector<double> createNoiseTable();
+
+  Signal signal;               ///< The parameters of the signal
+  quint32 phase;               ///< Phase of the signal or carrier
+  quint32 modulationPhase;     ///< Phase of the modulation
+  unsigned int noisePosition;  ///< Next value read from the noise table
+  quint32 random;              ///< State of the noise position generator
+  std::vector<quint32> phases; ///< Phase of each sample in the block
+};
+}
+
+#endif
@@ -0,0 +1,240 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+//  tracing.cpp
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QThread>
+
+#include "tracing.h"
+
+namespace Tracing {
+static QAtomicInt enabled;                     ///< 1 while spans are recorded
+static QAtomicInteger<unsigned int> lastFrame; ///< Id of the latest frame
+
+static QMutex ringsMutex;                 ///< Protects the list of rings
+static std::vector<Ring *> rings;         ///< The rings of all traced threads
+static thread_local Ring *threadRing = 0; ///< The ring of this thread
+
+/// \brief Returns the ring of the calling thread, creates it on first use.
+/// \return The ring the spans of this thread are appended to.
+static Ring *currentRing() {
+  if (threadRing)
+    return threadRing;
+
+  QString name;
+  QThread *thread = QThread::currentThread();
+  if (thread) {
+    name = thread->objectName();
+    if (name.isEmpty())
+      name = thread->metaObject()->className();
+  }
+
+  // The rings stay alive after their threads finished to keep the spans
+  QMutexLocker locker(&ringsMutex);
+  threadRing = new Ring((int)rings.size() + 1, name);
+  rings.push_back(threadRing);
+
+  return threadRing;
+}
+
+/// \brief Creates the started clock for now().
+/// \return A started timer.
+static QElapsedTimer startClock() {
+  QElapsedTimer clock;
+  clock.start();
+  return clock;
+}
+
+/// \brief Escapes a string for a JSON string literal.
+/// \param text The unescaped text.
+/// \return The text with escaped quotes and backslashes.
+static QString escape(const QString &text) {
+  QString escaped = text;
+  escaped.replace('\\', "\\\\");
+  escaped.replace('"', "\\\"");
+  return escaped;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class Tracing::Ring
+/// \brief Allocates the ring buffer.
+/// \param thread The id of the thread in the export.
+/// \param name The name of the thread.
+Ring::Ring(int thread, const QString &name) {
+  this->spans.resize(TRACING_RING_SIZE);
+  this->head.storeRelease(0);
+  this->full.storeRelease(0);
+  this->thread = thread;
+  this->name = name;
+}
+
+/// \brief Appends a span, overwriting the oldest one if the ring is full.
+/// \param span The finished span.
+void Ring::append(const Span &span) {
+  unsigned int head = this->head.loadAcquire();
+  this->spans[head & (TRACING_RING_SIZE - 1)] = span;
+  if (head + 1 >= TRACING_RING_SIZE)
+    this->full.storeRelease(1);
+  this->head.storeRelease(head + 1);
+}
+
+/// \brief Copies the spans that are in the ring.
+/// \param spans The spans are appended to this vector, oldest first.
+void Ring::copy(std::vector<Span> *spans) const {
+  unsigned int end = this->head.loadAcquire();
+  unsigned int count = end;
+  if (this->full.loadAcquire() || count > TRACING_RING_SIZE)
+    count = TRACING_RING_SIZE;
+
+  size_t first = spans->size();
+  for (unsigned int index = end - count; index != end; ++index)
+    spans->push_back(this->spans[index & (TRACING_RING_SIZE - 1)]);
+
+  // Drop the spans the writer may have overwritten while copying
+  qint64 overwritten = (qint64)(this->head.loadAcquire() - end) + 1 -
+                       (TRACING_RING_SIZE - count);
+  if (overwritten > 0)
+    spans->erase(spans->begin() + first,
+                 spans->begin() + first + qMin(overwritten, (qint64)count));
+}
+
+/// \brief Get the id of the thread.
+/// \return The id of the thread in the export.
+int Ring::getThread() const { return this->thread; }
+
+/// \brief Get the name of the thread.
+/// \return The name of the thread, class name of the QThread if unnamed.
+const QString &Ring::getName() const { return this->name; }
+
+////////////////////////////////////////////////////////////////////////////////
+// class Tracing::Scope
+/// \brief Starts a span for the latest frame.
+/// \param name The name of the stage, has to be a string literal.
+Scope::Scope(const char *name) {
+  this->name = name;
+  this->frame = 0;
+  this->start = -1;
+  if (enabled.loadAcquire()) {
+    this->frame = lastFrame.loadAcquire();
+    this->start = now();
+  }
+}
+
+/// \brief Starts a span for the given frame.
+/// \param name The name of the stage, has to be a string literal.
+/// \param frame The id of the processed acquisition.
+Scope::Scope(const char *name, unsigned int frame) {
+  this->name = name;
+  this->frame = frame;
+  this->start = enabled.loadAcquire() ? now() : -1;
+}
+
+/// \brief Appends the span to the ring of the calling thread.
+Scope::~Scope() {
+  if (this->start < 0)
+    return;
+
+  Span span;
+  span.name = this->name;
+  span.frame = this->frame;
+  span.start = this->start;
+  span.duration = now() - this->start;
+  currentRing()->append(span);
+}
+
+/// \brief Changes the frame, if it's only known after the span started.
+/// \param frame The id of the processed acquisition.
+void Scope::setFrame(unsigned int frame) { this->frame = frame; }
+
+////////////////////////////////////////////////////////////////////////////////
+// Tracing functions
+/// \brief Starts or stops recording spans.
+/// \param enable true to record spans.
+void setEnabled(bool enable) {
+  now(); // Start the clock
+  enabled.storeRelease(enable ? 1 : 0);
+}
+
+/// \brief Checks if spans are recorded.
+/// \return true, if tracing is enabled.
+bool isEnabled() { return enabled.loadAcquire() != 0; }
+
+/// \brief Sets the id of the latest acquisition.
+/// The stages that process the data afterwards use this id for their spans.
+/// \param frame The id of the acquisition.
+void setFrame(unsigned int frame) { lastFrame.storeRelease(frame); }
+
+/// \brief Get the id of the latest acquisition.
+/// \return The id set with setFrame().
+unsigned int getFrame() { return lastFrame.loadAcquire(); }
+
+/// \brief Get the time of the tracing clock.
+/// \return Monotonic time in ns since the clock started.
+qint64 now() {
+  static const QElapsedTimer clock = startClock();
+  return clock.nsecsElapsed();
+}
+
+/// \brief Writes all recorded spans as Chrome trace event JSON.
+/// The file can be opened with chrome://tracing or Perfetto.
+/// \param fileName The name of the JSON file.
+/// \return true, if the file was written.
+bool exportChrome(const QString &fileName) {
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    return false;
+
+  QTextStream stream(&file);
+  stream << "{\"traceEvents\":[";
+  bool first = true;
+
+  QMutexLocker locker(&ringsMutex);
+  std::vector<Span> spans;
+  for (size_t index = 0; index < rings.size(); ++index) {
+    Ring *ring = rings[index];
+    if (!first)
+      stream << ",";
+    first = false;
+    stream << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+           << ring->getThread() << ",\"args\":{\"name\":\""
+           << escape(ring->getName()) << "\"}}";
+
+    spans.clear();
+    ring->copy(&spans);
+    for (size_t span = 0; span < spans.size(); ++span) {
+      stream << ",\n{\"name\":\"" << escape(spans[span].name)
+             << "\",\"cat\":\"openhantek\",\"ph\":\"X\",\"ts\":"
+             << QString::number(spans[span].start / 1000.0, 'f', 3)
+             << ",\"dur\":"
+             << QString::number(spans[span].duration / 1000.0, 'f', 3)
+             << ",\"pid\":1,\"tid\":" << ring->getThread()
+             << ",\"args\":{\"frame\":" << spans[span].frame << "}}";
+    }
+  }
+
+  stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  stream.flush();
+
+  return stream.status() == QTextStream::Ok && file.error() == QFile::NoError;
+}
+}
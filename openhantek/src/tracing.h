@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  OpenHantek
+/// \file tracing.h
+/// \brief Declares the latency tracing of the processing stages.
+//
+//  This program is free software: you can redistribute it and/or modify it
+//  under the terms of the GNU General Public License as published by the Free
+//  Software Foundation, either version 3 of the License, or (at your option)
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful, but WITHOUT
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//  more details.
+//
+//  You should have received a copy of the GNU General Public License along with
+//  this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <vector>
+
+#include <QAtomicInteger>
+#include <QString>
+#include <QtGlobal>
+
+#define TRACING_RING_SIZE 16384 ///< Spans kept per thread, power of two
+
+namespace Tracing {
+//////////////////////////////////////////////////////////////////////////////
+/// \struct Span                                                     tracing.h
+/// \brief A timed section of one processing stage.
+struct Span {
+  const char *name;   ///< Name of the stage, has to be a string literal
+  unsigned int frame; ///< Id of the acquisition that was processed
+  qint64 start;       ///< Start time in ns since the tracing clock started
+  qint64 duration;    ///< Duration in ns
+};
+
+//////////////////////////////////////////////////////////////////////////////
+/// \class Ring                                                      tracing.h
+/// \brief The latest spans of one thread.
+/// Only the owning thread appends, the export can read the ring at any time
+/// without stopping the writer.
+class Ring {
+public:
+  Ring(int thread, const QString &name);
+
+  void append(const Span &span);
+  void copy(std::vector<Span> *spans) const;
+
+  int getThread() const;
+  const QString &getName() const;
+
+private:
+  std::vector<Span> spans;           ///< The ring buffer
+  QAtomicInteger<unsigned int> head; ///< Number of spans ever appended
+  QAtomicInteger<unsigned int> full; ///< 1 once the ring has wrapped
+  int thread;                        ///< Id of the thread in the export
+  QString name;                      ///< Name of the thread
+};
+
+//////////////////////////////////////////////////////////////////////////////
+/// \class Scope                                                     tracing.h
+/// \brief Records a span from its construction until it is destroyed.
+class Scope {
+public:
+  Scope(const char *name);
+  Scope(const char *name, unsigned int frame);
+  ~Scope();
+
+  void setFrame(unsigned int frame);
+
+private:
+  const char *name;   ///< Name of the stage
+  unsigned int frame; ///< Id of the processed acquisition
+  qint64 start;       ///< Start time, -1 if tracing was disabled
+};
+
+void setEnabled(bool enable);
+bool isEnabled();
+
+void setFrame(unsigned int frame);
+unsigned int getFrame();
+
+qint64 now();
+bool exportChrome(const QString &fileName);
+}
+
+#endif
@@ -758,7 +758,7 @@
     </message>
 </context>
 <context>
-    <name>QApplication</name>
+    <name>QCoreApplication</name>
     <message>
         <location filename="../src/helper.cpp" line="49"/>
         <source>Success (no error)</source>
@@ -776,7 +776,7 @@
     </message>
 </context>
 <context>
-    <name>QApplication</name>
+    <name>QCoreApplication</name>
     <message>
         <location filename="../src/helper.cpp" line="47"/>
         <source>Success (no error)</source>